@@ -6,15 +6,17 @@
 #include "new_string.h"
 #include "str_view.h"
 #include "util.h"
+#include "edit_batch.h"
 
 
-typedef enum {ACTION_INSERT_STRING, ACTION_REMOVE_STRING} ACTION;
+typedef enum {ACTION_INSERT_STRING, ACTION_REMOVE_STRING, ACTION_BATCH} ACTION;
 
 
 typedef struct {
     size_t cursor; // start of area to insert/delete substr
     ACTION action;
     String str;
+    Edit_batch batch; // edits of ACTION_BATCH (undone and redone together)
 } Action;
 
 
@@ -30,17 +32,17 @@ static void Actions_insert(Actions* actions, const Action* new_action, size_t in
     if (actions->capacity < actions->count + 1) {
         if (actions->capacity == 0) {
             actions->capacity = TEXT_DEFAULT_CAP;
-            actions->items = safe_malloc(actions->capacity * sizeof(actions[0]));
-            memset(actions->items, 0, actions->capacity);
+            actions->items = safe_malloc(actions->capacity * sizeof(actions->items[0]));
+            memset(actions->items, 0, actions->capacity * sizeof(actions->items[0]));
         } else {
             size_t text_prev_capacity = actions->capacity;
             actions->capacity = actions->capacity * 2;
-            actions->items = safe_realloc(actions->items, actions->capacity * sizeof(actions[0]));
-            memset(actions->items + text_prev_capacity, 0, actions->capacity - text_prev_capacity);
+            actions->items = safe_realloc(actions->items, actions->capacity * sizeof(actions->items[0]));
+            memset(actions->items + text_prev_capacity, 0, (actions->capacity - text_prev_capacity) * sizeof(actions->items[0]));
         }
     }
     assert(actions->capacity >= actions->count + 1);
-    memmove(actions->items + index + 1, actions->items + index, actions->count - index);
+    memmove(actions->items + index + 1, actions->items + index, (actions->count - index) * sizeof(actions->items[0]));
     actions->items[index] = *new_action;
     actions->count++;
 }
@@ -53,7 +55,7 @@ static void Actions_append(Actions* actions, const Action* new_ch) {
 
 static bool Actions_del(Actions* actions, size_t index) {
     assert(index < actions->count);
-    memmove(actions->items + index, actions->items + index + 1, actions->count - index - 1);
+    memmove(actions->items + index, actions->items + index + 1, (actions->count - index - 1) * sizeof(actions->items[0]));
     actions->count--;
     return true;
 }
@@ -80,6 +82,7 @@ static void Actions_free(Actions* actions) {
 
     for (size_t idx = 0; idx < actions->count; idx++) {
         String_free_char_data(&actions->items[idx].str);
+        Edit_batch_free(&actions->items[idx].batch);
     }
     free(actions->items);
     memset(actions, 0, sizeof(*actions));
@@ -0,0 +1,274 @@
+// microbenchmarks for the cursor/line-navigation kernels in text_box.h
+//
+// every kernel is run over synthetic corpora (short lines, very long lines, crlf line endings, huge file),
+// and the time per call and the time per byte walked are reported
+// (the corpora are converted to \n line endings like a file that is opened, and the conversion is benchmarked too)
+//
+// usage: make bench
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "new_string.h"
+#include "text_box.h"
+#include "line_ending.h"
+#include "timing.h"
+
+
+// each benchmark is repeated until it has run for at least this long
+#define BENCH_MIN_NS 200000000ull
+
+#define BENCH_VISUAL_WIDTH 100
+
+typedef struct {
+    const char* name;
+    String file; // text as it is in a file
+    LINE_ENDING line_ending;
+    String text; // text with \n line endings, as it is edited
+
+    // precalculated, so that setting up a benchmark does not get timed
+    size_t visual_x_last_char;
+    size_t visual_y_middle;
+} Corpus;
+
+
+typedef struct {
+    uint64_t count_calls;
+    uint64_t count_bytes;
+} Bench_result;
+
+
+// prevents the compiler from removing benchmarked code
+static volatile size_t bench_sink;
+
+
+static void Corpus_generate(Corpus* corpus, const char* name, size_t count_lines, size_t min_len_line, size_t max_len_line, const char* line_ending) {
+    static const char words[] = "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor ";
+    corpus->name = name;
+    String_init(&corpus->file);
+    String_init(&corpus->text);
+
+    size_t len_line_ending = strlen(line_ending);
+    uint32_t rand_state = 12345;
+    for (size_t idx_line = 0; idx_line < count_lines; idx_line++) {
+        rand_state = rand_state * 1103515245 + 12345;
+        size_t len_line = min_len_line + (rand_state >> 8) % (max_len_line - min_len_line + 1);
+        vector_enlarge_if_nessessary_char(&corpus->file, corpus->file.count + len_line + len_line_ending);
+        for (size_t idx_col = 0; idx_col < len_line; idx_col++) {
+            corpus->file.items[corpus->file.count++] = words[(idx_line + idx_col) % (sizeof(words) - 1)];
+        }
+        String_append_cstr(&corpus->file, line_ending, len_line_ending);
+    }
+
+    String_cpy(&corpus->text, &corpus->file);
+    Line_ending_counts line_endings;
+    corpus->text.count = line_ending_normalize(&line_endings, corpus->text.items, 0, corpus->text.count);
+    corpus->line_ending = line_endings.first;
+    Column_map_invalidate_all();
+
+    corpus->visual_x_last_char = cal_visual_x_at_cursor(&corpus->text, corpus->text.count - 1, BENCH_VISUAL_WIDTH);
+    corpus->visual_y_middle = cal_visual_y_at_cursor(&corpus->text, corpus->text.count / 2, BENCH_VISUAL_WIDTH);
+}
+
+
+static Bench_result bench_advance_one(const Corpus* corpus, bool is_visual) {
+    const String* text = &corpus->text;
+    Bench_result result = {0};
+    Pos_data pos = {0};
+    while (CUR_ADV_PAST_END_BUFFER != Pos_data_advance_one(&pos, text, BENCH_VISUAL_WIDTH, is_visual)) {
+        result.count_calls++;
+    }
+    result.count_bytes = pos.cursor;
+    bench_sink += pos.visual_y;
+    return result;
+}
+
+
+static Bench_result bench_decrement_one(const Corpus* corpus, bool is_visual) {
+    const String* text = &corpus->text;
+    Bench_result result = {0};
+    Pos_data pos = {.cursor = text->count - 1, .visual_x = 0, .visual_y = SIZE_MAX / 2};
+    if (is_visual) {
+        pos.visual_x = corpus->visual_x_last_char;
+    }
+    size_t start_cursor = pos.cursor;
+    while (pos.cursor > 0) {
+        Pos_data_decrement_one(&pos, text, BENCH_VISUAL_WIDTH, is_visual);
+        result.count_calls++;
+    }
+    result.count_bytes = start_cursor - pos.cursor;
+    bench_sink += pos.visual_x;
+    return result;
+}
+
+
+static Bench_result bench_next_line(const Corpus* corpus, bool is_visual) {
+    const String* text = &corpus->text;
+    Bench_result result = {0};
+    Pos_data pos = {0};
+    while (get_start_next_generic_line_from_curr_cursor_x_pos(&pos, text, &pos, BENCH_VISUAL_WIDTH, is_visual)) {
+        result.count_calls++;
+    }
+    result.count_calls++;
+    result.count_bytes = text->count;
+    return result;
+}
+
+
+// the editor only moves to previous visual lines, so only the visual variant is benchmarked
+static Bench_result bench_prev_line(const Corpus* corpus, bool is_visual) {
+    const String* text = &corpus->text;
+    Bench_result result = {0};
+    Pos_data pos = {.cursor = text->count - 1, .visual_x = 0, .visual_y = 0};
+    if (is_visual) {
+        pos.visual_x = corpus->visual_x_last_char;
+    }
+
+    size_t start_cursor = pos.cursor;
+    while (pos.cursor > 0) {
+        Pos_data prev_line;
+        if (!get_start_prev_generic_line_from_curr_cursor_x_pos(&prev_line, text, pos.cursor, pos.visual_x, BENCH_VISUAL_WIDTH, is_visual)) {
+            abort();
+        }
+        pos = prev_line;
+        result.count_calls++;
+    }
+    result.count_bytes = start_cursor - pos.cursor;
+    return result;
+}
+
+
+// scroll offset is always calculated in terms of visual lines
+static Bench_result bench_cal_index_scroll_offset(const Corpus* corpus, bool is_visual) {
+    const String* text = &corpus->text;
+    (void) is_visual;
+    Bench_result result = {0};
+
+    // scroll to the visual line that is about half way through the text
+    Scroll_data scroll = {0};
+    scroll.y = corpus->visual_y_middle;
+
+    size_t offset;
+    Text_box_cal_index_scroll_offset(&offset, &scroll, text, BENCH_VISUAL_WIDTH);
+    result.count_calls = 1;
+    result.count_bytes = offset;
+    bench_sink += offset;
+    return result;
+}
+
+
+// only the visual variant is implemented
+static Bench_result bench_cal_start_generic_line_internal(const Corpus* corpus, bool is_visual) {
+    const String* text = &corpus->text;
+    (void) is_visual;
+    Bench_result result = {0};
+    Pos_data line_data;
+    cal_start_generic_line_internal(&line_data, text, text->count / 2, BENCH_VISUAL_WIDTH, false, true);
+    result.count_calls = 1;
+    result.count_bytes = text->count / 2;
+    bench_sink += line_data.cursor;
+    return result;
+}
+
+
+// opening a file (the file is copied first, because it is converted in place; the buffer is reused like the buffer 
+// that a file is read into)
+static Bench_result bench_line_ending_normalize(const Corpus* corpus, bool is_visual) {
+    (void) is_visual;
+    static String text;
+    vector_enlarge_if_nessessary_char(&text, corpus->file.count);
+    memcpy(text.items, corpus->file.items, corpus->file.count);
+    text.count = corpus->file.count;
+    Line_ending_counts line_endings;
+    text.count = line_ending_normalize(&line_endings, text.items, 0, text.count);
+    Bench_result result = {.count_calls = 1, .count_bytes = corpus->file.count};
+    bench_sink += text.count;
+    return result;
+}
+
+
+// saving a file
+static Bench_result bench_line_ending_write(const Corpus* corpus, bool is_visual) {
+    (void) is_visual;
+    static FILE* null_file;
+    if (!null_file) {
+        null_file = fopen("/dev/null", "wb");
+        if (!null_file) {
+            abort();
+        }
+    }
+    if (!line_ending_write(null_file, corpus->text.items, corpus->text.count, corpus->line_ending)) {
+        abort();
+    }
+    Bench_result result = {.count_calls = 1, .count_bytes = corpus->text.count};
+    return result;
+}
+
+
+typedef Bench_result (*Bench_fn)(const Corpus* corpus, bool is_visual);
+
+
+static void bench_run(const Corpus* corpus, const char* kernel_name, Bench_fn bench_fn, bool is_visual) {
+    Bench_result total = {0};
+    uint64_t count_runs = 0;
+    uint64_t start = get_time_ns();
+    uint64_t elapsed = 0;
+    while (elapsed < BENCH_MIN_NS) {
+        Bench_result result = bench_fn(corpus, is_visual);
+        total.count_calls += result.count_calls;
+        total.count_bytes += result.count_bytes;
+        count_runs++;
+        elapsed = get_time_ns() - start;
+    }
+
+    printf(
+        "%-12s %-34s %-7s %8llu %14.2f %10.3f\n",
+        corpus->name,
+        kernel_name,
+        is_visual ? "visual" : "actual",
+        (unsigned long long)count_runs,
+        total.count_calls > 0 ? (double)elapsed / total.count_calls : 0.0,
+        total.count_bytes > 0 ? (double)elapsed / total.count_bytes : 0.0
+    );
+    fflush(stdout);
+}
+
+
+int main(void) {
+    log_file = fopen(LOG_FILE_NAME, "w");
+    if (!log_file) {
+        fprintf(stderr, "fetal error: log file \"%s\" could not be opened\n", LOG_FILE_NAME);
+        return 1;
+    }
+
+    Corpus corpora[4];
+    Corpus_generate(&corpora[0], "short_lines", 200000, 0, 40, "\n");
+    Corpus_generate(&corpora[1], "long_lines", 8, 256 * 1024, 512 * 1024, "\n");
+    Corpus_generate(&corpora[2], "crlf", 200000, 0, 40, "\r\n");
+    Corpus_generate(&corpora[3], "huge", 400000, 40, 120, "\n");
+
+    printf("%-12s %-34s %-7s %8s %14s %10s\n", "corpus", "kernel", "lines", "runs", "ns/call", "ns/byte");
+    for (size_t idx = 0; idx < sizeof(corpora)/sizeof(corpora[0]); idx++) {
+        const Corpus* corpus = &corpora[idx];
+        bench_run(corpus, "Pos_data_advance_one", bench_advance_one, true);
+        bench_run(corpus, "Pos_data_advance_one", bench_advance_one, false);
+        bench_run(corpus, "Pos_data_decrement_one", bench_decrement_one, true);
+        bench_run(corpus, "Pos_data_decrement_one", bench_decrement_one, false);
+        bench_run(corpus, "get_start_next_generic_line", bench_next_line, true);
+        bench_run(corpus, "get_start_next_generic_line", bench_next_line, false);
+        bench_run(corpus, "get_start_prev_generic_line", bench_prev_line, true);
+        bench_run(corpus, "Text_box_cal_index_scroll_offset", bench_cal_index_scroll_offset, true);
+        bench_run(corpus, "cal_start_generic_line_internal", bench_cal_start_generic_line_internal, true);
+        bench_run(corpus, "line_ending_normalize", bench_line_ending_normalize, false);
+        bench_run(corpus, "line_ending_write", bench_line_ending_write, false);
+    }
+
+    for (size_t idx = 0; idx < sizeof(corpora)/sizeof(corpora[0]); idx++) {
+        String_free_char_data(&corpora[idx].file);
+        String_free_char_data(&corpora[idx].text);
+    }
+    return 0;
+}
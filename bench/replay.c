@@ -0,0 +1,553 @@
+// headless keystroke replay benchmark
+//
+// drives Editor/Text_box from a keystroke script with a simulated screen size (no terminal is needed),
+// and writes throughput and per operation latency percentiles for every scenario as json
+//
+// usage: new_text_editor_replay <script> [output_file.json]
+//
+// script format (one command per line; lines starting with # are ignored):
+//     screen <width> <height>          set simulated screen size
+//     generate <count_lines> <len>     replace buffer with generated text
+//     open <file_name>                 replace buffer with contents of file
+//     goto start|middle|end            move cursor (not timed)
+//     wrap on|off                      wrap long lines, or scroll horizontally (not timed)
+//     syntax none|c|shell|json|log     highlight the buffer as this language (not timed)
+//     fold <count_lines> <every>       fold <count_lines> lines after every <every> lines (not timed)
+//     split none|horizontal|vertical  split the main window (the other window stays where the cursor is; not timed)
+//     cursors <every>|none             add a cursor at the start of every <every> lines, or remove them (not timed)
+//     scenario <name>                  following operations are reported under <name>
+//     key <key_name> <count>           press key <count> times (one operation per key)
+//     batch <key_name> <count>         press key <count> times as one batch (one operation)
+//     type <text> <count>              type <text> <count> times (one operation per character)
+//     search <query> <count>           search for <query> <count> times (one operation per search)
+//     resize <width> <height> <count>  alternate between current size and <width> <height> (one operation per resize)
+//     max_mean_us <us>                 fail (exit status 2) if the mean latency of the current scenario is higher than this
+//
+// key names: left, right, up, down, enter, backspace, undo, redo, select, copy, cut, paste, space,
+//            home, end, pageup, pagedown, command (enter/leave command mode), or a single character
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "editor.h"
+#include "input.h"
+#include "process_input.h"
+#include "timing.h"
+
+
+define_vector(uint64_t)
+
+
+typedef struct {
+    char name[64];
+    Vector_uint64_t latencies_ns;
+    uint64_t total_ns;
+    double max_mean_us; // 0 if there is no limit
+} Scenario;
+
+
+define_vector(Scenario)
+
+
+typedef struct {
+    Editor* editor;
+    Keys keys;
+    Vector_Scenario scenarios;
+    int width;
+    int height;
+} Replay;
+
+
+static bool replay_get_key(int* key, const char* key_name) {
+    static const struct {const char* name; int key;} key_names[] = {
+        {"left", KEY_LEFT},
+        {"right", KEY_RIGHT},
+        {"up", KEY_UP},
+        {"down", KEY_DOWN},
+        {"enter", '\n'},
+        {"backspace", KEY_BACKSPACE},
+        {"undo", ctrl('z')},
+        {"redo", ctrl('y')},
+        {"select", ctrl('q')},
+        {"copy", ctrl('c')},
+        {"cut", ctrl('x')},
+        {"paste", ctrl('v')},
+        {"space", ' '},
+        {"home", KEY_HOME},
+        {"end", KEY_END},
+        {"pageup", KEY_PPAGE},
+        {"pagedown", KEY_NPAGE},
+        {"command", ctrl('i')},
+    };
+
+    for (size_t idx = 0; idx < sizeof(key_names)/sizeof(key_names[0]); idx++) {
+        if (0 == strcmp(key_name, key_names[idx].name)) {
+            *key = key_names[idx].key;
+            return true;
+        }
+    }
+
+    if (strlen(key_name) == 1) {
+        *key = key_name[0];
+        return true;
+    }
+
+    return false;
+}
+
+
+static Scenario* replay_curr_scenario(Replay* replay) {
+    if (replay->scenarios.count < 1) {
+        Scenario new_scenario = {0};
+        snprintf(new_scenario.name, sizeof(new_scenario.name), "default");
+        vector_append_Scenario(&replay->scenarios, &new_scenario);
+    }
+    return vector_back_Scenario(&replay->scenarios);
+}
+
+
+// process keys as one batch, then do the layout for the next frame (drawing is skipped)
+static uint64_t replay_process_keys(Replay* replay, const int* keys, size_t count_keys) {
+    replay->keys.keys.count = 0;
+    for (size_t idx = 0; idx < count_keys; idx++) {
+        vector_append_int(&replay->keys.keys, &keys[idx]);
+    }
+
+    uint64_t start = get_time_ns();
+    bool should_resize_window = false;
+    bool should_close = false;
+    process_input_batch(&should_resize_window, replay->editor, &should_close, &replay->keys);
+    Editor_update_layout(replay->editor, should_resize_window);
+    return get_time_ns() - start;
+}
+
+
+static void replay_record(Replay* replay, uint64_t duration_ns) {
+    Scenario* scenario = replay_curr_scenario(replay);
+    vector_append_uint64_t(&scenario->latencies_ns, &duration_ns);
+    scenario->total_ns += duration_ns;
+}
+
+
+static uint64_t replay_resize(Replay* replay, int width, int height) {
+    uint64_t start = get_time_ns();
+    Editor_set_size(replay->editor, height, width);
+    Editor_update_layout(replay->editor, true);
+    return get_time_ns() - start;
+}
+
+
+static void replay_set_text(Replay* replay, const String* new_text) {
+    Editor* editor = replay->editor;
+    Clips_detach(&editor->file_text.text_box->string, 0, SIZE_MAX);
+    String_cpy(&editor->file_text.text_box->string, new_text);
+    Column_map_invalidate_all();
+    Cursor_info_init(&editor->file_text.text_box->cursor_info);
+    Visual_selected_init(&editor->file_text.text_box->visual_sel);
+    Actions_free(&editor->document->actions);
+    Actions_free(&editor->document->undo_actions);
+    Syntax_set_lang(&editor->document->syntax, editor->document->syntax.lang);
+    Brackets_clear(&editor->document->brackets);
+    Folds_clear(&editor->document->folds);
+    Document_clear_cursors(editor->document);
+    Editor_update_layout(editor, true);
+}
+
+
+static void replay_generate(Replay* replay, size_t count_lines, size_t len_line) {
+    static const char words[] = "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor ";
+    String new_text;
+    String_init(&new_text);
+    vector_enlarge_if_nessessary_char(&new_text, count_lines * (len_line + 1));
+
+    for (size_t idx_line = 0; idx_line < count_lines; idx_line++) {
+        for (size_t idx_col = 0; idx_col < len_line; idx_col++) {
+            String_append(&new_text, words[(idx_line + idx_col) % (sizeof(words) - 1)]);
+        }
+        String_append(&new_text, '\n');
+    }
+
+    replay_set_text(replay, &new_text);
+    String_free_char_data(&new_text);
+}
+
+
+static bool replay_open(Replay* replay, const char* file_name) {
+    FILE* file = fopen(file_name, "rb");
+    if (!file) {
+        fprintf(stderr, "error: could not open %s: %s\n", file_name, strerror(errno));
+        return false;
+    }
+
+    String new_text;
+    String_init(&new_text);
+    char buf[65536];
+    size_t amount_read;
+    while ((amount_read = fread(buf, 1, sizeof(buf), file)) > 0) {
+        String_append_cstr(&new_text, buf, amount_read);
+    }
+    fclose(file);
+
+    replay_set_text(replay, &new_text);
+    String_free_char_data(&new_text);
+    return true;
+}
+
+
+static void replay_fold(Replay* replay, size_t count_lines, size_t every) {
+    Document* document = replay->editor->document;
+    const String* string = &document->text_box.string;
+    size_t start_line = 0;
+    size_t idx_line = 0;
+    while (start_line < string->count) {
+        size_t end_line;
+        size_t start_next_line = line_scan_find_newline_forward(&end_line, string->items, start_line, string->count) ? end_line + 1 : string->count;
+        if (idx_line % every == 0) {
+            // start of the line count_lines lines after this one
+            size_t end_fold = start_next_line;
+            for (size_t idx = 0; idx < count_lines && end_fold < string->count; idx++) {
+                end_fold = line_scan_find_newline_forward(&end_line, string->items, end_fold, string->count) ? end_line + 1 : string->count;
+            }
+            if (start_next_line < end_fold) {
+                Folds_add(&document->folds, start_next_line, end_fold);
+            }
+        }
+        start_line = start_next_line;
+        idx_line++;
+    }
+    Editor_update_layout(replay->editor, true);
+}
+
+
+static void replay_add_cursors(Replay* replay, size_t every) {
+    Document* document = replay->editor->document;
+    const String* string = &document->text_box.string;
+    Vector_size_t positions = {0};
+    size_t start_line = 0;
+    size_t idx_line = 0;
+    while (start_line < string->count) {
+        if (idx_line % every == 0) {
+            vector_append_size_t(&positions, &start_line);
+        }
+        size_t end_line;
+        start_line = line_scan_find_newline_forward(&end_line, string->items, start_line, string->count) ? end_line + 1 : string->count;
+        idx_line++;
+    }
+    document_add_cursors(document, positions.items, positions.count);
+    free(positions.items);
+    Editor_update_layout(replay->editor, true);
+}
+
+
+static void replay_goto(Replay* replay, const char* target) {
+    Text_box* text_box = replay->editor->file_text.text_box;
+    size_t new_cursor = 0;
+    if (0 == strcmp(target, "middle")) {
+        new_cursor = text_box->string.count / 2;
+    } else if (0 == strcmp(target, "end")) {
+        new_cursor = text_box->string.count;
+    }
+    text_box->cursor_info.pos.cursor = new_cursor;
+    Editor_update_layout(replay->editor, true);
+}
+
+
+static bool replay_run_line(Replay* replay, char* line, size_t line_num) {
+    char command[64] = {0};
+    char arg[4096] = {0};
+    long count = 1;
+    long arg_2 = 0;
+
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\0') {
+        return true;
+    }
+
+    if (sscanf(line, "%63s", command) != 1) {
+        return true;
+    }
+
+    if (0 == strcmp(command, "screen")) {
+        if (sscanf(line, "%*s %d %d", &replay->width, &replay->height) != 2) {
+            goto error;
+        }
+        replay_resize(replay, replay->width, replay->height);
+    } else if (0 == strcmp(command, "generate")) {
+        if (sscanf(line, "%*s %ld %ld", &count, &arg_2) != 2) {
+            goto error;
+        }
+        replay_generate(replay, count, arg_2);
+    } else if (0 == strcmp(command, "open")) {
+        if (sscanf(line, "%*s %4095s", arg) != 1 || !replay_open(replay, arg)) {
+            goto error;
+        }
+    } else if (0 == strcmp(command, "goto")) {
+        if (sscanf(line, "%*s %4095s", arg) != 1) {
+            goto error;
+        }
+        replay_goto(replay, arg);
+    } else if (0 == strcmp(command, "wrap")) {
+        if (sscanf(line, "%*s %4095s", arg) != 1) {
+            goto error;
+        }
+        bool no_wrap = (0 == strcmp(arg, "off"));
+        if (no_wrap != replay->editor->file_text.no_wrap) {
+            Editor_toggle_wrap(replay->editor);
+        }
+    } else if (0 == strcmp(command, "syntax")) {
+        static const char* lang_names[SYNTAX_LANG_COUNT] = {
+            [SYNTAX_LANG_NONE] = "none",
+            [SYNTAX_LANG_C] = "c",
+            [SYNTAX_LANG_SHELL] = "shell",
+            [SYNTAX_LANG_JSON] = "json",
+            [SYNTAX_LANG_LOG] = "log",
+        };
+        if (sscanf(line, "%*s %4095s", arg) != 1) {
+            goto error;
+        }
+        size_t lang = 0;
+        while (lang < SYNTAX_LANG_COUNT && 0 != strcmp(arg, lang_names[lang])) {
+            lang++;
+        }
+        if (lang >= SYNTAX_LANG_COUNT) {
+            goto error;
+        }
+        Syntax_set_lang(&replay->editor->document->syntax, lang);
+        Editor_update_layout(replay->editor, true);
+    } else if (0 == strcmp(command, "fold")) {
+        if (sscanf(line, "%*s %ld %ld", &count, &arg_2) != 2 || count < 1 || arg_2 <= count) {
+            goto error;
+        }
+        replay_fold(replay, count, arg_2);
+    } else if (0 == strcmp(command, "split")) {
+        if (sscanf(line, "%*s %4095s", arg) != 1) {
+            goto error;
+        }
+        if (0 == strcmp(arg, "none")) {
+            Editor_close_other_window(replay->editor);
+        } else if (0 == strcmp(arg, "horizontal") || 0 == strcmp(arg, "vertical")) {
+            Editor_split(replay->editor, arg[0] == 'h' ? SPLIT_HORIZONTAL : SPLIT_VERTICAL);
+        } else {
+            goto error;
+        }
+        Editor_update_layout(replay->editor, true);
+    } else if (0 == strcmp(command, "cursors")) {
+        if (sscanf(line, "%*s %4095s", arg) != 1) {
+            goto error;
+        }
+        if (0 == strcmp(arg, "none")) {
+            Document_clear_cursors(replay->editor->document);
+            Editor_update_layout(replay->editor, true);
+        } else if (sscanf(arg, "%ld", &count) == 1 && count >= 1) {
+            replay_add_cursors(replay, count);
+        } else {
+            goto error;
+        }
+    } else if (0 == strcmp(command, "scenario")) {
+        Scenario new_scenario = {0};
+        if (sscanf(line, "%*s %63s", new_scenario.name) != 1) {
+            goto error;
+        }
+        vector_append_Scenario(&replay->scenarios, &new_scenario);
+    } else if (0 == strcmp(command, "max_mean_us")) {
+        double max_mean_us;
+        if (sscanf(line, "%*s %lf", &max_mean_us) != 1 || max_mean_us <= 0) {
+            goto error;
+        }
+        replay_curr_scenario(replay)->max_mean_us = max_mean_us;
+    } else if (0 == strcmp(command, "key") || 0 == strcmp(command, "batch")) {
+        int key;
+        if (sscanf(line, "%*s %4095s %ld", arg, &count) < 1 || !replay_get_key(&key, arg)) {
+            goto error;
+        }
+        if (0 == strcmp(command, "key")) {
+            for (long idx = 0; idx < count; idx++) {
+                replay_record(replay, replay_process_keys(replay, &key, 1));
+            }
+        } else {
+            int* keys = safe_malloc(count * sizeof(keys[0]));
+            for (long idx = 0; idx < count; idx++) {
+                keys[idx] = key;
+            }
+            replay_record(replay, replay_process_keys(replay, keys, count));
+            free(keys);
+        }
+    } else if (0 == strcmp(command, "type")) {
+        if (sscanf(line, "%*s %4095s %ld", arg, &count) < 1) {
+            goto error;
+        }
+        for (long idx = 0; idx < count; idx++) {
+            for (size_t idx_ch = 0; arg[idx_ch]; idx_ch++) {
+                int key = arg[idx_ch];
+                replay_record(replay, replay_process_keys(replay, &key, 1));
+            }
+        }
+    } else if (0 == strcmp(command, "search")) {
+        if (sscanf(line, "%*s %4095s %ld", arg, &count) < 1) {
+            goto error;
+        }
+        // enter search mode and replace the query (not timed)
+        Editor* editor = replay->editor;
+        int key = ctrl('f');
+        replay_process_keys(replay, &key, 1);
+        String_cpy_from_cstr(&editor->search_query.text_box->string, arg, strlen(arg));
+        Column_map_invalidate_all();
+        Cursor_info_init(&editor->search_query.text_box->cursor_info);
+        editor->search_status = SEARCH_FIRST;
+
+        key = '\n';
+        for (long idx = 0; idx < count; idx++) {
+            replay_record(replay, replay_process_keys(replay, &key, 1));
+        }
+
+        key = ctrl('f');
+        replay_process_keys(replay, &key, 1);
+    } else if (0 == strcmp(command, "resize")) {
+        int new_width;
+        int new_height;
+        if (sscanf(line, "%*s %d %d %ld", &new_width, &new_height, &count) < 2) {
+            goto error;
+        }
+        for (long idx = 0; idx < count; idx++) {
+            bool is_new_size = (idx % 2) == 0;
+            replay_record(replay, replay_resize(
+                replay,
+                is_new_size ? new_width : replay->width,
+                is_new_size ? new_height : replay->height
+            ));
+        }
+        replay_resize(replay, replay->width, replay->height);
+    } else {
+        goto error;
+    }
+
+    return true;
+
+error:
+    fprintf(stderr, "error: line %zu: invalid command: %s", line_num, line);
+    return false;
+}
+
+
+static double scenario_mean_us(const Scenario* scenario) {
+    return scenario->latencies_ns.count > 0 ? scenario->total_ns / 1e3 / scenario->latencies_ns.count : 0.0;
+}
+
+
+static int compare_uint64(const void* lhs, const void* rhs) {
+    uint64_t lhs_val = *(const uint64_t*)lhs;
+    uint64_t rhs_val = *(const uint64_t*)rhs;
+    return (lhs_val > rhs_val) - (lhs_val < rhs_val);
+}
+
+
+static double percentile_us(const Vector_uint64_t* sorted_latencies, double percentile) {
+    if (sorted_latencies->count < 1) {
+        return 0;
+    }
+    size_t idx = (size_t)(percentile * (double)(sorted_latencies->count - 1));
+    return sorted_latencies->items[idx] / 1e3;
+}
+
+
+static void replay_write_results(FILE* output, const Replay* replay, const char* script_name) {
+    fprintf(output, "{\n");
+    fprintf(output, "  \"script\": \"%s\",\n", script_name);
+    fprintf(output, "  \"screen\": {\"width\": %d, \"height\": %d},\n", replay->width, replay->height);
+    fprintf(output, "  \"scenarios\": [\n");
+    for (size_t idx = 0; idx < replay->scenarios.count; idx++) {
+        Scenario* scenario = &replay->scenarios.items[idx];
+        Vector_uint64_t* latencies = &scenario->latencies_ns;
+        qsort(latencies->items, latencies->count, sizeof(latencies->items[0]), compare_uint64);
+
+        double total_s = scenario->total_ns / 1e9;
+        fprintf(output, "    {\"name\": \"%s\", \"ops\": %zu, \"total_ms\": %.3f, \"ops_per_sec\": %.1f, ",
+            scenario->name,
+            latencies->count,
+            scenario->total_ns / 1e6,
+            total_s > 0 ? latencies->count / total_s : 0.0
+        );
+        fprintf(output, "\"latency_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}}%s\n",
+            scenario_mean_us(scenario),
+            percentile_us(latencies, 0.50),
+            percentile_us(latencies, 0.90),
+            percentile_us(latencies, 0.99),
+            percentile_us(latencies, 1.0),
+            idx + 1 < replay->scenarios.count ? "," : ""
+        );
+    }
+    fprintf(output, "  ]\n");
+    fprintf(output, "}\n");
+}
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <script> [output_file.json]\n", argv[0]);
+        return 1;
+    }
+
+    log_file = fopen(LOG_FILE_NAME, "w");
+    if (!log_file) {
+        fprintf(stderr, "fetal error: log file \"%s\" could not be opened\n", LOG_FILE_NAME);
+        return 1;
+    }
+
+    FILE* script = fopen(argv[1], "r");
+    if (!script) {
+        fprintf(stderr, "error: could not open script %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    Replay replay = {0};
+    replay.editor = Editor_get();
+    Keys_init(&replay.keys);
+    replay.width = 80;
+    replay.height = 24;
+    replay_resize(&replay, replay.width, replay.height);
+
+    char line[8192];
+    size_t line_num = 0;
+    while (fgets(line, sizeof(line), script)) {
+        line_num++;
+        if (!replay_run_line(&replay, line, line_num)) {
+            return 1;
+        }
+    }
+    fclose(script);
+
+    FILE* output = stdout;
+    if (argc > 2) {
+        output = fopen(argv[2], "w");
+        if (!output) {
+            fprintf(stderr, "error: could not open %s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+    }
+    replay_write_results(output, &replay, argv[1]);
+    if (output != stdout) {
+        fclose(output);
+    }
+
+    int status = 0;
+    for (size_t idx = 0; idx < replay.scenarios.count; idx++) {
+        const Scenario* scenario = &replay.scenarios.items[idx];
+        if (scenario->max_mean_us > 0 && scenario_mean_us(scenario) > scenario->max_mean_us) {
+            fprintf(stderr, "error: scenario %s: mean latency %.3f us is over the limit of %.3f us\n",
+                scenario->name, scenario_mean_us(scenario), scenario->max_mean_us
+            );
+            status = 2;
+        }
+    }
+
+    for (size_t idx = 0; idx < replay.scenarios.count; idx++) {
+        free(replay.scenarios.items[idx].latencies_ns.items);
+    }
+    free(replay.scenarios.items);
+    Keys_free(&replay.keys);
+    Editor_free(replay.editor);
+    free(replay.editor);
+    return status;
+}
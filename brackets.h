@@ -0,0 +1,424 @@
+#ifndef BRACKETS_H
+#define BRACKETS_H
+
+
+// index of the nesting of brackets in the text, used to find the bracket that matches another one
+//
+// the text is split into chunks of about BRACKETS_CHUNK bytes, and the depth of every kind of bracket at the end of
+// each chunk (and the lowest depth reached within it) is kept in a segment tree over the chunks; the chunk where the
+// matching bracket is found in O(log n), and only that chunk (and the one of the first bracket) is scanned
+// an edit only scans the chunk (or chunks) that it changed again
+// (brackets in strings and comments are counted like any other bracket)
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+
+// text is split into chunks of this many bytes when the index is built
+#define BRACKETS_CHUNK 1024
+// a chunk that grows past this many bytes is split again
+#define BRACKETS_MAX_CHUNK (4 * BRACKETS_CHUNK)
+
+
+typedef enum {BRACKET_ROUND = 0, BRACKET_SQUARE, BRACKET_CURLY, BRACKET_COUNT} BRACKET;
+
+
+// summary of a part of the text (a chunk, or every chunk below a node of the tree)
+typedef struct {
+    size_t count; // bytes
+    int64_t depth[BRACKET_COUNT]; // opening minus closing brackets of every kind
+    int64_t min_depth[BRACKET_COUNT]; // lowest depth reached, counted from the start of the part (at most 0)
+} Brackets_summary;
+
+
+define_vector(Brackets_summary)
+
+
+typedef struct {
+    bool is_built; // the index is only built when it is first needed
+    Vector_Brackets_summary chunks;
+    // tree[size + idx] is chunk idx; tree[idx] combines tree[2 * idx] and tree[2 * idx + 1] (tree[0] is unused)
+    Vector_Brackets_summary tree;
+    size_t size; // count of leaves of tree (power of 2)
+} Brackets;
+
+
+// returns 1 for an opening bracket, -1 for a closing bracket, or 0 if ch is not a bracket
+static inline int brackets_classify(char ch, BRACKET* kind) {
+    switch (ch) {
+    case '(': *kind = BRACKET_ROUND; return 1;
+    case ')': *kind = BRACKET_ROUND; return -1;
+    case '[': *kind = BRACKET_SQUARE; return 1;
+    case ']': *kind = BRACKET_SQUARE; return -1;
+    case '{': *kind = BRACKET_CURLY; return 1;
+    case '}': *kind = BRACKET_CURLY; return -1;
+    default: return 0;
+    }
+}
+
+
+// start of the first block of 16 bytes of items[start, end) that contains a bracket (or of the bytes after the last
+// full block)
+static inline size_t brackets_skip_plain(const char* items, size_t start, size_t end) {
+    size_t idx = start;
+#ifdef __SSE2__
+    // ( and ) differ only in the lowest bit; [ and {, and ] and }, differ only in bit 0x20
+    const __m128i round = _mm_set1_epi8('(');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i low_bit = _mm_set1_epi8(1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    for (; idx + 16 <= end; idx += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + idx));
+        __m128i folded = _mm_or_si128(chunk, case_bit);
+        __m128i found = _mm_or_si128(
+            _mm_cmpeq_epi8(_mm_andnot_si128(low_bit, chunk), round),
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close))
+        );
+        if (_mm_movemask_epi8(found)) {
+            break;
+        }
+    }
+#else
+    (void) items;
+    (void) end;
+#endif // __SSE2__
+    return idx;
+}
+
+
+static inline void brackets_summarize(Brackets_summary* summary, const char* items, size_t start, size_t end) {
+    memset(summary, 0, sizeof(*summary));
+    summary->count = end - start;
+    size_t idx = start;
+    while (idx < end) {
+        idx = brackets_skip_plain(items, idx, end);
+        size_t end_block = MIN(idx + 16, end);
+        for (; idx < end_block; idx++) {
+            BRACKET kind;
+            int step = brackets_classify(items[idx], &kind);
+            if (step == 0) {
+                continue;
+            }
+            summary->depth[kind] += step;
+            summary->min_depth[kind] = MIN(summary->min_depth[kind], summary->depth[kind]);
+        }
+    }
+}
+
+
+// summary of left followed by right
+static inline void brackets_combine(Brackets_summary* result, const Brackets_summary* left, const Brackets_summary* right) {
+    result->count = left->count + right->count;
+    for (size_t kind = 0; kind < BRACKET_COUNT; kind++) {
+        result->depth[kind] = left->depth[kind] + right->depth[kind];
+        result->min_depth[kind] = MIN(left->min_depth[kind], left->depth[kind] + right->min_depth[kind]);
+    }
+}
+
+
+static inline void Brackets_init(Brackets* brackets) {
+    memset(brackets, 0, sizeof(*brackets));
+}
+
+
+static inline void Brackets_free(Brackets* brackets) {
+    free(brackets->chunks.items);
+    free(brackets->tree.items);
+    Brackets_init(brackets);
+}
+
+
+// to be called when the whole text was replaced (the index is built again when it is needed)
+static inline void Brackets_clear(Brackets* brackets) {
+    brackets->is_built = false;
+    brackets->chunks.count = 0;
+    brackets->tree.count = 0;
+    brackets->size = 0;
+}
+
+
+static inline void Brackets_build_tree(Brackets* brackets) {
+    brackets->size = 1;
+    while (brackets->size < brackets->chunks.count) {
+        brackets->size *= 2;
+    }
+    vector_enlarge_if_nessessary_Brackets_summary(&brackets->tree, 2 * brackets->size);
+    brackets->tree.count = 2 * brackets->size;
+    memset(brackets->tree.items, 0, brackets->tree.count * sizeof(brackets->tree.items[0]));
+    memcpy(brackets->tree.items + brackets->size, brackets->chunks.items, brackets->chunks.count * sizeof(brackets->chunks.items[0]));
+    for (size_t idx = brackets->size - 1; idx >= 1; idx--) {
+        brackets_combine(&brackets->tree.items[idx], &brackets->tree.items[2 * idx], &brackets->tree.items[2 * idx + 1]);
+    }
+}
+
+
+static inline void Brackets_build_if_nessessary(Brackets* brackets, const String* string) {
+    if (brackets->is_built) {
+        return;
+    }
+    brackets->chunks.count = 0;
+    size_t start = 0;
+    do {
+        Brackets_summary chunk;
+        size_t end = MIN(start + BRACKETS_CHUNK, string->count);
+        brackets_summarize(&chunk, string->items, start, end);
+        vector_append_Brackets_summary(&brackets->chunks, &chunk);
+        start = end;
+    } while (start < string->count);
+    Brackets_build_tree(brackets);
+    brackets->is_built = true;
+}
+
+
+// chunk that contains position idx (the last chunk if idx is the end of the text)
+static inline size_t brackets_find_chunk(const Brackets* brackets, size_t idx, size_t* chunk_start) {
+    const Brackets_summary* tree = brackets->tree.items;
+    if (idx >= tree[1].count) {
+        size_t last = brackets->chunks.count - 1;
+        *chunk_start = tree[1].count - brackets->chunks.items[last].count;
+        return last;
+    }
+    size_t node = 1;
+    *chunk_start = 0;
+    while (node < brackets->size) {
+        if (idx < tree[2 * node].count) {
+            node = 2 * node;
+        } else {
+            idx -= tree[2 * node].count;
+            *chunk_start += tree[2 * node].count;
+            node = 2 * node + 1;
+        }
+    }
+    return node - brackets->size;
+}
+
+
+static inline size_t brackets_chunk_start(const Brackets* brackets, size_t chunk) {
+    size_t start = 0;
+    for (size_t node = brackets->size + chunk; node > 1; node /= 2) {
+        if (node % 2 == 1) {
+            start += brackets->tree.items[node - 1].count;
+        }
+    }
+    return start;
+}
+
+
+// to be called after count_removed bytes at start of string were replaced by string[start, start + count_inserted)
+static inline void Brackets_note_edit(Brackets* brackets, const String* string, size_t start, size_t count_removed, size_t count_inserted) {
+    if (!brackets->is_built) {
+        return;
+    }
+
+    // every chunk that the edit touched becomes one chunk, which is scanned again
+    size_t first_start;
+    size_t first = brackets_find_chunk(brackets, start, &first_start);
+    size_t last = first;
+    size_t last_start = first_start;
+    if (count_removed > 0) {
+        last = brackets_find_chunk(brackets, start + count_removed - 1, &last_start);
+    }
+    size_t new_count = last_start + brackets->chunks.items[last].count - count_removed + count_inserted - first_start;
+
+    bool is_tree_changed = last > first;
+    if (last > first) {
+        vector_remove_range_Brackets_summary(&brackets->chunks, first + 1, last - first);
+    }
+    brackets_summarize(&brackets->chunks.items[first], string->items, first_start, first_start + new_count);
+
+    if (new_count > BRACKETS_MAX_CHUNK) {
+        size_t count_parts = (new_count + BRACKETS_CHUNK - 1) / BRACKETS_CHUNK;
+        Vector_Brackets_summary* chunks = &brackets->chunks;
+        vector_enlarge_if_nessessary_Brackets_summary(chunks, chunks->count + count_parts - 1);
+        memmove(chunks->items + first + count_parts, chunks->items + first + 1, (chunks->count - first - 1) * sizeof(chunks->items[0]));
+        chunks->count += count_parts - 1;
+        for (size_t idx = 0; idx < count_parts; idx++) {
+            size_t part_start = first_start + idx * BRACKETS_CHUNK;
+            brackets_summarize(&brackets->chunks.items[first + idx], string->items, part_start, MIN(part_start + BRACKETS_CHUNK, first_start + new_count));
+        }
+        is_tree_changed = true;
+    }
+
+    if (is_tree_changed) {
+        Brackets_build_tree(brackets);
+        return;
+    }
+    size_t node = brackets->size + first;
+    brackets->tree.items[node] = brackets->chunks.items[first];
+    for (node /= 2; node >= 1; node /= 2) {
+        brackets_combine(&brackets->tree.items[node], &brackets->tree.items[2 * node], &brackets->tree.items[2 * node + 1]);
+    }
+}
+
+
+// find the bracket of kind in items[start, end) where *depth (the count of unmatched opening brackets) becomes 0
+static inline bool brackets_scan_forward(size_t* result, const char* items, size_t start, size_t end, BRACKET kind, int64_t* depth) {
+    size_t idx = start;
+    while (idx < end) {
+        idx = brackets_skip_plain(items, idx, end);
+        size_t end_block = MIN(idx + 16, end);
+        for (; idx < end_block; idx++) {
+            BRACKET curr_kind;
+            int step = brackets_classify(items[idx], &curr_kind);
+            if (step == 0 || curr_kind != kind) {
+                continue;
+            }
+            *depth += step;
+            if (*depth == 0) {
+                *result = idx;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// find the bracket of kind in items[start, end), searching from end, where *depth (the count of unmatched closing
+// brackets) becomes 0
+static inline bool brackets_scan_backward(size_t* result, const char* items, size_t start, size_t end, BRACKET kind, int64_t* depth) {
+    for (size_t idx = end; idx > start; idx--) {
+        BRACKET curr_kind;
+        int step = brackets_classify(items[idx - 1], &curr_kind);
+        if (step == 0 || curr_kind != kind) {
+            continue;
+        }
+        *depth -= step;
+        if (*depth == 0) {
+            *result = idx - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// first chunk after chunk where depth (counted from the end of chunk) becomes 0
+static inline bool brackets_find_chunk_forward(size_t* result, const Brackets* brackets, size_t chunk, BRACKET kind, int64_t* depth) {
+    const Brackets_summary* tree = brackets->tree.items;
+    size_t node = brackets->size + chunk;
+    // up, until a node to the right of the path contains the chunk
+    for (;;) {
+        if (node <= 1) {
+            return false;
+        }
+        if (node % 2 == 0) {
+            if (*depth + tree[node + 1].min_depth[kind] <= 0) {
+                node++;
+                break;
+            }
+            *depth += tree[node + 1].depth[kind];
+        }
+        node /= 2;
+    }
+    // then down to it
+    while (node < brackets->size) {
+        if (*depth + tree[2 * node].min_depth[kind] <= 0) {
+            node = 2 * node;
+        } else {
+            *depth += tree[2 * node].depth[kind];
+            node = 2 * node + 1;
+        }
+    }
+    *result = node - brackets->size;
+    return true;
+}
+
+
+// last chunk before chunk where depth (counted from the start of chunk, going backward) becomes 0
+static inline bool brackets_find_chunk_backward(size_t* result, const Brackets* brackets, size_t chunk, BRACKET kind, int64_t* depth) {
+    const Brackets_summary* tree = brackets->tree.items;
+    size_t node = brackets->size + chunk;
+    // (going backward over a node, the lowest depth is reached at one of its positions counted from its start)
+    for (;;) {
+        if (node <= 1) {
+            return false;
+        }
+        if (node % 2 == 1) {
+            if (*depth - tree[node - 1].depth[kind] + tree[node - 1].min_depth[kind] <= 0) {
+                node--;
+                break;
+            }
+            *depth -= tree[node - 1].depth[kind];
+        }
+        node /= 2;
+    }
+    while (node < brackets->size) {
+        if (*depth - tree[2 * node + 1].depth[kind] + tree[2 * node + 1].min_depth[kind] <= 0) {
+            node = 2 * node + 1;
+        } else {
+            *depth -= tree[2 * node + 1].depth[kind];
+            node = 2 * node;
+        }
+    }
+    *result = node - brackets->size;
+    return true;
+}
+
+
+// position of the bracket that matches the bracket at idx
+// returns false if there is no bracket at idx, or it is not matched
+static inline bool Brackets_find_match(size_t* result, Brackets* brackets, const String* string, size_t idx) {
+    BRACKET kind;
+    int direction = idx < string->count ? brackets_classify(string->items[idx], &kind) : 0;
+    if (direction == 0) {
+        return false;
+    }
+    Brackets_build_if_nessessary(brackets, string);
+
+    size_t chunk_start;
+    size_t chunk = brackets_find_chunk(brackets, idx, &chunk_start);
+    int64_t depth = 1;
+    if (direction > 0) {
+        size_t chunk_end = chunk_start + brackets->chunks.items[chunk].count;
+        if (brackets_scan_forward(result, string->items, idx + 1, chunk_end, kind, &depth)) {
+            return true;
+        }
+        if (!brackets_find_chunk_forward(&chunk, brackets, chunk, kind, &depth)) {
+            return false;
+        }
+        chunk_start = brackets_chunk_start(brackets, chunk);
+        chunk_end = chunk_start + brackets->chunks.items[chunk].count;
+        bool is_found = brackets_scan_forward(result, string->items, chunk_start, chunk_end, kind, &depth);
+        assert(is_found);
+        return is_found;
+    }
+
+    if (brackets_scan_backward(result, string->items, chunk_start, idx, kind, &depth)) {
+        return true;
+    }
+    if (!brackets_find_chunk_backward(&chunk, brackets, chunk, kind, &depth)) {
+        return false;
+    }
+    chunk_start = brackets_chunk_start(brackets, chunk);
+    bool is_found = brackets_scan_backward(result, string->items, chunk_start, chunk_start + brackets->chunks.items[chunk].count, kind, &depth);
+    assert(is_found);
+    return is_found;
+}
+
+
+// the bracket at cursor, or else the one just before cursor, and the bracket that matches it
+// returns false if neither is a matched bracket
+static inline bool Brackets_find_match_near(size_t* bracket, size_t* match, Brackets* brackets, const String* string, size_t cursor) {
+    if (Brackets_find_match(match, brackets, string, cursor)) {
+        *bracket = cursor;
+        return true;
+    }
+    if (cursor > 0 && Brackets_find_match(match, brackets, string, cursor - 1)) {
+        *bracket = cursor - 1;
+        return true;
+    }
+    return false;
+}
+
+
+#endif // BRACKETS_H
@@ -0,0 +1,351 @@
+#ifndef CLIPBOARD_H
+#define CLIPBOARD_H
+
+
+// copied text, and the registers and the ring of recent copies that hold it
+//
+// a copy only keeps a reference to the copied range of the text (so it costs the same however much is copied); the
+// bytes are copied out of the text only once an edit changes the range, or the text is replaced or freed
+// (see Clips_note_edit and Clips_detach), and a paste copies them from the text straight to where they are inserted
+// only clips that reference a text are registered, so that they can be found by the text when it is edited
+//
+// bytes that were copied out are kept in blobs, which are shared by every clip with the same bytes (a blob is found by
+// the hash of its bytes), so eg. the same large text copied many times is only stored once
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+
+
+typedef struct {
+    uint64_t hash;
+    size_t count_refs; // count of clips that have the blob
+    String bytes;
+} Clip_blob;
+
+
+typedef Clip_blob* Clip_blob_ptr;
+define_vector(Clip_blob_ptr)
+
+
+// every blob that a clip has
+static Vector_Clip_blob_ptr clip_blobs;
+
+
+// fnv-1a
+static inline uint64_t clip_hash(const char* items, size_t count) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t idx = 0; idx < count; idx++) {
+        hash = (hash ^ (unsigned char)items[idx]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// blob with the bytes of bytes, with one more reference (bytes is moved to a new blob, or freed if there already is a
+// blob with them)
+static inline Clip_blob* clip_blob_get(String* bytes) {
+    uint64_t hash = clip_hash(bytes->items, bytes->count);
+    for (size_t idx = 0; idx < clip_blobs.count; idx++) {
+        Clip_blob* blob = clip_blobs.items[idx];
+        if (blob->hash == hash && blob->bytes.count == bytes->count && 0 == memcmp(blob->bytes.items, bytes->items, bytes->count)) {
+            blob->count_refs++;
+            String_free_char_data(bytes);
+            return blob;
+        }
+    }
+    Clip_blob* blob = safe_malloc(sizeof(*blob));
+    *blob = (Clip_blob){.hash = hash, .count_refs = 1, .bytes = *bytes};
+    String_init(bytes);
+    vector_append_Clip_blob_ptr(&clip_blobs, &blob);
+    return blob;
+}
+
+
+static inline void clip_blob_release(Clip_blob* blob) {
+    if (!blob || --blob->count_refs > 0) {
+        return;
+    }
+    for (size_t idx = 0; idx < clip_blobs.count; idx++) {
+        if (clip_blobs.items[idx] == blob) {
+            clip_blobs.items[idx] = clip_blobs.items[--clip_blobs.count];
+            break;
+        }
+    }
+    String_free_char_data(&blob->bytes);
+    free(blob);
+}
+
+
+typedef struct {
+    const String* string; // text that the copied range is in (NULL once the bytes were copied out of it)
+    size_t start; // range of string (only used if string is not NULL)
+    size_t count;
+    Clip_blob* blob; // copied bytes, if string is NULL (NULL if the clip is empty)
+} Clip;
+
+
+// clips that reference a text
+#define CLIPS_MAX_REGISTERED 256
+static Clip* clips_registered[CLIPS_MAX_REGISTERED];
+static size_t clips_count_registered;
+
+
+static inline void clips_set_registered(Clip* clip, bool is_registered) {
+    for (size_t idx = 0; idx < clips_count_registered; idx++) {
+        if (clips_registered[idx] == clip) {
+            if (!is_registered) {
+                clips_registered[idx] = clips_registered[--clips_count_registered];
+            }
+            return;
+        }
+    }
+    if (!is_registered) {
+        return;
+    }
+    if (clips_count_registered >= CLIPS_MAX_REGISTERED) {
+        log("fetal error: too many clips that reference a text\n");
+        abort();
+    }
+    clips_registered[clips_count_registered++] = clip;
+}
+
+
+// clip must stay at the same address until Clip_free is called
+static inline void Clip_init(Clip* clip) {
+    memset(clip, 0, sizeof(*clip));
+}
+
+
+static inline void Clip_free(Clip* clip) {
+    clips_set_registered(clip, false);
+    clip_blob_release(clip->blob);
+    memset(clip, 0, sizeof(*clip));
+}
+
+
+static inline size_t Clip_count(const Clip* clip) {
+    if (clip->string) {
+        return clip->count;
+    }
+    return clip->blob ? clip->blob->bytes.count : 0;
+}
+
+
+// the copied bytes (Clip_count of them); only valid until the text or the clip is changed
+static inline const char* Clip_items(const Clip* clip) {
+    if (clip->string) {
+        return clip->string->items + clip->start;
+    }
+    return clip->blob ? clip->blob->bytes.items : "";
+}
+
+
+// the clip gets blob (which already has a reference for it)
+static inline void clip_set_blob(Clip* clip, Clip_blob* blob) {
+    clips_set_registered(clip, false);
+    clip_blob_release(clip->blob);
+    clip->string = NULL;
+    clip->blob = blob;
+}
+
+
+// copy string[start, start + count) (only the range is kept; string must stay at the same address while it is
+// referenced, see Clips_detach)
+static inline void Clip_set_range(Clip* clip, const String* string, size_t start, size_t count) {
+    assert(start + count <= string->count);
+    clip_blob_release(clip->blob);
+    clip->blob = NULL;
+    clip->string = count > 0 ? string : NULL;
+    clip->start = start;
+    clip->count = count;
+    clips_set_registered(clip, clip->string != NULL);
+}
+
+
+// the clip gets the bytes of bytes (bytes is moved to the clip, or freed)
+static inline void clip_set_bytes(Clip* clip, String* bytes) {
+    if (bytes->count < 1) {
+        String_free_char_data(bytes);
+        clip_set_blob(clip, NULL);
+        return;
+    }
+    clip_set_blob(clip, clip_blob_get(bytes));
+}
+
+
+// copy items[0, count)
+static inline void Clip_set_bytes(Clip* clip, const char* items, size_t count) {
+    String bytes = {0};
+    vector_insert_items_char(&bytes, items, count, 0);
+    clip_set_bytes(clip, &bytes);
+}
+
+
+// dest gets what src has (a reference to the same range of the same text, or the same blob)
+static inline void Clip_cpy(Clip* dest, const Clip* src) {
+    if (dest == src) {
+        return;
+    }
+    if (src->string) {
+        Clip_set_range(dest, src->string, src->start, src->count);
+        return;
+    }
+    if (src->blob) {
+        src->blob->count_refs++;
+    }
+    clip_set_blob(dest, src->blob);
+}
+
+
+// clips of the same range of a text that are copied out of it together share the blob of the first of them
+typedef struct {
+    size_t start;
+    size_t count;
+    Clip_blob* blob; // NULL until a clip was copied out
+} Clips_shared;
+
+
+static inline bool clips_shared_take(Clips_shared* shared, Clip* clip) {
+    if (!shared->blob || shared->start != clip->start || shared->count != clip->count) {
+        return false;
+    }
+    shared->blob->count_refs++;
+    clip_set_blob(clip, shared->blob);
+    return true;
+}
+
+
+static inline void clips_shared_set(Clips_shared* shared, size_t start, size_t count, const Clip* clip) {
+    *shared = (Clips_shared){.start = start, .count = count, .blob = clip->blob};
+}
+
+
+// to be called after removed[0, count_removed) at start of string was replaced by string[start, start + count_inserted)
+// a clip of a range before or after the edit is moved with the text; a clip of a range that the edit changed gets the
+// bytes the range had before the edit
+static inline void Clips_note_edit(const String* string, size_t start, const char* removed, size_t count_removed, size_t count_inserted) {
+    Clips_shared shared = {0};
+    size_t idx = 0;
+    while (idx < clips_count_registered) {
+        Clip* clip = clips_registered[idx];
+        if (clip->string != string || start >= clip->start + clip->count) {
+            idx++;
+            continue;
+        }
+        if (start + count_removed <= clip->start) {
+            clip->start = clip->start - count_removed + count_inserted;
+            idx++;
+            continue;
+        }
+
+        if (clips_shared_take(&shared, clip)) {
+            continue;
+        }
+
+        // the range before the edit is the text before start, the removed bytes, and the text after the inserted bytes
+        size_t clip_start = clip->start;
+        size_t end = clip->start + clip->count;
+        String bytes = {0};
+        if (clip->start < start) {
+            vector_insert_items_char(&bytes, string->items + clip->start, start - clip->start, bytes.count);
+        }
+        size_t start_removed = MAX(clip->start, start);
+        size_t end_removed = MIN(end, start + count_removed);
+        if (start_removed < end_removed) {
+            vector_insert_items_char(&bytes, removed + start_removed - start, end_removed - start_removed, bytes.count);
+        }
+        if (end > start + count_removed) {
+            size_t start_after = MAX(clip->start, start + count_removed);
+            vector_insert_items_char(&bytes, string->items + start_after - count_removed + count_inserted, end - start_after, bytes.count);
+        }
+        clip_set_bytes(clip, &bytes); // (the last clip is moved to idx)
+        clips_shared_set(&shared, clip_start, end - clip_start, clip);
+    }
+}
+
+
+// copy every clip of a range of string that overlaps string[start, end) out of it (before that part of string is
+// changed without Clips_note_edit, or string is replaced or freed)
+static inline void Clips_detach(const String* string, size_t start, size_t end) {
+    Clips_shared shared = {0};
+    size_t idx = 0;
+    while (idx < clips_count_registered) {
+        Clip* clip = clips_registered[idx];
+        if (clip->string != string || clip->start >= end || clip->start + clip->count <= start) {
+            idx++;
+            continue;
+        }
+        if (clips_shared_take(&shared, clip)) {
+            continue;
+        }
+        size_t clip_start = clip->start;
+        size_t clip_count = clip->count;
+        Clip_set_bytes(clip, string->items + clip_start, clip_count); // (the last clip is moved to idx)
+        clips_shared_set(&shared, clip_start, clip_count, clip);
+    }
+}
+
+
+// the named registers (a to z), and the ring of recent copies (and cuts)
+#define CLIPBOARD_COUNT_REGISTERS ('z' - 'a' + 1)
+#define CLIPBOARD_RING_SIZE 50
+
+typedef struct {
+    Clip registers[CLIPBOARD_COUNT_REGISTERS];
+    Clip ring[CLIPBOARD_RING_SIZE]; // the newest copy is ring[idx_newest], the one before it is the entry before that
+    size_t idx_newest;
+    size_t count_ring;
+} Clipboard;
+
+
+// clipboard must stay at the same address until Clipboard_free is called
+static inline void Clipboard_init(Clipboard* clipboard) {
+    memset(clipboard, 0, sizeof(*clipboard));
+}
+
+
+static inline void Clipboard_free(Clipboard* clipboard) {
+    for (size_t idx = 0; idx < CLIPBOARD_COUNT_REGISTERS; idx++) {
+        Clip_free(&clipboard->registers[idx]);
+    }
+    for (size_t idx = 0; idx < CLIPBOARD_RING_SIZE; idx++) {
+        Clip_free(&clipboard->ring[idx]);
+    }
+    Clipboard_init(clipboard);
+}
+
+
+// the (empty) entry of the ring for a new copy (the oldest copy is dropped if the ring is full)
+static inline Clip* Clipboard_push(Clipboard* clipboard) {
+    clipboard->idx_newest = (clipboard->idx_newest + 1) % CLIPBOARD_RING_SIZE;
+    clipboard->count_ring = MIN(clipboard->count_ring + 1, CLIPBOARD_RING_SIZE);
+    Clip* clip = &clipboard->ring[clipboard->idx_newest];
+    Clip_free(clip);
+    return clip;
+}
+
+
+// the copy made idx copies before the newest one (NULL if there is none)
+static inline Clip* Clipboard_get_recent(Clipboard* clipboard, size_t idx) {
+    if (idx >= clipboard->count_ring) {
+        return NULL;
+    }
+    return &clipboard->ring[(clipboard->idx_newest + CLIPBOARD_RING_SIZE - idx) % CLIPBOARD_RING_SIZE];
+}
+
+
+// named register name ('a' to 'z'; NULL for any other name)
+static inline Clip* Clipboard_get_register(Clipboard* clipboard, char name) {
+    if (name < 'a' || name > 'z') {
+        return NULL;
+    }
+    return &clipboard->registers[name - 'a'];
+}
+
+
+#endif // CLIPBOARD_H
@@ -0,0 +1,303 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "util.h"
+#include "line_scan.h"
+#include "utf8.h"
+
+
+// count of columns that the cells of the text take on the screen
+//
+// a cell is what the cursor moves over: a utf-8 character together with its combining characters (see utf8.h),
+// a tab, or a control character
+// a tab goes on to the next tab stop (tab stops are counted from the start of the visual line, and a tab never goes
+// past the end of a visual line); a control character is drawn as ^ and a letter (eg. ^A for 0x01), so it is two columns
+//
+// printable ascii is one column per byte, so every function first looks for other bytes with a vectorized search
+
+
+#define TAB_WIDTH_DEFAULT 8
+#define TAB_WIDTH_MAX 64
+
+
+// count of columns between tab stops (see --tab-width)
+static size_t tab_width = TAB_WIDTH_DEFAULT;
+
+
+// (line endings of a file are \n in the text; see line_ending.h)
+static inline bool columns_is_line_ending(unsigned char byte) {
+    return byte == '\n';
+}
+
+
+// control characters, other than the line ending (tab is one, and so is a \r that is not part of a line ending)
+static inline bool columns_is_control(unsigned char byte) {
+    return (byte < ' ' && !columns_is_line_ending(byte)) || byte == 0x7f;
+}
+
+
+// printable character that is drawn instead of a control character (after the ^)
+static inline char columns_control_letter(unsigned char byte) {
+    return (char)(byte ^ 0x40);
+}
+
+
+// a character of the text is never more columns than this many times its count of bytes
+static inline size_t columns_max_per_byte(void) {
+    return MAX(tab_width, (size_t)2);
+}
+
+
+// count of columns of a tab at column visual_x of a visual line that is max_visual_width columns wide
+static inline size_t columns_tab_width(size_t visual_x, size_t max_visual_width) {
+    size_t width = tab_width - visual_x % tab_width;
+    if (visual_x < max_visual_width && width > max_visual_width - visual_x) {
+        width = max_visual_width - visual_x;
+    }
+    return width;
+}
+
+
+// find the first byte in items[start, end) that is not printable ascii
+// (line endings are only found if is_line_ending_special is true; otherwise they are one column like printable ascii)
+// returns false if there is none
+static inline bool columns_find_special(size_t* result, const char* items, size_t start, size_t end, bool is_line_ending_special) {
+    size_t idx = start;
+
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i newline = _mm_set1_epi8('\n');
+    bool is_last_chunk = false;
+    while (idx < end && end - start >= 16) {
+        unsigned shift = 0;
+        if (idx + 16 > end) {
+            // last 16 bytes overlap the chunk before (the bytes that were already searched are shifted out of mask)
+            shift = (unsigned)(idx - (end - 16));
+            idx = end - 16;
+            is_last_chunk = true;
+        }
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + idx));
+        // signed compare, so bytes >= 0x80 are less than ' ' too
+        __m128i is_special = _mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del));
+        if (!is_line_ending_special) {
+            is_special = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, newline), is_special);
+        }
+        unsigned mask = ((unsigned)_mm_movemask_epi8(is_special) >> shift) << shift;
+        if (mask) {
+            *result = idx + __builtin_ctz(mask);
+            return true;
+        }
+        if (is_last_chunk) {
+            return false;
+        }
+        idx += 16;
+    }
+    // shorter ranges: the first and last 8 (or 4) bytes, which overlap
+    size_t len_chunk = end - start >= 8 ? 8 : 4;
+    if (end - start >= len_chunk) {
+        for (size_t idx_chunk = start; ; idx_chunk = end - len_chunk) {
+            __m128i chunk;
+            if (len_chunk == 8) {
+                chunk = _mm_loadl_epi64((const __m128i*)(items + idx_chunk));
+            } else {
+                int32_t bytes;
+                memcpy(&bytes, items + idx_chunk, sizeof(bytes));
+                chunk = _mm_cvtsi32_si128(bytes);
+            }
+            __m128i is_special = _mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del));
+            if (!is_line_ending_special) {
+                is_special = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, newline), is_special);
+            }
+            unsigned mask = (unsigned)_mm_movemask_epi8(is_special) & ((1u << len_chunk) - 1);
+            if (mask) {
+                *result = idx_chunk + __builtin_ctz(mask);
+                return true;
+            }
+            if (idx_chunk == end - len_chunk) {
+                return false;
+            }
+        }
+    }
+#else
+    for (; idx + 8 <= end; idx += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, items + idx, sizeof(chunk));
+        // any byte < ' ', >= 0x80, or 0x7f
+        uint64_t is_special = ((chunk - LINE_SCAN_SWAR_ONES * ' ') & ~chunk & LINE_SCAN_SWAR_HIGHS) | (chunk & LINE_SCAN_SWAR_HIGHS) |
+            line_scan_swar_has_byte(chunk, LINE_SCAN_SWAR_ONES * 0x7f);
+        if (is_special) {
+            // may only be a line ending
+            for (size_t idx_byte = idx; idx_byte < idx + 8; idx_byte++) {
+                unsigned char byte = items[idx_byte];
+                if (byte < ' ' || byte >= 0x7f) {
+                    if (is_line_ending_special || !columns_is_line_ending(byte)) {
+                        *result = idx_byte;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+#endif // __SSE2__
+
+    for (; idx < end; idx++) {
+        unsigned char byte = items[idx];
+        if ((byte < ' ' || byte >= 0x7f) && (is_line_ending_special || !columns_is_line_ending(byte))) {
+            *result = idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// cell that starts at items[idx] (idx < end), at column visual_x of a visual line that is max_visual_width columns wide
+// returns index one past the cell; width is set to its count of columns (at least 1; only a tab depends on visual_x)
+static inline size_t columns_next_cell(size_t* width, const char* items, size_t idx, size_t end, size_t visual_x, size_t max_visual_width) {
+    unsigned char lead = items[idx];
+    if (lead < 0x80 && (idx + 1 >= end || (unsigned char)items[idx + 1] < 0x80 || lead < ' ' || lead == 0x7f)) {
+        // combining characters after a tab, a control character, or a line ending are cells of their own
+        if (lead == '\t') {
+            *width = columns_tab_width(visual_x, max_visual_width);
+        } else if (columns_is_control(lead)) {
+            *width = 2;
+        } else {
+            *width = 1;
+        }
+        return idx + 1;
+    }
+
+    uint32_t code_point;
+    size_t next = idx + utf8_decode(&code_point, items, idx, end);
+    *width = code_point == UTF8_INVALID ? 1 : utf8_code_point_width(code_point);
+    if (*width < 1) {
+        // combining character at the start of a line
+        *width = 1;
+    }
+
+    // combining characters that follow belong to this cell
+    size_t len;
+    while (next < end && (unsigned char)items[next] >= 0x80 && utf8_is_zero_width_at(items, next, end, &len)) {
+        next += len;
+    }
+    return next;
+}
+
+
+// start of the cell that ends at items[idx] (start < idx); start is where the line (or text) starts
+// gives the same cells as columns_next_cell walking forward from the start of the line
+static inline size_t columns_prev_cell(const char* items, size_t start, size_t idx) {
+    if ((unsigned char)items[idx - 1] < 0x80) {
+        return idx - 1;
+    }
+
+    size_t cell_start = utf8_prev_char(items, start, idx);
+    size_t len;
+    while (
+        cell_start > start &&
+        (unsigned char)items[cell_start - 1] >= ' ' && items[cell_start - 1] != 0x7f &&
+        utf8_is_zero_width_at(items, cell_start, idx, &len)
+    ) {
+        // combining character belongs to the character before it
+        cell_start = utf8_prev_char(items, start, cell_start);
+    }
+    return cell_start;
+}
+
+
+// count of columns of the cells in items[start, end), where start is at column visual_x of its visual line
+// (start and end are at the start of a cell, and on the same visual line)
+static inline size_t columns_count(const char* items, size_t start, size_t end, size_t visual_x, size_t max_visual_width) {
+    size_t curr_visual_x = visual_x;
+    size_t idx = start;
+    while (idx < end) {
+        size_t special;
+        if (!columns_find_special(&special, items, idx, end, false)) {
+            curr_visual_x += end - idx;
+            break;
+        }
+
+        // printable character right before a non ascii one may have combining characters after it
+        if (special > idx + 1) {
+            curr_visual_x += special - 1 - idx;
+            idx = special - 1;
+        }
+        size_t width;
+        idx = columns_next_cell(&width, items, idx, end, curr_visual_x, max_visual_width);
+        curr_visual_x += width;
+    }
+    return curr_visual_x - visual_x;
+}
+
+
+// walk the cells of items[start, end) (start is at column visual_x of its visual line) while they fit in max_columns columns
+// returns index of the first cell that does not fit (or end); count_columns is set to the count of columns walked
+static inline size_t columns_skip(
+    size_t* count_columns,
+    const char* items,
+    size_t start,
+    size_t end,
+    size_t visual_x,
+    size_t max_columns,
+    size_t max_visual_width
+) {
+    size_t curr_columns = 0;
+    size_t idx = start;
+    while (idx < end && curr_columns < max_columns) {
+        // if the text is printable ascii, the rest of the columns are this many bytes
+        size_t end_plain = idx + MIN(max_columns - curr_columns, end - idx);
+        size_t special;
+        if (!columns_find_special(&special, items, idx, MIN(end_plain + 1, end), false)) {
+            curr_columns += end_plain - idx;
+            idx = end_plain;
+            break;
+        }
+
+        if (special > idx + 1) {
+            curr_columns += special - 1 - idx;
+            idx = special - 1;
+            continue;
+        }
+        size_t width;
+        size_t next = columns_next_cell(&width, items, idx, end, visual_x + curr_columns, max_visual_width);
+        if (curr_columns + width > max_columns) {
+            break;
+        }
+        curr_columns += width;
+        idx = next;
+    }
+
+    *count_columns = curr_columns;
+    return idx;
+}
+
+
+// walk the cells of items[start, end) (start is at column visual_x of its visual line) until at least min_end
+// returns index of the first cell at or after min_end (or end); visual_x is set to the column of that cell
+static inline size_t columns_walk_to(size_t* visual_x, const char* items, size_t start, size_t min_end, size_t end, size_t max_visual_width) {
+    size_t idx = start;
+    while (idx < min_end) {
+        size_t special;
+        if (!columns_find_special(&special, items, idx, MIN(min_end + 1, end), false)) {
+            *visual_x += min_end - idx;
+            return min_end;
+        }
+
+        if (special > idx + 1) {
+            *visual_x += special - 1 - idx;
+            idx = special - 1;
+        }
+        size_t width;
+        idx = columns_next_cell(&width, items, idx, end, *visual_x, max_visual_width);
+        *visual_x += width;
+    }
+    return idx;
+}
+
+
+#endif // COLUMNS_H
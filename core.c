@@ -0,0 +1,162 @@
+// implementation of text_editor_core.h
+// this translation unit must not include ncurses (or any header that does)
+
+#include "text_editor_core.h"
+#include "util.h"
+#include "new_string.h"
+#include "text_box.h"
+#include "document.h"
+
+
+#ifdef NCURSES_VERSION
+#error "the editor core must not depend on ncurses"
+#endif // NCURSES_VERSION
+
+
+#define CORE_DEFAULT_WIDTH 80
+#define CORE_DEFAULT_HEIGHT 24
+
+
+struct Core_document {
+    Document document;
+    String file_name;
+
+    size_t width;
+    size_t height;
+};
+
+
+Core_document* Core_document_new(const char* log_file_name) {
+    if (!log_file) {
+        log_file = log_file_name ? fopen(log_file_name, "w") : NULL;
+        if (!log_file) {
+            log_file = stderr;
+        }
+    }
+
+    Core_document* document = malloc(sizeof(*document));
+    if (!document) {
+        return NULL;
+    }
+    Document_init(&document->document);
+    String_init(&document->file_name);
+    document->width = CORE_DEFAULT_WIDTH;
+    document->height = CORE_DEFAULT_HEIGHT;
+    return document;
+}
+
+
+void Core_document_free(Core_document* document) {
+    Document_free(&document->document);
+    String_free_char_data(&document->file_name);
+    free(document);
+}
+
+
+bool Core_document_open(Core_document* document, const char* file_name) {
+    // file name is kept, so that the document can be saved later
+    String_cpy_from_cstr(&document->file_name, file_name, strlen(file_name));
+    String_append(&document->file_name, '\0');
+    document->document.file_name = document->file_name.items;
+
+    Actions_free(&document->document.actions);
+    Actions_free(&document->document.undo_actions);
+    return DOC_OPEN_SUCCESS == Document_open_file(&document->document);
+}
+
+
+bool Core_document_save(Core_document* document) {
+    if (!document->document.file_name) {
+        return false;
+    }
+    return Document_save(&document->document);
+}
+
+
+bool Core_document_has_unsaved_changes(const Core_document* document) {
+    return document->document.unsaved_changes;
+}
+
+
+void Core_document_set_size(Core_document* document, size_t width, size_t height) {
+    assert(width > 0 && height > 0);
+    document->width = width;
+    document->height = height;
+    Text_box_recalculate_visual_xy_and_scroll_offset(&document->document.text_box, width, height);
+}
+
+
+const char* Core_document_get_text(const Core_document* document, size_t* count) {
+    *count = document->document.text_box.string.count;
+    return document->document.text_box.string.items;
+}
+
+
+size_t Core_document_get_cursor(const Core_document* document) {
+    return document->document.text_box.cursor_info.pos.cursor;
+}
+
+
+void Core_document_move_cursor(Core_document* document, CORE_DIRECTION direction, size_t count) {
+    DIRECTION text_box_direction = DIR_UP;
+    switch (direction) {
+    case CORE_DIR_UP:
+        text_box_direction = DIR_UP;
+        break;
+    case CORE_DIR_DOWN:
+        text_box_direction = DIR_DOWN;
+        break;
+    case CORE_DIR_RIGHT:
+        text_box_direction = DIR_RIGHT;
+        break;
+    case CORE_DIR_LEFT:
+        text_box_direction = DIR_LEFT;
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+    Text_box_move_cursor_repeat(&document->document.text_box, text_box_direction, count, document->width, document->height, false);
+}
+
+
+void Core_document_insert(Core_document* document, const char* text, size_t count) {
+    if (count < 1) {
+        return;
+    }
+    String new_str = {.count = count, .capacity = count, .items = (char*)text};
+    Document_insert(
+        &document->document,
+        &new_str,
+        document->document.text_box.cursor_info.pos.cursor,
+        document->width,
+        document->height
+    );
+}
+
+
+bool Core_document_backspace(Core_document* document) {
+    return Document_del_before_cursor(&document->document, document->width, document->height);
+}
+
+
+bool Core_document_undo(Core_document* document) {
+    return Document_undo(&document->document, document->width, document->height);
+}
+
+
+bool Core_document_redo(Core_document* document) {
+    return Document_redo(&document->document, document->width, document->height);
+}
+
+
+bool Core_document_search(Core_document* document, const char* query, size_t count_query, bool forwards) {
+    String query_str = {.count = count_query, .capacity = count_query, .items = (char*)query};
+    return Text_box_do_search(
+        &document->document.text_box,
+        &query_str,
+        forwards ? SEARCH_DIR_FORWARDS : SEARCH_DIR_BACKWARDS,
+        document->width,
+        document->height
+    );
+}
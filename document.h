@@ -0,0 +1,815 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+
+// text of one file, with its cursor, undo history and save state
+// nothing in here depends on ncurses, so it can be used without a terminal (see text_editor_core.h)
+
+
+#include <pthread.h>
+#include "util.h"
+#include "new_string.h"
+#include "text_box.h"
+#include "action.h"
+#include "line_ending.h"
+#include "syntax.h"
+#include "brackets.h"
+#include "fold.h"
+#include "clipboard.h"
+
+
+typedef enum {
+    DOC_OPEN_SUCCESS = 0,
+    DOC_OPEN_NO_FILE_NAME,
+    DOC_OPEN_ERROR, // errno is set
+} DOC_OPEN_STATUS;
+
+
+// another window that displays the text (eg. the other window of a split)
+typedef struct {
+    Cursor_info* cursor_info; // its cursor (NULL if there is no such window)
+    size_t max_visual_width;
+    size_t max_visual_height;
+} Document_view;
+
+
+typedef struct {
+    Text_box text_box;
+
+    Actions actions;
+    Actions undo_actions;
+
+    const char* file_name;
+    LINE_ENDING line_ending; // line ending of the file (the text has \n line endings; see line_ending.h)
+    Syntax syntax; // highlighting of the text (every edit of the text is passed on to it; see Document_note_edit)
+    Brackets brackets; // nesting of the brackets of the text (also kept up to date by Document_note_edit)
+    Folds folds; // folded lines of the text (also kept up to date by Document_note_edit)
+    bool unsaved_changes;
+    Document_view other_view; // its cursor is kept up to date by Document_note_edit (text_box has the cursor of the focused window)
+    Vector_size_t cursors; // other cursors of the text (sorted, without the main cursor of text_box; see Document_insert_at_cursors)
+
+    // size of the window that the cursor and the scroll of the text were last computed for (see Editor_switch_document)
+    size_t layout_width;
+    size_t layout_height;
+} Document;
+
+
+typedef Document* Document_ptr;
+define_vector(Document_ptr)
+
+
+static inline void Document_init(Document* document) {
+    memset(document, 0, sizeof(*document));
+    Text_box_init(&document->text_box);
+    Actions_init(&document->actions);
+    Actions_init(&document->undo_actions);
+    Syntax_init(&document->syntax);
+    Brackets_init(&document->brackets);
+    Folds_init(&document->folds, &document->text_box.string);
+}
+
+
+static inline void Document_free(Document* document) {
+    Clips_detach(&document->text_box.string, 0, SIZE_MAX);
+    Text_box_free(&document->text_box);
+    Actions_free(&document->actions);
+    Actions_free(&document->undo_actions);
+    Syntax_free(&document->syntax);
+    Brackets_free(&document->brackets);
+    Folds_free(&document->folds);
+    free(document->cursors.items);
+}
+
+
+// to be called after removed[0, count_removed) at start of the text was replaced by count_inserted bytes
+static inline void Document_note_edit(Document* document, size_t start, const char* removed, size_t count_removed, size_t count_inserted) {
+    Syntax_note_edit(&document->syntax, &document->text_box.string, start, removed, count_removed, count_inserted);
+    Brackets_note_edit(&document->brackets, &document->text_box.string, start, count_removed, count_inserted);
+    Folds_note_edit(&document->folds, start, count_removed, count_inserted);
+    Clips_note_edit(&document->text_box.string, start, removed, count_removed, count_inserted);
+    for (size_t idx = 0; idx < document->cursors.count; idx++) {
+        document->cursors.items[idx] = text_box_adjust_after_edit(document->cursors.items[idx], start, count_removed, count_inserted);
+    }
+    const Document_view* view = &document->other_view;
+    if (view->cursor_info) {
+        Cursor_info_note_edit(
+            view->cursor_info, &document->text_box.string, start, count_removed, count_inserted, view->max_visual_width, view->max_visual_height
+        );
+    }
+}
+
+
+// to be called before batch is applied to the text (the clips of the text from the first edit to the last one are
+// copied out of it, since the text after each edit is only known once every edit was applied)
+static inline void Document_note_batch_start(Document* document, const Edit_batch* batch) {
+    if (batch->edits.count < 1) {
+        return;
+    }
+    const Batch_edit* last = &batch->edits.items[batch->edits.count - 1];
+    Clips_detach(&document->text_box.string, batch->edits.items[0].start, last->start + last->count_removed);
+}
+
+
+// to be called after batch was applied to the text (the same as noting every edit of it, except that the highlighting
+// and the brackets from the first edit to the last one are found again at once, and the other view is walked once)
+static inline void Document_note_batch(Document* document, const Edit_batch* batch) {
+    if (batch->edits.count < 1) {
+        return;
+    }
+    const String* string = &document->text_box.string;
+
+    // the edits are noted in order, each at its position in the text after the edits before it
+    size_t count_removed = 0;
+    size_t count_inserted = 0;
+    size_t rows_inserted = 0;
+    for (size_t idx = 0; idx < batch->edits.count; idx++) {
+        const Batch_edit* edit = &batch->edits.items[idx];
+        size_t start = edit->start - count_removed + count_inserted;
+        Folds_note_edit(&document->folds, start, edit->count_removed, edit->count_inserted);
+        Clips_note_edit(string, start, batch->removed.items + count_removed, edit->count_removed, edit->count_inserted);
+        rows_inserted += line_scan_count_newlines(string->items, start, start + edit->count_inserted);
+        count_removed += edit->count_removed;
+        count_inserted += edit->count_inserted;
+    }
+
+    const Batch_edit* first = &batch->edits.items[0];
+    const Batch_edit* last = &batch->edits.items[batch->edits.count - 1];
+    size_t end_removed = last->start + last->count_removed;
+    size_t end_inserted = end_removed - count_removed + count_inserted;
+    Column_map_update_after_edit(string, first->start, end_removed - first->start, end_inserted - first->start);
+
+    // the lexer reads the text, which only has its lines after every edit, so the batch is noted as one edit from the
+    // first edit to the last one (its removed lines are the lines of the text between the edits, and the removed ones)
+    size_t rows_span = line_scan_count_newlines(string->items, first->start, end_inserted);
+    size_t rows_removed = rows_span - rows_inserted + line_scan_count_newlines(batch->removed.items, 0, count_removed);
+    Syntax_note_edit_rows(&document->syntax, string, first->start, end_removed - first->start, rows_removed, end_inserted - first->start);
+    Brackets_note_edit(&document->brackets, string, first->start, end_removed - first->start, end_inserted - first->start);
+
+    Edit_batch_move_positions(batch, document->cursors.items, document->cursors.count);
+    const Document_view* view = &document->other_view;
+    Cursor_info* cursor_info = view->cursor_info;
+    if (cursor_info && (first->start < cursor_info->pos.cursor || first->start < cursor_info->scroll.offset)) {
+        Edit_batch_move_positions(batch, &cursor_info->pos.cursor, 1);
+        Edit_batch_move_positions(batch, &cursor_info->scroll.offset, 1);
+        Cursor_info_note_moved(cursor_info, string, first->start, end_inserted, view->max_visual_width, view->max_visual_height);
+    }
+}
+
+
+// replace text of document with contents of file_name (Document_note_opened must be called after it succeeds)
+// only the document is changed, so several documents can be read at the same time (see Documents_open_files)
+static inline DOC_OPEN_STATUS Document_read_file(Document* document) {
+    if (!document->file_name) {
+        return DOC_OPEN_NO_FILE_NAME;
+    }
+
+    if (0 != access(document->file_name, R_OK)) {
+        return DOC_OPEN_ERROR;
+    }
+
+    log("note: opening file %s\n", document->file_name);
+    FILE* f = fopen(document->file_name, "r");
+    if (!f) {
+        return DOC_OPEN_ERROR;
+    }
+    // read straight into the text (line endings are converted in place below)
+    String* string = &document->text_box.string;
+    string->count = 0;
+    size_t amount_read;
+    do {
+        vector_enlarge_if_nessessary_char(string, string->count + 65536);
+        amount_read = fread(string->items + string->count, 1, string->capacity - string->count, f);
+        string->count += amount_read;
+    } while (amount_read > 0);
+    fclose(f);
+
+    Line_ending_counts line_endings;
+    string->count = line_ending_normalize(&line_endings, string->items, 0, string->count);
+    document->line_ending = line_endings.first;
+    if (line_endings.count_crlf > 0 || line_endings.count_cr > 0) {
+        log(
+            "note: %s has %s line endings (%zu crlf and %zu cr line endings were converted)\n", 
+            document->file_name, line_ending_name(line_endings.first), line_endings.count_crlf, line_endings.count_cr
+        );
+    }
+
+    // invalid bytes are still kept (and saved) as they are; they are only drawn as U+FFFD
+    size_t first_invalid;
+    if (!utf8_validate(&first_invalid, string->items, string->count)) {
+        log("warning: %s is not valid utf-8 (first invalid byte at offset %zu)\n", document->file_name, first_invalid);
+    }
+    return DOC_OPEN_SUCCESS;
+}
+
+
+// reset everything that depended on the text, after it was replaced by Document_read_file
+static inline void Document_note_opened(Document* document) {
+    Column_map_invalidate_all();
+    Syntax_set_lang(&document->syntax, syntax_lang_from_file_name(document->file_name));
+    Brackets_clear(&document->brackets);
+    Folds_clear(&document->folds);
+    document->cursors.count = 0;
+
+    Cursor_info_init(&document->text_box.cursor_info);
+    if (document->other_view.cursor_info) {
+        Cursor_info_init(document->other_view.cursor_info);
+    }
+    Visual_selected_init(&document->text_box.visual_sel);
+    document->unsaved_changes = false;
+}
+
+
+// replace text of document with contents of file_name
+static inline DOC_OPEN_STATUS Document_open_file(Document* document) {
+    Clips_detach(&document->text_box.string, 0, SIZE_MAX);
+    DOC_OPEN_STATUS status = Document_read_file(document);
+    if (status == DOC_OPEN_SUCCESS) {
+        Document_note_opened(document);
+    }
+    return status;
+}
+
+
+// files are read by at most this many threads at the same time
+#define DOCUMENTS_MAX_READ_THREADS 8
+
+
+// documents[first], documents[first + step], ... are read by one thread
+typedef struct {
+    Document** documents;
+    DOC_OPEN_STATUS* statuses;
+    int* errnos;
+    size_t count;
+    size_t first;
+    size_t step;
+} Documents_read_job;
+
+
+static inline void* documents_read_worker(void* arg) {
+    const Documents_read_job* job = arg;
+    for (size_t idx = job->first; idx < job->count; idx += job->step) {
+        errno = 0;
+        job->statuses[idx] = Document_read_file(job->documents[idx]);
+        job->errnos[idx] = errno;
+    }
+    return NULL;
+}
+
+
+// open every document (the files are read by several threads; the rest is done by the calling thread)
+// statuses[idx] is the status of documents[idx], and errnos[idx] is errno after it was read
+static inline void Documents_open_files(DOC_OPEN_STATUS* statuses, int* errnos, Document** documents, size_t count) {
+    size_t count_threads = MIN(count, DOCUMENTS_MAX_READ_THREADS);
+    pthread_t threads[DOCUMENTS_MAX_READ_THREADS];
+    Documents_read_job jobs[DOCUMENTS_MAX_READ_THREADS];
+    bool is_started[DOCUMENTS_MAX_READ_THREADS] = {0};
+    for (size_t idx = 0; idx < count; idx++) {
+        Clips_detach(&documents[idx]->text_box.string, 0, SIZE_MAX);
+    }
+    for (size_t idx = 0; idx < count_threads; idx++) {
+        jobs[idx] = (Documents_read_job){
+            .documents = documents, .statuses = statuses, .errnos = errnos, .count = count, .first = idx, .step = count_threads
+        };
+        // (the first job is done by this thread)
+        if (idx > 0) {
+            is_started[idx] = 0 == pthread_create(&threads[idx], NULL, documents_read_worker, &jobs[idx]);
+        }
+    }
+    for (size_t idx = 0; idx < count_threads; idx++) {
+        if (is_started[idx]) {
+            pthread_join(threads[idx], NULL);
+        } else {
+            documents_read_worker(&jobs[idx]);
+        }
+    }
+
+    for (size_t idx = 0; idx < count; idx++) {
+        if (statuses[idx] == DOC_OPEN_SUCCESS) {
+            Document_note_opened(documents[idx]);
+        }
+    }
+}
+
+
+// returns false if file could not be written
+static inline bool Document_save(Document* document) {
+    const String* string = &document->text_box.string;
+    if (!line_ending_replace_file(document->file_name, string->items, string->count, document->line_ending)) {
+        return false;
+    }
+
+    document->unsaved_changes = false;
+    return true;
+}
+
+
+static inline void Document_insert(Document* document, const String* new_str, size_t index, size_t max_visual_width, size_t max_visual_height) {
+    Text_box_insert_substr(&document->text_box, new_str, index, max_visual_width, max_visual_height);
+    Document_note_edit(document, index, NULL, 0, new_str->count);
+
+    Action new_action = {.cursor = index, .action = ACTION_INSERT_STRING, .str = {0}};
+    String_cpy(&new_action.str, new_str);
+    Actions_append(&document->actions, &new_action);
+    document->unsaved_changes = true;
+}
+
+
+// delete the character before the cursor
+// returns false if nothing was deleted
+static inline bool Document_del_before_cursor(Document* document, size_t max_visual_width, size_t max_visual_height) {
+    Text_box* text_box = &document->text_box;
+    if (text_box->cursor_info.pos.cursor < 1) {
+        return false;
+    }
+
+    size_t start_prev_char = get_start_prev_char(&text_box->string, text_box->cursor_info.pos.cursor);
+    if (Folds_open_at(&document->folds, start_prev_char)) {
+        // (the line ending of the last folded line is deleted, so the fold is shown first)
+        Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+    }
+    Action new_action = {
+        .cursor = start_prev_char,
+        .action = ACTION_REMOVE_STRING,
+        .str = {0}
+    };
+
+    // placing char to delete (all of its bytes) in new_action->str
+    String_init(&new_action.str);
+    String_cpy_from_substring(&new_action.str, &text_box->string, start_prev_char, text_box->cursor_info.pos.cursor - start_prev_char);
+
+    Actions_append(&document->actions, &new_action);
+
+    bool del_success = Text_box_del_ch(text_box, start_prev_char, max_visual_width, max_visual_height);
+    if (del_success) {
+        Document_note_edit(document, start_prev_char, new_action.str.items, new_action.str.count, 0);
+        document->unsaved_changes = true;
+    }
+    return del_success;
+}
+
+
+// undo the edits of batch (after it was applied); batch is turned into the batch that undoes this (so that it can be
+// redone by the same function)
+static inline void document_revert_batch(Document* document, Edit_batch* batch) {
+    Text_box* text_box = &document->text_box;
+    Edit_batch_invert(batch);
+    Document_note_batch_start(document, batch);
+    Edit_batch_apply(&text_box->string, batch);
+    Edit_batch_move_positions(batch, &text_box->cursor_info.pos.cursor, 1);
+    Document_note_batch(document, batch);
+}
+
+
+// returns false if there is nothing to undo
+static inline bool Document_undo(Document* document, size_t max_visual_width, size_t max_visual_height) {
+    if (document->actions.count < 1) {
+        return false;
+    }
+
+    Action action_to_undo;
+    Actions_pop(&action_to_undo, &document->actions);
+
+    Text_box* text_box = &document->text_box;
+    debug("Document_undo: cursor: %zu", action_to_undo.cursor);
+    switch (action_to_undo.action) {
+    case ACTION_INSERT_STRING: {
+        Text_box_del_substr(text_box, action_to_undo.cursor, action_to_undo.str.count);
+        Document_note_edit(document, action_to_undo.cursor, action_to_undo.str.items, action_to_undo.str.count, 0);
+        text_box->cursor_info.pos.cursor = action_to_undo.cursor;
+        Action undo_action = {.cursor = action_to_undo.cursor, .action = ACTION_REMOVE_STRING, .str = action_to_undo.str};
+        Actions_append(&document->undo_actions, &undo_action);
+        } break;
+    case ACTION_REMOVE_STRING: {
+        String_insert_string(&text_box->string, action_to_undo.cursor, &action_to_undo.str);
+        Column_map_update_after_edit(&text_box->string, action_to_undo.cursor, 0, action_to_undo.str.count);
+        Document_note_edit(document, action_to_undo.cursor, NULL, 0, action_to_undo.str.count);
+        text_box->cursor_info.pos.cursor = action_to_undo.cursor + action_to_undo.str.count;
+        Action undo_action = {.cursor = action_to_undo.cursor, .action = ACTION_INSERT_STRING, .str = action_to_undo.str};
+        Actions_append(&document->undo_actions, &undo_action);
+        } break;
+    case ACTION_BATCH: {
+        document_revert_batch(document, &action_to_undo.batch);
+        Actions_append(&document->undo_actions, &action_to_undo);
+        } break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+
+    Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+    return true;
+}
+
+
+// returns false if there is nothing to redo
+static inline bool Document_redo(Document* document, size_t max_visual_width, size_t max_visual_height) {
+    if (document->undo_actions.count < 1) {
+        return false;
+    }
+
+    Action action_to_redo;
+    Actions_pop(&action_to_redo, &document->undo_actions);
+
+    Text_box* text_box = &document->text_box;
+    switch (action_to_redo.action) {
+    case ACTION_INSERT_STRING: {
+        Text_box_del_substr(text_box, action_to_redo.cursor, action_to_redo.str.count);
+        Document_note_edit(document, action_to_redo.cursor, action_to_redo.str.items, action_to_redo.str.count, 0);
+        text_box->cursor_info.pos.cursor = action_to_redo.cursor;
+        Action redo_action = {.cursor = action_to_redo.cursor, .action = ACTION_REMOVE_STRING, .str = {0}};
+        String_cpy(&redo_action.str, &action_to_redo.str);
+        Actions_append(&document->actions, &redo_action);
+        } break;
+    case ACTION_REMOVE_STRING: {
+        String_insert_string(&text_box->string, action_to_redo.cursor, &action_to_redo.str);
+        Column_map_update_after_edit(&text_box->string, action_to_redo.cursor, 0, action_to_redo.str.count);
+        Document_note_edit(document, action_to_redo.cursor, NULL, 0, action_to_redo.str.count);
+        text_box->cursor_info.pos.cursor = action_to_redo.cursor + action_to_redo.str.count;
+        Action redo_action = {.cursor = action_to_redo.cursor, .action = ACTION_INSERT_STRING, .str = {0}};
+        String_cpy(&redo_action.str, &action_to_redo.str);
+        Actions_append(&document->actions, &redo_action);
+        } break;
+    case ACTION_BATCH: {
+        document_revert_batch(document, &action_to_redo.batch);
+        Actions_append(&document->actions, &action_to_redo);
+        } break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+
+    Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+    return true;
+}
+
+
+// end of the lines after the header line that are nested in a bracket opened on the header, and closed on a later line
+// (start is the start of the line after the header); returns false if there is none
+static inline bool document_find_fold_by_brackets(size_t* end, Document* document, size_t start_header, size_t start) {
+    const String* string = &document->text_box.string;
+    for (size_t idx = start - 1; idx-- > start_header;) {
+        BRACKET kind;
+        size_t match;
+        if (brackets_classify(string->items[idx], &kind) <= 0 || !Brackets_find_match(&match, &document->brackets, string, idx) || match < start) {
+            continue;
+        }
+        // the line of the closing bracket stays visible
+        size_t end_prev_line;
+        bool has_prev_line = line_scan_find_newline_backward(&end_prev_line, string->items, start, match);
+        if (has_prev_line) {
+            *end = end_prev_line + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static inline size_t document_count_indent(const String* string, size_t start_line, bool* is_blank) {
+    size_t idx = start_line;
+    while (idx < string->count && (string->items[idx] == ' ' || string->items[idx] == '\t')) {
+        idx++;
+    }
+    *is_blank = idx >= string->count || string->items[idx] == '\n';
+    return idx - start_line;
+}
+
+
+// end of the lines after the header line that are indented more than it (blank lines between them are included)
+// returns false if there is none
+static inline bool document_find_fold_by_indent(size_t* end, const String* string, size_t start_header, size_t start) {
+    bool is_blank;
+    size_t indent_header = document_count_indent(string, start_header, &is_blank);
+    bool is_found = false;
+    size_t start_line = start;
+    while (start_line < string->count) {
+        size_t indent = document_count_indent(string, start_line, &is_blank);
+        if (!is_blank && indent <= indent_header) {
+            break;
+        }
+        size_t end_line;
+        size_t start_next_line = line_scan_find_newline_forward(&end_line, string->items, start_line, string->count) ? end_line + 1 : string->count;
+        if (!is_blank) {
+            *end = start_next_line;
+            is_found = true;
+        }
+        start_line = start_next_line;
+    }
+    return is_found;
+}
+
+
+// close (or open) the fold of the lines after the line of the cursor
+// if there is none, the lines up to the closing bracket of a bracket opened on that line, or else the lines that are
+// indented more than it, are folded
+// returns false if there is nothing to fold
+static inline bool Document_toggle_fold(Document* document, size_t max_visual_width, size_t max_visual_height) {
+    Text_box* text_box = &document->text_box;
+    const String* string = &text_box->string;
+    size_t cursor = text_box->cursor_info.pos.cursor;
+    size_t end_header;
+    if (!line_scan_find_newline_forward(&end_header, string->items, cursor, string->count) || end_header + 1 >= string->count) {
+        return false;
+    }
+    size_t end_prev_line;
+    size_t start_header = line_scan_find_newline_backward(&end_prev_line, string->items, 0, cursor) ? end_prev_line + 1 : 0;
+    size_t start = end_header + 1;
+
+    size_t existing = Folds_find_at(&document->folds, start);
+    if (existing < document->folds.folds.count) {
+        document->folds.folds.items[existing].is_closed = !document->folds.folds.items[existing].is_closed;
+        folds_update_hidden(&document->folds);
+    } else {
+        size_t end;
+        if (!document_find_fold_by_brackets(&end, document, start_header, start) && !document_find_fold_by_indent(&end, string, start_header, start)) {
+            return false;
+        }
+        if (!Folds_add(&document->folds, start, end)) {
+            return false;
+        }
+    }
+    Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+    return true;
+}
+
+
+static inline void Document_cpy_selection(Clip* clip, const Document* document) {
+    size_t start = Text_box_get_visual_sel_start(&document->text_box);
+    size_t end = Text_box_get_visual_sel_end(&document->text_box);
+
+    // the selection includes every byte of the character at end
+    end = end < document->text_box.string.count ? get_end_of_char(&document->text_box.string, end) : document->text_box.string.count;
+    Clip_set_range(clip, &document->text_box.string, start, end - start);
+}
+
+
+// insert text at the cursor, without moving the cursor
+static inline void Document_paste(Document* document, const Clip* clip) {
+    size_t count = Clip_count(clip);
+    if (count < 1) {
+        return;
+    }
+
+    // insert text (straight from the text that it was copied from)
+    String* string = &document->text_box.string;
+    size_t cursor = document->text_box.cursor_info.pos.cursor;
+    if (clip->string == string) {
+        String_insert_from_self(string, cursor, clip->start, count);
+    } else {
+        String_insert_cstr(string, cursor, Clip_items(clip), count);
+    }
+    Column_map_update_after_edit(string, cursor, 0, count);
+    Document_note_edit(document, cursor, NULL, 0, count);
+
+    // add action to actions so that insertion can be undone
+    Action new_action = {
+        .cursor = cursor,
+        .action = ACTION_INSERT_STRING,
+        .str = {0}
+    };
+    String_cpy_from_substring(&new_action.str, string, cursor, count);
+    Actions_append(&document->actions, &new_action);
+}
+
+
+// delete the selected text (the selection is ended)
+// returns false if nothing is selected
+static inline bool Document_del_selection(Document* document, size_t max_visual_width, size_t max_visual_height) {
+    Text_box* text_box = &document->text_box;
+    if (text_box->visual_sel.state == VIS_STATE_NONE) {
+        return false;
+    }
+    size_t start = Text_box_get_visual_sel_start(text_box);
+    size_t end = Text_box_get_visual_sel_end(text_box);
+    end = end < text_box->string.count ? get_end_of_char(&text_box->string, end) : text_box->string.count;
+    text_box->visual_sel.state = VIS_STATE_NONE;
+    if (start >= end) {
+        return false;
+    }
+
+    Action new_action = {
+        .cursor = start,
+        .action = ACTION_REMOVE_STRING,
+        .str = {0}
+    };
+    String_cpy_from_substring(&new_action.str, &text_box->string, start, end - start);
+    Actions_append(&document->actions, &new_action);
+
+    Text_box_del_substr(text_box, start, end - start);
+    Document_note_edit(document, start, new_action.str.items, new_action.str.count, 0);
+    text_box->cursor_info.pos.cursor = start;
+    document->unsaved_changes = true;
+    Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+    return true;
+}
+
+
+// multiple cursors
+//
+// the main cursor is the cursor of text_box (it is moved, and scrolled to, like the cursor of any text); the others are
+// only positions in the text (document->cursors), which are moved with the text by every edit
+// a key typed with several cursors is one Edit_batch of edits at every cursor (see edit_batch.h): the text and every
+// cursor are changed in one pass, and the batch is undone as one action
+
+
+// add a cursor at each of positions (sorted)
+static inline void document_add_cursors(Document* document, const size_t* positions, size_t count_positions) {
+    // both are sorted, so they are merged (duplicates and the main cursor are dropped)
+    size_t main_cursor = document->text_box.cursor_info.pos.cursor;
+    Vector_size_t merged = {0};
+    vector_enlarge_if_nessessary_size_t(&merged, document->cursors.count + count_positions);
+    size_t idx_old = 0;
+    size_t idx_new = 0;
+    while (idx_old < document->cursors.count || idx_new < count_positions) {
+        size_t pos;
+        if (idx_new >= count_positions || (idx_old < document->cursors.count && document->cursors.items[idx_old] <= positions[idx_new])) {
+            pos = document->cursors.items[idx_old++];
+        } else {
+            pos = positions[idx_new++];
+        }
+        if (pos == main_cursor || (merged.count > 0 && *vector_back_size_t(&merged) == pos)) {
+            continue;
+        }
+        merged.items[merged.count++] = pos;
+    }
+    free(document->cursors.items);
+    document->cursors = merged;
+}
+
+
+// drop the cursors that are at the same position as the one before them (or as the main cursor)
+static inline void document_drop_duplicate_cursors(Document* document) {
+    size_t main_cursor = document->text_box.cursor_info.pos.cursor;
+    Vector_size_t* cursors = &document->cursors;
+    size_t count_kept = 0;
+    for (size_t idx = 0; idx < cursors->count; idx++) {
+        size_t pos = cursors->items[idx];
+        if (pos == main_cursor || (count_kept > 0 && cursors->items[count_kept - 1] == pos)) {
+            continue;
+        }
+        cursors->items[count_kept++] = pos;
+    }
+    cursors->count = count_kept;
+}
+
+
+// every cursor (the main one and the others), sorted
+static inline void document_get_all_cursors(Vector_size_t* positions, const Document* document) {
+    size_t main_cursor = document->text_box.cursor_info.pos.cursor;
+    size_t idx_main = 0;
+    while (idx_main < document->cursors.count && document->cursors.items[idx_main] < main_cursor) {
+        idx_main++;
+    }
+    positions->count = 0;
+    vector_insert_items_size_t(positions, document->cursors.items, document->cursors.count, 0);
+    if (idx_main >= document->cursors.count || document->cursors.items[idx_main] != main_cursor) {
+        // (the main cursor can be moved to where another cursor is)
+        vector_insert_size_t(positions, &main_cursor, idx_main);
+    }
+}
+
+
+static inline void Document_clear_cursors(Document* document) {
+    document->cursors.count = 0;
+}
+
+
+// add a cursor at the start of every match of query (matches do not overlap)
+static inline void Document_add_cursors_at_matches(Document* document, const String* query) {
+    const String* string = &document->text_box.string;
+    if (query->count < 1 || query->count > string->count) {
+        return;
+    }
+    Vector_size_t matches = {0};
+    size_t idx = 0;
+    while (idx + query->count <= string->count) {
+        const char* found = memchr(string->items + idx, query->items[0], string->count - query->count + 1 - idx);
+        if (!found) {
+            break;
+        }
+        size_t pos = found - string->items;
+        if (0 == memcmp(string->items + pos, query->items, query->count)) {
+            vector_append_size_t(&matches, &pos);
+            idx = pos + query->count;
+        } else {
+            idx = pos + 1;
+        }
+    }
+    document_add_cursors(document, matches.items, matches.count);
+    free(matches.items);
+}
+
+
+// add a cursor to every line from the line of start to the line of end, at the column of the main cursor (or at the
+// end of a line that is shorter)
+static inline void Document_add_cursors_on_lines(Document* document, size_t start, size_t end) {
+    const String* string = &document->text_box.string;
+    size_t main_cursor = document->text_box.cursor_info.pos.cursor;
+    size_t end_prev_line;
+    size_t start_main_line = line_scan_find_newline_backward(&end_prev_line, string->items, 0, main_cursor) ? end_prev_line + 1 : 0;
+    size_t column = columns_count(string->items, start_main_line, main_cursor, 0, TEXT_BOX_NO_WRAP);
+
+    Vector_size_t positions = {0};
+    size_t start_line = line_scan_find_newline_backward(&end_prev_line, string->items, 0, start) ? end_prev_line + 1 : 0;
+    while (start_line <= end) {
+        size_t end_line;
+        bool has_newline = line_scan_find_newline_forward(&end_line, string->items, start_line, string->count);
+        if (!has_newline) {
+            end_line = string->count;
+        }
+        size_t count_columns;
+        size_t pos = columns_skip(&count_columns, string->items, start_line, end_line, 0, column, TEXT_BOX_NO_WRAP);
+        vector_append_size_t(&positions, &pos);
+        if (!has_newline) {
+            break;
+        }
+        start_line = end_line + 1;
+    }
+    document_add_cursors(document, positions.items, positions.count);
+    free(positions.items);
+}
+
+
+// apply batch (made for the text) as one action; every cursor is moved with the text
+static inline void document_apply_batch(Document* document, Action* action, size_t max_visual_width, size_t max_visual_height) {
+    Text_box* text_box = &document->text_box;
+    Document_note_batch_start(document, &action->batch);
+    Edit_batch_apply(&text_box->string, &action->batch);
+    Edit_batch_move_positions(&action->batch, &text_box->cursor_info.pos.cursor, 1);
+    Document_note_batch(document, &action->batch);
+    document_drop_duplicate_cursors(document);
+    Actions_append(&document->actions, action);
+    document->unsaved_changes = true;
+    Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+}
+
+
+// insert new_str at every cursor, as one action
+static inline void Document_insert_at_cursors(Document* document, const String* new_str, size_t max_visual_width, size_t max_visual_height) {
+    Vector_size_t positions = {0};
+    document_get_all_cursors(&positions, document);
+    Action new_action = {.cursor = document->text_box.cursor_info.pos.cursor, .action = ACTION_BATCH, .str = {0}};
+    Edit_batch_init(&new_action.batch);
+    vector_enlarge_if_nessessary_Batch_edit(&new_action.batch.edits, positions.count);
+    vector_enlarge_if_nessessary_char(&new_action.batch.inserted, positions.count * new_str->count);
+    for (size_t idx = 0; idx < positions.count; idx++) {
+        Edit_batch_add(&new_action.batch, &document->text_box.string, positions.items[idx], 0, new_str->items, new_str->count);
+    }
+    free(positions.items);
+    document_apply_batch(document, &new_action, max_visual_width, max_visual_height);
+}
+
+
+// delete the character before every cursor, as one action
+// returns false if nothing was deleted
+static inline bool Document_del_before_cursors(Document* document, size_t max_visual_width, size_t max_visual_height) {
+    const String* string = &document->text_box.string;
+    Vector_size_t positions = {0};
+    document_get_all_cursors(&positions, document);
+    Action new_action = {.cursor = document->text_box.cursor_info.pos.cursor, .action = ACTION_BATCH, .str = {0}};
+    Edit_batch_init(&new_action.batch);
+    size_t end_prev_edit = 0;
+    for (size_t idx = 0; idx < positions.count; idx++) {
+        size_t pos = positions.items[idx];
+        if (pos < 1) {
+            continue;
+        }
+        size_t start_prev_char = MAX(get_start_prev_char(string, pos), end_prev_edit);
+        if (start_prev_char < pos) {
+            Edit_batch_add(&new_action.batch, string, start_prev_char, pos - start_prev_char, "", 0);
+            end_prev_edit = pos;
+        }
+    }
+    free(positions.items);
+    if (new_action.batch.edits.count < 1) {
+        Edit_batch_free(&new_action.batch);
+        return false;
+    }
+    document_apply_batch(document, &new_action, max_visual_width, max_visual_height);
+    return true;
+}
+
+
+// move the other cursors count characters left (or right), after the main cursor was moved by the caller
+static inline void Document_move_cursors(Document* document, DIRECTION direction, size_t count) {
+    const String* string = &document->text_box.string;
+    for (size_t idx = 0; idx < document->cursors.count; idx++) {
+        size_t* pos = &document->cursors.items[idx];
+        for (size_t idx_move = 0; idx_move < count; idx_move++) {
+            switch (direction) {
+            case DIR_LEFT:
+                *pos = *pos > 0 ? get_start_prev_char(string, *pos) : 0;
+                break;
+            case DIR_RIGHT:
+                *pos = *pos < string->count ? get_end_of_char(string, *pos) : string->count;
+                break;
+            default:
+                assert(false && "only left and right");
+                abort();
+            }
+        }
+    }
+    document_drop_duplicate_cursors(document);
+}
+
+#endif // DOCUMENT_H
@@ -0,0 +1,180 @@
+#ifndef EDIT_BATCH_H
+#define EDIT_BATCH_H
+
+
+// several edits of a text that are made (and undone) together, eg. a key typed at every cursor of a document
+//
+// the edits are applied in one pass over the text (the parts of the text between the edits are each moved once), so
+// a batch costs about as much as one edit of the whole text, however many edits it has; positions in the text (eg.
+// the cursors) are moved with it in one pass over the edits
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+
+
+typedef struct {
+    size_t start; // position in the text before the batch is applied
+    size_t count_removed;
+    size_t count_inserted;
+} Batch_edit;
+
+
+define_vector(Batch_edit)
+
+
+typedef struct {
+    Vector_Batch_edit edits; // sorted by start, and not overlapping
+    String removed; // text removed by every edit, one after another (in the order of the edits)
+    String inserted; // text inserted by every edit, one after another
+} Edit_batch;
+
+
+static inline void Edit_batch_init(Edit_batch* batch) {
+    memset(batch, 0, sizeof(*batch));
+}
+
+
+static inline void Edit_batch_free(Edit_batch* batch) {
+    free(batch->edits.items);
+    String_free_char_data(&batch->removed);
+    String_free_char_data(&batch->inserted);
+    memset(batch, 0, sizeof(*batch));
+}
+
+
+// string[start, start + count_removed) is replaced by inserted[0, count_inserted)
+// (start must be after the part removed by the edit added before)
+static inline void Edit_batch_add(Edit_batch* batch, const String* string, size_t start, size_t count_removed, const char* inserted, size_t count_inserted) {
+    assert(start + count_removed <= string->count);
+    if (batch->edits.count > 0) {
+        const Batch_edit* last = vector_back_Batch_edit(&batch->edits);
+        assert(start >= last->start + last->count_removed && "edits must be sorted and not overlap");
+        (void) last;
+    }
+    Batch_edit edit = {.start = start, .count_removed = count_removed, .count_inserted = count_inserted};
+    vector_append_Batch_edit(&batch->edits, &edit);
+    vector_insert_items_char(&batch->removed, string->items + start, count_removed, batch->removed.count);
+    vector_insert_items_char(&batch->inserted, inserted, count_inserted, batch->inserted.count);
+}
+
+
+// copy the parts of src between the edits (and the inserted text) to dest, from the first edit to the last one
+// (dest can be src if no part is moved to the right)
+static inline void edit_batch_copy_forward(char* dest, const char* src, size_t count_src, const Edit_batch* batch) {
+    size_t idx_src = 0;
+    size_t idx_dest = 0;
+    size_t offset_inserted = 0;
+    for (size_t idx = 0; idx < batch->edits.count; idx++) {
+        const Batch_edit* edit = &batch->edits.items[idx];
+        memmove(dest + idx_dest, src + idx_src, edit->start - idx_src);
+        idx_dest += edit->start - idx_src;
+        memcpy(dest + idx_dest, batch->inserted.items + offset_inserted, edit->count_inserted);
+        idx_dest += edit->count_inserted;
+        offset_inserted += edit->count_inserted;
+        idx_src = edit->start + edit->count_removed;
+    }
+    memmove(dest + idx_dest, src + idx_src, count_src - idx_src);
+}
+
+
+// same as edit_batch_copy_forward, from the last edit to the first one, in place
+// (no part can be moved to the left)
+static inline void edit_batch_copy_backward(char* items, size_t count_src, size_t count_dest, const Edit_batch* batch) {
+    size_t end_src = count_src;
+    size_t end_dest = count_dest;
+    size_t end_inserted = batch->inserted.count;
+    for (size_t idx = batch->edits.count; idx-- > 0;) {
+        const Batch_edit* edit = &batch->edits.items[idx];
+        size_t start_kept = edit->start + edit->count_removed;
+        memmove(items + end_dest - (end_src - start_kept), items + start_kept, end_src - start_kept);
+        end_dest -= end_src - start_kept;
+        memcpy(items + end_dest - edit->count_inserted, batch->inserted.items + end_inserted - edit->count_inserted, edit->count_inserted);
+        end_dest -= edit->count_inserted;
+        end_inserted -= edit->count_inserted;
+        end_src = edit->start;
+    }
+    assert(end_dest == end_src);
+}
+
+
+// apply every edit of the batch to string (which must be the text that the batch was made for)
+static inline void Edit_batch_apply(String* string, const Edit_batch* batch) {
+    size_t count_new = string->count - batch->removed.count + batch->inserted.count;
+
+    // every part of the text is moved the same way (eg. the same key typed at every cursor), so the text is changed in
+    // place; otherwise it is built again in a new buffer
+    bool is_moved_left = true;
+    bool is_moved_right = true;
+    size_t count_removed = 0;
+    size_t count_inserted = 0;
+    for (size_t idx = 0; idx < batch->edits.count; idx++) {
+        count_removed += batch->edits.items[idx].count_removed;
+        count_inserted += batch->edits.items[idx].count_inserted;
+        is_moved_left = is_moved_left && count_inserted <= count_removed;
+        is_moved_right = is_moved_right && count_inserted >= count_removed;
+    }
+
+    if (is_moved_left) {
+        edit_batch_copy_forward(string->items, string->items, string->count, batch);
+    } else if (is_moved_right) {
+        vector_enlarge_if_nessessary_char(string, count_new);
+        edit_batch_copy_backward(string->items, string->count, count_new, batch);
+    } else {
+        String new_string;
+        String_init(&new_string);
+        vector_enlarge_if_nessessary_char(&new_string, count_new);
+        edit_batch_copy_forward(new_string.items, string->items, string->count, batch);
+        String_free_char_data(string);
+        *string = new_string;
+    }
+    string->count = count_new;
+}
+
+
+// move positions[0, count_positions) (sorted, in the text before the batch was applied) to the same places in the text
+// after it; a position where text was inserted (or within a removed part) is moved to the end of the inserted text
+static inline void Edit_batch_move_positions(const Edit_batch* batch, size_t* positions, size_t count_positions) {
+    size_t idx_pos = 0;
+    size_t count_removed = 0;
+    size_t count_inserted = 0;
+    for (size_t idx = 0; idx < batch->edits.count; idx++) {
+        const Batch_edit* edit = &batch->edits.items[idx];
+        for (; idx_pos < count_positions && positions[idx_pos] < edit->start; idx_pos++) {
+            positions[idx_pos] = positions[idx_pos] - count_removed + count_inserted;
+        }
+        for (; idx_pos < count_positions && positions[idx_pos] < edit->start + edit->count_removed; idx_pos++) {
+            positions[idx_pos] = edit->start - count_removed + count_inserted + edit->count_inserted;
+        }
+        count_removed += edit->count_removed;
+        count_inserted += edit->count_inserted;
+    }
+    for (; idx_pos < count_positions; idx_pos++) {
+        positions[idx_pos] = positions[idx_pos] - count_removed + count_inserted;
+    }
+}
+
+
+// turn the batch into the batch that undoes it (after it was applied)
+static inline void Edit_batch_invert(Edit_batch* batch) {
+    size_t count_removed = 0;
+    size_t count_inserted = 0;
+    for (size_t idx = 0; idx < batch->edits.count; idx++) {
+        Batch_edit* edit = &batch->edits.items[idx];
+        size_t edit_removed = edit->count_removed;
+        edit->start = edit->start - count_removed + count_inserted;
+        count_removed += edit->count_removed;
+        count_inserted += edit->count_inserted;
+        edit->count_removed = edit->count_inserted;
+        edit->count_inserted = edit_removed;
+    }
+    String temp = batch->removed;
+    batch->removed = batch->inserted;
+    batch->inserted = temp;
+}
+
+
+#endif // EDIT_BATCH_H
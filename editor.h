@@ -3,14 +3,66 @@
 
 
 #include "text_box.h"
+#include "viewport.h"
 #include "action.h"
+#include "document.h"
+#include "timing.h"
+#include "vt.h"
 #include <ncurses.h>
 
 
+static const char* NO_CHANGES_TEXT = "no changes";
+static const char* UNSAVED_CHANGES_TEXT = "no changes";
+static const char* FILE_NOT_OPEN = "file could not be opened";
+static const char* FILE_NAME_NOT_SPECIFIED = "file name not specified";
+static const char* INSERT_TEXT = "[insert]: press ctrl-I to enter command mode or exit";
+static const char* COMMAND_TEXT = "[command]: press q to quit. press ctrl-I to go back to insert mode";
+static const char* SEARCH_TEXT = "[search]: press ctrl-f to go to insert mode; "
+                                 "ctrl-n or ctrl-p to go to next/previous result; " 
+                                 "ctrl-h for help";
+static const char* SEARCH_FAILURE_TEXT = "[search]: no results. press ctrl-h for help";
+static const char* QUIT_CONFIRM_TEXT = "Are you sure that you want to exit without saving? N/y";
+static const char* GO_TO_LINE_TEXT = "[go to line]: type a line number and press enter: ";
+static const char* REGISTER_TEXT = "[register]: type a letter (a named register), or the number of a recent copy (0 is the newest) and press enter: ";
+
+
+// color information (ncurses)
+static int SEARCH_RESULT_PAIR    =  1;
+#define SEARCH_RESULT_BACKGND_COLOR COLOR_GREEN
+#define SEARCH_RESULT_TEXT_COLOR    COLOR_BLACK
+
+// syntax highlighting: one pair per text color (on the default background), starting at SYNTAX_FIRST_PAIR
+#define SYNTAX_FIRST_PAIR 2
+static const short syntax_kind_colors[SYNTAX_COUNT] = {
+    [SYNTAX_NONE] = -1,
+    [SYNTAX_KEYWORD] = COLOR_YELLOW,
+    [SYNTAX_TYPE] = COLOR_GREEN,
+    [SYNTAX_STRING] = COLOR_RED,
+    [SYNTAX_NUMBER] = COLOR_MAGENTA,
+    [SYNTAX_COMMENT] = COLOR_CYAN,
+    [SYNTAX_PREPROC] = COLOR_BLUE,
+    [SYNTAX_VARIABLE] = COLOR_MAGENTA,
+};
+
+
+#define GENERAL_INFO_HEIGHT    1
+#define SAVE_INFO_HEIGHT       1
+#define SEARCH_QUERY_HEIGHT    1
+#define INFO_HEIGHT            (GENERAL_INFO_HEIGHT + SAVE_INFO_HEIGHT + SEARCH_QUERY_HEIGHT)
+
+
 typedef enum {SEARCH_FIRST, SEARCH_REPEAT} SEARCH_STATUS;
 typedef enum {GEN_INFO_NORMAL, GEN_INFO_OLDEST_CHANGE, GEN_INFO_NEWEST_CHANGE} GEN_INFO_STATE;
 
 
+// how the screen is drawn and keys are read
+typedef enum {BACKEND_NCURSES = 0, BACKEND_VT} BACKEND;
+
+
+// how the main window is split (both windows of a split display a document, each with its own cursor)
+typedef enum {SPLIT_NONE = 0, SPLIT_HORIZONTAL, SPLIT_VERTICAL} SPLIT;
+
+
 typedef uint32_t MISC_INFO;
 #define MISC_HAS_COLOR (1 << 0)
 
@@ -18,8 +70,23 @@ typedef uint32_t MISC_INFO;
 typedef struct {
     int height;
     int width;
-    WINDOW* window;
-    Text_box text_box;
+    int start_y; // row of the screen where the window starts
+    int start_x; // column of the screen where the window starts
+    WINDOW* window; // NULL if the vt backend is used
+    Text_box* text_box; // text displayed in this window (own_text_box, or the text of a document)
+    Text_box own_text_box; // text of windows that do not display a document
+    Viewport viewport; // rows displayed during the current frame
+    bool no_wrap; // lines are not wrapped; the window is scrolled horizontally instead
+    Syntax* syntax; // highlighting of the text of the document (NULL if the window does not display a document)
+    Vector_Syntax_span spans; // highlighted parts of the rows of viewport
+    Brackets* brackets; // brackets of the text of the document (NULL if the window does not display a document)
+    Folds* folds; // folded lines of the text of the document (NULL if the window does not display a document)
+    const Vector_size_t* cursors; // other cursors of the document (NULL if the window does not display a document)
+    bool has_bracket_match; // the cursor is at (or just after) a bracket that is matched
+    size_t bracket; // position of that bracket
+    size_t bracket_match; // position of the bracket that matches it
+    Cursor_info cursor_info; // cursor of the window while it is the window of a split that is not focused
+                             // (the focused window uses the cursor of its text_box; see Editor_focus_other_window)
 } Text_win;
 
 
@@ -27,84 +94,148 @@ typedef struct {
     int total_height;
     int total_width;
 
-    bool unsaved_changes;
-    const char* file_name;
+    Document* document; // document displayed in file_text (one of documents)
+    Vector_Document_ptr documents; // every open document (each is allocated on its own, so it is never moved)
+    size_t idx_document; // index of document in documents
 
-    Text_win file_text;
+    Text_win file_text; // main window (the focused window, if it is split)
+    Text_win split_text; // other window of the split (only used if split is not SPLIT_NONE)
+    SPLIT split;
+    bool is_focus_second; // file_text is the bottom (or right) window of the split
+    WINDOW* split_border; // line between the windows of the split (NULL if the vt backend is used)
     Text_win save_info;
     Text_win search_query;
     Text_win general_info;
 
-    String clipboard;
-
-    Actions actions;
-    Actions undo_actions;
+    Clipboard clipboard; // copied text (only a reference to the text it was copied from, until that text changes)
+    String draw_buf; // row that is not printable ascii converted to what the terminal should show (see draw_window)
 
     ED_STATE state;
     SEARCH_STATUS search_status;
     GEN_INFO_STATE gen_info_state;
+    size_t go_to_line_num; // line number typed so far in STATE_GO_TO_LINE
+    char register_name; // named register for the next copy or paste ('\0' if there is none, see idx_recent)
+    size_t idx_recent; // copy for the next paste if there is no named register (0 is the newest one)
+    size_t recent_num; // number typed so far in STATE_REGISTER
 
     MISC_INFO misc_info;
+
+    BACKEND backend;
+    Vt_screen vt; // only used by the vt backend
+
+    Timing timing;
 } Editor;
 
 
 static inline void Text_win_init(Text_win* window) {
     memset(window, 0, sizeof(*window));
+    Text_box_init(&window->own_text_box);
+    window->text_box = &window->own_text_box;
+    Viewport_init(&window->viewport);
+}
+
+
+// width that the text of the window is wrapped at
+static inline size_t Text_win_wrap_width(const Text_win* text_win) {
+    return text_win->no_wrap ? TEXT_BOX_NO_WRAP : (size_t)text_win->width;
+}
+
+
+// walk the text that will be visible in this window during the next frame (and find the highlighted parts of it)
+static inline void Text_win_update_layout(Text_win* text_win) {
+    Cursor_info* cursor_info = &text_win->text_box->cursor_info;
+    if (text_win->folds && folds_is_hidden(&text_win->text_box->string, cursor_info->pos.cursor)) {
+        // the cursor was moved into folded lines (eg. by a search), so they are shown
+        Folds_open_at(text_win->folds, cursor_info->pos.cursor);
+        Text_box_recalculate_visual_xy_and_scroll_offset(text_win->text_box, Text_win_wrap_width(text_win), text_win->height);
+    }
+    if (text_win->no_wrap) {
+        Scroll_data_scroll_x_to_cursor(&cursor_info->scroll, &cursor_info->pos, text_win->width);
+    }
+
+    Viewport_build(
+        &text_win->viewport,
+        &text_win->text_box->string,
+        &cursor_info->scroll,
+        text_win->height,
+        Text_win_wrap_width(text_win),
+        text_win->width
+    );
+
+    if (text_win->syntax) {
+        // (the text of closed folds is skipped, so the rows are highlighted in runs of rows that follow each other)
+        const Viewport* viewport = &text_win->viewport;
+        text_win->spans.count = 0;
+        size_t idx_row = 0;
+        while (idx_row < viewport->rows.count) {
+            size_t start_run = Viewport_row_at(viewport, idx_row)->start;
+            while (idx_row + 1 < viewport->rows.count && !Viewport_row_at(viewport, idx_row)->is_folded) {
+                idx_row++;
+            }
+            const Visual_row* last_row = Viewport_row_at(viewport, idx_row);
+            Syntax_append_spans(&text_win->spans, text_win->syntax, &text_win->text_box->string, start_run, last_row->start + last_row->count);
+            idx_row++;
+        }
+    }
+    if (text_win->brackets) {
+        text_win->has_bracket_match = Brackets_find_match_near(
+            &text_win->bracket, &text_win->bracket_match, text_win->brackets, &text_win->text_box->string, cursor_info->pos.cursor
+        );
+    }
 }
 
 
 static inline void Editor_print_error(Editor* editor) {
-    log("error: could not open file %s: errno %d: %s\n", editor->file_name, errno, strerror(errno));
-    editor->unsaved_changes = false;
-    String_cpy_from_cstr(&editor->save_info.text_box.string, FILE_NOT_OPEN, strlen(FILE_NOT_OPEN));
+    log("error: could not open file %s: errno %d: %s\n", editor->document->file_name, errno, strerror(errno));
+    editor->document->unsaved_changes = false;
+    String_cpy_from_cstr(&editor->save_info.text_box->string, FILE_NOT_OPEN, strlen(FILE_NOT_OPEN));
     const char* colon_space = ": ";
-    String_append_cstr(&editor->save_info.text_box.string, colon_space, strlen(colon_space));
-    String_append_cstr(&editor->save_info.text_box.string, strerror(errno), strlen(strerror(errno)));
-    editor->file_text.text_box.cursor_info.pos.cursor = 0;
+    String_append_cstr(&editor->save_info.text_box->string, colon_space, strlen(colon_space));
+    String_append_cstr(&editor->save_info.text_box->string, strerror(errno), strlen(strerror(errno)));
+    editor->file_text.text_box->cursor_info.pos.cursor = 0;
 }
 
 
 static inline void Editor_print_success(Editor* editor) {
-    editor->unsaved_changes = false;
-    String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
-    String_cpy_from_cstr(&editor->save_info.text_box.string, NO_CHANGES_TEXT, strlen(NO_CHANGES_TEXT));
-    editor->file_text.text_box.cursor_info.pos.cursor = 0;
+    editor->document->unsaved_changes = false;
+    String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+    String_cpy_from_cstr(&editor->save_info.text_box->string, NO_CHANGES_TEXT, strlen(NO_CHANGES_TEXT));
+    editor->file_text.text_box->cursor_info.pos.cursor = 0;
 }
 
 
-// returns true if file opened successfully
-static inline bool Editor_open_file(Editor* editor) {
-    if (!editor->file_name) {
-        String_cpy_from_cstr(&editor->general_info.text_box.string, FILE_NAME_NOT_SPECIFIED, strlen(FILE_NAME_NOT_SPECIFIED));
-        return false;
-    }
-
-    if (0 != access(editor->file_name, R_OK)) {
-        Editor_print_error(editor);
-        return false;
+// returns true if the file of the displayed document opened successfully
+// (the files of every document are opened, by several threads)
+static inline bool Editor_open_files(Editor* editor) {
+    size_t count = editor->documents.count;
+    DOC_OPEN_STATUS* statuses = safe_malloc(count * sizeof(statuses[0]));
+    int* errnos = safe_malloc(count * sizeof(errnos[0]));
+    Documents_open_files(statuses, errnos, editor->documents.items, count);
+    for (size_t idx = 0; idx < count; idx++) {
+        // (the error of the displayed document is shown by Editor_print_error)
+        if (statuses[idx] == DOC_OPEN_ERROR && idx != editor->idx_document) {
+            log("error: could not open file %s: errno %d: %s\n", editor->documents.items[idx]->file_name, errnos[idx], strerror(errnos[idx]));
+        }
     }
+    DOC_OPEN_STATUS status = statuses[editor->idx_document];
+    errno = errnos[editor->idx_document];
+    free(statuses);
+    free(errnos);
 
-    if (0 != access(editor->file_name, F_OK)) {
-        log("note: creating new file %s\n", editor->file_name);
+    switch (status) {
+    case DOC_OPEN_SUCCESS:
         Editor_print_success(editor);
         return true;
-    }
-
-    log("note: opening file %s\n", editor->file_name);
-    FILE* f = fopen(editor->file_name, "r");
-    //open(editor->file_name, O_RDONLY | O_CREAT);
-    if (!f) {
+    case DOC_OPEN_NO_FILE_NAME:
+        String_cpy_from_cstr(&editor->general_info.text_box->string, FILE_NAME_NOT_SPECIFIED, strlen(FILE_NAME_NOT_SPECIFIED));
+        return false;
+    case DOC_OPEN_ERROR:
         Editor_print_error(editor);
         return false;
+    default:
+        assert(false && "unreachable");
+        abort();
     }
-    int curr_char = getc(f);
-    while (!feof(f)) {
-        Text_box_append(&editor->file_text.text_box, curr_char, 1000000, 10000000);
-        curr_char = getc(f);
-    }
-
-    Editor_print_success(editor);
-    return true;
 }
 
 
@@ -121,12 +252,61 @@ static WINDOW* get_newwin(int height, int width, int starty, int startx) {
 }
 
 
-static inline void Editor_set_window_coordinates(Editor* editor) {
-    getmaxyx(stdscr, editor->total_height, editor->total_width);
+// the document displayed by file_text keeps the cursor of split_text up to date, if split_text displays it too
+static inline void Editor_link_windows(Editor* editor) {
+    for (size_t idx = 0; idx < editor->documents.count; idx++) {
+        editor->documents.items[idx]->other_view.cursor_info = NULL;
+    }
+    if (editor->split == SPLIT_NONE || editor->split_text.text_box != editor->file_text.text_box) {
+        return;
+    }
+    editor->document->other_view = (Document_view){
+        .cursor_info = &editor->split_text.cursor_info,
+        .max_visual_width = Text_win_wrap_width(&editor->split_text),
+        .max_visual_height = editor->split_text.height,
+    };
+}
+
+
+// file_text is given the area of both windows of the split (and the line between them)
+// the first window is above (or left of) the line, and the second one is below (or right of) it
+static inline void Editor_set_split_size(Editor* editor) {
+    if (editor->split == SPLIT_NONE) {
+        return;
+    }
+    int height = editor->file_text.height;
+    int width = editor->file_text.width;
+    Text_win* first = editor->is_focus_second ? &editor->split_text : &editor->file_text;
+    Text_win* second = editor->is_focus_second ? &editor->file_text : &editor->split_text;
+    first->start_y = 0;
+    first->start_x = 0;
+    if (editor->split == SPLIT_HORIZONTAL) {
+        first->height = MAX((height - 1) / 2, 1);
+        first->width = width;
+        second->height = MAX(height - 1 - first->height, 1);
+        second->width = width;
+        second->start_y = first->height + 1;
+        second->start_x = 0;
+    } else {
+        first->height = height;
+        first->width = MAX((width - 1) / 2, 1);
+        second->height = height;
+        second->width = MAX(width - 1 - first->width, 1);
+        second->start_y = 0;
+        second->start_x = first->width + 1;
+    }
+}
+
+
+// size of every window is derived from the total size of the screen
+static inline void Editor_set_size(Editor* editor, int total_height, int total_width) {
+    editor->total_height = total_height;
+    editor->total_width = total_width;
     assert(editor->total_height > INFO_HEIGHT);
 
     editor->file_text.height = editor->total_height - INFO_HEIGHT - 1;
     editor->file_text.width = editor->total_width;
+    editor->file_text.start_x = 0;
 
     editor->general_info.height = GENERAL_INFO_HEIGHT;
     editor->general_info.width = editor->total_width;
@@ -136,51 +316,124 @@ static inline void Editor_set_window_coordinates(Editor* editor) {
 
     editor->save_info.height = SAVE_INFO_HEIGHT;
     editor->save_info.width = editor->total_width;
-}
 
+    // windows are stacked from top to bottom
+    int curr_y = 0;
+    editor->file_text.start_y = curr_y;
+    curr_y += editor->file_text.height;
 
-static void Editor_do_resize(Editor* editor) {
-    Editor_set_window_coordinates(editor);
-
-    wresize(editor->file_text.window, editor->file_text.height, editor->file_text.width);
-    wresize(editor->general_info.window, editor->general_info.height, editor->general_info.width);
-    wresize(editor->save_info.window, editor->save_info.height, editor->save_info.width);
-    wresize(editor->search_query.window, editor->search_query.height, editor->search_query.width);
-
-    // move windows to the correct locations
-    int curr_y = editor->file_text.height;
-
-    mvwin(editor->general_info.window, curr_y, 0);
+    editor->general_info.start_y = curr_y;
     curr_y += editor->general_info.height;
 
-    mvwin(editor->search_query.window, curr_y, 0);
+    editor->search_query.start_y = curr_y;
     curr_y += editor->search_query.height;
 
-    mvwin(editor->save_info.window, curr_y, 0);
+    editor->save_info.start_y = curr_y;
     curr_y += editor->save_info.height;
 
     assert(curr_y == editor->total_height - 1);
+    Editor_set_split_size(editor);
+    Editor_link_windows(editor);
+}
+
+
+static inline void Editor_set_window_coordinates(Editor* editor) {
+    switch (editor->backend) {
+    case BACKEND_NCURSES: {
+        int total_height;
+        int total_width;
+        getmaxyx(stdscr, total_height, total_width);
+        Editor_set_size(editor, total_height, total_width);
+    } break;
+    case BACKEND_VT:
+        Vt_screen_resize(&editor->vt);
+        Editor_set_size(editor, editor->vt.height, editor->vt.width);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+}
+
+
+static inline void Text_win_do_resize(Text_win* window) {
+    wresize(window->window, window->height, window->width);
+    mvwin(window->window, window->start_y, window->start_x);
+}
+
+
+// the line between the windows of the split is one row below (or one column right of) the first window
+static inline void Editor_get_split_border(const Editor* editor, int* start_y, int* start_x, int* height, int* width) {
+    const Text_win* first = editor->is_focus_second ? &editor->split_text : &editor->file_text;
+    if (editor->split == SPLIT_HORIZONTAL) {
+        *start_y = first->height;
+        *start_x = 0;
+        *height = 1;
+        *width = first->width;
+    } else {
+        *start_y = 0;
+        *start_x = first->width;
+        *height = first->height;
+        *width = 1;
+    }
+}
+
+
+static void Editor_do_resize(Editor* editor) {
+    Editor_set_window_coordinates(editor);
+
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        Text_win_do_resize(&editor->file_text);
+        Text_win_do_resize(&editor->general_info);
+        Text_win_do_resize(&editor->search_query);
+        Text_win_do_resize(&editor->save_info);
+        if (editor->split != SPLIT_NONE) {
+            // (the windows of a split are made when they are first shown)
+            int start_y, start_x, height, width;
+            Editor_get_split_border(editor, &start_y, &start_x, &height, &width);
+            if (!editor->split_text.window) {
+                editor->split_text.window = get_newwin(editor->split_text.height, editor->split_text.width, editor->split_text.start_y, editor->split_text.start_x);
+            }
+            if (!editor->split_border) {
+                editor->split_border = get_newwin(height, width, start_y, start_x);
+            }
+            Text_win_do_resize(&editor->split_text);
+            wresize(editor->split_border, height, width);
+            mvwin(editor->split_border, start_y, start_x);
+        }
+        break;
+    case BACKEND_VT:
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
 }
 
 
 static inline void Editor_init_windows(Editor* editor) {
     Editor_set_window_coordinates(editor);
+    if (editor->backend == BACKEND_VT) {
+        return;
+    }
+
     editor->file_text.window = get_newwin(editor->file_text.height, editor->file_text.width, 0, 0);
     if (!editor->file_text.window) {
         log("fetal error: could not initialize main window\n");
         abort();
     }
-    editor->general_info.window = get_newwin(editor->general_info.height, editor->general_info.width, editor->general_info.height, 0);
+    editor->general_info.window = get_newwin(editor->general_info.height, editor->general_info.width, editor->general_info.start_y, 0);
     if (!editor->general_info.window) {
         log("fetal error: could not initialize general info window\n");
         abort();
     }
-    editor->save_info.window = get_newwin(editor->save_info.height, editor->save_info.width, editor->save_info.height, 0);
+    editor->save_info.window = get_newwin(editor->save_info.height, editor->save_info.width, editor->save_info.start_y, 0);
     if (!editor->save_info.window) {
         log("fetal error: could not initialize save info window\n");
         abort();
     }
-    editor->search_query.window = get_newwin(editor->search_query.height, editor->search_query.width, editor->search_query.height, 0);
+    editor->search_query.window = get_newwin(editor->search_query.height, editor->search_query.width, editor->search_query.start_y, 0);
     if (!editor->search_query.window) {
         log("fetal error: could not initialize search query window\n");
         abort();
@@ -188,25 +441,66 @@ static inline void Editor_init_windows(Editor* editor) {
 }
 
 
+// file_name is not copied
+static inline Document* Editor_add_document(Editor* editor, const char* file_name) {
+    Document* document = safe_malloc(sizeof(*document));
+    Document_init(document);
+    document->file_name = file_name;
+    vector_append_Document_ptr(&editor->documents, &document);
+    return document;
+}
+
+
+// display documents[idx_document] in the main window
+static inline void Editor_show_document(Editor* editor, size_t idx_document) {
+    assert(idx_document < editor->documents.count);
+    editor->idx_document = idx_document;
+    editor->document = editor->documents.items[idx_document];
+    editor->file_text.text_box = &editor->document->text_box;
+    editor->file_text.syntax = &editor->document->syntax;
+    editor->file_text.brackets = &editor->document->brackets;
+    editor->file_text.folds = &editor->document->folds;
+    editor->file_text.cursors = &editor->document->cursors;
+}
+
+
 static inline void Editor_init(Editor* editor) {
     memset(editor, 0, sizeof(*editor));
 
-    String_init(&editor->clipboard);
+    Clipboard_init(&editor->clipboard);
+    String_init(&editor->draw_buf);
 
     Text_win_init(&editor->general_info);
     Text_win_init(&editor->search_query);
     Text_win_init(&editor->save_info);
     Text_win_init(&editor->file_text);
+    Editor_add_document(editor, NULL);
+    Editor_show_document(editor, 0);
 
-    Actions_init(&editor->actions);
-    Actions_init(&editor->undo_actions);
+    Vt_screen_init(&editor->vt);
+
+    Timing_init(&editor->timing);
+}
+
+
+// initscr (or Vt_screen_enter) must be called before this function
+static inline void Editor_init_colors(Editor* editor) {
+    if (editor->backend == BACKEND_VT) {
+        editor->misc_info |= MISC_HAS_COLOR;
+        editor->vt.has_color = true;
+        return;
+    }
 
     // TODO: check for colors?
     if (true) {
         log("Will operate in 8 color mode");
         editor->misc_info |= MISC_HAS_COLOR;
         start_color();
+        use_default_colors();
         init_pair(SEARCH_RESULT_PAIR, SEARCH_RESULT_TEXT_COLOR, SEARCH_RESULT_BACKGND_COLOR);
+        for (short color = 0; color < VT_ATTR_MAX_FG; color++) {
+            init_pair(SYNTAX_FIRST_PAIR + color, color, -1);
+        }
     } else {
         log("no colors are available");
         SEARCH_RESULT_PAIR = 0;
@@ -221,170 +515,372 @@ static inline Editor* Editor_get() {
 }
 
 
+// the cursor of split_text is put into its text_box while split_text is laid out (or drawn), and then put back
+// (calling this twice puts both cursors back)
+static inline void Editor_swap_split_cursor_info(Editor* editor) {
+    Cursor_info temp = editor->split_text.text_box->cursor_info;
+    editor->split_text.text_box->cursor_info = editor->split_text.cursor_info;
+    editor->split_text.cursor_info = temp;
+}
+
+
+// walk the text that will be visible in every window during the next frame
+static inline void Editor_update_layout(Editor* editor, bool did_resize) {
+    if (editor->split != SPLIT_NONE) {
+        Editor_swap_split_cursor_info(editor);
+        if (did_resize) {
+            Text_box_recalculate_visual_xy_and_scroll_offset(
+                editor->split_text.text_box, Text_win_wrap_width(&editor->split_text), editor->split_text.height
+            );
+        }
+        Text_win_update_layout(&editor->split_text);
+        Editor_swap_split_cursor_info(editor);
+    }
+    if (did_resize) {
+        assert(editor->file_text.width >= 1);
+        assert(editor->file_text.height >= 1);
+        debug("width of main: %d", editor->file_text.width);
+        Text_box_recalculate_visual_xy_and_scroll_offset(
+            editor->file_text.text_box,
+            Text_win_wrap_width(&editor->file_text),
+            editor->file_text.height
+        );
+    }
+    Text_win_update_layout(&editor->file_text);
+    Text_win_update_layout(&editor->general_info);
+    Text_win_update_layout(&editor->search_query);
+    Text_win_update_layout(&editor->save_info);
+}
+
+
 static inline void Text_win_free(Text_win* window) {
-    Text_box_free(&window->text_box);
-    delwin(window->window);
+    Text_box_free(&window->own_text_box);
+    Viewport_free(&window->viewport);
+    free(window->spans.items);
+    if (window->window) {
+        delwin(window->window);
+    }
 }
 
 
 static void Editor_free(Editor* editor) {
-    Actions_free(&editor->actions);
-    Actions_free(&editor->undo_actions);
+    for (size_t idx = 0; idx < editor->documents.count; idx++) {
+        Document_free(editor->documents.items[idx]);
+        free(editor->documents.items[idx]);
+    }
+    free(editor->documents.items);
+    Vt_screen_free(&editor->vt);
 
     Text_win_free(&editor->file_text);
+    if (editor->split != SPLIT_NONE) {
+        Text_win_free(&editor->split_text);
+    }
+    if (editor->split_border) {
+        delwin(editor->split_border);
+    }
     Text_win_free(&editor->save_info);
     Text_win_free(&editor->search_query);
     Text_win_free(&editor->general_info);
 
-    String_free_char_data(&editor->clipboard);
+    Clipboard_free(&editor->clipboard);
+    String_free_char_data(&editor->draw_buf);
+    Column_map_free_all();
 }
 
 
-static void Editor_undo(Editor* editor, size_t max_visual_width, size_t max_visual_height) {
-    Action action_to_undo;
-    Actions_pop(&action_to_undo, &editor->actions);
+// returns false if there is nothing to undo
+static bool Editor_undo(Editor* editor) {
+    return Document_undo(editor->document, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+}
 
-    debug("Editor_undo: cursor: %zu", action_to_undo.cursor);
-    switch (action_to_undo.action) {
-    case ACTION_INSERT_STRING: {
-        Text_box_del_substr(
-            &editor->file_text.text_box,
-            action_to_undo.cursor,
-            action_to_undo.str.count
-        );
-        Action undo_action = {.cursor = action_to_undo.cursor, .action = ACTION_REMOVE_STRING, .str = action_to_undo.str};
-        Actions_append(&editor->undo_actions, &undo_action);
-        } break;
-    case ACTION_REMOVE_STRING: {
-        Text_box_insert_substr(
-            &editor->file_text.text_box,
-            &action_to_undo.str,
-            action_to_undo.cursor,
-            max_visual_width,
-            max_visual_height
-        );
-        Action undo_action = {.cursor = action_to_undo.cursor, .action = ACTION_INSERT_STRING, .str = action_to_undo.str};
-        Actions_append(&editor->undo_actions, &undo_action);
-        } break;
-    default:
-        assert(false && "unreachable");
-        abort();
-    }
 
-    Text_box_recalculate_visual_xy_and_scroll_offset(&editor->file_text.text_box, max_visual_width);
+// returns false if there is nothing to redo
+static bool Editor_redo(Editor* editor) {
+    return Document_redo(editor->document, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
 }
 
 
-static void Editor_redo(Editor* editor, size_t max_visual_width, size_t max_visual_height) {
-    Action action_to_redo;
-    Actions_pop(&action_to_redo, &editor->undo_actions);
+// switch the main window between wrapping long lines and scrolling horizontally
+static void Editor_toggle_wrap(Editor* editor) {
+    Text_win* file_text = &editor->file_text;
+    file_text->no_wrap = !file_text->no_wrap;
+    file_text->text_box->cursor_info.scroll.x = 0;
+    Text_box_recalculate_visual_xy_and_scroll_offset(file_text->text_box, Text_win_wrap_width(file_text), file_text->height);
+    Editor_link_windows(editor);
 
-    switch (action_to_redo.action) {
-    case ACTION_INSERT_STRING: {
-        Text_box_del_substr(&editor->file_text.text_box, action_to_redo.cursor, action_to_redo.str.count);
-        Action redo_action = {.cursor = action_to_redo.cursor, .action = ACTION_REMOVE_STRING, .str = {0}};
-        String_cpy(&redo_action.str, &action_to_redo.str);
-        Actions_append(&editor->actions, &redo_action);
-        } break;
-    case ACTION_REMOVE_STRING: {
-        Text_box_insert_substr(&editor->file_text.text_box, &action_to_redo.str, action_to_redo.cursor, max_visual_width, max_visual_height);
-        Action redo_action = {.cursor = action_to_redo.cursor, .action = ACTION_INSERT_STRING, .str = {0}};
-        String_cpy(&redo_action.str, &action_to_redo.str);
-        Actions_append(&editor->actions, &redo_action);
-        } break;
-    default:
-        assert(false && "unreachable");
-        abort();
+    const char* wrap_text = file_text->no_wrap ? "[command]: lines are not wrapped" : "[command]: lines are wrapped";
+    String_cpy_from_cstr(&editor->general_info.text_box->string, wrap_text, strlen(wrap_text));
+}
+
+
+// move the cursor count times (the other cursors are also moved left or right; see Document_move_cursors)
+static void Editor_move_cursor(Editor* editor, DIRECTION direction, size_t count) {
+    Text_box_move_cursor_repeat(
+        editor->file_text.text_box, direction, count, Text_win_wrap_width(&editor->file_text), editor->file_text.height, false
+    );
+    if (editor->document->cursors.count > 0 && (direction == DIR_LEFT || direction == DIR_RIGHT)) {
+        Document_move_cursors(editor->document, direction, count);
+    }
+}
+
+
+// add a cursor at every match of the search query (or on every line of the selection, if there is one)
+static void Editor_add_cursors(Editor* editor) {
+    Text_box* text_box = editor->file_text.text_box;
+    if (text_box->visual_sel.state == VIS_STATE_ON) {
+        Document_add_cursors_on_lines(editor->document, Text_box_get_visual_sel_start(text_box), Text_box_get_visual_sel_end(text_box));
+        text_box->visual_sel.state = VIS_STATE_NONE;
+    } else {
+        Document_add_cursors_at_matches(editor->document, &editor->search_query.text_box->string);
     }
 
-    Text_box_recalculate_visual_xy_and_scroll_offset(&editor->file_text.text_box, max_visual_width);
+    char info_text[96];
+    int len = snprintf(
+        info_text, sizeof(info_text), "[insert]: %zu cursors; press M in command mode to keep only one", editor->document->cursors.count + 1
+    );
+    String_cpy_from_cstr(&editor->general_info.text_box->string, info_text, len);
 }
 
 
-static bool Editor_save_file(const Editor* editor) {
-    // TODO: confirm that temp_file_name does not already exist
-    // TODO: make actual name for temp file
-    const char* temp_file_name = ".temp_thingyksdjfaijdfkj.txt";
+static void Editor_jump(Editor* editor, JUMP jump) {
+    Text_box_jump(editor->file_text.text_box, jump, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+}
+
 
-    // write temporary file
-    if (!actual_write(temp_file_name, editor->file_text.text_box.string.items, editor->file_text.text_box.string.count)) {
+// move the cursor to the bracket that matches the one at (or just before) the cursor
+// returns false if there is no such bracket
+static bool Editor_jump_to_matching_bracket(Editor* editor) {
+    Text_box* text_box = editor->file_text.text_box;
+    size_t bracket;
+    size_t match;
+    if (!Brackets_find_match_near(&bracket, &match, &editor->document->brackets, &text_box->string, text_box->cursor_info.pos.cursor)) {
         return false;
     }
+    text_box->cursor_info.pos.cursor = match;
+    Text_box_recalculate_visual_xy_and_scroll_offset(text_box, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+    text_box->cursor_info.scroll.user_max_col = text_box->cursor_info.pos.visual_x;
+    return true;
+}
 
-    // write actual file
-    // TODO: consider if this can be done better
-    if (!actual_write(editor->file_name, editor->file_text.text_box.string.items, editor->file_text.text_box.string.count)) {
-        return false;
+
+// fold the lines after the line of the cursor (or open or close the fold that they already are)
+// returns false if there is nothing to fold
+static bool Editor_toggle_fold(Editor* editor) {
+    return Document_toggle_fold(editor->document, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+}
+
+
+static void Editor_open_all_folds(Editor* editor) {
+    Folds_open_all(&editor->document->folds);
+    Text_box_recalculate_visual_xy_and_scroll_offset(editor->file_text.text_box, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+}
+
+
+// display the document offset documents after the displayed one (offset can be negative; the documents wrap around)
+// the cursor and the scroll of every document are kept, so they are only computed again if the window changed size since
+// the document was last displayed
+static void Editor_switch_document(Editor* editor, long offset) {
+    size_t count = editor->documents.count;
+    Text_win* file_text = &editor->file_text;
+    editor->document->layout_width = Text_win_wrap_width(file_text);
+    editor->document->layout_height = file_text->height;
+
+    long idx_new = ((long)editor->idx_document + offset % (long)count + (long)count) % (long)count;
+    Editor_show_document(editor, (size_t)idx_new);
+    if (editor->document->layout_width != Text_win_wrap_width(file_text) || editor->document->layout_height != (size_t)file_text->height) {
+        Text_box_recalculate_visual_xy_and_scroll_offset(file_text->text_box, Text_win_wrap_width(file_text), file_text->height);
     }
+    Editor_link_windows(editor);
+
+    String* info = &editor->general_info.text_box->string;
+    char info_text[64];
+    int len = snprintf(info_text, sizeof(info_text), "[command]: file %zu of %zu: ", editor->idx_document + 1, count);
+    String_cpy_from_cstr(info, info_text, len);
+    const char* file_name = editor->document->file_name ? editor->document->file_name : "(no file name)";
+    String_append_cstr(info, file_name, strlen(file_name));
+    const char* save_text = editor->document->unsaved_changes ? UNSAVED_CHANGES_TEXT : NO_CHANGES_TEXT;
+    String_cpy_from_cstr(&editor->save_info.text_box->string, save_text, strlen(save_text));
+}
 
-    return true;
+
+// split the main window in two windows that display its document, each with its own cursor and scroll
+// (if it is already split, only the direction of the split is changed)
+static void Editor_split(Editor* editor, SPLIT split) {
+    assert(split != SPLIT_NONE);
+    if (editor->split == SPLIT_NONE) {
+        Text_win* file_text = &editor->file_text;
+        Text_win* split_text = &editor->split_text;
+        Text_win_init(split_text);
+        split_text->text_box = file_text->text_box;
+        split_text->syntax = file_text->syntax;
+        split_text->brackets = file_text->brackets;
+        split_text->folds = file_text->folds;
+        split_text->cursors = file_text->cursors;
+        split_text->no_wrap = file_text->no_wrap;
+        split_text->cursor_info = file_text->text_box->cursor_info;
+        editor->is_focus_second = false;
+    }
+    editor->split = split;
+    Editor_set_size(editor, editor->total_height, editor->total_width);
+}
+
+
+// focus the other window of the split
+static void Editor_focus_other_window(Editor* editor) {
+    if (editor->split == SPLIT_NONE) {
+        return;
+    }
+    // the window that is no longer focused keeps its cursor, and the focused one puts its cursor in its text_box
+    editor->file_text.cursor_info = editor->file_text.text_box->cursor_info;
+    Text_win temp = editor->file_text;
+    editor->file_text = editor->split_text;
+    editor->split_text = temp;
+    editor->file_text.text_box->cursor_info = editor->file_text.cursor_info;
+    editor->is_focus_second = !editor->is_focus_second;
+
+    for (size_t idx = 0; idx < editor->documents.count; idx++) {
+        if (&editor->documents.items[idx]->text_box == editor->file_text.text_box) {
+            editor->idx_document = idx;
+            editor->document = editor->documents.items[idx];
+        }
+    }
+    Editor_link_windows(editor);
+}
+
+
+// only the focused window is kept
+static void Editor_close_other_window(Editor* editor) {
+    if (editor->split == SPLIT_NONE) {
+        return;
+    }
+    Text_win_free(&editor->split_text);
+    Text_win_init(&editor->split_text);
+    if (editor->split_border) {
+        delwin(editor->split_border);
+        editor->split_border = NULL;
+    }
+    editor->split = SPLIT_NONE;
+    editor->is_focus_second = false;
+    Editor_set_size(editor, editor->total_height, editor->total_width);
+}
+
+
+static bool Editor_has_unsaved_changes(const Editor* editor) {
+    for (size_t idx = 0; idx < editor->documents.count; idx++) {
+        if (editor->documents.items[idx]->unsaved_changes) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// show the line number typed so far
+static void Editor_update_go_to_line_text(Editor* editor) {
+    String* info = &editor->general_info.text_box->string;
+    String_cpy_from_cstr(info, GO_TO_LINE_TEXT, strlen(GO_TO_LINE_TEXT));
+    if (editor->go_to_line_num > 0) {
+        char num_text[32];
+        int len = snprintf(num_text, sizeof(num_text), "%zu", editor->go_to_line_num);
+        String_append_cstr(info, num_text, len);
+    }
+}
+
+
+// line_num is counted from 1 (as it is displayed to the user)
+static void Editor_go_to_line(Editor* editor, size_t line_num) {
+    Text_box* text_box = editor->file_text.text_box;
+    Cursor_info_move_cursor_to_line(
+        &text_box->cursor_info,
+        &text_box->string,
+        line_num > 0 ? line_num - 1 : 0,
+        Text_win_wrap_width(&editor->file_text),
+        editor->file_text.height
+    );
 }
 
 
 static void Editor_save(Editor* editor) {
-    if (!editor->unsaved_changes) {
+    if (!editor->document->unsaved_changes) {
         return;
     }
 
-    if (!Editor_save_file(editor)) {
+    if (!Document_save(editor->document)) {
         const char* file_error_text =  "error: file could not be saved";
-        String_cpy_from_cstr(&editor->save_info.text_box.string, file_error_text, strlen(file_error_text));
+        String_cpy_from_cstr(&editor->save_info.text_box->string, file_error_text, strlen(file_error_text));
         return;
     }
 
     const char* file_success_text = "file saved";
-    String_cpy_from_cstr(&editor->save_info.text_box.string, file_success_text, strlen(file_success_text));
-    editor->unsaved_changes = false;
+    String_cpy_from_cstr(&editor->save_info.text_box->string, file_success_text, strlen(file_success_text));
 }
 
 
-static void Editor_cpy_selection(Editor* editor) {
-    size_t start = Text_box_get_visual_sel_start(&editor->file_text.text_box);
-    size_t end = Text_box_get_visual_sel_end(&editor->file_text.text_box);
-
-    String_cpy_from_substring(
-        &editor->clipboard,
-        &editor->file_text.text_box.string,
-        start,
-        end + 1 - start
-    );
+// show the number typed so far
+static void Editor_update_register_text(Editor* editor) {
+    String* info = &editor->general_info.text_box->string;
+    String_cpy_from_cstr(info, REGISTER_TEXT, strlen(REGISTER_TEXT));
+    if (editor->recent_num > 0) {
+        char num_text[32];
+        int len = snprintf(num_text, sizeof(num_text), "%zu", editor->recent_num);
+        String_append_cstr(info, num_text, len);
+    }
 }
 
 
-static void Editor_paste_selection(Editor* editor) {
-    // insert text
-    String_insert_string(&editor->file_text.text_box.string, editor->file_text.text_box.cursor_info.pos.cursor, &editor->clipboard);
-
-    // add action to actions so that insertion can be undone
-    Action new_action = {
-        .cursor = editor->file_text.text_box.cursor_info.pos.cursor,
-        .action = ACTION_INSERT_STRING,
-        .str = {0}
-    };
-    String_cpy(&new_action.str, &editor->clipboard);
-    Actions_append(&editor->actions, &new_action);
+// the next copy goes to named register name (and to the recent copies), and the next paste is from it
+static void Editor_select_register(Editor* editor, char name) {
+    editor->register_name = name;
+    editor->idx_recent = 0;
+    char info_text[96];
+    int len = snprintf(info_text, sizeof(info_text), "[insert]: register %c: ctrl-C, ctrl-X or ctrl-V uses it once", name);
+    String_cpy_from_cstr(&editor->general_info.text_box->string, info_text, len);
 }
 
 
-static void Editor_insert_into_main_file_text(Editor* editor, const String* new_str, size_t index, size_t max_visual_width, size_t max_visual_height) {
-    if (!editor->unsaved_changes) {
-        String_cpy_from_cstr(&editor->save_info.text_box.string, UNSAVED_CHANGES_TEXT, strlen(UNSAVED_CHANGES_TEXT));
-        editor->unsaved_changes = true;
+// the next paste is from the copy made idx copies before the newest one
+static void Editor_select_recent(Editor* editor, size_t idx) {
+    editor->register_name = '\0';
+    editor->idx_recent = idx;
+    char info_text[96];
+    int len = snprintf(info_text, sizeof(info_text), "[insert]: recent copy %zu: ctrl-V pastes it once", idx);
+    String_cpy_from_cstr(&editor->general_info.text_box->string, info_text, len);
+}
+
+
+// the copy is added to the recent copies (and to the selected named register, if there is one)
+static void Editor_cpy_selection(Editor* editor) {
+    Clip* clip = Clipboard_push(&editor->clipboard);
+    Document_cpy_selection(clip, editor->document);
+    Clip* named = Clipboard_get_register(&editor->clipboard, editor->register_name);
+    if (named) {
+        Clip_cpy(named, clip);
     }
+    editor->register_name = '\0';
+    editor->idx_recent = 0;
+}
 
-    Text_box_insert_substr(&editor->file_text.text_box, new_str, index, max_visual_width, max_visual_height);
 
-    Action new_action = {.cursor = editor->file_text.text_box.cursor_info.pos.cursor - 1, .action = ACTION_INSERT_STRING, .str = {0}};
-    String_cpy(&new_action.str, new_str);
-    Actions_append(&editor->actions, &new_action);
-    editor->unsaved_changes = true;
+static void Editor_paste_selection(Editor* editor) {
+    Clip* clip = editor->register_name != '\0' ?
+        Clipboard_get_register(&editor->clipboard, editor->register_name) :
+        Clipboard_get_recent(&editor->clipboard, editor->idx_recent);
+    if (clip) {
+        Document_paste(editor->document, clip);
+    }
+    editor->register_name = '\0';
+    editor->idx_recent = 0;
+}
+
 
+// undo/redo failure messages are cleared once the main text is edited
+static void Editor_note_main_file_text_changed(Editor* editor) {
     switch (editor->gen_info_state) {
     case GEN_INFO_NORMAL:
         break;
     case GEN_INFO_OLDEST_CHANGE: // fallthrough
     case GEN_INFO_NEWEST_CHANGE:
-        String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
+        String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
         editor->gen_info_state = GEN_INFO_NORMAL;
         break;
     default:
@@ -394,37 +890,44 @@ static void Editor_insert_into_main_file_text(Editor* editor, const String* new_
 }
 
 
-static void Editor_del_main_file_text(Editor* editor, size_t max_visual_width, size_t max_visual_height) {
-    Action new_action = {
-        .cursor = editor->file_text.text_box.cursor_info.pos.cursor - 1,
-        .action = ACTION_REMOVE_STRING,
-        .str = {0}
-    };
+static void Editor_insert_into_main_file_text(Editor* editor, const String* new_str, size_t index, size_t max_visual_width, size_t max_visual_height) {
+    if (!editor->document->unsaved_changes) {
+        String_cpy_from_cstr(&editor->save_info.text_box->string, UNSAVED_CHANGES_TEXT, strlen(UNSAVED_CHANGES_TEXT));
+    }
 
-    // placing char to delete in new_action->str
-    String_init(&new_action.str);
-    String_append(&new_action.str, String_at(&editor->file_text.text_box.string, editor->file_text.text_box.cursor_info.pos.cursor - 1));
+    if (editor->document->cursors.count > 0) {
+        Document_insert_at_cursors(editor->document, new_str, max_visual_width, max_visual_height);
+    } else {
+        Document_insert(editor->document, new_str, index, max_visual_width, max_visual_height);
+    }
+    Editor_note_main_file_text_changed(editor);
+}
 
-    Actions_append(&editor->actions, &new_action);
 
-    bool del_success = Text_box_del_ch(&editor->file_text.text_box, editor->file_text.text_box.cursor_info.pos.cursor - 1, max_visual_width, max_visual_height);
-    if (del_success && !editor->unsaved_changes) {
-        String_cpy_from_cstr(&editor->save_info.text_box.string, UNSAVED_CHANGES_TEXT, strlen(UNSAVED_CHANGES_TEXT));
-        editor->unsaved_changes = true;
+static void Editor_del_main_file_text(Editor* editor, size_t max_visual_width, size_t max_visual_height) {
+    bool had_unsaved_changes = editor->document->unsaved_changes;
+    bool del_success = editor->document->cursors.count > 0 ?
+        Document_del_before_cursors(editor->document, max_visual_width, max_visual_height) :
+        Document_del_before_cursor(editor->document, max_visual_width, max_visual_height);
+    if (del_success && !had_unsaved_changes) {
+        String_cpy_from_cstr(&editor->save_info.text_box->string, UNSAVED_CHANGES_TEXT, strlen(UNSAVED_CHANGES_TEXT));
     }
+    Editor_note_main_file_text_changed(editor);
+}
 
-    switch (editor->gen_info_state) {
-    case GEN_INFO_NORMAL:
-        break;
-    case GEN_INFO_OLDEST_CHANGE: // fallthrough
-    case GEN_INFO_NEWEST_CHANGE:
-        String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
-        editor->gen_info_state = GEN_INFO_NORMAL;
-        break;
-    default:
-        assert(false && "unreachable");
-        abort();
+
+// copy the selected text (see Editor_cpy_selection) and delete it
+static void Editor_cut_selection(Editor* editor) {
+    if (editor->document->text_box.visual_sel.state == VIS_STATE_NONE) {
+        return;
+    }
+    Editor_cpy_selection(editor);
+    bool had_unsaved_changes = editor->document->unsaved_changes;
+    bool del_success = Document_del_selection(editor->document, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+    if (del_success && !had_unsaved_changes) {
+        String_cpy_from_cstr(&editor->save_info.text_box->string, UNSAVED_CHANGES_TEXT, strlen(UNSAVED_CHANGES_TEXT));
     }
+    Editor_note_main_file_text_changed(editor);
 }
 
 
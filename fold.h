@@ -0,0 +1,277 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+
+// folded (hidden) lines of a text
+//
+// a fold hides the lines after its header line (which stays visible, and is drawn as one row); folds can be nested,
+// and are kept as a tree, in preorder (a fold comes before the folds nested in it)
+// the outermost closed folds are the hidden ranges of the text; the functions that step from one visual line to the
+// next (or previous) one skip a hidden range in one step (folds_skip_forward, folds_skip_backward), so moving the
+// cursor and scrolling cost the same however much text is folded
+//
+// the text_box.h functions only get the text, so the folds of a text are found by the text; only texts that have
+// closed folds are registered (so texts without them are skipped after a few comparisons, however many texts are open)
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+
+
+typedef struct {
+    size_t start; // start of the first hidden line (the line before it is the header)
+    size_t end; // start of the line after the last hidden line (or the end of the text)
+    bool is_closed;
+} Fold;
+
+
+define_vector(Fold)
+
+
+typedef struct {
+    const String* string; // text that the folds are in
+    Vector_Fold folds; // every fold (open or closed), sorted by start (and then by end, from the largest)
+    Vector_Fold hidden; // outermost closed folds (sorted, and not overlapping)
+} Folds;
+
+
+typedef Folds* Folds_ptr;
+define_vector(Folds_ptr)
+
+
+// texts that have closed folds
+static Vector_Folds_ptr folds_registered;
+// folds that were found last (the same text is usually looked up many times in a row)
+static const Folds* folds_last_found;
+
+
+static inline const Folds* folds_find(const String* string) {
+    if (folds_last_found && folds_last_found->string == string) {
+        return folds_last_found;
+    }
+    for (size_t idx = 0; idx < folds_registered.count; idx++) {
+        if (folds_registered.items[idx]->string == string) {
+            folds_last_found = folds_registered.items[idx];
+            return folds_last_found;
+        }
+    }
+    return NULL;
+}
+
+
+static inline void folds_set_registered(Folds* folds, bool is_registered) {
+    for (size_t idx = 0; idx < folds_registered.count; idx++) {
+        if (folds_registered.items[idx] == folds) {
+            if (!is_registered) {
+                folds_registered.items[idx] = folds_registered.items[--folds_registered.count];
+                if (folds_last_found == folds) {
+                    folds_last_found = NULL;
+                }
+            }
+            return;
+        }
+    }
+    if (is_registered) {
+        vector_append_Folds_ptr(&folds_registered, &folds);
+    }
+}
+
+
+// folds and string must stay at the same address until Folds_free is called
+static inline void Folds_init(Folds* folds, const String* string) {
+    memset(folds, 0, sizeof(*folds));
+    folds->string = string;
+}
+
+
+static inline void Folds_free(Folds* folds) {
+    folds_set_registered(folds, false);
+    free(folds->folds.items);
+    free(folds->hidden.items);
+    memset(folds, 0, sizeof(*folds));
+}
+
+
+static inline void folds_update_hidden(Folds* folds) {
+    folds->hidden.count = 0;
+    for (size_t idx = 0; idx < folds->folds.count; idx++) {
+        const Fold* fold = &folds->folds.items[idx];
+        if (!fold->is_closed || (folds->hidden.count > 0 && fold->start < vector_back_Fold(&folds->hidden)->end)) {
+            continue;
+        }
+        vector_append_Fold(&folds->hidden, fold);
+    }
+    folds_set_registered(folds, folds->hidden.count > 0);
+}
+
+
+// index of the last fold of folds[0, count) that starts at or before idx (count if there is none)
+static inline size_t folds_find_last_at_or_before(const Fold* folds, size_t count, size_t idx) {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (folds[mid].start <= idx) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low > 0 ? low - 1 : count;
+}
+
+
+// end of the hidden range that contains idx (or idx if it is not hidden)
+static inline size_t folds_skip_forward(const String* string, size_t idx) {
+    const Folds* folds = folds_find(string);
+    if (!folds || folds->hidden.count < 1) {
+        return idx;
+    }
+    size_t found = folds_find_last_at_or_before(folds->hidden.items, folds->hidden.count, idx);
+    if (found < folds->hidden.count && idx < folds->hidden.items[found].end) {
+        return folds->hidden.items[found].end;
+    }
+    return idx;
+}
+
+
+// start of the hidden range that ends at (or contains) idx, where idx is the start of a line (or idx if there is none)
+static inline size_t folds_skip_backward(const String* string, size_t idx) {
+    const Folds* folds = folds_find(string);
+    if (!folds || folds->hidden.count < 1 || idx < 1) {
+        return idx;
+    }
+    size_t found = folds_find_last_at_or_before(folds->hidden.items, folds->hidden.count, idx - 1);
+    if (found < folds->hidden.count && idx <= folds->hidden.items[found].end) {
+        return folds->hidden.items[found].start;
+    }
+    return idx;
+}
+
+
+static inline bool folds_is_hidden(const String* string, size_t idx) {
+    return folds_skip_forward(string, idx) != idx;
+}
+
+
+// index of the fold that hides the lines from start to end (or folds->folds.count if there is none)
+static inline size_t folds_find_exact(const Folds* folds, size_t start, size_t end) {
+    for (size_t idx = folds_find_last_at_or_before(folds->folds.items, folds->folds.count, start); idx < folds->folds.count; idx--) {
+        if (folds->folds.items[idx].start != start) {
+            break;
+        }
+        if (folds->folds.items[idx].end == end) {
+            return idx;
+        }
+    }
+    return folds->folds.count;
+}
+
+
+// index of the largest fold that starts at start (or folds->folds.count if there is none)
+static inline size_t Folds_find_at(const Folds* folds, size_t start) {
+    size_t idx = folds_find_last_at_or_before(folds->folds.items, folds->folds.count, start);
+    if (idx >= folds->folds.count || folds->folds.items[idx].start != start) {
+        return folds->folds.count;
+    }
+    while (idx > 0 && folds->folds.items[idx - 1].start == start) {
+        idx--;
+    }
+    return idx;
+}
+
+
+// add a closed fold that hides the lines from start to end (both are starts of lines)
+// returns false if it would overlap another fold without being nested in it (or containing it)
+static inline bool Folds_add(Folds* folds, size_t start, size_t end) {
+    assert(start < end);
+    size_t existing = folds_find_exact(folds, start, end);
+    if (existing < folds->folds.count) {
+        folds->folds.items[existing].is_closed = true;
+        folds_update_hidden(folds);
+        return true;
+    }
+
+    size_t idx_insert = 0;
+    for (size_t idx = 0; idx < folds->folds.count; idx++) {
+        const Fold* fold = &folds->folds.items[idx];
+        bool is_disjoint = fold->end <= start || fold->start >= end;
+        bool is_nested = (fold->start <= start && fold->end >= end) || (fold->start >= start && fold->end <= end);
+        if (!is_disjoint && !is_nested) {
+            return false;
+        }
+        if (fold->start < start || (fold->start == start && fold->end > end)) {
+            idx_insert = idx + 1;
+        }
+    }
+    Fold new_fold = {.start = start, .end = end, .is_closed = true};
+    vector_insert_Fold(&folds->folds, &new_fold, idx_insert);
+    folds_update_hidden(folds);
+    return true;
+}
+
+
+// open every fold that hides idx
+// returns false if idx was not hidden
+static inline bool Folds_open_at(Folds* folds, size_t idx) {
+    bool is_changed = false;
+    for (size_t idx_fold = 0; idx_fold < folds->folds.count && folds->folds.items[idx_fold].start <= idx; idx_fold++) {
+        Fold* fold = &folds->folds.items[idx_fold];
+        if (fold->is_closed && idx < fold->end) {
+            fold->is_closed = false;
+            is_changed = true;
+        }
+    }
+    folds_update_hidden(folds);
+    return is_changed;
+}
+
+
+// open every fold (the folds are kept, so they can be closed again)
+static inline void Folds_open_all(Folds* folds) {
+    for (size_t idx = 0; idx < folds->folds.count; idx++) {
+        folds->folds.items[idx].is_closed = false;
+    }
+    folds_update_hidden(folds);
+}
+
+
+static inline void Folds_clear(Folds* folds) {
+    folds->folds.count = 0;
+    folds->hidden.count = 0;
+    folds_set_registered(folds, false);
+}
+
+
+// to be called after count_removed bytes at start of the text were replaced by count_inserted bytes
+// folds before or after the edit are kept (and moved); a fold that the edit is within gets longer or shorter; every
+// other fold that the edit touched (eg. it joined the header and the first hidden line) is removed
+static inline void Folds_note_edit(Folds* folds, size_t start, size_t count_removed, size_t count_inserted) {
+    if (folds->folds.count < 1) {
+        return;
+    }
+    const String* string = folds->string;
+    size_t count_kept = 0;
+    for (size_t idx = 0; idx < folds->folds.count; idx++) {
+        Fold fold = folds->folds.items[idx];
+        if (fold.end < start || (fold.end == start && string->items[fold.end - 1] == '\n')) {
+            // before the edit
+        } else if (start + count_removed < fold.start) {
+            fold.start = fold.start - count_removed + count_inserted;
+            fold.end = fold.end - count_removed + count_inserted;
+        } else if (start >= fold.start && start + count_removed < fold.end) {
+            fold.end = fold.end - count_removed + count_inserted;
+        } else {
+            continue;
+        }
+        folds->folds.items[count_kept++] = fold;
+    }
+    folds->folds.count = count_kept;
+    folds_update_hidden(folds);
+}
+
+
+#endif // FOLD_H
@@ -0,0 +1,445 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+
+#include <ncurses.h>
+#include <poll.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+#include "text_box.h"
+#include "line_ending.h"
+#include "vt.h"
+#include "timing.h"
+
+
+define_vector(int)
+
+
+// special key that is placed in Keys.keys when a bracketed paste was received
+#define KEY_PASTE (KEY_MAX + 1)
+
+
+static const char PASTE_START[] = "\033[200~";
+static const char PASTE_END[] = "\033[201~";
+#define PASTE_MARKER_LEN (sizeof(PASTE_START) - 1)
+
+// give up on a bracketed paste if no more pasted text arrives in this amount of time
+#define PASTE_TIMEOUT_MS 1000
+// wait this long for the rest of a paste start marker that was only partially received
+#define PASTE_MARKER_TIMEOUT_MS 50
+
+
+// keys that were read from the terminal, and that will be processed before the next redraw
+typedef struct {
+    Vector_int keys;
+
+    String pastes; // text of every bracketed paste in this batch (one after another)
+    Vector_size_t paste_counts; // count characters of each paste (in the same order as KEY_PASTE appears in keys)
+
+    String vt_pending; // bytes read from the terminal that are not decoded into keys yet (vt backend only)
+} Keys;
+
+
+// maximum count of keys that are processed before the screen is redrawn
+#define KEYS_MAX_BATCH 65536
+
+
+static inline void Keys_init(Keys* keys) {
+    memset(keys, 0, sizeof(*keys));
+}
+
+
+static inline void Keys_free(Keys* keys) {
+    free(keys->keys.items);
+    String_free_char_data(&keys->pastes);
+    free(keys->paste_counts.items);
+    String_free_char_data(&keys->vt_pending);
+    memset(keys, 0, sizeof(*keys));
+}
+
+
+static inline void set_bracketed_paste(bool enabled) {
+    fputs(enabled ? "\033[?2004h" : "\033[?2004l", stdout);
+    fflush(stdout);
+}
+
+
+// returns true if the last keys are the first count_marker characters of marker
+static inline bool Keys_ends_with_marker(const Keys* keys, const char* marker, size_t count_marker) {
+    if (keys->keys.count < count_marker) {
+        return false;
+    }
+    const int* tail = keys->keys.items + keys->keys.count - count_marker;
+    for (size_t idx = 0; idx < count_marker; idx++) {
+        if (tail[idx] != marker[idx]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// returns true if keys end with a partial paste start marker (the rest of the marker is probably in flight)
+static inline bool Keys_ends_with_partial_paste_start(const Keys* keys) {
+    for (size_t count_marker = 1; count_marker < PASTE_MARKER_LEN; count_marker++) {
+        if (Keys_ends_with_marker(keys, PASTE_START, count_marker)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// returns index of the paste end marker in pastes, or pastes.count if it was not found
+static inline size_t Keys_find_paste_end(const Keys* keys, size_t search_start) {
+    const char* items = keys->pastes.items;
+    size_t idx = search_start;
+    while (idx + PASTE_MARKER_LEN <= keys->pastes.count) {
+        const char* esc = memchr(items + idx, PASTE_END[0], keys->pastes.count - idx);
+        if (!esc) {
+            break;
+        }
+        idx = esc - items;
+        if (idx + PASTE_MARKER_LEN <= keys->pastes.count && 0 == memcmp(esc, PASTE_END, PASTE_MARKER_LEN)) {
+            return idx;
+        }
+        idx++;
+    }
+    return keys->pastes.count;
+}
+
+
+// read pasted text straight from the terminal in large chunks, until the paste end marker is found
+// text of the paste (from paste_start) may already be partially in pastes
+// returns index of the end marker in pastes (or pastes.count if the paste did not end)
+static inline size_t Keys_read_paste_until_end(Keys* keys, size_t paste_start) {
+    size_t idx_end = Keys_find_paste_end(keys, paste_start);
+    if (idx_end < keys->pastes.count) {
+        return idx_end;
+    }
+
+    char buf[65536];
+    while (1) {
+        struct pollfd poll_fd = {.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+        if (poll(&poll_fd, 1, PASTE_TIMEOUT_MS) < 1) {
+            log("warning: bracketed paste did not end; using text received so far");
+            return keys->pastes.count;
+        }
+        ssize_t amount_read = read(STDIN_FILENO, buf, sizeof(buf));
+        if (amount_read < 1) {
+            log("warning: could not read bracketed paste: errno: %d: %s", errno, strerror(errno));
+            return keys->pastes.count;
+        }
+
+        // end marker may be split between this chunk and the previous one
+        size_t search_start = keys->pastes.count;
+        search_start = search_start - MIN(search_start - paste_start, PASTE_MARKER_LEN - 1);
+
+        String_append_cstr(&keys->pastes, buf, amount_read);
+        idx_end = Keys_find_paste_end(keys, search_start);
+        if (idx_end < keys->pastes.count) {
+            return idx_end;
+        }
+    }
+}
+
+
+// add the paste that starts at paste_start (and ends at the end of pastes) as one KEY_PASTE
+static inline void Keys_finish_paste(Keys* keys, size_t paste_start) {
+    // terminals send pasted line endings as \r or \r\n
+    Line_ending_counts line_endings;
+    keys->pastes.count = line_ending_normalize(&line_endings, keys->pastes.items, paste_start, keys->pastes.count);
+
+    size_t count_paste = keys->pastes.count - paste_start;
+    vector_append_size_t(&keys->paste_counts, &count_paste);
+    int paste_key = KEY_PASTE;
+    vector_append_int(&keys->keys, &paste_key);
+}
+
+
+// pasted text is read straight from the terminal in large chunks, bypassing wgetch
+static inline void Keys_read_paste(Keys* keys) {
+    size_t paste_start = keys->pastes.count;
+    size_t idx_end = Keys_read_paste_until_end(keys, paste_start);
+
+    // give text typed after the paste back to ncurses (ungetch is last in, first out)
+    for (size_t idx = keys->pastes.count; idx > idx_end + PASTE_MARKER_LEN; idx--) {
+        if (ERR == ungetch((unsigned char)keys->pastes.items[idx - 1])) {
+            log("warning: key typed after paste was dropped");
+        }
+    }
+    keys->pastes.count = idx_end;
+
+    Keys_finish_paste(keys, paste_start);
+}
+
+
+// block until one key is available, then read every key that is already pending without blocking
+// (timing of the keystroke starts once the first key is available)
+static inline void Keys_read_pending(Keys* keys, WINDOW* window, Timing* timing) {
+    keys->keys.count = 0;
+    keys->pastes.count = 0;
+    keys->paste_counts.count = 0;
+
+    int new_ch = wgetch(window);
+    Timing_key_start(timing);
+    while (1) {
+        vector_append_int(&keys->keys, &new_ch);
+
+        if (Keys_ends_with_marker(keys, PASTE_START, PASTE_MARKER_LEN)) {
+            keys->keys.count -= PASTE_MARKER_LEN;
+            Keys_read_paste(keys);
+        }
+
+        if (keys->keys.count >= KEYS_MAX_BATCH) {
+            break;
+        }
+
+        if (Keys_ends_with_partial_paste_start(keys)) {
+            // rest of the paste start marker should arrive shortly
+            wtimeout(window, PASTE_MARKER_TIMEOUT_MS);
+        } else {
+            nodelay(window, TRUE);
+        }
+        new_ch = wgetch(window);
+        if (new_ch == ERR) {
+            break;
+        }
+    }
+    nodelay(window, FALSE);
+    Timing_key_decoded(timing, keys->keys.items[0]);
+}
+
+
+// longest escape sequence that is decoded (longer sequences are treated as an escape key followed by text)
+#define VT_MAX_ESC_SEQ_LEN 16
+
+
+// decode the key at the start of bytes (same key values as ncurses with keypad enabled)
+// returns count of bytes used by the key, or 0 if the escape sequence is not complete yet
+// key is ERR if the escape sequence is not supported, and KEY_PASTE if it is the start of a bracketed paste
+static inline size_t vt_decode_key(int* key, const char* bytes, size_t count) {
+    assert(count > 0);
+    unsigned char first = bytes[0];
+    if (first != 27) {
+        switch (first) {
+        case '\r':
+            *key = '\n';
+            break;
+        case 0x7f:
+            *key = KEY_BACKSPACE;
+            break;
+        default:
+            *key = first;
+            break;
+        }
+        return 1;
+    }
+
+    if (count < 2) {
+        return 0;
+    }
+    if (bytes[1] != '[' && bytes[1] != 'O') {
+        // alt + key
+        *key = 27;
+        return 1;
+    }
+
+    // parameters are digits and ';', followed by one final character
+    size_t idx_final = 2;
+    while (idx_final < count && idx_final < VT_MAX_ESC_SEQ_LEN && (
+        (bytes[idx_final] >= '0' && bytes[idx_final] <= '9') || bytes[idx_final] == ';'
+    )) {
+        idx_final++;
+    }
+    if (idx_final >= VT_MAX_ESC_SEQ_LEN) {
+        *key = 27;
+        return 1;
+    }
+    if (idx_final >= count) {
+        return 0;
+    }
+
+    int param = atoi(bytes + 2);
+    switch (bytes[idx_final]) {
+    case 'A':
+        *key = KEY_UP;
+        break;
+    case 'B':
+        *key = KEY_DOWN;
+        break;
+    case 'C':
+        *key = KEY_RIGHT;
+        break;
+    case 'D':
+        *key = KEY_LEFT;
+        break;
+    case 'H':
+        *key = KEY_HOME;
+        break;
+    case 'F':
+        *key = KEY_END;
+        break;
+    case '~':
+        switch (param) {
+        case 1: // fallthrough
+        case 7:
+            *key = KEY_HOME;
+            break;
+        case 2:
+            *key = KEY_IC;
+            break;
+        case 3:
+            *key = KEY_DC;
+            break;
+        case 4: // fallthrough
+        case 8:
+            *key = KEY_END;
+            break;
+        case 5:
+            *key = KEY_PPAGE;
+            break;
+        case 6:
+            *key = KEY_NPAGE;
+            break;
+        case 200:
+            *key = KEY_PASTE;
+            break;
+        default:
+            *key = ERR;
+            break;
+        }
+        break;
+    default:
+        *key = ERR;
+        break;
+    }
+    if (*key == ERR) {
+        log("warning: unsupported escape sequence: %.*s", (int)(idx_final - 1), bytes + 1);
+    }
+    return idx_final + 1;
+}
+
+
+// read every byte that is available from the terminal (without blocking) into vt_pending
+// returns false if no bytes were available within timeout_ms
+static inline bool Keys_vt_read_available(Keys* keys, int timeout_ms) {
+    char buf[65536];
+    bool did_read = false;
+    while (1) {
+        struct pollfd poll_fd = {.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+        if (poll(&poll_fd, 1, did_read ? 0 : timeout_ms) < 1) {
+            return did_read;
+        }
+        ssize_t amount_read = read(STDIN_FILENO, buf, sizeof(buf));
+        if (amount_read < 1) {
+            return did_read;
+        }
+        String_append_cstr(&keys->vt_pending, buf, amount_read);
+        did_read = true;
+    }
+}
+
+
+// vt backend version of Keys_read_pending (reads and decodes bytes from the terminal directly)
+static inline void Keys_read_pending_vt(Keys* keys, Timing* timing) {
+    keys->keys.count = 0;
+    keys->pastes.count = 0;
+    keys->paste_counts.count = 0;
+
+    // block until at least one byte is available, or the terminal is resized
+    while (keys->vt_pending.count < 1 && !vt_did_resize) {
+        char buf[65536];
+        ssize_t amount_read = read(STDIN_FILENO, buf, sizeof(buf));
+        if (amount_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (amount_read < 1) {
+            log("fetal error: could not read from terminal: errno: %d: %s", errno, strerror(errno));
+            abort();
+        }
+        String_append_cstr(&keys->vt_pending, buf, amount_read);
+    }
+    Timing_key_start(timing);
+    if (vt_did_resize) {
+        vt_did_resize = 0;
+        int resize_key = KEY_RESIZE;
+        vector_append_int(&keys->keys, &resize_key);
+    }
+    Keys_vt_read_available(keys, 0);
+
+    size_t idx = 0;
+    while (idx < keys->vt_pending.count && keys->keys.count < KEYS_MAX_BATCH) {
+        int key;
+        size_t count_used = vt_decode_key(&key, keys->vt_pending.items + idx, keys->vt_pending.count - idx);
+        if (count_used == 0) {
+            // rest of the escape sequence should arrive shortly
+            if (Keys_vt_read_available(keys, PASTE_MARKER_TIMEOUT_MS)) {
+                continue;
+            }
+            key = 27;
+            count_used = 1;
+        }
+        idx += count_used;
+
+        if (key == KEY_PASTE) {
+            // pasted text (and anything after it) is moved from vt_pending to pastes
+            size_t paste_start = keys->pastes.count;
+            String_append_cstr(&keys->pastes, keys->vt_pending.items + idx, keys->vt_pending.count - idx);
+            size_t idx_end = Keys_read_paste_until_end(keys, paste_start);
+
+            // text typed after the paste is decoded next
+            keys->vt_pending.count = 0;
+            if (idx_end + PASTE_MARKER_LEN < keys->pastes.count) {
+                String_append_cstr(
+                    &keys->vt_pending,
+                    keys->pastes.items + idx_end + PASTE_MARKER_LEN,
+                    keys->pastes.count - idx_end - PASTE_MARKER_LEN
+                );
+            }
+            keys->pastes.count = idx_end;
+            Keys_finish_paste(keys, paste_start);
+            idx = 0;
+            continue;
+        }
+
+        if (key != ERR) {
+            vector_append_int(&keys->keys, &key);
+        }
+    }
+
+    // keep bytes that were not decoded for the next batch
+    vector_remove_range_char(&keys->vt_pending, 0, idx);
+
+    if (keys->keys.count < 1) {
+        // only unsupported escape sequences were read; wait for the next key
+        Keys_read_pending_vt(keys, timing);
+        return;
+    }
+    Timing_key_decoded(timing, keys->keys.items[0]);
+}
+
+
+// returns true if key moves the cursor
+static inline bool key_get_direction(DIRECTION* direction, int key) {
+    switch (key) {
+    case KEY_LEFT:
+        *direction = DIR_LEFT;
+        return true;
+    case KEY_RIGHT:
+        *direction = DIR_RIGHT;
+        return true;
+    case KEY_UP:
+        *direction = DIR_UP;
+        return true;
+    case KEY_DOWN:
+        *direction = DIR_DOWN;
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+#endif // INPUT_H
@@ -0,0 +1,324 @@
+#ifndef LINE_ENDING_H
+#define LINE_ENDING_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "util.h"
+#include "line_scan.h"
+
+
+// line endings of a file
+//
+// the text is always edited with \n line endings: the line endings of a file are converted to \n when it is opened,
+// and converted back to the line ending of the file when it is saved
+// (a file with mixed line endings is saved with the line ending that it starts with)
+// a \r that is not part of a line ending is not possible in a file that is opened; a \r that is inserted later is
+// drawn as a control character
+
+
+typedef enum {
+    LINE_ENDING_LF = 0,
+    LINE_ENDING_CRLF,
+    LINE_ENDING_CR,
+} LINE_ENDING;
+
+
+// what line_ending_normalize found
+typedef struct {
+    LINE_ENDING first; // line ending of the first line (LINE_ENDING_LF if there are none)
+    size_t count_crlf; // count of \r\n that were converted to \n
+    size_t count_cr; // count of \r that were converted to \n
+} Line_ending_counts;
+
+
+static inline const char* line_ending_to_cstr(LINE_ENDING line_ending) {
+    switch (line_ending) {
+    case LINE_ENDING_LF:
+        return "\n";
+    case LINE_ENDING_CRLF:
+        return "\r\n";
+    case LINE_ENDING_CR:
+        return "\r";
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+}
+
+
+static inline const char* line_ending_name(LINE_ENDING line_ending) {
+    switch (line_ending) {
+    case LINE_ENDING_LF:
+        return "lf";
+    case LINE_ENDING_CRLF:
+        return "crlf";
+    case LINE_ENDING_CR:
+        return "cr";
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+}
+
+
+#ifdef __SSE2__
+// bit idx is set if items[idx] is \r (for idx < 64)
+static inline uint64_t line_ending_find_carriage_returns(const char* items) {
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    uint64_t mask = 0;
+    for (size_t idx = 0; idx < 4; idx++) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(items + 16 * idx));
+        mask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, carriage_return)) << (16 * idx);
+    }
+    return mask;
+}
+#endif // __SSE2__
+
+
+// convert every \r\n and \r in items[start, end) to \n, in place
+// returns the new end (the text after end is not moved)
+//
+// text with \n line endings is only searched for \r; otherwise the text from the first \r on is copied down one line 
+// at a time, 32 bytes at a time (the \r of the next 64 bytes are found at once, so there is no search per line)
+// a copy never overwrites bytes that were not read yet once 32 line endings were made shorter, so the first 32 are 
+// converted one byte at a time (text with \r line endings is not made shorter, so its \r are replaced where they are)
+static inline size_t line_ending_normalize(Line_ending_counts* counts, char* items, size_t start, size_t end) {
+    memset(counts, 0, sizeof(*counts));
+
+    size_t idx_src;
+    if (!line_scan_find_byte_forward(&idx_src, items, start, end, '\r')) {
+        return end;
+    }
+    size_t first_newline;
+    if (!line_scan_find_newline_forward(&first_newline, items, start, idx_src)) {
+        counts->first = idx_src + 1 < end && items[idx_src + 1] == '\n' ? LINE_ENDING_CRLF : LINE_ENDING_CR;
+    }
+
+    // idx_dest is never after idx_src, so the bytes that are written were already read
+    size_t idx_dest = idx_src;
+    while (idx_src < end) {
+#ifdef __SSE2__
+        // (the line after the last \r of the 64 bytes may be copied too, and then the byte after it is read)
+        if (idx_src - idx_dest >= 32 && idx_src + 64 + 32 + 1 <= end) {
+            uint64_t mask = line_ending_find_carriage_returns(items + idx_src);
+            if (!mask) {
+                __m128i blocks[4];
+                for (size_t idx = 0; idx < 4; idx++) {
+                    blocks[idx] = _mm_loadu_si128((const __m128i*)(items + idx_src + 16 * idx));
+                }
+                for (size_t idx = 0; idx < 4; idx++) {
+                    _mm_storeu_si128((__m128i*)(items + idx_dest + 16 * idx), blocks[idx]);
+                }
+                idx_src += 64;
+                idx_dest += 64;
+                continue;
+            }
+
+            size_t start_window = idx_src;
+            while (mask) {
+                size_t carriage_return = start_window + (size_t)__builtin_ctzll(mask);
+                mask &= mask - 1;
+
+                // line (and the bytes after it, up to a multiple of 32 bytes, which are overwritten later)
+                size_t len_line = carriage_return + 1 - idx_src;
+                for (size_t idx = 0; idx < len_line; idx += 32) {
+                    __m128i block_low = _mm_loadu_si128((const __m128i*)(items + idx_src + idx));
+                    __m128i block_high = _mm_loadu_si128((const __m128i*)(items + idx_src + idx + 16));
+                    _mm_storeu_si128((__m128i*)(items + idx_dest + idx), block_low);
+                    _mm_storeu_si128((__m128i*)(items + idx_dest + idx + 16), block_high);
+                }
+                items[idx_dest + len_line - 1] = '\n';
+                idx_dest += len_line;
+                idx_src = carriage_return + 1;
+                if (items[idx_src] == '\n') {
+                    idx_src++;
+                    counts->count_crlf++;
+                } else {
+                    counts->count_cr++;
+                }
+            }
+            continue;
+        }
+
+        if (idx_src == idx_dest && idx_src + 17 <= end) {
+            // nothing was removed yet, so a block without \r\n is converted where it is
+            const __m128i carriage_return = _mm_set1_epi8('\r');
+            const __m128i newline = _mm_set1_epi8('\n');
+            __m128i block = _mm_loadu_si128((const __m128i*)(items + idx_src));
+            __m128i block_next = _mm_loadu_si128((const __m128i*)(items + idx_src + 1));
+            __m128i is_carriage_return = _mm_cmpeq_epi8(block, carriage_return);
+            unsigned mask = (unsigned)_mm_movemask_epi8(is_carriage_return);
+            if (!(mask & (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block_next, newline)))) {
+                block = _mm_or_si128(_mm_and_si128(is_carriage_return, newline), _mm_andnot_si128(is_carriage_return, block));
+                _mm_storeu_si128((__m128i*)(items + idx_dest), block);
+                counts->count_cr += (size_t)__builtin_popcount(mask);
+                idx_src += 16;
+                idx_dest += 16;
+                continue;
+            }
+        }
+#endif // __SSE2__
+
+        size_t end_block = MIN(idx_src + 16, end);
+        for (; idx_src < end_block; idx_src++) {
+            char curr_char = items[idx_src];
+            if (curr_char == '\r') {
+                if (idx_src + 1 < end && items[idx_src + 1] == '\n') {
+                    // \n is copied next
+                    counts->count_crlf++;
+                    continue;
+                }
+                curr_char = '\n';
+                counts->count_cr++;
+            }
+            items[idx_dest++] = curr_char;
+        }
+    }
+    return idx_dest;
+}
+
+
+// write items[0, count) to file, with every \n written as line_ending
+// (the text is copied to a buffer one line at a time, so that the file is written in large blocks)
+// returns false if the file could not be written
+static inline bool line_ending_write(FILE* file, const char* items, size_t count, LINE_ENDING line_ending) {
+    if (line_ending == LINE_ENDING_LF) {
+        return count == fwrite(items, 1, count, file);
+    }
+
+    const char* line_ending_str = line_ending_to_cstr(line_ending);
+    size_t len_line_ending = strlen(line_ending_str);
+    char buf[65536];
+    size_t count_buf = 0;
+    size_t idx = 0;
+    while (idx < count) {
+        size_t end_line;
+        bool is_newline_found = line_scan_find_newline_forward(&end_line, items, idx, count);
+        if (!is_newline_found) {
+            end_line = count;
+        }
+
+        // line may be longer than the buffer
+        while (idx < end_line) {
+            if (count_buf >= sizeof(buf)) {
+                if (count_buf != fwrite(buf, 1, count_buf, file)) {
+                    return false;
+                }
+                count_buf = 0;
+            }
+            size_t count_copy = MIN(end_line - idx, sizeof(buf) - count_buf);
+            memcpy(buf + count_buf, items + idx, count_copy);
+            count_buf += count_copy;
+            idx += count_copy;
+        }
+
+        if (is_newline_found) {
+            if (count_buf + len_line_ending > sizeof(buf)) {
+                if (count_buf != fwrite(buf, 1, count_buf, file)) {
+                    return false;
+                }
+                count_buf = 0;
+            }
+            memcpy(buf + count_buf, line_ending_str, len_line_ending);
+            count_buf += len_line_ending;
+            idx++;
+        }
+    }
+    return count_buf == fwrite(buf, 1, count_buf, file);
+}
+
+
+// write data to dest_file_name, with every \n written as line_ending
+// returns false if file could not be written
+static inline bool line_ending_write_file(const char* dest_file_name, const char* data, size_t data_size, LINE_ENDING line_ending) {
+    FILE* dest_file = fopen(dest_file_name, "wb");
+    if (!dest_file) {
+        log("error: file %s could not be opened: errno: %d: %s\n", dest_file_name, errno, strerror(errno));
+        return false;
+    }
+
+    if (!line_ending_write(dest_file, data, data_size, line_ending)) {
+        log("error: file %s could not be written: errno: %d: %s\n", dest_file_name, errno, strerror(errno));
+        fclose(dest_file);
+        return false;
+    }
+
+    if (0 != fclose(dest_file)) {
+        log("error: file %s could not be written: errno: %d: %s\n", dest_file_name, errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+
+// write data to a new temporary file (created from the template temp_file_name), then rename it to file_name
+static inline bool write_temp_file_and_rename(char* temp_file_name, const char* file_name, mode_t mode, const char* data, size_t data_size, LINE_ENDING line_ending) {
+    int fd = mkstemp(temp_file_name);
+    if (fd < 0) {
+        log("error: temporary file %s could not be created: errno: %d: %s\n", temp_file_name, errno, strerror(errno));
+        return false;
+    }
+    if (0 != fchmod(fd, mode)) {
+        log("warning: permissions of temporary file %s could not be set: errno: %d: %s\n", temp_file_name, errno, strerror(errno));
+    }
+    FILE* temp_file = fdopen(fd, "wb");
+    if (!temp_file) {
+        log("error: temporary file %s could not be opened: errno: %d: %s\n", temp_file_name, errno, strerror(errno));
+        close(fd);
+        unlink(temp_file_name);
+        return false;
+    }
+
+    bool is_written = line_ending_write(temp_file, data, data_size, line_ending);
+    if (0 != fclose(temp_file)) {
+        is_written = false;
+    }
+    if (!is_written) {
+        log("error: temporary file %s could not be written: errno: %d: %s\n", temp_file_name, errno, strerror(errno));
+        unlink(temp_file_name);
+        return false;
+    }
+
+    if (0 != rename(temp_file_name, file_name)) {
+        log("error: file %s could not be replaced: errno: %d: %s\n", file_name, errno, strerror(errno));
+        unlink(temp_file_name);
+        return false;
+    }
+    return true;
+}
+
+
+// write data to a temporary file next to dest_file_name, then rename it to dest_file_name, so that the file is
+// replaced as a whole (and is never left half written); the new file keeps the permissions of the file it replaces
+// returns false if file could not be written
+static inline bool line_ending_replace_file(const char* dest_file_name, const char* data, size_t data_size, LINE_ENDING line_ending) {
+    mode_t mode;
+    struct stat file_stat;
+    if (0 == lstat(dest_file_name, &file_stat)) {
+        if (S_ISLNK(file_stat.st_mode)) {
+            // a symlink would be replaced by a plain file, so the file that it points to is written in place
+            return line_ending_write_file(dest_file_name, data, data_size, line_ending);
+        }
+        mode = file_stat.st_mode & 07777;
+    } else {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0666 & ~mask;
+    }
+
+    size_t size_temp_file_name = strlen(dest_file_name) + sizeof(".XXXXXX");
+    char* temp_file_name = safe_malloc(size_temp_file_name);
+    snprintf(temp_file_name, size_temp_file_name, "%s.XXXXXX", dest_file_name);
+
+    bool is_written = write_temp_file_and_rename(temp_file_name, dest_file_name, mode, data, data_size, line_ending);
+    free(temp_file_name);
+    return is_written;
+}
+
+#endif // LINE_ENDING_H
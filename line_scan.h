@@ -0,0 +1,140 @@
+#ifndef LINE_SCAN_H
+#define LINE_SCAN_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+
+// byte search kernels used to find line boundaries without stepping through the text one character at a time
+// sse2 is used when available, with a portable swar (8 bytes at a time) fallback
+
+
+#ifndef __SSE2__
+#define LINE_SCAN_SWAR_ONES 0x0101010101010101ull
+#define LINE_SCAN_SWAR_HIGHS 0x8080808080808080ull
+
+
+// returns non zero if any byte of chunk is equal to the byte repeated in pattern
+static inline uint64_t line_scan_swar_has_byte(uint64_t chunk, uint64_t pattern) {
+    uint64_t diff = chunk ^ pattern;
+    return (diff - LINE_SCAN_SWAR_ONES) & ~diff & LINE_SCAN_SWAR_HIGHS;
+}
+#endif // __SSE2__
+
+
+// find the first byte in items[start, end)
+// returns false if there is none
+static inline bool line_scan_find_byte_forward(size_t* result, const char* items, size_t start, size_t end, char byte) {
+    size_t idx = start;
+
+#ifdef __SSE2__
+    const __m128i pattern = _mm_set1_epi8(byte);
+    for (; idx + 16 <= end; idx += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + idx));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+        if (mask) {
+            *result = idx + __builtin_ctz(mask);
+            return true;
+        }
+    }
+#else
+    for (; idx + 8 <= end; idx += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, items + idx, sizeof(chunk));
+        if (line_scan_swar_has_byte(chunk, LINE_SCAN_SWAR_ONES * (unsigned char)byte)) {
+            // exact position is found below
+            break;
+        }
+    }
+#endif // __SSE2__
+
+    for (; idx < end; idx++) {
+        if (items[idx] == byte) {
+            *result = idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// find the first \n in items[start, end)
+// returns false if there is none
+static inline bool line_scan_find_newline_forward(size_t* result, const char* items, size_t start, size_t end) {
+    return line_scan_find_byte_forward(result, items, start, end, '\n');
+}
+
+
+// find the last \n in items[start, end)
+// returns false if there is none
+static inline bool line_scan_find_newline_backward(size_t* result, const char* items, size_t start, size_t end) {
+    size_t idx = end;
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; idx >= start + 16; idx -= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + idx - 16));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (mask) {
+            *result = idx - 16 + (31 - __builtin_clz(mask));
+            return true;
+        }
+    }
+#else
+    for (; idx >= start + 8; idx -= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, items + idx - 8, sizeof(chunk));
+        if (line_scan_swar_has_byte(chunk, LINE_SCAN_SWAR_ONES * '\n')) {
+            // exact position is found below
+            break;
+        }
+    }
+#endif // __SSE2__
+
+    for (; idx > start; idx--) {
+        if (items[idx - 1] == '\n') {
+            *result = idx - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// count of \n in items[start, end)
+static inline size_t line_scan_count_newlines(const char* items, size_t start, size_t end) {
+    size_t count = 0;
+    size_t idx = start;
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; idx + 16 <= end; idx += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + idx));
+        count += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+    }
+#else
+    for (; idx + 8 <= end; idx += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, items + idx, sizeof(chunk));
+        // (the swar test can only tell if there is any \n, so the bytes of a chunk with one are counted below)
+        if (line_scan_swar_has_byte(chunk, LINE_SCAN_SWAR_ONES * '\n')) {
+            for (size_t idx_byte = idx; idx_byte < idx + 8; idx_byte++) {
+                count += items[idx_byte] == '\n';
+            }
+        }
+    }
+#endif // __SSE2__
+
+    for (; idx < end; idx++) {
+        count += items[idx] == '\n';
+    }
+    return count;
+}
+
+
+#endif // LINE_SCAN_H
@@ -6,15 +6,19 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <locale.h>
+#include <langinfo.h>
 
 #include "util.h"
 #include "editor.h"
 #include "text_box.h"
+#include "viewport.h"
+#include "input.h"
+#include "process_input.h"
 
 // TODO: rope?
 // TODO: copy/paste to/from system clipboard
 // TODO: set info text to say "copied", etc. when copying
-// TODO: utf-8
 // TODO: keyremapping at runtime
 // TODO: cursor for info text_box if text wraps
 // TODO: tab and carriage return characters being displayed
@@ -27,124 +31,187 @@
 // TODO: make way to pipe text into grep and jump to result, similar to :grep in vim
 
 
-static void draw_cursor(WINDOW* window, const Text_box* text_box) {
-    if (text_box->cursor_info.scroll.x > 0) {
-        assert(false && "not implemented");
-    }
+// drawing primitives of the selected backend (coordinates are relative to the window)
 
-    int64_t screen_x = Cursor_info_get_cursor_screen_x(&text_box->cursor_info);
-    int64_t screen_y = Cursor_info_get_cursor_screen_y(&text_box->cursor_info);
-    wmove(window, screen_y, screen_x);
+static void Text_win_clear(const Editor* editor, const Text_win* text_win) {
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        for (int idx_line = 0; idx_line < text_win->height; idx_line++) {
+            mvwprintw(text_win->window, idx_line, 0, "\n");
+        }
+        break;
+    case BACKEND_VT:
+        // whole screen is cleared at the start of the frame
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
 }
 
 
-static inline void highlight_text_in_area(
-    WINDOW* window,
-    const Text_box* main_box,
-    size_t vis_start,
-    size_t vis_end,
-    size_t scroll_offset,
-    size_t window_width,
-    size_t end_last_displayed_line,
-    MISC_INFO misc_info
-) {
-    if (misc_info & MISC_HAS_COLOR) {
-        attron(COLOR_PAIR(SEARCH_RESULT_PAIR));
+static void Text_win_put_str(Editor* editor, const Text_win* text_win, size_t y, size_t x, const char* str, size_t count) {
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        mvwaddnstr(text_win->window, y, x, str, count);
+        break;
+    case BACKEND_VT:
+        Vt_screen_put_str(&editor->vt, text_win->start_y + y, text_win->start_x + x, str, count);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
     }
+}
 
-    debug(
-        "VISUAL_PRINTING_THING: visual_sel_start: %zu; visual_sel_end: %zu; cursor: %zu; scroll_offset: %zu",
-        vis_start,
-        vis_end,
-        main_box->cursor_info.pos.cursor,
-        scroll_offset
-    );
 
-    Cursor_info* curr_visual = Cursor_info_get();
-
-    // highlight area between visual_start and cursor position (inclusive)
-    Cursor_info_cpy(curr_visual, &main_box->cursor_info);
-    
-    // move curr_visual to the start of the highlighted area
-    debug("visual_print_thing 34: curr_visual->scroll.scroll_offset: %zu; vis_start: %zu; vis_end: %zu", curr_visual->scroll.offset, vis_start, vis_end);
-    while (curr_visual->pos.cursor > vis_start && curr_visual->pos.cursor > scroll_offset) {
-        debug("highlight thing 1: y: %zu; x: %zu; cursor: %zu", curr_visual->pos.visual_y, curr_visual->pos.visual_x, curr_visual->pos.cursor);
-        CUR_DECRE_STATUS status = Pos_data_decrement_one(&curr_visual->pos, &main_box->string, window_width, true);
-        switch (status) {
-        case CUR_DEC_NORMAL:
-        case CUR_DEC_MOVED_TO_PREV_LINE:
-            break;
-        case CUR_DEC_AT_START_BUFFER: // fallthrough
-        case CUR_DEC_AT_START_CURR_LINE:
-            debug("start_curr_line: visual_y: %zu; cursor: %zu", curr_visual->pos.visual_y, curr_visual->pos.cursor);
-            break;
-        case CUR_DEC_ALREADY_AT_START_BUFFER: // fallthrough
-        case CUR_DEC_ERROR: 
-            log("fetal error");
-            abort();
-            break;
+static void Text_win_set_attr(Editor* editor, const Text_win* text_win, size_t y, size_t x, size_t count, VT_ATTR attr) {
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        if (attr & VT_ATTR_FG_MASK) {
+            mvwchgat(text_win->window, y, x, count, 0, SYNTAX_FIRST_PAIR + ((attr & VT_ATTR_FG_MASK) >> VT_ATTR_FG_SHIFT) - 1, NULL);
+        }
+        if (attr & VT_ATTR_HIGHLIGHT) {
+            mvwchgat(text_win->window, y, x, count, 0, SEARCH_RESULT_PAIR, NULL);
         }
+        if (attr & VT_ATTR_UNDERLINE) {
+            // (the color of the text is kept)
+            chtype curr = mvwinch(text_win->window, y, x);
+            mvwchgat(text_win->window, y, x, count, (curr & A_ATTRIBUTES & ~A_COLOR) | A_UNDERLINE, PAIR_NUMBER(curr), NULL);
+        }
+        if (attr & VT_ATTR_REVERSE) {
+            mvwchgat(text_win->window, y, x, count, A_REVERSE, 0, NULL);
+        }
+        break;
+    case BACKEND_VT:
+        Vt_screen_set_attr(&editor->vt, text_win->start_y + y, text_win->start_x + x, count, attr);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
     }
+}
 
-    // highlight area between visual_start and visual_end (inclusive)
-    while (curr_visual->pos.cursor < vis_end && curr_visual->pos.cursor < end_last_displayed_line) {
-        debug("highlight thing 2: y: %zu; x: %zu", curr_visual->pos.visual_y, curr_visual->pos.visual_x);
-        mvwchgat(
-            window,
-            Cursor_info_get_cursor_screen_y(curr_visual),
-            Cursor_info_get_cursor_screen_x(curr_visual),
-            1,
-            0,
-            SEARCH_RESULT_PAIR,
-            NULL
-        );
 
-        CUR_ADVANCE_STATUS status = Pos_data_advance_one(&curr_visual->pos, &main_box->string, window_width, true);
-        switch (status) {
-        case CUR_ADV_AT_START_NEXT_LINE: // fallthrough
-        case CUR_ADV_NORMAL:
-            break;
-        case CUR_ADV_PAST_END_BUFFER: //fallthrough
-        case CUR_ADV_ERROR: 
-            log("fetal error");
-            abort();
+static void draw_cursor(Editor* editor, const Text_win* text_win) {
+    const Text_box* text_box = text_win->text_box;
+
+    size_t screen_y;
+    size_t screen_x;
+    if (!Viewport_get_screen_yx(&screen_y, &screen_x, &text_win->viewport, &text_box->string, text_box->cursor_info.pos.cursor)) {
+        // cursor is not on the screen
+        return;
+    }
+
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        wmove(text_win->window, screen_y, screen_x);
+        break;
+    case BACKEND_VT:
+        Vt_screen_set_cursor(&editor->vt, text_win->start_y + screen_y, text_win->start_x + screen_x);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+}
+
+
+static inline void highlight_text_in_area(Editor* editor, const Text_win* text_win, size_t vis_start, size_t vis_end) {
+    const Viewport* viewport = &text_win->viewport;
+    if (viewport->rows.count < 1) {
+        return;
+    }
+
+    debug("VISUAL_PRINTING_THING: visual_sel_start: %zu; visual_sel_end: %zu", vis_start, vis_end);
+
+    // highlight area between visual_start and visual_end (inclusive), one segment per screen row
+    for (size_t idx_row = 0; idx_row < viewport->rows.count; idx_row++) {
+        const Visual_row* row = Viewport_row_at(viewport, idx_row);
+        if (row->start > vis_end) {
             break;
         }
+
+        // only the columns that are on the (horizontally scrolled) screen
+        // (vis_end is the start of the last highlighted character, which can be several bytes long; at the end of the
+        // text it is the column after the last character)
+        const String* string = &text_win->text_box->string;
+        size_t end_selected = vis_end < string->count ? get_end_of_char(string, vis_end) : vis_end + 1;
+        size_t screen_x_start;
+        size_t count_columns = Visual_row_get_screen_span(&screen_x_start, row, viewport, string, vis_start, end_selected);
+        if (count_columns < 1 || screen_x_start >= (size_t)text_win->width) {
+            continue;
+        }
+        count_columns = MIN(count_columns, (size_t)text_win->width - screen_x_start);
+        Text_win_set_attr(editor, text_win, idx_row, screen_x_start, count_columns, VT_ATTR_HIGHLIGHT);
     }
-    mvwchgat(
-        window,
-        Cursor_info_get_cursor_screen_y(curr_visual),
-        Cursor_info_get_cursor_screen_x(curr_visual),
-        1,
-        0,
-        SEARCH_RESULT_PAIR,
-        NULL
-    );
+}
+
 
-    free(curr_visual);
-    if (misc_info & MISC_HAS_COLOR) {
-        attroff(COLOR_PAIR(SEARCH_RESULT_PAIR));
+// color the highlighted parts of the text (spans were found for the rows of the viewport by Text_win_update_layout)
+// spans and rows are both sorted, so they are walked together
+static inline void highlight_syntax(Editor* editor, const Text_win* text_win) {
+    if (!(editor->misc_info & MISC_HAS_COLOR)) {
+        return;
+    }
+    const Viewport* viewport = &text_win->viewport;
+    const String* string = &text_win->text_box->string;
+    size_t idx_first_span = 0;
+    for (size_t idx_row = 0; idx_row < viewport->rows.count; idx_row++) {
+        const Visual_row* row = Viewport_row_at(viewport, idx_row);
+        // spans that end before this row also end before the rows after it
+        while (idx_first_span < text_win->spans.count && text_win->spans.items[idx_first_span].end <= row->draw_start) {
+            idx_first_span++;
+        }
+        for (size_t idx_span = idx_first_span; idx_span < text_win->spans.count; idx_span++) {
+            const Syntax_span* span = &text_win->spans.items[idx_span];
+            if (span->start >= row->draw_end) {
+                break;
+            }
+            size_t seg_start = MAX(span->start, row->draw_start);
+            size_t seg_end = MIN(span->end, row->draw_end);
+            if (seg_start >= seg_end) {
+                continue;
+            }
+            size_t screen_x_start = Visual_row_get_screen_x(row, viewport, string, seg_start);
+            size_t screen_x_end = Visual_row_get_screen_x(row, viewport, string, seg_end);
+            if (screen_x_start >= (size_t)text_win->width) {
+                continue;
+            }
+            Text_win_set_attr(
+                editor, text_win, idx_row, screen_x_start, MIN(screen_x_end, (size_t)text_win->width) - screen_x_start,
+                VT_ATTR_FG(syntax_kind_colors[span->kind])
+            );
+        }
     }
 }
 
 
-static inline void highlight_text_in_vis_area(WINDOW* window, const Text_box* main_box, size_t scroll_offset, size_t window_width, size_t end_last_displayed_line, MISC_INFO misc_info) {
-    size_t vis_start = Text_box_get_visual_sel_start(main_box);
-    size_t vis_end = Text_box_get_visual_sel_end(main_box);
-    highlight_text_in_area(window, main_box, vis_start, vis_end, scroll_offset, window_width, end_last_displayed_line, misc_info);
+// underline the bracket at the cursor and the one that matches it (if they are on the screen)
+static inline void highlight_matching_bracket(Editor* editor, const Text_win* text_win) {
+    if (!text_win->has_bracket_match) {
+        return;
+    }
+    size_t positions[2] = {text_win->bracket, text_win->bracket_match};
+    for (size_t idx = 0; idx < 2; idx++) {
+        size_t screen_y;
+        size_t screen_x;
+        if (Viewport_get_screen_yx(&screen_y, &screen_x, &text_win->viewport, &text_win->text_box->string, positions[idx])) {
+            Text_win_set_attr(editor, text_win, screen_y, screen_x, 1, VT_ATTR_UNDERLINE);
+        }
+    }
 }
 
 
-static inline bool highlight_search_result_if_nessessary(
-    WINDOW* nc_win,
-    const Text_box* text_box,
-    const String* query,
-    size_t scroll_offset,
-    size_t window_width,
-    size_t end_last_displayed_line,
-    MISC_INFO misc_info
-) {
+static inline void highlight_text_in_vis_area(Editor* editor, const Text_win* text_win) {
+    size_t vis_start = Text_box_get_visual_sel_start(text_win->text_box);
+    size_t vis_end = Text_box_get_visual_sel_end(text_win->text_box);
+    highlight_text_in_area(editor, text_win, vis_start, vis_end);
+}
+
 
+static inline bool highlight_search_result_if_nessessary(Editor* editor, const Text_win* text_win, const String* query) {
+    const Text_box* text_box = text_win->text_box;
     if (text_box->string.count - text_box->cursor_info.pos.cursor < query->count) {
         return false;
     }
@@ -163,74 +230,167 @@ static inline bool highlight_search_result_if_nessessary(
     }
 
     highlight_text_in_area(
-        nc_win,
-        text_box,
+        editor,
+        text_win,
         text_box->cursor_info.pos.cursor,
-        text_box->cursor_info.pos.cursor + query->count - 1,
-        scroll_offset,
-        window_width,
-        end_last_displayed_line,
-        misc_info
+        text_box->cursor_info.pos.cursor + query->count - 1
     );
 
     return true;
 }
 
 
-static void draw_window(Text_win* file_text, bool print_mvw_cursor, ED_STATE search_status, const String* query, MISC_INFO misc_info) {
-    const Text_box* text_box = &file_text->text_box;
-    WINDOW* nc_win = file_text->window;
+// copy string[start, end) to dest (start is at column visual_x of its visual line), so that the terminal draws it in 
+// the columns that the cursor functions expect: a tab becomes spaces up to the next tab stop, a control character
+// becomes ^ and a letter, invalid utf-8 and c1 control characters become U+FFFD, and a combining character that does
+// not follow another character gets a space to combine with
+static void String_cpy_drawable(String* dest, const String* string, size_t start, size_t end, size_t visual_x, size_t max_visual_width) {
+    dest->count = 0;
+    size_t idx = start;
+    while (idx < end) {
+        unsigned char curr_char = string->items[idx];
+        if (curr_char == '\t') {
+            size_t width = columns_tab_width(visual_x, max_visual_width);
+            for (size_t idx_space = 0; idx_space < width; idx_space++) {
+                String_append(dest, ' ');
+            }
+            visual_x += width;
+            idx++;
+            continue;
+        }
+        if (columns_is_control(curr_char)) {
+            String_append(dest, '^');
+            String_append(dest, columns_control_letter(curr_char));
+            visual_x += 2;
+            idx++;
+            continue;
+        }
+        if (curr_char < 0x80) {
+            String_append(dest, curr_char);
+            visual_x++;
+            idx++;
+            continue;
+        }
+
+        uint32_t code_point;
+        size_t len = utf8_decode(&code_point, string->items, idx, end);
+        if (code_point == UTF8_INVALID || (code_point >= 0x80 && code_point < 0xa0)) {
+            String_append_cstr(dest, UTF8_REPLACEMENT, UTF8_REPLACEMENT_LEN);
+            visual_x++;
+        } else {
+            size_t width = utf8_code_point_width(code_point);
+            if (width == 0 && (idx == start || (unsigned char)string->items[idx - 1] < ' ' || string->items[idx - 1] == 0x7f)) {
+                String_append(dest, ' ');
+                width = 1;
+            }
+            String_append_cstr(dest, string->items + idx, len);
+            visual_x += width;
+        }
+        idx += len;
+    }
+}
+
+
+// "..." after the header line of every closed fold (one column after the end of the line, so the cursor can be on it)
+static inline void draw_fold_markers(Editor* editor, const Text_win* text_win) {
+    static const char marker[] = "...";
+    const Viewport* viewport = &text_win->viewport;
+    const String* string = &text_win->text_box->string;
+    for (size_t idx_row = 0; idx_row < viewport->rows.count; idx_row++) {
+        const Visual_row* row = Viewport_row_at(viewport, idx_row);
+        if (!row->is_folded || row->draw_end < row->start + Visual_row_count_printable(row, string)) {
+            continue;
+        }
+        size_t screen_x = Visual_row_get_screen_x(row, viewport, string, row->draw_end) + 1;
+        if (screen_x >= (size_t)text_win->width) {
+            continue;
+        }
+        size_t count = MIN(sizeof(marker) - 1, (size_t)text_win->width - screen_x);
+        Text_win_put_str(editor, text_win, idx_row, screen_x, marker, count);
+        if (editor->misc_info & MISC_HAS_COLOR) {
+            Text_win_set_attr(editor, text_win, idx_row, screen_x, count, VT_ATTR_FG(syntax_kind_colors[SYNTAX_COMMENT]));
+        }
+    }
+}
+
 
-    if (text_box->cursor_info.scroll.x > 0) {
-        assert(false && "not implemented");
+// the other cursors of the document are drawn like the cursor (they are sorted, so only the ones on the screen are
+// looked at)
+static inline void draw_other_cursors(Editor* editor, const Text_win* text_win) {
+    const Vector_size_t* cursors = text_win->cursors;
+    const Viewport* viewport = &text_win->viewport;
+    if (!cursors || cursors->count < 1 || viewport->rows.count < 1) {
+        return;
     }
+    const String* string = &text_win->text_box->string;
+    size_t start_screen = Viewport_row_at(viewport, 0)->start;
+    size_t low = 0;
+    size_t high = cursors->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (cursors->items[mid] < start_screen) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    for (size_t idx = low; idx < cursors->count && cursors->items[idx] <= viewport->end; idx++) {
+        size_t screen_y;
+        size_t screen_x;
+        if (Viewport_get_screen_yx(&screen_y, &screen_x, viewport, string, cursors->items[idx])) {
+            Text_win_set_attr(editor, text_win, screen_y, screen_x, get_width_of_char(string, cursors->items[idx]), VT_ATTR_REVERSE);
+        }
+    }
+}
+
 
-    size_t scroll_offset;
-    scroll_offset = text_box->cursor_info.scroll.offset;
+static void draw_window(Editor* editor, Text_win* text_win, bool print_mvw_cursor) {
+    const Text_box* text_box = text_win->text_box;
 
 #ifdef DO_EXTRA_CHECKS
-    size_t scroll_offset_check;
-    Text_box_cal_index_scroll_offset(&scroll_offset_check, &main_box, window_width);
-    debug("scroll_offset: %zu; scroll_offset_check: %zu", scroll_offset, scroll_offset_check);
-    assert(scroll_offset == scroll_offset_check);
+    // (scroll.y can only be checked if it is counted from the start of the text)
+    if (!text_box->cursor_info.scroll.is_y_relative) {
+        size_t scroll_offset_check;
+        Text_box_cal_index_scroll_offset(&scroll_offset_check, &text_box->cursor_info.scroll, &text_box->string, Text_win_wrap_width(text_win));
+        debug("scroll_offset: %zu; scroll_offset_check: %zu", text_box->cursor_info.scroll.offset, scroll_offset_check);
+        assert(text_box->cursor_info.scroll.offset == scroll_offset_check);
+    }
 #endif
 
-    size_t end_last_displayed_line;
-    size_t count_lines_actually_displayed;
-    STATUS_GET_LAST_LINE status_get_last_line = get_end_last_displayed_visual_line_from_cursor(
-        &count_lines_actually_displayed,
-        &end_last_displayed_line,
-        text_box,
-        scroll_offset,
-        file_text->height,
-        file_text->width
-    );
-    if (!(status_get_last_line == STATUS_LAST_LINE_END_BUFFER || status_get_last_line == STATUS_LAST_LINE_SUCCESS)) {
-        abort();
-    }
+    // viewport was built by Text_win_update_layout (this is the only walk of the text done for this frame)
+    const Viewport* viewport = &text_win->viewport;
 
-    debug("end_last_displayed_line: %zu", end_last_displayed_line);
-    debug("draw_main_window: scroll_offset: %zu", scroll_offset);
+    debug("draw_main_window: scroll_offset: %zu; viewport end: %zu", text_box->cursor_info.scroll.offset, viewport->end);
     if (text_box->string.count > 0) {
         // clear characters on the window
-        for (int idx_line = 0; idx_line < file_text->height; idx_line++) {
-            mvwprintw(nc_win, idx_line, 0, "\n");
-        }
+        Text_win_clear(editor, text_win);
 
         // print actual characters
-        mvwprintw(
-            nc_win, 0, 0, "%.*s\n",
-            (int)((end_last_displayed_line + 1) - (scroll_offset)),
-            text_box->string.items + scroll_offset
-        );
+        // (only the slice of the row that is on the screen; rows can be very long if lines are not wrapped)
+        for (size_t idx_row = 0; idx_row < viewport->rows.count; idx_row++) {
+            const Visual_row* row = Viewport_row_at(viewport, idx_row);
+            if (row->draw_start >= row->draw_end) {
+                continue;
+            }
+            if (row->is_plain) {
+                Text_win_put_str(editor, text_win, idx_row, row->draw_x, text_box->string.items + row->draw_start, row->draw_end - row->draw_start);
+                continue;
+            }
+            String_cpy_drawable(&editor->draw_buf, &text_box->string, row->draw_start, row->draw_end, row->draw_visual_x, viewport->max_visual_width);
+            Text_win_put_str(editor, text_win, idx_row, row->draw_x, editor->draw_buf.items, editor->draw_buf.count);
+        }
+        draw_fold_markers(editor, text_win);
     }
 
+    highlight_syntax(editor, text_win);
+    highlight_matching_bracket(editor, text_win);
+
     switch (text_box->visual_sel.state) {
     case VIS_STATE_NONE:
         break;
     case VIS_STATE_ON: 
         // highlight current visual area
-        highlight_text_in_vis_area(nc_win, text_box, scroll_offset, file_text->width, end_last_displayed_line, misc_info);
+        highlight_text_in_vis_area(editor, text_win);
         break;
     default:
         log("internal error\n");
@@ -239,281 +399,132 @@ static void draw_window(Text_win* file_text, bool print_mvw_cursor, ED_STATE sea
 
 
     // highlight search result if nessessary
-    switch (search_status) {
+    switch (editor->state) {
     case STATE_SEARCH: {
-        highlight_search_result_if_nessessary(
-            nc_win,
-            text_box,
-            query,
-            scroll_offset,
-            file_text->width,
-            end_last_displayed_line,
-            misc_info
-        );
+        highlight_search_result_if_nessessary(editor, text_win, &editor->search_query.text_box->string);
     } break;
     default:
         break;
     }
 
     // draw cursor
+    draw_other_cursors(editor, text_win);
     if (print_mvw_cursor) {
-        mvwchgat(nc_win, 0, text_box->cursor_info.pos.cursor, 1, A_REVERSE, 0, NULL);
+        size_t screen_y;
+        size_t screen_x;
+        if (Viewport_get_screen_yx(&screen_y, &screen_x, viewport, &text_box->string, text_box->cursor_info.pos.cursor)) {
+            Text_win_set_attr(editor, text_win, screen_y, screen_x, get_width_of_char(&text_box->string, text_box->cursor_info.pos.cursor), VT_ATTR_REVERSE);
+        }
     }
 
-    // refresh windows
-    wrefresh(nc_win);
+    // refresh windows (the terminal itself is updated once all windows are drawn)
+    if (editor->backend == BACKEND_NCURSES) {
+        wnoutrefresh(text_win->window);
+    }
 }
 
 
-static void process_next_input(bool* should_resize_window, Editor* editor, bool* should_close) {
-    *should_resize_window = false;
-
-    Text_box* main_box = &editor->file_text.text_box;
-    Text_box* search_box = &editor->search_query.text_box;
-
-    switch (editor->state) {
-
-    case STATE_INSERT: {
-        int new_ch = wgetch(editor->file_text.window);
-        switch (new_ch) {
-        case KEY_RESIZE: {
-            *should_resize_window = true;
-        } break;
-        case ctrl('i'): {
-            editor->state = STATE_COMMAND;
-            String_cpy_from_cstr(&editor->general_info.text_box.string, COMMAND_TEXT, strlen(COMMAND_TEXT));
-        } break;
-        case ctrl('f'): {
-            editor->state = STATE_SEARCH;
-            String_cpy_from_cstr(&editor->general_info.text_box.string, SEARCH_TEXT, strlen(SEARCH_TEXT));
-        } break;
-        case ctrl('q'): {
-            Text_box_toggle_visual_mode(main_box);
-        } break;
-        case ctrl('s'): {
-            Editor_save(editor);
-        } break;
-        case ctrl('c'): {
-            Editor_cpy_selection(editor);
-        } break;
-        case ctrl('v'): {
-            Editor_paste_selection(editor);
-        } break;
-        case ctrl('z'): {
-            if (editor->actions.count < 1) {
-                const char* undo_failure_text = "already at oldest change";
-                String_cpy_from_cstr(&editor->general_info.text_box.string, undo_failure_text, strlen(undo_failure_text));
-                editor->gen_info_state = GEN_INFO_OLDEST_CHANGE;
-                break;
-            }
-            Editor_undo(editor, editor->file_text.width, editor->file_text.height);
-        } break;
-        case ctrl('y'): {
-            if (editor->undo_actions.count < 1) {
-                const char* redo_failure_text = "already at newest change";
-                String_cpy_from_cstr(&editor->general_info.text_box.string, redo_failure_text, strlen(redo_failure_text));
-                editor->gen_info_state = GEN_INFO_NEWEST_CHANGE;
-                break;
-            }
-            Editor_redo(editor, editor->file_text.width, editor->file_text.height);
-        } break;
-        case KEY_LEFT: {
-            Text_box_move_cursor(main_box, DIR_LEFT, editor->file_text.width, editor->file_text.height, false);
-        } break;
-        case KEY_RIGHT: {
-            Text_box_move_cursor(main_box, DIR_RIGHT, editor->file_text.width, editor->file_text.height, false);
-        } break;
-        case KEY_UP: {
-            Text_box_move_cursor(main_box, DIR_UP, editor->file_text.width, editor->file_text.height, false);
-        } break;
-        case KEY_DOWN: {
-            Text_box_move_cursor(main_box, DIR_DOWN, editor->file_text.width, editor->file_text.height, false);
-        } break;
-        case KEY_BACKSPACE: {
-            if (main_box->cursor_info.pos.cursor > 0) {
-                Editor_del_main_file_text(editor, editor->file_text.width, editor->file_text.height);
-            }
-        } break;
-        case KEY_ENTER: {
-            String new_str;
-            String_init(&new_str);
-            String_append(&new_str, '\n');
-            Editor_insert_into_main_file_text(editor, &new_str, main_box->cursor_info.pos.cursor, editor->file_text.width, editor->file_text.height);
-            String_free_char_data(&new_str);
-        } break;
-        default: {
-            String new_str;
-            String_init(&new_str);
-            String_append(&new_str, new_ch);
-            Editor_insert_into_main_file_text(editor, &new_str, main_box->cursor_info.pos.cursor, editor->file_text.width, editor->file_text.height);
-            String_free_char_data(&new_str);
-        } break;
-    } break;
+// the window of a split that is not focused is drawn with its own cursor (see Editor_swap_split_cursor_info)
+static void draw_split(Editor* editor) {
+    if (editor->split == SPLIT_NONE) {
+        return;
     }
-
-    case STATE_SEARCH: {
-        int new_ch = wgetch(editor->file_text.window);
-        switch (new_ch) {
-        case KEY_RESIZE: {
-            *should_resize_window = true;
-        } break;
-        case ctrl('i'): {
-            editor->state = STATE_INSERT;
-            String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
-        } break;
-        case ctrl('f'): {
-            editor->state = STATE_INSERT;
-            String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
-        } break;
-        case ctrl('s'): {
-            assert(false && "not implemented");
-            //editor_save(editor);
-        } break;
-        case KEY_LEFT: {
-            Text_box_move_cursor(search_box, DIR_LEFT, editor->general_info.width, editor->file_text.height, false);
-        } break;
-        case KEY_RIGHT: {
-            Text_box_move_cursor(search_box, DIR_RIGHT, editor->general_info.width, editor->file_text.height, false);
-        } break;
-        case KEY_UP: {
-            //assert(false && "not implemented");
-        } break;
-        case KEY_DOWN: {
-            //assert(false && "not implemented");
-        } break;
-        case KEY_BACKSPACE: {
-            if (editor->search_query.text_box.cursor_info.pos.cursor > 0) {
-                Text_box_del_ch(&editor->search_query.text_box, editor->search_query.text_box.cursor_info.pos.cursor - 1, editor->file_text.width, editor->file_text.height);
-            }
-        } break;
-        case ctrl('n'): // fallthrough
-        case KEY_ENTER: // fallthrough
-        case '\n': { 
-            debug("search before: cursor: %zu", main_box->cursor_info.pos.cursor);
-            switch (editor->search_status) {
-            case SEARCH_FIRST:
-                break;
-            case SEARCH_REPEAT:
-                // move cursor by one to avoid getting the same search result again if there are multiple search results
-                Text_box_move_cursor(main_box, DIR_RIGHT, editor->file_text.width, editor->file_text.height, true);
-                break;
-            default:
-                assert(false && "unreachable");
-                abort();
-            }
-            debug("search after part 1: cursor: %zu", main_box->cursor_info.pos.cursor);
-            if (Text_box_do_search(
-                main_box,
-                &search_box->string,
-                SEARCH_DIR_FORWARDS,
-                editor->file_text.width,
-                editor->file_text.height
-            )) {
-                debug("search yes");
-                editor->search_status = SEARCH_REPEAT;
-                String_cpy_from_cstr(&editor->general_info.text_box.string, SEARCH_TEXT, strlen(SEARCH_TEXT));
-            } else {
-                debug("search no");
-                String_cpy_from_cstr(&editor->general_info.text_box.string, SEARCH_FAILURE_TEXT, strlen(SEARCH_FAILURE_TEXT));
-            }
-            debug("search end: cursor: %zu", main_box->cursor_info.pos.cursor);
-            //editor->state = STATE_INSERT;
-            //String_cpy_from_cstr(&editor->general_info.box.str, insert_text, strlen(insert_text));
-        } break;
-        case ctrl('p'): {
-            switch (editor->search_status) {
-            case SEARCH_FIRST:
-                break;
-            case SEARCH_REPEAT:
-                Text_box_move_cursor(main_box, DIR_LEFT, editor->file_text.width, editor->file_text.height, true);
-                break;
-            default:
-                assert(false && "unreachable");
-                abort();
-            }
-            if (Text_box_do_search(
-                    main_box,
-                    &editor->search_query.text_box.string,
-                    SEARCH_DIR_BACKWARDS,
-                    editor->file_text.width,
-                    editor->file_text.height
-                )) {
-                editor->search_status = SEARCH_REPEAT;
-                String_cpy_from_cstr(&editor->general_info.text_box.string, SEARCH_TEXT, strlen(SEARCH_TEXT));
-            } else {
-                String_cpy_from_cstr(&editor->general_info.text_box.string, SEARCH_FAILURE_TEXT, strlen(SEARCH_FAILURE_TEXT));
-            }
-        } break;
-        default: {
-            Text_box_insert_ch(&editor->search_query.text_box, new_ch, editor->search_query.text_box.cursor_info.pos.cursor, editor->file_text.width, editor->file_text.height);
-        } break;
+    Editor_swap_split_cursor_info(editor);
+    draw_window(editor, &editor->split_text, false);
+    Editor_swap_split_cursor_info(editor);
+
+    int start_y, start_x, height, width;
+    Editor_get_split_border(editor, &start_y, &start_x, &height, &width);
+    char border = editor->split == SPLIT_HORIZONTAL ? '-' : '|';
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        if (editor->split == SPLIT_HORIZONTAL) {
+            mvwhline(editor->split_border, 0, 0, border, width);
+        } else {
+            mvwvline(editor->split_border, 0, 0, border, height);
         }
-    } break;
-
-    case STATE_COMMAND: {
-        int new_ch = wgetch(editor->file_text.window);
-        switch (new_ch) {
-        case KEY_RESIZE: {
-            *should_resize_window = true;
-        } break;
-        case 'q': {
-            if (editor->unsaved_changes) {
-                editor->state = STATE_QUIT_CONFIRM;
-                String_cpy_from_cstr(&editor->general_info.text_box.string, QUIT_CONFIRM_TEXT, strlen(QUIT_CONFIRM_TEXT));
-            } else {
-                *should_close = true;
+        wnoutrefresh(editor->split_border);
+        break;
+    case BACKEND_VT:
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                Vt_screen_put_str(&editor->vt, start_y + y, start_x + x, &border, 1);
             }
-        } break;
-        case ctrl('i'): // fallthrough
-        case KEY_BACKSPACE: {
-            editor->state = STATE_INSERT;
-            String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
-        } break;
-        case 'w':   // fallthrough
-        case 's':   // fallthrough
-        case ctrl('s'): {
-            Editor_save(editor);
-        } break;
-        case 27: {
-            //nodelay(window, true);
-            //
-            log("warning: keys with escape sequence (unimplemented) pressed in command mode\n");
-            //if (-1 == getch()) { /* esc */
-            //    text->state = state_insert;
-            //} else {
-            //    log("warning: alt key (unimplemented) pressed in command mode\n");
-            //}
-            //nodelay(window, false);
-        } break;
-        default: {
-            log("warning: unsupported key pressed in command mode\n");
-        } break;
         }
-    } break;
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+}
 
-    case STATE_QUIT_CONFIRM: {
-        int new_ch = wgetch(editor->file_text.window);
-        switch (new_ch) {
-        case 'y': //fallthrough
-        case 'Y': {
-            *should_close = true;
-        } break;
-        default:
-            editor->state = STATE_INSERT;
-            String_cpy_from_cstr(&editor->general_info.text_box.string, INSERT_TEXT, strlen(INSERT_TEXT));
-        } break;
-    } break;
+
+// start of every frame
+static void Editor_clear_screen(Editor* editor) {
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        clear();    // erase();
+        break;
+    case BACKEND_VT:
+        Vt_screen_clear(&editor->vt);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
     }
 }
 
 
-static void parse_args(Editor* editor, int argc, char** argv) {
-    int curr_arg_idx = 1;
-    if (curr_arg_idx > 2) {
-        todo("not implemented");
+// send the frame to the terminal
+static void Editor_flush_screen(Editor* editor) {
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        doupdate();
+        break;
+    case BACKEND_VT:
+        Vt_screen_flush(&editor->vt);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
     }
-    for (;curr_arg_idx < argc; curr_arg_idx++) {
-        editor->file_name = argv[curr_arg_idx];
+}
+
+
+static void parse_args(Editor* editor, int argc, char** argv) {
+    for (int curr_arg_idx = 1; curr_arg_idx < argc; curr_arg_idx++) {
+        const char* curr_arg = argv[curr_arg_idx];
+        if (0 == strcmp(curr_arg, "--vt")) {
+            editor->backend = BACKEND_VT;
+        } else if (0 == strcmp(curr_arg, "--no-wrap")) {
+            editor->file_text.no_wrap = true;
+        } else if (0 == strcmp(curr_arg, "--timing")) {
+            editor->timing.enabled = true;
+        } else if (0 == strcmp(curr_arg, "--slow-key-ms")) {
+            if (curr_arg_idx + 1 >= argc) {
+                log("error: --slow-key-ms requires a value in milliseconds");
+                continue;
+            }
+            curr_arg_idx++;
+            editor->timing.enabled = true;
+            editor->timing.slow_key_threshold_ns = (uint64_t)(strtod(argv[curr_arg_idx], NULL) * 1e6);
+        } else if (0 == strcmp(curr_arg, "--tab-width")) {
+            if (curr_arg_idx + 1 >= argc) {
+                log("error: --tab-width requires a count of columns");
+                continue;
+            }
+            curr_arg_idx++;
+            long new_tab_width = strtol(argv[curr_arg_idx], NULL, 10);
+            if (new_tab_width < 1 || new_tab_width > TAB_WIDTH_MAX) {
+                log("error: --tab-width must be from 1 to %d", TAB_WIDTH_MAX);
+                continue;
+            }
+            tab_width = (size_t)new_tab_width;
+        } else if (!editor->document->file_name) {
+            editor->document->file_name = curr_arg;
+        } else {
+            Editor_add_document(editor, curr_arg);
+        }
     }
 }
 
@@ -616,9 +627,1329 @@ void test_get_index_start_next_line(void) {
 }
 
 
+void test_template_Viewport_build(const char* text, size_t max_visual_width, size_t row_idx, size_t expected_start, size_t expected_count) {
+    String string;
+    String_init(&string);
+    String_cpy_from_cstr(&string, text, strlen(text));
+    Scroll_data scroll = {0};
+    Viewport viewport;
+    Viewport_init(&viewport);
+
+    Viewport_build(&viewport, &string, &scroll, 100, max_visual_width, 100);
+    assert(row_idx < viewport.rows.count && "test failed");
+    assert(Viewport_row_at(&viewport, row_idx)->start == expected_start && "test failed");
+    assert(Viewport_row_at(&viewport, row_idx)->count == expected_count && "test failed");
+    assert(Viewport_row_at(&viewport, row_idx)->visual_y == row_idx && "test failed");
+
+    Viewport_free(&viewport);
+    String_free_char_data(&string);
+}
+
+
+void test_Viewport_build(void) {
+    test_template_Viewport_build("hello\nworld", 100, 0, 0, 6);
+    test_template_Viewport_build("hello\nworld", 100, 1, 6, 5);
+    test_template_Viewport_build("hello\n\nworld\n", 100, 1, 6, 1);
+    test_template_Viewport_build("hello\n\nworld\n", 100, 2, 7, 6);
+
+    // wrapped lines
+    test_template_Viewport_build("hello world\n", 4, 0, 0, 4);
+    test_template_Viewport_build("hello world\n", 4, 1, 4, 4);
+    test_template_Viewport_build("hello world\n", 4, 2, 8, 4);
+
+    // lines are not wrapped
+    test_template_Viewport_build("hello world\nend", TEXT_BOX_NO_WRAP, 0, 0, 12);
+    test_template_Viewport_build("hello world\nend", TEXT_BOX_NO_WRAP, 1, 12, 3);
+}
+
+
+// columns highlighted on row row_idx for string[start, end) (the line ending, and the end of the text, are one column)
+void test_template_highlight(const char* text, size_t max_visual_width, size_t row_idx, size_t start, size_t end, size_t expected_x, size_t expected_count) {
+    String string;
+    String_init(&string);
+    String_cpy_from_cstr(&string, text, strlen(text));
+    Scroll_data scroll = {0};
+    Viewport viewport;
+    Viewport_init(&viewport);
+
+    Viewport_build(&viewport, &string, &scroll, 100, max_visual_width, 100);
+    assert(row_idx < viewport.rows.count && "test failed");
+    size_t screen_x;
+    size_t count_columns = Visual_row_get_screen_span(&screen_x, Viewport_row_at(&viewport, row_idx), &viewport, &string, start, end);
+    assert(count_columns == expected_count && (count_columns < 1 || screen_x == expected_x) && "test failed");
+
+    Viewport_free(&viewport);
+    String_free_char_data(&string);
+}
+
+
+void test_highlight(void) {
+    test_template_highlight("hello\nworld", 100, 0, 1, 3, 1, 2);
+    test_template_highlight("hello\nworld", 100, 0, 3, 8, 3, 3);
+    test_template_highlight("hello\nworld", 100, 1, 3, 8, 0, 2);
+
+    // a selection up to the end of the text includes the column after the last character
+    test_template_highlight("hello\nworld", 100, 1, 9, 12, 3, 3);
+    test_template_highlight("hello\nworld", 100, 1, 11, 12, 5, 1);
+    test_template_highlight("hello\n", 100, 0, 0, 7, 0, 7);
+    test_template_highlight("hello world", 4, 2, 10, 12, 2, 2);
+    test_template_highlight("hello world", 4, 1, 7, 12, 3, 1);
+    test_template_highlight("hello\n\xc3\xa9", TEXT_BOX_NO_WRAP, 1, 6, 9, 0, 2);
+}
+
+
+// reference for the line scanning kernels: step one character at a time until the next line is reached
+bool test_step_to_start_next_line(Pos_data* result, const String* string, const Pos_data* init_pos, size_t max_visual_width, bool is_visual) {
+    Pos_data curr_pos = *init_pos;
+    while (1) {
+        switch (Pos_data_advance_one(&curr_pos, string, max_visual_width, is_visual)) {
+        case CUR_ADV_NORMAL:
+            break;
+        case CUR_ADV_AT_START_NEXT_LINE:
+            *result = curr_pos;
+            return true;
+        case CUR_ADV_PAST_END_BUFFER: // fallthrough
+        case CUR_ADV_ERROR:
+            return false;
+        }
+    }
+}
+
+
+void test_template_line_scan(const char* text, size_t max_visual_width) {
+    String string;
+    String_init(&string);
+    String_cpy_from_cstr(&string, text, strlen(text));
+
+    for (size_t cursor = 0; cursor <= string.count; cursor++) {
+        for (size_t visual_x = 0; visual_x < max_visual_width; visual_x++) {
+            for (int is_visual = 0; is_visual < 2; is_visual++) {
+                Pos_data init_pos = {.cursor = cursor, .visual_x = visual_x, .visual_y = 3};
+                Pos_data expected = {0};
+                Pos_data result = {0};
+                bool expected_status = test_step_to_start_next_line(&expected, &string, &init_pos, max_visual_width, is_visual);
+                bool status = get_start_next_generic_line_from_curr_cursor_x_pos(&result, &string, &init_pos, max_visual_width, is_visual);
+                assert(status == expected_status && "test failed");
+                if (status) {
+                    assert(0 == memcmp(&result, &expected, sizeof(result)) && "test failed");
+                }
+            }
+        }
+    }
+
+    for (size_t start = 0; start <= string.count; start++) {
+        for (size_t end = start; end <= string.count; end++) {
+            size_t expected_forward = end;
+            for (size_t idx = start; idx < end && expected_forward == end; idx++) {
+                if (string.items[idx] == '\n') {
+                    expected_forward = idx;
+                }
+            }
+            size_t result;
+            bool status = line_scan_find_newline_forward(&result, string.items, start, end);
+            assert(status == (expected_forward < end) && (!status || result == expected_forward) && "test failed");
+
+            size_t expected_backward = end;
+            for (size_t idx = end; idx > start && expected_backward == end; idx--) {
+                if (string.items[idx - 1] == '\n') {
+                    expected_backward = idx - 1;
+                }
+            }
+            status = line_scan_find_newline_backward(&result, string.items, start, end);
+            assert(status == (expected_backward < end) && (!status || result == expected_backward) && "test failed");
+        }
+    }
+
+    String_free_char_data(&string);
+}
+
+
+void test_line_scan(void) {
+    test_template_line_scan("hello\nworld", 4);
+    test_template_line_scan("\n\nhel\rlo\nworld\n", 3);
+    test_template_line_scan("a long line that is longer than sixteen characters\nand a second one, also longer\n\nend", 7);
+    test_template_line_scan("a long line that is longer than sixteen characters without a line ending at all", 20);
+}
+
+
+void test_no_wrap(void) {
+    String string;
+    String_init(&string);
+    const char* text = "a line that is much longer than the width of the screen\nsecond\n";
+    String_cpy_from_cstr(&string, text, strlen(text));
+
+    Pos_data init_pos = {.cursor = 3, .visual_x = 3, .visual_y = 0};
+    Pos_data result;
+    assert(get_start_next_visual_line_from_curr_cursor_x(&result, &string, &init_pos, TEXT_BOX_NO_WRAP) && "test failed");
+    assert(result.cursor == 56 && result.visual_x == 0 && result.visual_y == 1 && "test failed");
+    assert(cal_visual_x_at_cursor(&string, 50, TEXT_BOX_NO_WRAP) == 50 && "test failed");
+    assert(cal_visual_y_at_cursor(&string, 60, TEXT_BOX_NO_WRAP) == 1 && "test failed");
+
+    Scroll_data scroll = {0};
+    Pos_data pos = {.cursor = 50, .visual_x = 50, .visual_y = 0};
+    Scroll_data_scroll_x_to_cursor(&scroll, &pos, 20);
+    assert(scroll.x == 31 && "test failed");
+    pos.visual_x = 10;
+    Scroll_data_scroll_x_to_cursor(&scroll, &pos, 20);
+    assert(scroll.x == 10 && "test failed");
+
+    String_free_char_data(&string);
+}
+
+
+// reference for jumping to the end of the file: step one character at a time (scrolling one line at a time)
+void test_walk_to_end_of_file(Cursor_info* cursor_info, const String* string, size_t max_visual_width, size_t max_visual_height) {
+    while (1) {
+        switch (Pos_data_advance_one(&cursor_info->pos, string, max_visual_width, true)) {
+        case CUR_ADV_AT_START_NEXT_LINE:
+            Scroll_data_scroll_screen_down_one(&cursor_info->scroll, &cursor_info->pos, string, max_visual_width, max_visual_height);
+            break;
+        case CUR_ADV_NORMAL:
+            break;
+        case CUR_ADV_PAST_END_BUFFER: // fallthrough
+        case CUR_ADV_ERROR:
+            return;
+        }
+    }
+}
+
+
+void test_template_jump(const char* text, size_t max_visual_width, size_t max_visual_height) {
+    Text_box text_box;
+    Text_box_init(&text_box);
+    String_cpy_from_cstr(&text_box.string, text, strlen(text));
+
+    for (size_t count_moves = 0; count_moves <= text_box.string.count; count_moves++) {
+        Cursor_info expected;
+        Cursor_info_init(&expected);
+        Text_box_move_cursor_repeat(&text_box, DIR_RIGHT, count_moves, max_visual_width, max_visual_height, false);
+        Cursor_info_cpy(&expected, &text_box.cursor_info);
+        test_walk_to_end_of_file(&expected, &text_box.string, max_visual_width, max_visual_height);
+
+        Cursor_info result = text_box.cursor_info;
+        Cursor_info_move_cursor_to_end_of_file(&result, &text_box.string, max_visual_width, max_visual_height);
+        assert(result.pos.cursor == expected.pos.cursor && "test failed");
+        assert(result.pos.visual_x == expected.pos.visual_x && "test failed");
+        assert(result.scroll.offset == expected.scroll.offset && "test failed");
+        assert(result.pos.visual_y - result.scroll.y == expected.pos.visual_y - expected.scroll.y && "test failed");
+
+        // end of the visual line is where moving right leaves the line
+        Cursor_info end_line = text_box.cursor_info;
+        Cursor_info_move_cursor_to_end_of_line(&end_line, &text_box.string, max_visual_width);
+        Text_box walk_box = text_box;
+        while (1) {
+            Cursor_info prev = walk_box.cursor_info;
+            Text_box_move_cursor(&walk_box, DIR_RIGHT, max_visual_width, max_visual_height, false);
+            if (walk_box.cursor_info.pos.visual_y != prev.pos.visual_y || walk_box.cursor_info.pos.cursor == prev.pos.cursor) {
+                assert(end_line.pos.cursor == prev.pos.cursor && end_line.pos.visual_x == prev.pos.visual_x && "test failed");
+                break;
+            }
+        }
+
+        Cursor_info_init(&text_box.cursor_info);
+    }
+
+    // go to line, then back up to the start of the file with page up
+    Cursor_info_move_cursor_to_line(&text_box.cursor_info, &text_box.string, 2, max_visual_width, max_visual_height);
+    size_t start_line_2 = text_box.cursor_info.pos.cursor;
+    assert(text_box.cursor_info.pos.visual_x == 0 && "test failed");
+    assert(start_line_2 == 0 || text_box.string.items[start_line_2 - 1] == '\n');
+    for (size_t idx = 0; idx < text_box.string.count && text_box.cursor_info.pos.cursor > 0; idx++) {
+        Cursor_info_move_page_up(&text_box.cursor_info, &text_box.string, max_visual_width, max_visual_height);
+    }
+    assert(text_box.cursor_info.pos.cursor == 0 && text_box.cursor_info.scroll.offset == 0 && "test failed");
+
+    Text_box_free(&text_box);
+}
+
+
+void test_jump(void) {
+    const char* texts[] = {
+        "",
+        "hello",
+        "hello\n",
+        "hello\nworld\r\nabc\r",
+        "a line that is longer than the width\nshort\n\nanother long line of text here\nend",
+        "abcd\nabcdefgh\nabc",
+    };
+    for (size_t idx = 0; idx < sizeof(texts)/sizeof(texts[0]); idx++) {
+        for (size_t width = 1; width <= 6; width++) {
+            for (size_t height = 1; height <= 4; height++) {
+                test_template_jump(texts[idx], width, height);
+            }
+        }
+        test_template_jump(texts[idx], TEXT_BOX_NO_WRAP, 3);
+    }
+}
+
+
+// several moves in the same direction, merged into one, end where the moves one at a time end
+void test_template_move_repeat(const char* text, size_t max_visual_width, size_t max_visual_height) {
+    Text_box text_box;
+    Text_box_init(&text_box);
+    String_cpy_from_cstr(&text_box.string, text, strlen(text));
+
+    static const DIRECTION directions[] = {DIR_RIGHT, DIR_DOWN, DIR_LEFT, DIR_UP};
+    uint32_t random = 7;
+    for (size_t idx = 0; idx < 300; idx++) {
+        random = random * 1103515245u + 12345u;
+        DIRECTION direction = directions[(random >> 8) % 4];
+        size_t count_moves = 2 + (random >> 16) % 12;
+
+        Cursor_info start;
+        Cursor_info_cpy(&start, &text_box.cursor_info);
+        for (size_t idx_move = 0; idx_move < count_moves; idx_move++) {
+            Text_box_move_cursor(&text_box, direction, max_visual_width, max_visual_height, false);
+        }
+        Cursor_info expected;
+        Cursor_info_cpy(&expected, &text_box.cursor_info);
+
+        Cursor_info_cpy(&text_box.cursor_info, &start);
+        Text_box_move_cursor_repeat(&text_box, direction, count_moves, max_visual_width, max_visual_height, false);
+        const Cursor_info* result = &text_box.cursor_info;
+        assert(result->pos.cursor == expected.pos.cursor && result->pos.visual_x == expected.pos.visual_x && "test failed");
+        assert(result->scroll.offset == expected.scroll.offset && result->scroll.user_max_col == expected.scroll.user_max_col && "test failed");
+        assert(result->pos.visual_y - result->scroll.y == expected.pos.visual_y - expected.scroll.y && "test failed");
+    }
+
+    Text_box_free(&text_box);
+}
+
+
+void test_move_repeat(void) {
+    const char* texts[] = {
+        "hello\nworld\r\nabc\r",
+        "a line that is longer than the width\nshort\n\nanother long line of text here\nend",
+        "abcd\nabcdefgh\nabc\n\n\n",
+        "h\xc3\xa9llo we\xcc\x81rld\n\xe4\xb8\xad\xe6\x96\x87\xe4\xb8\xad\xe6\x96\x87\n\xf0\x9f\x98\x80 x",
+        "a\tb\tc\n\tx\n\t\tlonger\tline\twith\ttabs",
+    };
+    for (size_t idx = 0; idx < sizeof(texts)/sizeof(texts[0]); idx++) {
+        for (size_t width = 2; width <= 7; width++) {
+            for (size_t height = 2; height <= 5; height++) {
+                test_template_move_repeat(texts[idx], width, height);
+            }
+        }
+        test_template_move_repeat(texts[idx], TEXT_BOX_NO_WRAP, 3);
+    }
+}
+
+
+// resize from old_width to new_width with the cursor on every position of the text
+void test_template_rewrap(const char* text, size_t old_width, size_t new_width, size_t max_visual_height) {
+    Text_box text_box;
+    Text_box_init(&text_box);
+    String_cpy_from_cstr(&text_box.string, text, strlen(text));
+
+    for (size_t count_moves = 0; count_moves <= text_box.string.count; count_moves++) {
+        Cursor_info_init(&text_box.cursor_info);
+        Text_box_move_cursor_repeat(&text_box, DIR_RIGHT, count_moves, old_width, max_visual_height, false);
+        size_t old_offset = text_box.cursor_info.scroll.offset;
+
+        Text_box_recalculate_visual_xy_and_scroll_offset(&text_box, new_width, max_visual_height);
+        const Cursor_info* result = &text_box.cursor_info;
+        const String* string = &text_box.string;
+        assert(result->pos.visual_x == cal_visual_x_at_cursor(string, result->pos.cursor, new_width) && "test failed");
+
+        // first character on the screen stays on the screen, unless the screen has to follow the cursor down
+        size_t screen_y = result->pos.visual_y - result->scroll.y;
+        assert((result->scroll.offset <= old_offset || screen_y == max_visual_height - 2) && "test failed");
+
+        // cursor is on the screen, and its row matches the row counted from the start of the text
+        assert(screen_y < max_visual_height && "test failed");
+        size_t expected_screen_y = cal_visual_y_at_cursor(string, result->pos.cursor, new_width) - 
+            cal_visual_y_at_cursor(string, result->scroll.offset, new_width);
+        assert(screen_y == expected_screen_y && "test failed");
+        if (!result->scroll.is_y_relative) {
+            assert(result->pos.visual_y == cal_visual_y_at_cursor(string, result->pos.cursor, new_width) && "test failed");
+        }
+    }
+
+    Text_box_free(&text_box);
+}
+
+
+void test_rewrap_text(const char* text) {
+    for (size_t old_width = 1; old_width <= 5; old_width++) {
+        for (size_t new_width = 1; new_width <= 5; new_width++) {
+            for (size_t height = 2; height <= 4; height++) {
+                test_template_rewrap(text, old_width, new_width, height);
+            }
+        }
+    }
+}
+
+
+void test_rewrap(void) {
+    const char* texts[] = {
+        "",
+        "hello\n",
+        "hello\nworld\r\nabc\r",
+        "a line that is longer than the width\nshort\n\nanother long line of text here\nend",
+        "abcd\nabcdefgh\nabc",
+    };
+    for (size_t idx = 0; idx < sizeof(texts)/sizeof(texts[0]); idx++) {
+        test_rewrap_text(texts[idx]);
+    }
+}
+
+
+// move right through the whole text, then back left, at every width; every stop must be at the start of a character,
+// with visual_x and visual_y matching the ones counted from the start of the text
+void test_template_utf8_walk(const char* text, size_t max_visual_width) {
+    Text_box text_box;
+    Text_box_init(&text_box);
+    String_cpy_from_cstr(&text_box.string, text, strlen(text));
+    const String* string = &text_box.string;
+    Cursor_info* cursor_info = &text_box.cursor_info;
+
+    size_t stops[64];
+    size_t count_stops = 0;
+    while (1) {
+        size_t cursor = cursor_info->pos.cursor;
+        assert(count_stops < sizeof(stops)/sizeof(stops[0]));
+        stops[count_stops++] = cursor;
+        if (cursor < string->count) {
+            assert(cursor_info->pos.visual_x == cal_visual_x_at_cursor(string, cursor, max_visual_width) && "test failed");
+            assert(cursor_info->pos.visual_y == cal_visual_y_at_cursor(string, cursor, max_visual_width) && "test failed");
+        }
+        Cursor_info_move_cursor_right(cursor_info, string, max_visual_width, 1000, false);
+        if (cursor_info->pos.cursor == cursor) {
+            break;
+        }
+        assert(cursor_info->pos.cursor > cursor && "test failed");
+    }
+    assert(stops[count_stops - 1] == get_end_of_text(string, max_visual_width) && "test failed");
+
+    for (size_t idx = count_stops - 1; idx > 0; idx--) {
+        Cursor_info_move_cursor_left(cursor_info, string, max_visual_width, 1000, false);
+        assert(cursor_info->pos.cursor == stops[idx - 1] && "test failed");
+        assert(cursor_info->pos.visual_x == cal_visual_x_at_cursor(string, stops[idx - 1], max_visual_width) && "test failed");
+    }
+
+    // move down and up from every stop
+    for (size_t idx = 0; idx < count_stops; idx++) {
+        for (DIRECTION direction = DIR_UP; direction <= DIR_DOWN; direction++) {
+            Cursor_info_init(cursor_info);
+            for (size_t idx_move = 0; idx_move < idx; idx_move++) {
+                Cursor_info_move_cursor_right(cursor_info, string, max_visual_width, 1000, false);
+            }
+            Text_box_move_cursor(&text_box, direction, max_visual_width, 1000, false);
+            size_t cursor = cursor_info->pos.cursor;
+            if (cursor < string->count) {
+                assert(cursor_info->pos.visual_x == cal_visual_x_at_cursor(string, cursor, max_visual_width) && "test failed");
+                assert(cursor_info->pos.visual_y == cal_visual_y_at_cursor(string, cursor, max_visual_width) && "test failed");
+            }
+            assert(cursor_info->pos.visual_x <= cursor_info->scroll.user_max_col && "test failed");
+        }
+    }
+
+    Text_box_free(&text_box);
+}
+
+
+void test_utf8(void) {
+    // e with combining acute accent is one cell; the two cjk characters are two columns each
+    const char* mixed = "a\xc3\xa9" "e\xcc\x81" "\xe4\xb8\xad\xe6\x96\x87" "b\n\xf0\x9f\x98\x80x\xffy\n";
+    assert(columns_count(mixed, 0, 13, 0, TEXT_BOX_NO_WRAP) == 8 && "test failed");
+    assert(columns_count("\xe4\xb8\xad", 0, 3, 0, TEXT_BOX_NO_WRAP) == 2 && "test failed");
+    assert(columns_count("\xff\xfe", 0, 2, 0, TEXT_BOX_NO_WRAP) == 2 && "test failed");
+
+    size_t first_invalid = 0;
+    assert(utf8_validate(&first_invalid, mixed, 19) && "test failed");
+    assert(!utf8_validate(&first_invalid, mixed, strlen(mixed)) && first_invalid == 19 && "test failed");
+    assert(!utf8_validate(&first_invalid, "ab\xc0\x80", 4) && first_invalid == 2 && "test failed"); // overlong
+
+    for (size_t width = 1; width <= 6; width++) {
+        test_template_utf8_walk(mixed, width);
+        test_template_utf8_walk("\xcc\x81" "abc\n\xe4\xb8\xad", width);
+        test_template_utf8_walk("ab\xe4\xb8\xad\xe6\x96\x87\xe4\xb8\xad", width);
+    }
+
+    // wide character that does not fit at the end of a visual line goes to the next visual line
+    String string;
+    String_init(&string);
+    String_cpy_from_cstr(&string, "ab\xe4\xb8\xad" "c", 6);
+    assert(cal_start_visual_line(&string, 2, 3) == 2 && "test failed");
+    assert(cal_visual_x_at_cursor(&string, 5, 3) == 2 && "test failed");
+    String_free_char_data(&string);
+
+    test_rewrap_text(mixed);
+    test_rewrap_text("\xe4\xb8\xad\xe6\x96\x87\n" "a\xe4\xb8\xad" "b\xe6\x96\x87" "c\n");
+}
+
+
+void test_tabs(void) {
+    assert(columns_count("a\tb", 0, 3, 0, TEXT_BOX_NO_WRAP) == 9 && "test failed");
+    assert(columns_count("a\tb", 0, 3, 5, TEXT_BOX_NO_WRAP) == 4 && "test failed");
+    assert(columns_count("\x01\x7f", 0, 2, 0, TEXT_BOX_NO_WRAP) == 4 && "test failed");
+    // tab does not go past the end of a visual line
+    assert(columns_count("abcde\t", 0, 6, 0, 6) == 6 && "test failed");
+
+    const char* code = "\tif (a) {\n\t\treturn\x01b;\n\t}\n";
+    const char* mixed = "\xe4\xb8\xad\t\xcc\x81x\tz\x1b[\t";
+    for (size_t width = 1; width <= 12; width++) {
+        test_template_utf8_walk(code, width);
+        test_template_utf8_walk(mixed, width);
+    }
+    tab_width = 3;
+    test_template_utf8_walk(code, TEXT_BOX_NO_WRAP);
+    test_template_utf8_walk(mixed, 7);
+    tab_width = TAB_WIDTH_DEFAULT;
+    test_rewrap_text(code);
+
+    // the column map of a long line has checkpoints within the visual lines too
+    String string;
+    String_init(&string);
+    for (size_t idx = 0; idx < COLUMN_MAP_STEP; idx++) {
+        String_append_cstr(&string, idx % 7 ? "ab\t" : "\xe4\xb8\xad", 3);
+    }
+    String_append(&string, '\n');
+    Column_map_invalidate_all();
+    size_t widths[] = {TEXT_BOX_NO_WRAP, 37};
+    for (size_t idx_width = 0; idx_width < sizeof(widths)/sizeof(widths[0]); idx_width++) {
+        const Column_map* map = Column_map_get(&string, 0, widths[idx_width]);
+        assert(!map->is_plain && map->checkpoints.count > 1 && "test failed");
+        for (size_t cursor = 0; cursor < string.count; cursor = get_end_of_char(&string, cursor + 40)) {
+            size_t visual_x;
+            size_t start_line = Column_map_find_cursor(&visual_x, map, &string, cursor);
+            assert(start_line == cal_start_visual_line(&string, cursor, widths[idx_width]) && "test failed");
+            assert(visual_x == cal_visual_x_at_cursor(&string, cursor, widths[idx_width]) && "test failed");
+        }
+    }
+    String_free_char_data(&string);
+    Column_map_invalidate_all();
+}
+
+
+// a column map is kept by edits of other texts (a paste, undo and redo, and edits at several cursors), and is moved
+// by edits before its line
+void test_template_column_map_kept(const Column_map* map, const String* string, size_t expected_start) {
+    assert(Column_map_is_valid(map, string, TEXT_BOX_NO_WRAP) && map->start == expected_start && "test failed");
+    for (size_t cursor = map->start; cursor < map->end; cursor = get_end_of_char(string, cursor + 40)) {
+        size_t visual_x;
+        assert(Column_map_find_cursor(&visual_x, map, string, cursor) == map->start && "test failed");
+        assert(visual_x == cal_visual_x_at_cursor(string, cursor, TEXT_BOX_NO_WRAP) && "test failed");
+    }
+}
+
+
+void test_column_map_edits(void) {
+    Document documents[2];
+    for (size_t idx = 0; idx < 2; idx++) {
+        Document_init(&documents[idx]);
+        String_cpy_from_cstr(&documents[idx].text_box.string, "ab\ncd\n", 6);
+    }
+    String* string = &documents[0].text_box.string;
+    for (size_t idx = 0; idx < COLUMN_MAP_STEP; idx++) {
+        String_append_cstr(string, idx % 7 ? "ab\t" : "\xe4\xb8\xad", 3);
+    }
+    Column_map_invalidate_all();
+    const Column_map* map = Column_map_get(string, 6, TEXT_BOX_NO_WRAP);
+    assert(!map->is_plain && "test failed");
+
+    Clip clip;
+    Clip_init(&clip);
+    Clip_set_range(&clip, &documents[1].text_box.string, 0, 3);
+    Document_paste(&documents[1], &clip);
+    test_template_column_map_kept(map, string, 6);
+    Document_paste(&documents[0], &clip);
+    test_template_column_map_kept(map, string, 9);
+    assert(Document_undo(&documents[0], TEXT_BOX_NO_WRAP, 10) && "test failed");
+    test_template_column_map_kept(map, string, 6);
+    assert(Document_redo(&documents[0], TEXT_BOX_NO_WRAP, 10) && "test failed");
+    test_template_column_map_kept(map, string, 9);
+
+    String query = {0};
+    String_cpy_from_cstr(&query, "cd", 2);
+    Document_add_cursors_at_matches(&documents[0], &query);
+    assert(documents[0].cursors.count == 1 && "test failed");
+    Document_insert_at_cursors(&documents[0], &query, TEXT_BOX_NO_WRAP, 10);
+    test_template_column_map_kept(map, string, 13);
+    assert(Document_undo(&documents[0], TEXT_BOX_NO_WRAP, 10) && "test failed");
+    test_template_column_map_kept(map, string, 9);
+
+    String_free_char_data(&query);
+    Clip_free(&clip);
+    Document_free(&documents[0]);
+    Document_free(&documents[1]);
+}
+
+
+// lines longer than COLUMN_MAP_MIN_BYTES that are not wrapped: the end of a line is kept in its column map, and a column
+// far along a line is found with the map
+void test_long_lines_no_wrap(void) {
+    const char* pieces[] = {"abcdefg", "ab\tcd\xe4\xb8\xad"};
+    for (size_t idx_piece = 0; idx_piece < sizeof(pieces)/sizeof(pieces[0]); idx_piece++) {
+        String string;
+        String_init(&string);
+        size_t starts_line[3];
+        for (size_t idx_line = 0; idx_line < 3; idx_line++) {
+            starts_line[idx_line] = string.count;
+            for (size_t idx = 0; idx < COLUMN_MAP_MIN_BYTES / 3 + idx_line * 100; idx++) {
+                String_append_cstr(&string, pieces[idx_piece], strlen(pieces[idx_piece]));
+            }
+            if (idx_line < 2) {
+                String_append(&string, '\n');
+            }
+        }
+        Column_map_invalidate_all();
+
+        for (size_t idx_line = 0; idx_line < 3; idx_line++) {
+            Pos_data start_line = {.cursor = starts_line[idx_line], .visual_x = 0, .visual_y = 0};
+            Pos_data start_next_line;
+            bool has_next_line = get_start_next_visual_line_from_curr_cursor_x(&start_next_line, &string, &start_line, TEXT_BOX_NO_WRAP);
+            assert(has_next_line == (idx_line < 2) && "test failed");
+            assert((!has_next_line || start_next_line.cursor == starts_line[idx_line + 1]) && "test failed");
+        }
+
+        size_t max_cols[] = {0, 5, COLUMN_MAP_MIN_BYTES + 3, 2 * COLUMN_MAP_MIN_BYTES + 1, SIZE_MAX};
+        for (size_t idx_line = 1; idx_line < 3; idx_line++) {
+            size_t start_next_line = idx_line < 2 ? starts_line[idx_line + 1] : string.count + 1;
+            for (size_t idx_col = 0; idx_col < sizeof(max_cols)/sizeof(max_cols[0]); idx_col++) {
+                size_t visual_x;
+                size_t cursor = get_cursor_at_column(&visual_x, &string, starts_line[idx_line], start_next_line, max_cols[idx_col], TEXT_BOX_NO_WRAP);
+
+                // walk the line
+                size_t expected = starts_line[idx_line];
+                size_t expected_visual_x = 0;
+                while (expected < string.count && String_at(&string, expected) != '\n') {
+                    size_t width;
+                    size_t end_char = columns_next_cell(&width, string.items, expected, string.count, expected_visual_x, TEXT_BOX_NO_WRAP);
+                    if (expected_visual_x + width > max_cols[idx_col]) {
+                        break;
+                    }
+                    expected_visual_x += width;
+                    expected = end_char;
+                }
+                assert(cursor == expected && visual_x == expected_visual_x && "test failed");
+            }
+        }
+        String_free_char_data(&string);
+    }
+    Column_map_invalidate_all();
+}
+
+
+void test_template_line_endings(const char* text, const char* expected, LINE_ENDING expected_first) {
+    String string;
+    String_init(&string);
+    String_cpy_from_cstr(&string, text, strlen(text));
+    Line_ending_counts counts;
+    string.count = line_ending_normalize(&counts, string.items, 0, string.count);
+    assert(string.count == strlen(expected) && 0 == memcmp(string.items, expected, string.count) && "test failed");
+    assert(counts.first == expected_first && "test failed");
+
+    // saved with the line ending of the first line
+    FILE* file = tmpfile();
+    assert(file && line_ending_write(file, string.items, string.count, counts.first) && "test failed");
+    rewind(file);
+    String saved;
+    String_init(&saved);
+    int curr_char;
+    while (EOF != (curr_char = fgetc(file))) {
+        String_append(&saved, (char)curr_char);
+    }
+    fclose(file);
+    Line_ending_counts counts_saved;
+    saved.count = line_ending_normalize(&counts_saved, saved.items, 0, saved.count);
+    assert(saved.count == string.count && 0 == memcmp(saved.items, string.items, string.count) && "test failed");
+    assert(counts_saved.first == counts.first && "test failed");
+    if (counts.count_crlf + counts.count_cr == 0 || counts.count_crlf == 0 || counts.count_cr == 0) {
+        // file without mixed line endings is saved as it was opened
+        assert(counts_saved.count_crlf == counts.count_crlf && counts_saved.count_cr == counts.count_cr && "test failed");
+    }
+
+    String_free_char_data(&saved);
+    String_free_char_data(&string);
+}
+
+
+void test_line_endings(void) {
+    test_template_line_endings("", "", LINE_ENDING_LF);
+    test_template_line_endings("abc", "abc", LINE_ENDING_LF);
+    test_template_line_endings("a\nb\r\nc\rd", "a\nb\nc\nd", LINE_ENDING_LF);
+    test_template_line_endings("a\r\nb\r\n\r\nc", "a\nb\n\nc", LINE_ENDING_CRLF);
+    test_template_line_endings("\r\r\nab\r", "\n\nab\n", LINE_ENDING_CR);
+    test_template_line_endings("a line that is longer than sixteen characters\r\nand another one\r\n", 
+        "a line that is longer than sixteen characters\nand another one\n", LINE_ENDING_CRLF);
+
+    // lines of every length up to more than 64 bytes (sometimes with a \r in the middle), and more text than the 
+    // buffer that the file is written with
+    const char* line_endings[] = {"\r\n", "\r"};
+    for (size_t idx_line_ending = 0; idx_line_ending < 2; idx_line_ending++) {
+        String text;
+        String expected;
+        String_init(&text);
+        String_init(&expected);
+        for (size_t idx = 0; idx < 3000; idx++) {
+            for (size_t idx_char = 0; idx_char < idx % 71; idx_char++) {
+                char curr_char = idx % 13 == 0 && idx_char == 5 ? '\r' : 'a' + idx_char % 26;
+                String_append(&text, curr_char);
+                String_append(&expected, curr_char == '\r' ? '\n' : curr_char);
+            }
+            String_append_cstr(&text, line_endings[idx_line_ending], strlen(line_endings[idx_line_ending]));
+            String_append(&expected, '\n');
+        }
+        String_append(&text, '\0');
+        String_append(&expected, '\0');
+        test_template_line_endings(text.items, expected.items, idx_line_ending == 0 ? LINE_ENDING_CRLF : LINE_ENDING_CR);
+        String_free_char_data(&text);
+        String_free_char_data(&expected);
+    }
+
+    // a file is replaced as a whole, keeps its permissions, and no temporary file is left next to it
+    char dir_name[] = "/tmp/test_line_endings_XXXXXX";
+    assert(mkdtemp(dir_name) && "test failed");
+    char file_name[sizeof(dir_name) + 16];
+    snprintf(file_name, sizeof(file_name), "%s/file.txt", dir_name);
+    assert(line_ending_replace_file(file_name, "a\nb\n", 4, LINE_ENDING_LF) && "test failed");
+    assert(0 == chmod(file_name, 0640) && "test failed");
+    assert(line_ending_replace_file(file_name, "c\n", 2, LINE_ENDING_CRLF) && "test failed");
+    struct stat file_stat;
+    assert(0 == stat(file_name, &file_stat) && (file_stat.st_mode & 07777) == 0640 && "test failed");
+    FILE* file = fopen(file_name, "rb");
+    char buf[8];
+    assert(file && 3 == fread(buf, 1, sizeof(buf), file) && 0 == memcmp(buf, "c\r\n", 3) && "test failed");
+    fclose(file);
+    assert(0 == unlink(file_name) && 0 == rmdir(dir_name) && "test failed");
+}
+
+
+void test_syntax(void) {
+    assert(syntax_lang_from_file_name("dir.d/main.c") == SYNTAX_LANG_C && "test failed");
+    assert(syntax_lang_from_file_name("main.c.txt") == SYNTAX_LANG_NONE && "test failed");
+    assert(syntax_lang_from_file_name("Makefile") == SYNTAX_LANG_NONE && "test failed");
+
+    // rows of edits are counted from the last edit (forwards or backwards)
+    const char* text = "int a;\n\n\tfoo(\"x\\n\");\n// a comment that is longer than sixteen bytes\n}\n";
+    String string;
+    String_init(&string);
+    String_cpy_from_cstr(&string, text, strlen(text));
+    Syntax syntax;
+    Syntax_init(&syntax);
+    size_t cursors[] = {5, 7, 40, 0, string.count, 12, 9, 30};
+    for (size_t idx = 0; idx < sizeof(cursors)/sizeof(cursors[0]); idx++) {
+        size_t cursor = cursors[idx];
+        Syntax_point expected = {0};
+        for (size_t idx_char = 0; idx_char < cursor; idx_char++) {
+            expected.column++;
+            if (text[idx_char] == '\n') {
+                expected.row++;
+                expected.column = 0;
+            }
+        }
+        Syntax_point point = Syntax_point_at(&syntax, &string, cursor);
+        assert(point.row == expected.row && point.column == expected.column && "test failed");
+    }
+    Syntax_free(&syntax);
+    String_free_char_data(&string);
+}
+
+
+// states of the lines that were kept while syntax was edited must be the same as the states found by lexing the text 
+// from the start (and so must the spans of the second half of the text, which are found starting with those states)
+void test_template_syntax_lexer(Syntax* syntax, const String* string) {
+    Syntax fresh;
+    Syntax_init(&fresh);
+    Syntax_set_lang(&fresh, syntax->lang);
+    size_t count_lines = line_scan_count_newlines(string->items, 0, string->count);
+    Syntax_lexer_extend(&syntax->lexer, syntax->lang, string, count_lines);
+    Syntax_lexer_extend(&fresh.lexer, fresh.lang, string, count_lines);
+    assert(syntax->lexer.line_states.count == count_lines + 1 && fresh.lexer.line_states.count == count_lines + 1 && "test failed");
+    assert(0 == memcmp(syntax->lexer.line_states.items, fresh.lexer.line_states.items, count_lines + 1) && "test failed");
+
+    Vector_Syntax_span spans = {0};
+    Vector_Syntax_span expected = {0};
+    Syntax_get_spans(&spans, syntax, string, string->count / 2, string->count);
+    Syntax_get_spans(&expected, &fresh, string, 0, string->count);
+    size_t idx_expected = 0;
+    while (idx_expected < expected.count && expected.items[idx_expected].start < spans.items[0].start) {
+        idx_expected++;
+    }
+    assert(spans.count == expected.count - idx_expected && "test failed");
+    for (size_t idx = 0; idx < spans.count; idx++) {
+        const Syntax_span* span = &spans.items[idx];
+        const Syntax_span* expected_span = &expected.items[idx_expected + idx];
+        assert(span->start == expected_span->start && span->end == expected_span->end && span->kind == expected_span->kind && "test failed");
+    }
+    Syntax_free(&fresh);
+    free(spans.items);
+    free(expected.items);
+}
+
+
+void test_syntax_lexer(void) {
+    for (size_t lang = SYNTAX_LANG_NONE + 1; lang < SYNTAX_LANG_COUNT; lang++) {
+        const Syntax_lang_def* def = &syntax_lang_defs[lang];
+        for (size_t idx = 1; idx < def->count_keywords; idx++) {
+            assert(strcmp(def->keywords[idx - 1], def->keywords[idx]) < 0 && "keywords must be sorted");
+        }
+        for (size_t idx = 1; idx < def->count_types; idx++) {
+            assert(strcmp(def->types[idx - 1], def->types[idx]) < 0 && "types must be sorted");
+        }
+    }
+
+    const char* text = "#include <a.h>\nstatic int x = 42; /* a\nb */ char* s = \"q\\\"\"; // c\n";
+    Vector_Syntax_span spans = {0};
+    const struct {const char* token; SYNTAX_KIND kind;} expected[] = {
+        {"#include ", SYNTAX_PREPROC}, {"static", SYNTAX_KEYWORD}, {"int", SYNTAX_TYPE}, {"42", SYNTAX_NUMBER},
+        {"/* a\nb */", SYNTAX_COMMENT}, {"char", SYNTAX_TYPE}, {"\"q\\\"\"", SYNTAX_STRING}, {"// c", SYNTAX_COMMENT},
+    };
+    size_t end_line = 0;
+    uint8_t state = SYNTAX_LEX_NORMAL;
+    for (size_t start_line = 0; start_line < strlen(text); start_line = end_line + 1) {
+        end_line = strchr(text + start_line, '\n') - text;
+        state = syntax_lex_line(&spans, SYNTAX_LANG_C, text, start_line, end_line, state);
+    }
+    // (the comment that goes over two lines is two spans)
+    assert(spans.count == sizeof(expected)/sizeof(expected[0]) + 1 && "test failed");
+    for (size_t idx = 0, idx_span = 0; idx < sizeof(expected)/sizeof(expected[0]); idx++, idx_span++) {
+        const Syntax_span* span = &spans.items[idx_span];
+        if (expected[idx].kind == SYNTAX_COMMENT && span->end < spans.items[idx_span + 1].start) {
+            idx_span++;
+            span = &spans.items[idx_span];
+            assert(text[span->start - 1] == '\n' && "test failed");
+            span = &(Syntax_span){.start = spans.items[idx_span - 1].start, .end = span->end, .kind = span->kind};
+        }
+        assert(span->kind == expected[idx].kind && "test failed");
+        assert(span->end - span->start == strlen(expected[idx].token) && "test failed");
+        assert(0 == memcmp(text + span->start, expected[idx].token, span->end - span->start) && "test failed");
+    }
+    free(spans.items);
+
+    // edits that open and close comments and strings, and add and remove lines
+    const char* edits[] = {"/*", "x\n", "*/", "\"", "\n\n", "'", "y", "#"};
+    for (size_t lang = SYNTAX_LANG_C; lang <= SYNTAX_LANG_SHELL; lang++) {
+        String string;
+        String_init(&string);
+        for (size_t idx = 0; idx < 600; idx++) {
+            String_append_cstr(&string, idx % 5 ? "int a = 1; // b\n" : "\tif x; then\n", idx % 5 ? 16 : 12);
+        }
+        Syntax syntax;
+        Syntax_init(&syntax);
+        Syntax_set_lang(&syntax, lang);
+        test_template_syntax_lexer(&syntax, &string);
+        size_t random = 1;
+        for (size_t idx = 0; idx < 200; idx++) {
+            random = random * 1103515245 + 12345;
+            size_t start = (random >> 8) % string.count;
+            const char* edit = edits[(random >> 4) % (sizeof(edits)/sizeof(edits[0]))];
+            if (idx % 3 == 2) {
+                size_t count_removed = MIN((random >> 16) % 40, string.count - start);
+                String removed;
+                String_init(&removed);
+                String_cpy_from_substring(&removed, &string, start, count_removed);
+                String_del_substr(&string, start, count_removed);
+                Syntax_note_edit(&syntax, &string, start, removed.items, count_removed, 0);
+                String_free_char_data(&removed);
+            } else {
+                String_insert_cstr(&string, start, edit, strlen(edit));
+                Syntax_note_edit(&syntax, &string, start, NULL, 0, strlen(edit));
+            }
+            if (idx % 7 == 0 || idx == 199) {
+                test_template_syntax_lexer(&syntax, &string);
+            }
+        }
+        Syntax_free(&syntax);
+        String_free_char_data(&string);
+    }
+}
+
+
+// every bracket of string is compared with a match found by a stack of the unmatched brackets of each kind
+void test_template_brackets(Brackets* brackets, const String* string) {
+    size_t* expected = safe_malloc((string->count + 1) * sizeof(expected[0]));
+    size_t* stacks[BRACKET_COUNT];
+    size_t stack_counts[BRACKET_COUNT] = {0};
+    for (size_t kind = 0; kind < BRACKET_COUNT; kind++) {
+        stacks[kind] = safe_malloc((string->count + 1) * sizeof(stacks[kind][0]));
+    }
+    for (size_t idx = 0; idx < string->count; idx++) {
+        expected[idx] = SIZE_MAX;
+        BRACKET kind;
+        int direction = brackets_classify(string->items[idx], &kind);
+        if (direction > 0) {
+            stacks[kind][stack_counts[kind]++] = idx;
+        } else if (direction < 0 && stack_counts[kind] > 0) {
+            size_t open = stacks[kind][--stack_counts[kind]];
+            expected[open] = idx;
+            expected[idx] = open;
+        }
+    }
+
+    for (size_t idx = 0; idx < string->count; idx++) {
+        size_t match;
+        bool is_found = Brackets_find_match(&match, brackets, string, idx);
+        assert(is_found == (expected[idx] != SIZE_MAX) && "test failed");
+        assert((!is_found || match == expected[idx]) && "test failed");
+    }
+
+    free(expected);
+    for (size_t kind = 0; kind < BRACKET_COUNT; kind++) {
+        free(stacks[kind]);
+    }
+}
+
+
+void test_brackets(void) {
+    String string;
+    String_init(&string);
+    Brackets brackets;
+    Brackets_init(&brackets);
+    test_template_brackets(&brackets, &string);
+    Brackets_clear(&brackets);
+
+    const char* pieces[] = {"(", ")", "[", "]", "{", "}", "ab", "{\n\t\"a\": [1, 2],\n}", "f(x[i]);\n"};
+    size_t random = 1;
+    for (size_t idx = 0; idx < 3000; idx++) {
+        random = random * 1103515245 + 12345;
+        const char* piece = pieces[(random >> 8) % (sizeof(pieces)/sizeof(pieces[0]))];
+        String_append_cstr(&string, piece, strlen(piece));
+    }
+    test_template_brackets(&brackets, &string);
+
+    // small edits, edits over several chunks, and an insertion that is split into several chunks
+    String big;
+    String_init(&big);
+    for (size_t idx = 0; idx < 3 * BRACKETS_MAX_CHUNK; idx++) {
+        String_append(&big, "({x})"[idx % 5]);
+    }
+    for (size_t idx = 0; idx < 300; idx++) {
+        random = random * 1103515245 + 12345;
+        size_t start = (random >> 8) % (string.count + 1);
+        if (idx % 3 == 2) {
+            size_t count_removed = MIN((random >> 16) % (idx % 2 ? 40 : 3 * BRACKETS_CHUNK), string.count - start);
+            String_del_substr(&string, start, count_removed);
+            Brackets_note_edit(&brackets, &string, start, count_removed, 0);
+        } else if (idx % 50 == 0) {
+            String_insert_string(&string, start, &big);
+            Brackets_note_edit(&brackets, &string, start, 0, big.count);
+        } else {
+            const char* piece = pieces[(random >> 4) % (sizeof(pieces)/sizeof(pieces[0]))];
+            String_insert_cstr(&string, start, piece, strlen(piece));
+            Brackets_note_edit(&brackets, &string, start, 0, strlen(piece));
+        }
+        if (idx % 25 == 0 || idx == 299) {
+            test_template_brackets(&brackets, &string);
+        }
+    }
+
+    String_free_char_data(&big);
+    String_free_char_data(&string);
+    Brackets_free(&brackets);
+}
+
+
+void test_folds(void) {
+    Document document;
+    Document_init(&document);
+    Text_box* text_box = &document.text_box;
+    const char* text = "int f() {\n    a;\n    b;\n}\nint g;\n";
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+
+    // the lines up to the closing bracket are folded, and skipped by moving and by the viewport
+    assert(Document_toggle_fold(&document, 100, 5) && "test failed");
+    assert(document.folds.hidden.count == 1 && document.folds.hidden.items[0].start == 10 && document.folds.hidden.items[0].end == 24 && "test failed");
+    assert(cal_visual_y_at_cursor(&text_box->string, 24, 100) == 1 && "test failed");
+    Text_box_move_cursor(text_box, DIR_DOWN, 100, 5, false);
+    assert(text_box->cursor_info.pos.cursor == 24 && text_box->cursor_info.pos.visual_y == 1 && "test failed");
+    Text_box_move_cursor(text_box, DIR_UP, 100, 5, false);
+    assert(text_box->cursor_info.pos.cursor == 0 && "test failed");
+
+    Viewport viewport;
+    Viewport_init(&viewport);
+    Viewport_build(&viewport, &text_box->string, &text_box->cursor_info.scroll, 5, 100, 100);
+    assert(viewport.rows.count == 3 && viewport.rows.items[0].is_folded && viewport.rows.items[1].start == 24 && "test failed");
+    Viewport_free(&viewport);
+
+    // edits after the fold keep it, edits before it move it, and joining the header with the fold removes it
+    String_insert_cstr(&text_box->string, 26, "x", 1);
+    Document_note_edit(&document, 26, NULL, 0, 1);
+    String_insert_cstr(&text_box->string, 0, "//\n", 3);
+    Document_note_edit(&document, 0, NULL, 0, 3);
+    assert(document.folds.folds.count == 1 && document.folds.folds.items[0].start == 13 && document.folds.folds.items[0].end == 27 && "test failed");
+    String_del_substr(&text_box->string, 12, 1);
+    Document_note_edit(&document, 12, "\n", 1, 0);
+    assert(document.folds.folds.count == 0 && document.folds.hidden.count == 0 && "test failed");
+
+    // without brackets, the lines that are indented more are folded (and a second toggle opens them)
+    text = "a:\n  b\n\n  c\nd\n";
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+    Cursor_info_init(&text_box->cursor_info);
+    assert(Document_toggle_fold(&document, 100, 5) && "test failed");
+    assert(document.folds.folds.count == 1 && document.folds.folds.items[0].start == 3 && document.folds.folds.items[0].end == 12 && "test failed");
+    assert(Document_toggle_fold(&document, 100, 5) && document.folds.hidden.count == 0 && "test failed");
+    Text_box_move_cursor_repeat(text_box, DIR_DOWN, 4, 100, 5, false);
+    assert(!Document_toggle_fold(&document, 100, 5) && "test failed");
+
+    // opening every fold keeps the folds
+    Cursor_info_init(&text_box->cursor_info);
+    assert(Document_toggle_fold(&document, 100, 5) && document.folds.hidden.count == 1 && "test failed");
+    Folds_open_all(&document.folds);
+    assert(document.folds.folds.count == 1 && document.folds.hidden.count == 0 && !folds_is_hidden(&text_box->string, 3) && "test failed");
+
+    // any count of texts can have closed folds
+    Document* documents = safe_malloc(300 * sizeof(*documents));
+    for (size_t idx = 0; idx < 300; idx++) {
+        Document_init(&documents[idx]);
+        String_cpy_from_cstr(&documents[idx].text_box.string, text, strlen(text));
+        assert(Document_toggle_fold(&documents[idx], 100, 5) && "test failed");
+    }
+    for (size_t idx = 0; idx < 300; idx++) {
+        assert(folds_is_hidden(&documents[idx].text_box.string, 3) && !folds_is_hidden(&text_box->string, 3) && "test failed");
+    }
+    for (size_t idx = 0; idx < 300; idx++) {
+        Document_free(&documents[idx]);
+    }
+    free(documents);
+    assert(folds_registered.count == 0 && "test failed");
+
+    Document_free(&document);
+}
+
+
+// a key typed at every cursor is one batch of edits: the text, the cursors, the highlighting and the brackets end up the
+// same as if the edits were made one at a time, and the batch is undone as one action
+void test_multi_cursor(void) {
+    // batches that move the text to the left, to the right, and both ways (which is not done in place)
+    const char* text = "int a;\nint b;\n/* c */ int c;\n{ d(); }\nint e;\n";
+    static const struct {size_t start; size_t count_removed; const char* inserted;} edits[3][3] = {
+        {{4, 1, ""}, {11, 1, ""}, {30, 2, "x"}},
+        {{4, 0, "{"}, {14, 3, "/*x"}, {38, 0, "(\n"}},
+        {{0, 3, "long"}, {11, 3, ""}, {29, 1, "{{"}},
+    };
+    for (size_t idx_case = 0; idx_case < 3; idx_case++) {
+        String string = {0};
+        String expected = {0};
+        String_cpy_from_cstr(&string, text, strlen(text));
+        String_cpy_from_cstr(&expected, text, strlen(text));
+        Edit_batch batch;
+        Edit_batch_init(&batch);
+        for (size_t idx = 0; idx < 3; idx++) {
+            Edit_batch_add(&batch, &string, edits[idx_case][idx].start, edits[idx_case][idx].count_removed, edits[idx_case][idx].inserted, strlen(edits[idx_case][idx].inserted));
+        }
+        for (size_t idx = 3; idx-- > 0;) {
+            if (edits[idx_case][idx].count_removed > 0) {
+                String_del_substr(&expected, edits[idx_case][idx].start, edits[idx_case][idx].count_removed);
+            }
+            String_insert_cstr(&expected, edits[idx_case][idx].start, edits[idx_case][idx].inserted, strlen(edits[idx_case][idx].inserted));
+        }
+        Edit_batch_apply(&string, &batch);
+        assert(string.count == expected.count && 0 == memcmp(string.items, expected.items, string.count) && "test failed");
+        Edit_batch_invert(&batch);
+        Edit_batch_apply(&string, &batch);
+        assert(string.count == strlen(text) && 0 == memcmp(string.items, text, string.count) && "test failed");
+        Edit_batch_free(&batch);
+        String_free_char_data(&string);
+        String_free_char_data(&expected);
+    }
+
+    Document document;
+    Document_init(&document);
+    Text_box* text_box = &document.text_box;
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+    Syntax_set_lang(&document.syntax, SYNTAX_LANG_C);
+    test_template_syntax_lexer(&document.syntax, &text_box->string);
+    test_template_brackets(&document.brackets, &text_box->string);
+    Cursor_info other_cursor_info;
+    Cursor_info_init(&other_cursor_info);
+    other_cursor_info.pos.cursor = 40;
+    document.other_view = (Document_view){.cursor_info = &other_cursor_info, .max_visual_width = 100, .max_visual_height = 5};
+
+    String query = {0};
+    String_cpy_from_cstr(&query, "int", 3);
+    Document_add_cursors_at_matches(&document, &query);
+    assert(document.cursors.count == 3 && document.cursors.items[0] == 7 && document.cursors.items[1] == 22 && document.cursors.items[2] == 38 && "test failed");
+
+    String new_str = {0};
+    String_cpy_from_cstr(&new_str, "/*{", 3);
+    Document_insert_at_cursors(&document, &new_str, 100, 5);
+    const char* expected = "/*{int a;\n/*{int b;\n/* c */ /*{int c;\n{ d(); }\n/*{int e;\n";
+    assert(text_box->string.count == strlen(expected) && 0 == memcmp(text_box->string.items, expected, strlen(expected)) && "test failed");
+    assert(text_box->cursor_info.pos.cursor == 3 && document.cursors.items[0] == 13 && document.cursors.items[2] == 50 && "test failed");
+    assert(other_cursor_info.pos.cursor == 52 && document.actions.count == 1 && "test failed");
+    test_template_syntax_lexer(&document.syntax, &text_box->string);
+    test_template_brackets(&document.brackets, &text_box->string);
+
+    assert(Document_del_before_cursors(&document, 100, 5) && text_box->string.count == strlen(text) + 8 && "test failed");
+    assert(Document_undo(&document, 100, 5) && Document_undo(&document, 100, 5) && "test failed");
+    assert(text_box->string.count == strlen(text) && 0 == memcmp(text_box->string.items, text, strlen(text)) && "test failed");
+    assert(text_box->cursor_info.pos.cursor == 0 && document.cursors.items[1] == 22 && other_cursor_info.pos.cursor == 40 && "test failed");
+    test_template_syntax_lexer(&document.syntax, &text_box->string);
+    test_template_brackets(&document.brackets, &text_box->string);
+    assert(Document_redo(&document, 100, 5) && 0 == memcmp(text_box->string.items, expected, strlen(expected)) && "test failed");
+
+    // a cursor on every line of a selection, at the column of the main cursor
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+    Document_note_opened(&document);
+    text_box->cursor_info.pos.cursor = 2;
+    Document_add_cursors_on_lines(&document, 2, 30);
+    assert(document.cursors.count == 3 && document.cursors.items[0] == 9 && document.cursors.items[1] == 16 && document.cursors.items[2] == 31 && "test failed");
+
+    // a batch that joins lines after the first edit (the lexer has the states of lines that the text no longer has)
+    text = "/*\na\nb\nc\n";
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+    Document_note_opened(&document);
+    Syntax_set_lang(&document.syntax, SYNTAX_LANG_C);
+    assert(Syntax_lexer_extend(&document.syntax.lexer, SYNTAX_LANG_C, &text_box->string, 4) && "test failed");
+    text_box->cursor_info.pos.cursor = 1;
+    size_t other_cursor = 5;
+    vector_append_size_t(&document.cursors, &other_cursor);
+    assert(Document_del_before_cursors(&document, 100, 5) && "test failed");
+    expected = "*\nab\nc\n";
+    assert(text_box->string.count == strlen(expected) && 0 == memcmp(text_box->string.items, expected, strlen(expected)) && "test failed");
+    test_template_syntax_lexer(&document.syntax, &text_box->string);
+    assert(Document_undo(&document, 100, 5) && 0 == memcmp(text_box->string.items, text, strlen(text)) && "test failed");
+    test_template_syntax_lexer(&document.syntax, &text_box->string);
+
+    String_free_char_data(&query);
+    String_free_char_data(&new_str);
+    Document_free(&document);
+}
+
+
+// a copy references the copied range of the text, and gets its own bytes (the bytes the range had) once the range is
+// edited; a paste copies straight from the text, wherever the copied range is
+void test_clipboard(void) {
+    String string = {0};
+    const char* text = "0123456789abcdefghij";
+    String_cpy_from_cstr(&string, text, strlen(text));
+    String part = {0};
+    String_cpy_from_substring(&part, &string, 2, 3);
+    assert(part.count == 3 && part.capacity < string.count && 0 == memcmp(part.items, "234", 3) && "test failed");
+    String_free_char_data(&part);
+
+    static const struct {size_t index; size_t src_start; const char* expected;} inserts[] = {
+        {2, 10, "01abcde23456789abcdefghij"},
+        {15, 10, "0123456789abcdeabcdefghij"},
+        {12, 10, "0123456789ababcdecdefghij"},
+    };
+    for (size_t idx = 0; idx < sizeof(inserts)/sizeof(inserts[0]); idx++) {
+        String_cpy_from_cstr(&string, text, strlen(text));
+        String_insert_from_self(&string, inserts[idx].index, inserts[idx].src_start, 5);
+        assert(string.count == strlen(inserts[idx].expected) && 0 == memcmp(string.items, inserts[idx].expected, string.count) && "test failed");
+    }
+
+    Document document;
+    Document_init(&document);
+    Text_box* text_box = &document.text_box;
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+    Clip clip;
+    Clip_init(&clip);
+    Clip_set_range(&clip, &text_box->string, 10, 5);
+    assert(clip.string == &text_box->string && Clip_count(&clip) == 5 && "test failed");
+
+    // edits before the range move it; an edit within it gives the clip the bytes of the range
+    String_insert_cstr(&text_box->string, 0, "xy", 2);
+    Document_note_edit(&document, 0, NULL, 0, 2);
+    String_insert_cstr(&text_box->string, 17, "--", 2);
+    Document_note_edit(&document, 17, NULL, 0, 2);
+    assert(clip.string == &text_box->string && clip.start == 12 && 0 == memcmp(Clip_items(&clip), "abcde", 5) && "test failed");
+    text_box->cursor_info.pos.cursor = 14;
+    Document_paste(&document, &clip);
+    assert(clip.string == NULL && Clip_count(&clip) == 5 && 0 == memcmp(Clip_items(&clip), "abcde", 5) && "test failed");
+    const char* expected = "xy0123456789ababcdecde--fghij";
+    assert(text_box->string.count == strlen(expected) && 0 == memcmp(text_box->string.items, expected, strlen(expected)) && "test failed");
+
+    Clip_set_range(&clip, &text_box->string, 20, 4);
+    String_del_substr(&text_box->string, 18, 4);
+    Document_note_edit(&document, 18, "ecde", 4, 0);
+    assert(clip.string == NULL && 0 == memcmp(Clip_items(&clip), "de--", 4) && "test failed");
+
+    // a clip of a text that is freed keeps its bytes
+    Clip_set_range(&clip, &text_box->string, 0, 3);
+    Document_free(&document);
+    assert(clip.string == NULL && 0 == memcmp(Clip_items(&clip), "xy0", 3) && "test failed");
+
+    Clip_free(&clip);
+    String_free_char_data(&string);
+}
+
+
+// copies of the same text share one blob once they are copied out of the text; the ring keeps the newest copies
+void test_clipboard_ring(size_t max_visual_width, size_t max_visual_height) {
+    Document document;
+    Document_init(&document);
+    Text_box* text_box = &document.text_box;
+    const char* text = "0123456789abcdefghij";
+    String_cpy_from_cstr(&text_box->string, text, strlen(text));
+    size_t count_blobs = clip_blobs.count;
+
+    Clipboard clipboard;
+    Clipboard_init(&clipboard);
+    for (size_t idx = 0; idx < CLIPBOARD_RING_SIZE + 10; idx++) {
+        Clip_set_range(Clipboard_push(&clipboard), &text_box->string, 10, 5);
+    }
+    assert(Clipboard_get_recent(&clipboard, CLIPBOARD_RING_SIZE - 1) && !Clipboard_get_recent(&clipboard, CLIPBOARD_RING_SIZE) && "test failed");
+    Clip_cpy(Clipboard_get_register(&clipboard, 'a'), Clipboard_get_recent(&clipboard, 0));
+
+    // the selection "abcde" is cut: every copy of it gets the same blob
+    text_box->visual_sel.state = VIS_STATE_ON;
+    text_box->visual_sel.cursor_started = 10;
+    text_box->cursor_info.pos.cursor = 14;
+    assert(Document_del_selection(&document, max_visual_width, max_visual_height) && "test failed");
+    assert(clip_blobs.count == count_blobs + 1 && "test failed");
+    const Clip* newest = Clipboard_get_recent(&clipboard, 0);
+    const Clip* named = Clipboard_get_register(&clipboard, 'a');
+    assert(newest->string == NULL && newest->blob == named->blob && newest->blob->count_refs == CLIPBOARD_RING_SIZE + 1 && "test failed");
+    assert(0 == memcmp(Clip_items(named), "abcde", 5) && "test failed");
+
+    // the same bytes copied again (from anywhere) are found by their hash
+    Clip_set_bytes(Clipboard_get_register(&clipboard, 'b'), "abcde", 5);
+    assert(Clipboard_get_register(&clipboard, 'b')->blob == named->blob && clip_blobs.count == count_blobs + 1 && "test failed");
+
+    // the cut is undone as one action
+    assert(Document_undo(&document, max_visual_width, max_visual_height) && "test failed");
+    assert(text_box->string.count == strlen(text) && 0 == memcmp(text_box->string.items, text, strlen(text)) && "test failed");
+
+    Clipboard_free(&clipboard);
+    assert(clip_blobs.count == count_blobs && "test failed");
+    Document_free(&document);
+}
+
+
+// edits made in one window of a split move the cursor and the scroll of the other window with the text
+void test_template_split(size_t max_visual_width, size_t max_visual_height) {
+    Document document;
+    Document_init(&document);
+    Text_box* text_box = &document.text_box;
+    const char* pieces[] = {"a", "\n", "bcdefgh\n", "\n\nij", "klmnopqrstu"};
+    for (size_t idx = 0; idx < 60; idx++) {
+        const char* piece = pieces[idx % (sizeof(pieces)/sizeof(pieces[0]))];
+        String_append_cstr(&text_box->string, piece, strlen(piece));
+    }
+    Cursor_info other;
+    document.other_view = (Document_view){.cursor_info = &other, .max_visual_width = max_visual_width, .max_visual_height = max_visual_height};
+
+    size_t random = 1;
+    for (size_t idx = 0; idx < 300; idx++) {
+        random = random * 1103515245 + 12345;
+        if (idx % 20 == 0) {
+            // the other window is put somewhere else in the text
+            Cursor_info_init(&text_box->cursor_info);
+            Text_box_move_cursor_repeat(text_box, DIR_DOWN, (random >> 8) % 40, max_visual_width, max_visual_height, false);
+            Text_box_move_cursor_repeat(text_box, DIR_RIGHT, (random >> 16) % 5, max_visual_width, max_visual_height, false);
+            other = text_box->cursor_info;
+        }
+        size_t start = (random >> 4) % (text_box->string.count + 1);
+        if (idx % 3 == 2) {
+            size_t count_removed = MIN((random >> 12) % 12, text_box->string.count - start);
+            String removed;
+            String_init(&removed);
+            String_cpy_from_substring(&removed, &text_box->string, start, count_removed);
+            String_del_substr(&text_box->string, start, count_removed);
+            Document_note_edit(&document, start, removed.items, count_removed, 0);
+            String_free_char_data(&removed);
+        } else {
+            const char* piece = pieces[(random >> 12) % (sizeof(pieces)/sizeof(pieces[0]))];
+            String_insert_cstr(&text_box->string, start, piece, strlen(piece));
+            Document_note_edit(&document, start, NULL, 0, strlen(piece));
+        }
+        Column_map_invalidate_all();
+
+        // the cursor is on the screen, and its row matches the row counted from the start of the text
+        const String* string = &text_box->string;
+        assert(other.scroll.offset <= other.pos.cursor && other.pos.cursor <= string->count && "test failed");
+        assert(other.scroll.offset == cal_start_visual_line(string, other.scroll.offset, max_visual_width) && "test failed");
+        assert(other.pos.visual_x == cal_visual_x_at_cursor(string, other.pos.cursor, max_visual_width) && "test failed");
+        size_t screen_y = other.pos.visual_y - other.scroll.y;
+        assert(screen_y < max_visual_height && "test failed");
+        size_t expected_screen_y = cal_visual_y_at_cursor(string, other.pos.cursor, max_visual_width) - 
+            cal_visual_y_at_cursor(string, other.scroll.offset, max_visual_width);
+        assert(screen_y == expected_screen_y && "test failed");
+        if (!other.scroll.is_y_relative) {
+            assert(other.pos.visual_y == cal_visual_y_at_cursor(string, other.pos.cursor, max_visual_width) && "test failed");
+        }
+    }
+
+    Document_free(&document);
+}
+
+
+void test_split(void) {
+    test_template_split(3, 4);
+    test_template_split(7, 6);
+    test_template_split(TEXT_BOX_NO_WRAP, 5);
+}
+
+
+// files are opened by several threads, and every document keeps its cursor while another one is displayed
+void test_documents(void) {
+    enum {COUNT_FILES = 12};
+    char file_names[COUNT_FILES][64];
+    Editor* editor = Editor_get();
+    for (size_t idx = 0; idx < COUNT_FILES; idx++) {
+        snprintf(file_names[idx], sizeof(file_names[idx]), "/tmp/new_text_editor_test_XXXXXX");
+        int fd = mkstemp(file_names[idx]);
+        assert(fd >= 0 && "test failed");
+        FILE* file = fdopen(fd, "w");
+        for (size_t idx_line = 0; idx_line <= idx; idx_line++) {
+            fprintf(file, "file %zu line %zu\r\n", idx, idx_line);
+        }
+        fclose(file);
+        if (idx == 0) {
+            editor->document->file_name = file_names[idx];
+        } else {
+            Editor_add_document(editor, file_names[idx]);
+        }
+    }
+    Editor_add_document(editor, "/tmp/new_text_editor_test_does_not_exist");
+    assert(Editor_open_files(editor) && "test failed");
+
+    for (size_t idx = 0; idx < COUNT_FILES; idx++) {
+        const Document* document = editor->documents.items[idx];
+        char expected[64];
+        int len = snprintf(expected, sizeof(expected), "file %zu line 0\n", idx);
+        assert(document->line_ending == LINE_ENDING_CRLF && "test failed");
+        assert(line_scan_count_newlines(document->text_box.string.items, 0, document->text_box.string.count) == idx + 1 && "test failed");
+        assert(0 == memcmp(document->text_box.string.items, expected, len) && "test failed");
+    }
+    assert(editor->documents.items[COUNT_FILES]->text_box.string.count == 0 && "test failed");
+
+    Editor_set_size(editor, 20, 40);
+    Editor_switch_document(editor, 5);
+    Text_box_move_cursor_repeat(editor->file_text.text_box, DIR_DOWN, 3, 40, editor->file_text.height, false);
+    size_t cursor = editor->file_text.text_box->cursor_info.pos.cursor;
+    Editor_switch_document(editor, 1);
+    assert(editor->idx_document == 6 && "test failed");
+    Editor_switch_document(editor, -1);
+    assert(editor->idx_document == 5 && editor->file_text.text_box->cursor_info.pos.cursor == cursor && "test failed");
+    Editor_switch_document(editor, -6);
+    assert(editor->idx_document == COUNT_FILES && editor->file_text.text_box == &editor->documents.items[COUNT_FILES]->text_box && "test failed");
+
+    for (size_t idx = 0; idx < COUNT_FILES; idx++) {
+        remove(file_names[idx]);
+    }
+    Editor_free(editor);
+    free(editor);
+}
+
+
 void do_tests(void) {
     test_get_index_start_next_line();
+    test_line_scan();
+    test_no_wrap();
+    test_jump();
+    test_move_repeat();
+    test_rewrap();
     test_Text_box_get_index_scroll_offset();
+    test_Viewport_build();
+    test_highlight();
+    test_utf8();
+    test_long_lines_no_wrap();
+    test_column_map_edits();
+    test_tabs();
+    test_line_endings();
+    test_syntax();
+    test_syntax_lexer();
+    test_brackets();
+    test_folds();
+    test_documents();
+    test_split();
+    test_multi_cursor();
+    test_clipboard();
+    test_clipboard_ring(7, 6);
 }
 #endif // DO_NO_TESTS
 
@@ -626,7 +1957,7 @@ void do_tests(void) {
 int main(int argc, char** argv) {
     log_file = fopen(LOG_FILE_NAME, "w");
     if (!log_file) {
-        log("fetal error: log file \"%s\" could not be opened", LOG_FILE_NAME);
+        fprintf(stderr, "fetal error: log file \"%s\" could not be opened\n", LOG_FILE_NAME);
         abort();
     }
 
@@ -634,22 +1965,45 @@ int main(int argc, char** argv) {
         do_tests();
 #   endif // DO_NO_TESTS
 
-    if (!initscr()) {
-        log("fetal error: initscr failed");
-        abort();
+    Editor* editor = Editor_get();
+    parse_args(editor, argc, argv);
+
+    // the text is drawn as utf-8 (see utf8.h)
+    setlocale(LC_ALL, "");
+    if (0 != strcmp(nl_langinfo(CODESET), "UTF-8")) {
+        if (!setlocale(LC_CTYPE, "C.UTF-8")) {
+            log("warning: no utf-8 locale; non ascii characters may not be drawn correctly");
+        }
     }
-	keypad(stdscr, TRUE); // We get F1, F2 etc..
-    //cbreak();
-    raw();	    // Line buffering disabled
-	noecho();	// Don't echo() while we do getch
-    nl();
-    refresh();
 
-    Editor* editor = Editor_get();
+    switch (editor->backend) {
+    case BACKEND_NCURSES:
+        if (!initscr()) {
+            log("fetal error: initscr failed");
+            abort();
+        }
+        keypad(stdscr, TRUE); // We get F1, F2 etc..
+        //cbreak();
+        raw();	    // Line buffering disabled
+        noecho();	// Don't echo() while we do getch
+        nl();
+        refresh();
+        break;
+    case BACKEND_VT:
+        if (!Vt_screen_enter(&editor->vt)) {
+            fprintf(stderr, "fetal error: could not set up terminal for --vt\n");
+            abort();
+        }
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+    set_bracketed_paste(true);
+    Editor_init_colors(editor);
 
     //set_escdelay(100);
-    parse_args(editor, argc, argv);
-    Editor_open_file(editor);
+    Editor_open_files(editor);
     Editor_init_windows(editor);
 
     debug("thing size Text_box: %zu", sizeof(editor->file_text));
@@ -657,46 +2011,70 @@ int main(int argc, char** argv) {
     bool should_close = false;
     bool should_resize_window = true;
 
+    Keys keys;
+    Keys_init(&keys);
+
     while (!should_close) {
 
-        // draw
-        clear();    // erase();
+        // layout
         if (should_resize_window) {
             debug("Windows_do_resize");
             Editor_do_resize(editor);
-            assert(editor->file_text.width >= 1);
-            assert(editor->file_text.height >= 1);
-            debug("width of main: %d", editor->file_text.width);
-            Text_box_recalculate_visual_xy_and_scroll_offset(&editor->file_text.text_box, editor->file_text.width);
         }
+        Editor_clear_screen(editor);
+        Editor_update_layout(editor, should_resize_window);
+        Timing_phase_end(&editor->timing, PHASE_LAYOUT);
 
+        // draw
         bool show_search_cursor = (editor->state == STATE_SEARCH);
-        draw_window(&editor->file_text, false, editor->state, &editor->search_query.text_box.string, editor->misc_info);
-        draw_window(&editor->general_info, false, editor->state, &editor->search_query.text_box.string, editor->misc_info);
-        draw_window(&editor->search_query, show_search_cursor, editor->state, &editor->search_query.text_box.string, editor->misc_info);
-        draw_window(&editor->save_info, false, editor->state, &editor->search_query.text_box.string, editor->misc_info);
+        draw_window(editor, &editor->file_text, false);
+        draw_split(editor);
+        draw_window(editor, &editor->general_info, false);
+        draw_window(editor, &editor->search_query, show_search_cursor);
+        draw_window(editor, &editor->save_info, false);
 
+        // position and draw cursor
         //if (editor->state == STATE_INSERT) {
-            draw_cursor(editor->file_text.window, &editor->file_text.text_box);
+            draw_cursor(editor, &editor->file_text);
+            if (editor->backend == BACKEND_NCURSES) {
+                wnoutrefresh(editor->file_text.window);
+            }
         //} 
-
-        // position and draw cursor
         debug("draw cursor");
+        Timing_phase_end(&editor->timing, PHASE_DRAW);
+
+        // flush
+        Editor_flush_screen(editor);
+        Timing_phase_end(&editor->timing, PHASE_FLUSH);
+        Timing_key_end(&editor->timing);
+
+        // get and process next keystroke (and any keystrokes that are already queued)
+        if (editor->backend == BACKEND_VT) {
+            Keys_read_pending_vt(&keys, &editor->timing);
+        } else {
+            Keys_read_pending(&keys, editor->file_text.window, &editor->timing);
+        }
 
-        // get and process next keystroke
-        process_next_input(&should_resize_window, editor, &should_close);
+        process_input_batch(&should_resize_window, editor, &should_close, &keys);
+        Timing_phase_end(&editor->timing, PHASE_PROCESS);
         debug("AFTER process_next_input; visual_x: %zu; visual_y: %zu; cursor: %zu; scroll_y: %zu, char at cursor: %c",
-            editor->file_text.text_box.cursor_info.pos.visual_x,
-            editor->file_text.text_box.cursor_info.pos.visual_y,
-            editor->file_text.text_box.cursor_info.pos.cursor,
-            editor->file_text.text_box.cursor_info.scroll.y,
-            String_at(&editor->file_text.text_box.string, editor->file_text.text_box.cursor_info.pos.cursor)
+            editor->file_text.text_box->cursor_info.pos.visual_x,
+            editor->file_text.text_box->cursor_info.pos.visual_y,
+            editor->file_text.text_box->cursor_info.pos.cursor,
+            editor->file_text.text_box->cursor_info.scroll.y,
+            String_at(&editor->file_text.text_box->string, editor->file_text.text_box->cursor_info.pos.cursor)
         );
         debug("\n");
-        assert(editor->file_text.text_box.cursor_info.pos.cursor < editor->file_text.text_box.string.count + 1);
+        assert(editor->file_text.text_box->cursor_info.pos.cursor < editor->file_text.text_box->string.count + 1);
+    }
+    set_bracketed_paste(false);
+    if (editor->backend == BACKEND_VT) {
+        Vt_screen_leave(&editor->vt);
+    } else {
+        endwin();
     }
-    endwin();
 
+    Keys_free(&keys);
     Editor_free(editor);
     free(editor);
 
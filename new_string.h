@@ -12,6 +12,7 @@
 #include <string.h>
 
 define_vector(char)
+define_vector(size_t)
 
 
 typedef Vector_char String;
@@ -45,13 +46,32 @@ static inline void String_insert_substring(String* dest, size_t dest_index, cons
 
 
 static inline void String_insert_string(String* dest, size_t index, const String* src) {
-    vector_insert_vector_char(dest, src, index);
+    vector_insert_items_char(dest, src->items, src->count, index);
 }
 
 
 static inline void String_insert_cstr(String* dest, size_t index_dest, const char* src, size_t len_src) {
-    for (size_t idx_src = 0; idx_src < len_src; idx_src++) {
-        vector_insert_char(dest, &src[idx_src], index_dest + idx_src);
+    vector_insert_items_char(dest, src, len_src, index_dest);
+}
+
+
+// insert string[src_start, src_start + count) at index of the same string
+static inline void String_insert_from_self(String* string, size_t index, size_t src_start, size_t count) {
+    assert(index <= string->count && src_start + count <= string->count);
+    vector_enlarge_if_nessessary_char(string, string->count + count);
+    char* items = string->items;
+    memmove(items + index + count, items + index, string->count - index);
+    string->count += count;
+
+    // the part of the source at or after index was moved by count
+    if (src_start >= index) {
+        memcpy(items + index, items + src_start + count, count);
+    } else if (src_start + count <= index) {
+        memcpy(items + index, items + src_start, count);
+    } else {
+        size_t count_before = index - src_start;
+        memcpy(items + index, items + src_start, count_before);
+        memcpy(items + index + count_before, items + index + count, count - count_before);
     }
 }
 
@@ -102,6 +122,16 @@ static inline bool String_del(String* string, size_t index) {
 }
 
 
+static inline bool String_del_substr(String* string, size_t index, size_t count) {
+    if (index + count > string->count) {
+        return false;
+    }
+
+    vector_remove_range_char(string, index, count);
+    return true;
+}
+
+
 static inline bool String_pop(char* popped_item, String* string) {
     if (string->count < 1) {
         return false;
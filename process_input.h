@@ -0,0 +1,493 @@
+#ifndef PROCESS_INPUT_H
+#define PROCESS_INPUT_H
+
+
+#include "util.h"
+#include "editor.h"
+#include "text_box.h"
+#include "input.h"
+
+
+static void process_next_input(bool* should_resize_window, Editor* editor, bool* should_close, int new_ch) {
+    *should_resize_window = false;
+
+    Text_box* main_box = editor->file_text.text_box;
+    Text_box* search_box = editor->search_query.text_box;
+
+    switch (editor->state) {
+
+    case STATE_INSERT: {
+        switch (new_ch) {
+        case KEY_RESIZE: {
+            *should_resize_window = true;
+        } break;
+        case ctrl('i'): {
+            editor->state = STATE_COMMAND;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, COMMAND_TEXT, strlen(COMMAND_TEXT));
+        } break;
+        case ctrl('f'): {
+            editor->state = STATE_SEARCH;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, SEARCH_TEXT, strlen(SEARCH_TEXT));
+        } break;
+        case ctrl('q'): {
+            Text_box_toggle_visual_mode(main_box);
+        } break;
+        case ctrl('s'): {
+            Editor_save(editor);
+        } break;
+        case ctrl('c'): {
+            Editor_cpy_selection(editor);
+        } break;
+        case ctrl('v'): {
+            Editor_paste_selection(editor);
+        } break;
+        case ctrl('x'): {
+            Editor_cut_selection(editor);
+        } break;
+        case ctrl('z'): {
+            if (!Editor_undo(editor)) {
+                const char* undo_failure_text = "already at oldest change";
+                String_cpy_from_cstr(&editor->general_info.text_box->string, undo_failure_text, strlen(undo_failure_text));
+                editor->gen_info_state = GEN_INFO_OLDEST_CHANGE;
+            }
+        } break;
+        case ctrl('y'): {
+            if (!Editor_redo(editor)) {
+                const char* redo_failure_text = "already at newest change";
+                String_cpy_from_cstr(&editor->general_info.text_box->string, redo_failure_text, strlen(redo_failure_text));
+                editor->gen_info_state = GEN_INFO_NEWEST_CHANGE;
+            }
+        } break;
+        case KEY_LEFT: {
+            Editor_move_cursor(editor, DIR_LEFT, 1);
+        } break;
+        case KEY_RIGHT: {
+            Editor_move_cursor(editor, DIR_RIGHT, 1);
+        } break;
+        case KEY_UP: {
+            Text_box_move_cursor(main_box, DIR_UP, Text_win_wrap_width(&editor->file_text), editor->file_text.height, false);
+        } break;
+        case KEY_DOWN: {
+            Text_box_move_cursor(main_box, DIR_DOWN, Text_win_wrap_width(&editor->file_text), editor->file_text.height, false);
+        } break;
+        case KEY_HOME: {
+            Editor_jump(editor, JUMP_START_OF_LINE);
+        } break;
+        case KEY_END: {
+            Editor_jump(editor, JUMP_END_OF_LINE);
+        } break;
+        case KEY_PPAGE: {
+            Editor_jump(editor, JUMP_PAGE_UP);
+        } break;
+        case KEY_NPAGE: {
+            Editor_jump(editor, JUMP_PAGE_DOWN);
+        } break;
+        case KEY_BACKSPACE: {
+            if (main_box->cursor_info.pos.cursor > 0 || editor->document->cursors.count > 0) {
+                Editor_del_main_file_text(editor, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+            }
+        } break;
+        case KEY_ENTER: {
+            String new_str;
+            String_init(&new_str);
+            String_append(&new_str, '\n');
+            Editor_insert_into_main_file_text(editor, &new_str, main_box->cursor_info.pos.cursor, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+            String_free_char_data(&new_str);
+        } break;
+        default: {
+            String new_str;
+            String_init(&new_str);
+            String_append(&new_str, new_ch);
+            Editor_insert_into_main_file_text(editor, &new_str, main_box->cursor_info.pos.cursor, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+            String_free_char_data(&new_str);
+        } break;
+    } break;
+    }
+
+    case STATE_SEARCH: {
+        switch (new_ch) {
+        case KEY_RESIZE: {
+            *should_resize_window = true;
+        } break;
+        case ctrl('i'): {
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case ctrl('f'): {
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case ctrl('s'): {
+            assert(false && "not implemented");
+            //editor_save(editor);
+        } break;
+        case KEY_LEFT: {
+            Text_box_move_cursor(search_box, DIR_LEFT, editor->general_info.width, editor->file_text.height, false);
+        } break;
+        case KEY_RIGHT: {
+            Text_box_move_cursor(search_box, DIR_RIGHT, editor->general_info.width, editor->file_text.height, false);
+        } break;
+        case KEY_UP: {
+            //assert(false && "not implemented");
+        } break;
+        case KEY_DOWN: {
+            //assert(false && "not implemented");
+        } break;
+        case KEY_BACKSPACE: {
+            if (editor->search_query.text_box->cursor_info.pos.cursor > 0) {
+                Text_box* search_box = editor->search_query.text_box;
+                size_t start_prev_char = get_start_prev_char(&search_box->string, search_box->cursor_info.pos.cursor);
+                Text_box_del_ch(search_box, start_prev_char, editor->file_text.width, editor->file_text.height);
+            }
+        } break;
+        case ctrl('n'): // fallthrough
+        case KEY_ENTER: // fallthrough
+        case '\n': { 
+            debug("search before: cursor: %zu", main_box->cursor_info.pos.cursor);
+            switch (editor->search_status) {
+            case SEARCH_FIRST:
+                break;
+            case SEARCH_REPEAT:
+                // move cursor by one to avoid getting the same search result again if there are multiple search results
+                Text_box_move_cursor(main_box, DIR_RIGHT, Text_win_wrap_width(&editor->file_text), editor->file_text.height, true);
+                break;
+            default:
+                assert(false && "unreachable");
+                abort();
+            }
+            debug("search after part 1: cursor: %zu", main_box->cursor_info.pos.cursor);
+            if (Text_box_do_search(
+                main_box,
+                &search_box->string,
+                SEARCH_DIR_FORWARDS,
+                Text_win_wrap_width(&editor->file_text),
+                editor->file_text.height
+            )) {
+                debug("search yes");
+                editor->search_status = SEARCH_REPEAT;
+                String_cpy_from_cstr(&editor->general_info.text_box->string, SEARCH_TEXT, strlen(SEARCH_TEXT));
+            } else {
+                debug("search no");
+                String_cpy_from_cstr(&editor->general_info.text_box->string, SEARCH_FAILURE_TEXT, strlen(SEARCH_FAILURE_TEXT));
+            }
+            debug("search end: cursor: %zu", main_box->cursor_info.pos.cursor);
+            //editor->state = STATE_INSERT;
+            //String_cpy_from_cstr(&editor->general_info.box.str, insert_text, strlen(insert_text));
+        } break;
+        case ctrl('p'): {
+            switch (editor->search_status) {
+            case SEARCH_FIRST:
+                break;
+            case SEARCH_REPEAT:
+                Text_box_move_cursor(main_box, DIR_LEFT, Text_win_wrap_width(&editor->file_text), editor->file_text.height, true);
+                break;
+            default:
+                assert(false && "unreachable");
+                abort();
+            }
+            if (Text_box_do_search(
+                    main_box,
+                    &editor->search_query.text_box->string,
+                    SEARCH_DIR_BACKWARDS,
+                    Text_win_wrap_width(&editor->file_text),
+                    editor->file_text.height
+                )) {
+                editor->search_status = SEARCH_REPEAT;
+                String_cpy_from_cstr(&editor->general_info.text_box->string, SEARCH_TEXT, strlen(SEARCH_TEXT));
+            } else {
+                String_cpy_from_cstr(&editor->general_info.text_box->string, SEARCH_FAILURE_TEXT, strlen(SEARCH_FAILURE_TEXT));
+            }
+        } break;
+        default: {
+            Text_box_insert_ch(editor->search_query.text_box, new_ch, editor->search_query.text_box->cursor_info.pos.cursor, editor->file_text.width, editor->file_text.height);
+        } break;
+        }
+    } break;
+
+    case STATE_COMMAND: {
+        switch (new_ch) {
+        case KEY_RESIZE: {
+            *should_resize_window = true;
+        } break;
+        case 'q': {
+            if (Editor_has_unsaved_changes(editor)) {
+                editor->state = STATE_QUIT_CONFIRM;
+                String_cpy_from_cstr(&editor->general_info.text_box->string, QUIT_CONFIRM_TEXT, strlen(QUIT_CONFIRM_TEXT));
+            } else {
+                *should_close = true;
+            }
+        } break;
+        case ctrl('i'): // fallthrough
+        case KEY_BACKSPACE: {
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'w':   // fallthrough
+        case 's':   // fallthrough
+        case ctrl('s'): {
+            Editor_save(editor);
+        } break;
+        case 'r': {
+            Editor_toggle_wrap(editor);
+        } break;
+        case 'g': {
+            Editor_jump(editor, JUMP_START_OF_FILE);
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'G': {
+            Editor_jump(editor, JUMP_END_OF_FILE);
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case '%': {
+            if (!Editor_jump_to_matching_bracket(editor)) {
+                const char* no_match_text = "[command]: no matched bracket at the cursor";
+                String_cpy_from_cstr(&editor->general_info.text_box->string, no_match_text, strlen(no_match_text));
+                break;
+            }
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'z': {
+            if (!Editor_toggle_fold(editor)) {
+                const char* no_fold_text = "[command]: nothing to fold at the cursor";
+                String_cpy_from_cstr(&editor->general_info.text_box->string, no_fold_text, strlen(no_fold_text));
+                break;
+            }
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'Z': {
+            Editor_open_all_folds(editor);
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'n': {
+            Editor_switch_document(editor, 1);
+        } break;
+        case 'p': {
+            Editor_switch_document(editor, -1);
+        } break;
+        case '-':   // fallthrough
+        case '|': {
+            Editor_split(editor, new_ch == '-' ? SPLIT_HORIZONTAL : SPLIT_VERTICAL);
+            *should_resize_window = true;
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'o': {
+            Editor_focus_other_window(editor);
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'O': {
+            Editor_close_other_window(editor);
+            *should_resize_window = true;
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case 'm': {
+            editor->state = STATE_INSERT;
+            Editor_add_cursors(editor);
+        } break;
+        case 'M': {
+            Document_clear_cursors(editor->document);
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        case '"': {
+            editor->state = STATE_REGISTER;
+            editor->recent_num = 0;
+            Editor_update_register_text(editor);
+        } break;
+        case 'l': {
+            editor->state = STATE_GO_TO_LINE;
+            editor->go_to_line_num = 0;
+            Editor_update_go_to_line_text(editor);
+        } break;
+        case 't': {
+            if (!editor->timing.enabled) {
+                editor->timing.enabled = true;
+                const char* timing_enabled_text = "[timing]: enabled; press t in command mode again to view results";
+                String_cpy_from_cstr(&editor->general_info.text_box->string, timing_enabled_text, strlen(timing_enabled_text));
+                break;
+            }
+            Timing_report(&editor->general_info.text_box->string, &editor->timing);
+        } break;
+        case 27: {
+            //nodelay(window, true);
+            //
+            log("warning: keys with escape sequence (unimplemented) pressed in command mode\n");
+            //if (-1 == getch()) { /* esc */
+            //    text->state = state_insert;
+            //} else {
+            //    log("warning: alt key (unimplemented) pressed in command mode\n");
+            //}
+            //nodelay(window, false);
+        } break;
+        default: {
+            log("warning: unsupported key pressed in command mode\n");
+        } break;
+        }
+    } break;
+
+    case STATE_GO_TO_LINE: {
+        switch (new_ch) {
+        case KEY_RESIZE: {
+            *should_resize_window = true;
+        } break;
+        case KEY_BACKSPACE: {
+            editor->go_to_line_num /= 10;
+            Editor_update_go_to_line_text(editor);
+        } break;
+        case KEY_ENTER: // fallthrough
+        case '\n': {
+            Editor_go_to_line(editor, editor->go_to_line_num);
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        default: {
+            if (new_ch >= '0' && new_ch <= '9') {
+                if (editor->go_to_line_num < SIZE_MAX / 10 - 10) {
+                    editor->go_to_line_num = editor->go_to_line_num * 10 + (new_ch - '0');
+                }
+                Editor_update_go_to_line_text(editor);
+                break;
+            }
+            // any other key cancels
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        }
+    } break;
+
+    case STATE_REGISTER: {
+        switch (new_ch) {
+        case KEY_RESIZE: {
+            *should_resize_window = true;
+        } break;
+        case KEY_BACKSPACE: {
+            editor->recent_num /= 10;
+            Editor_update_register_text(editor);
+        } break;
+        case KEY_ENTER: // fallthrough
+        case '\n': {
+            editor->state = STATE_INSERT;
+            Editor_select_recent(editor, editor->recent_num);
+        } break;
+        default: {
+            if (new_ch >= '0' && new_ch <= '9') {
+                if (editor->recent_num < CLIPBOARD_RING_SIZE) {
+                    editor->recent_num = editor->recent_num * 10 + (new_ch - '0');
+                }
+                Editor_update_register_text(editor);
+                break;
+            }
+            editor->state = STATE_INSERT;
+            if (new_ch >= 'a' && new_ch <= 'z') {
+                Editor_select_register(editor, (char)new_ch);
+                break;
+            }
+            // any other key cancels
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+        }
+    } break;
+
+    case STATE_QUIT_CONFIRM: {
+        switch (new_ch) {
+        case 'y': //fallthrough
+        case 'Y': {
+            *should_close = true;
+        } break;
+        default:
+            editor->state = STATE_INSERT;
+            String_cpy_from_cstr(&editor->general_info.text_box->string, INSERT_TEXT, strlen(INSERT_TEXT));
+        } break;
+    } break;
+    }
+}
+
+
+static void process_paste(Editor* editor, const String* pasted_text) {
+    if (pasted_text->count < 1) {
+        return;
+    }
+
+    switch (editor->state) {
+    case STATE_INSERT: {
+        // inserted as one undoable action
+        Text_box* main_box = editor->file_text.text_box;
+        Editor_insert_into_main_file_text(editor, pasted_text, main_box->cursor_info.pos.cursor, Text_win_wrap_width(&editor->file_text), editor->file_text.height);
+    } break;
+    case STATE_SEARCH: {
+        Text_box* search_box = editor->search_query.text_box;
+        Text_box_insert_substr(search_box, pasted_text, search_box->cursor_info.pos.cursor, editor->file_text.width, editor->file_text.height);
+    } break;
+    default:
+        log("warning: paste ignored in current mode");
+        break;
+    }
+}
+
+
+// apply every key of the batch; the screen is redrawn once afterwards
+static void process_input_batch(bool* should_resize_window, Editor* editor, bool* should_close, const Keys* keys) {
+    *should_resize_window = false;
+
+    size_t idx_key = 0;
+    size_t idx_paste = 0;
+    size_t paste_offset = 0;
+    while (idx_key < keys->keys.count && !*should_close) {
+        int curr_key = keys->keys.items[idx_key];
+
+        if (curr_key == KEY_PASTE) {
+            size_t count_paste = keys->paste_counts.items[idx_paste];
+            String pasted_text = {.count = count_paste, .capacity = count_paste, .items = keys->pastes.items + paste_offset};
+            process_paste(editor, &pasted_text);
+            paste_offset += count_paste;
+            idx_paste++;
+            idx_key++;
+            continue;
+        }
+
+        // bytes of one utf-8 character arrive as separate keys; they are inserted together
+        if ((editor->state == STATE_INSERT || editor->state == STATE_SEARCH) && curr_key >= 0xc0 && curr_key < 0xf8) {
+            char bytes[UTF8_MAX_LEN];
+            size_t count_bytes = 0;
+            bytes[count_bytes++] = curr_key;
+            while (
+                count_bytes < UTF8_MAX_LEN && idx_key + count_bytes < keys->keys.count &&
+                keys->keys.items[idx_key + count_bytes] >= 0x80 && keys->keys.items[idx_key + count_bytes] < 0xc0
+            ) {
+                bytes[count_bytes] = keys->keys.items[idx_key + count_bytes];
+                count_bytes++;
+            }
+            String new_char = {.count = count_bytes, .capacity = count_bytes, .items = bytes};
+            process_paste(editor, &new_char);
+            idx_key += count_bytes;
+            continue;
+        }
+
+        // merge consecutive identical cursor moves into one move
+        DIRECTION direction;
+        if (editor->state == STATE_INSERT && key_get_direction(&direction, curr_key)) {
+            size_t count_same = 1;
+            while (idx_key + count_same < keys->keys.count && keys->keys.items[idx_key + count_same] == curr_key) {
+                count_same++;
+            }
+            Editor_move_cursor(editor, direction, count_same);
+            idx_key += count_same;
+            continue;
+        }
+
+        bool curr_should_resize = false;
+        process_next_input(&curr_should_resize, editor, should_close, curr_key);
+        *should_resize_window = *should_resize_window || curr_should_resize;
+        idx_key++;
+    }
+}
+
+
+#endif // PROCESS_INPUT_H
@@ -0,0 +1,205 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+
+// syntax highlighting of the text of a document
+//
+// every edit of the text is passed on to the highlighter when it is made (Syntax_note_edit), so that only what was
+// changed is lexed again; the spans of the text are only found for the rows that are displayed (Syntax_get_spans)
+// every language is highlighted by the built-in lexer (see syntax_lexer.h)
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+#include "line_scan.h"
+
+
+typedef enum {
+    SYNTAX_LANG_NONE = 0,
+    SYNTAX_LANG_C,
+    SYNTAX_LANG_SHELL,
+    SYNTAX_LANG_JSON,
+    SYNTAX_LANG_LOG,
+
+    SYNTAX_LANG_COUNT,
+} SYNTAX_LANG;
+
+
+typedef enum {
+    SYNTAX_NONE = 0,
+    SYNTAX_KEYWORD,
+    SYNTAX_TYPE,
+    SYNTAX_STRING,
+    SYNTAX_NUMBER,
+    SYNTAX_COMMENT,
+    SYNTAX_PREPROC,
+    SYNTAX_VARIABLE,
+
+    SYNTAX_COUNT,
+} SYNTAX_KIND;
+
+
+// text[start, end) is highlighted as kind
+typedef struct {
+    size_t start;
+    size_t end;
+    SYNTAX_KIND kind;
+} Syntax_span;
+
+
+define_vector(Syntax_span)
+
+
+// row (counted from 0) and byte column of a position in the text
+typedef struct {
+    size_t row;
+    size_t column;
+} Syntax_point;
+
+
+#include "syntax_lexer.h"
+
+
+typedef struct {
+    SYNTAX_LANG lang;
+    Syntax_lexer lexer;
+
+    // row of position anchor (so the row of an edit is counted from the last edit, not from the start of the text)
+    size_t anchor;
+    size_t anchor_row;
+} Syntax;
+
+
+static inline SYNTAX_LANG syntax_lang_from_file_name(const char* file_name) {
+    if (!file_name) {
+        return SYNTAX_LANG_NONE;
+    }
+    const char* extension = strrchr(file_name, '.');
+    if (!extension) {
+        return SYNTAX_LANG_NONE;
+    }
+    static const struct {const char* extension; SYNTAX_LANG lang;} langs[] = {
+        {".c", SYNTAX_LANG_C},
+        {".h", SYNTAX_LANG_C},
+        {".sh", SYNTAX_LANG_SHELL},
+        {".bash", SYNTAX_LANG_SHELL},
+        {".json", SYNTAX_LANG_JSON},
+        {".log", SYNTAX_LANG_LOG},
+    };
+    for (size_t idx = 0; idx < sizeof(langs)/sizeof(langs[0]); idx++) {
+        if (0 == strcmp(extension, langs[idx].extension)) {
+            return langs[idx].lang;
+        }
+    }
+    return SYNTAX_LANG_NONE;
+}
+
+
+static inline void Syntax_init(Syntax* syntax) {
+    memset(syntax, 0, sizeof(*syntax));
+}
+
+
+static inline void Syntax_free(Syntax* syntax) {
+    Syntax_lexer_free(&syntax->lexer);
+    Syntax_init(syntax);
+}
+
+
+// to be called when the whole text was replaced (eg. a file was opened)
+static inline void Syntax_set_lang(Syntax* syntax, SYNTAX_LANG lang) {
+    Syntax_free(syntax);
+    syntax->lang = lang;
+    Syntax_lexer_init(&syntax->lexer);
+}
+
+
+// point of position idx of string
+static inline Syntax_point Syntax_point_at(Syntax* syntax, const String* string, size_t idx) {
+    if (syntax->anchor > string->count) {
+        syntax->anchor = 0;
+        syntax->anchor_row = 0;
+    }
+    if (idx >= syntax->anchor) {
+        syntax->anchor_row += line_scan_count_newlines(string->items, syntax->anchor, idx);
+    } else {
+        syntax->anchor_row -= line_scan_count_newlines(string->items, idx, syntax->anchor);
+    }
+    syntax->anchor = idx;
+
+    size_t end_prev_line;
+    size_t start_line = line_scan_find_newline_backward(&end_prev_line, string->items, 0, idx) ? end_prev_line + 1 : 0;
+    return (Syntax_point){.row = syntax->anchor_row, .column = idx - start_line};
+}
+
+
+// to be called after count_removed bytes (rows_removed lines) at start of string were replaced by
+// string[start, start + count_inserted), when only the count of lines of the removed bytes is known
+// (eg. for edits at several cursors, which are noted as one edit from the first edit to the last one)
+static inline void Syntax_note_edit_rows(Syntax* syntax, const String* string, size_t start, size_t count_removed, size_t rows_removed, size_t count_inserted) {
+    if (syntax->lang == SYNTAX_LANG_NONE) {
+        return;
+    }
+
+    // the anchor is moved with the text after it (an anchor within the removed bytes is dropped, since the row of the
+    // edit cannot be counted from it)
+    size_t rows_inserted = line_scan_count_newlines(string->items, start, start + count_inserted);
+    if (syntax->anchor >= start + count_removed) {
+        syntax->anchor = syntax->anchor - count_removed + count_inserted;
+        syntax->anchor_row = syntax->anchor_row - rows_removed + rows_inserted;
+    } else if (syntax->anchor > start) {
+        syntax->anchor = 0;
+        syntax->anchor_row = 0;
+    }
+    Syntax_point start_point = Syntax_point_at(syntax, string, start);
+    Syntax_lexer_note_edit(
+        &syntax->lexer, syntax->lang, string, start_point.row, start - start_point.column,
+        count_removed, rows_removed, count_inserted, rows_inserted
+    );
+}
+
+
+// to be called after removed[0, count_removed) at start of string was replaced by string[start, start + count_inserted)
+static inline void Syntax_note_edit(
+    Syntax* syntax,
+    const String* string,
+    size_t start,
+    const char* removed,
+    size_t count_removed,
+    size_t count_inserted
+) {
+    if (syntax->lang == SYNTAX_LANG_NONE) {
+        return;
+    }
+
+    // an anchor within the removed bytes is moved to the start of the edit
+    if (syntax->anchor > start && syntax->anchor < start + count_removed) {
+        syntax->anchor_row -= line_scan_count_newlines(removed, 0, syntax->anchor - start);
+        syntax->anchor = start;
+    }
+    Syntax_note_edit_rows(syntax, string, start, count_removed, line_scan_count_newlines(removed, 0, count_removed), count_inserted);
+}
+
+
+// append the highlighted parts of string[start, end) to spans, sorted by start
+// (spans can be nested, eg. a string within a preprocessor directive)
+static inline void Syntax_append_spans(Vector_Syntax_span* spans, Syntax* syntax, const String* string, size_t start, size_t end) {
+    if (syntax->lang == SYNTAX_LANG_NONE) {
+        return;
+    }
+    Syntax_point start_point = Syntax_point_at(syntax, string, start);
+    Syntax_lexer_get_spans(spans, &syntax->lexer, syntax->lang, string, start_point.row, start - start_point.column, end);
+}
+
+
+// set spans to the highlighted parts of string[start, end)
+static inline void Syntax_get_spans(Vector_Syntax_span* spans, Syntax* syntax, const String* string, size_t start, size_t end) {
+    spans->count = 0;
+    Syntax_append_spans(spans, syntax, string, start, end);
+}
+
+
+#endif // SYNTAX_H
@@ -0,0 +1,547 @@
+#ifndef SYNTAX_LEXER_H
+#define SYNTAX_LEXER_H
+
+
+// built-in highlighter of syntax.h
+//
+// a language is a table of character classes and sorted lists of words; a line is lexed in one pass, starting in the
+// state that the line before it ended in (eg. within a block comment)
+// the state at the start of every line is kept, so that the rows that are displayed are lexed without lexing the
+// text before them again; after an edit, the lines from the edited one on are lexed again until a line starts in the
+// same state that it started in before the edit
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "vector.h"
+#include "new_string.h"
+#include "line_scan.h"
+
+
+// state at the start of a line
+typedef enum {
+    SYNTAX_LEX_NORMAL = 0,
+    SYNTAX_LEX_BLOCK_COMMENT,
+    SYNTAX_LEX_STRING_DOUBLE,
+    SYNTAX_LEX_STRING_SINGLE,
+} SYNTAX_LEX_STATE;
+
+
+typedef enum {
+    SYNTAX_CLASS_OTHER = 0,
+    SYNTAX_CLASS_WORD, // start of a keyword, type, or identifier
+    SYNTAX_CLASS_DIGIT,
+    SYNTAX_CLASS_DOUBLE_QUOTE,
+    SYNTAX_CLASS_SINGLE_QUOTE,
+    SYNTAX_CLASS_COMMENT, // first byte of a line comment or a block comment
+    SYNTAX_CLASS_PREPROC, // # at the start of a line
+    SYNTAX_CLASS_VARIABLE, // $name or ${name}
+} SYNTAX_CLASS;
+
+
+typedef struct {
+    const char* line_comment; // NULL if there are no line comments
+    const char* block_comment_start; // NULL if there are no block comments
+    const char* block_comment_end;
+    bool has_single_quote_strings;
+    bool has_multi_line_strings; // otherwise a string that is not closed ends at the end of the line
+    bool has_preproc;
+    bool has_variables;
+    bool has_keys; // a string that is followed by : is a key (highlighted as a type)
+    bool is_comment_at_word_start_only; // a line comment only starts after a space (eg. # in shell)
+    const char* extra_word_chars; // bytes (other than letters, digits, and _) that are part of a word
+    const char* extra_number_chars; // bytes (other than letters and digits) that are part of a number
+
+    // sorted (by strcmp)
+    const char* const* keywords;
+    size_t count_keywords;
+    const char* const* types;
+    size_t count_types;
+} Syntax_lang_def;
+
+
+static const char* const syntax_c_keywords[] = {
+    "break", "case", "const", "continue", "default", "do", "else", "enum", "extern", "for", "goto", "if", "inline",
+    "register", "restrict", "return", "sizeof", "static", "struct", "switch", "typedef", "union", "volatile", "while",
+};
+static const char* const syntax_c_types[] = {
+    "FILE", "bool", "char", "double", "float", "int", "int16_t", "int32_t", "int64_t", "int8_t", "long", "short",
+    "signed", "size_t", "ssize_t", "uint16_t", "uint32_t", "uint64_t", "uint8_t", "unsigned", "void",
+};
+static const char* const syntax_shell_keywords[] = {
+    "case", "do", "done", "elif", "else", "esac", "exit", "export", "fi", "for", "function", "if", "in", "local",
+    "return", "select", "then", "until", "while",
+};
+static const char* const syntax_json_keywords[] = {
+    "false", "null", "true",
+};
+static const char* const syntax_log_keywords[] = {
+    "DEBUG", "ERROR", "FATAL", "INFO", "TRACE", "WARN", "WARNING", "debug", "error", "fatal", "info", "note", "trace",
+    "warn", "warning",
+};
+
+#define SYNTAX_COUNT_OF(array) (sizeof(array)/sizeof((array)[0]))
+
+static const Syntax_lang_def syntax_lang_defs[SYNTAX_LANG_COUNT] = {
+    [SYNTAX_LANG_C] = {
+        .line_comment = "//",
+        .block_comment_start = "/*",
+        .block_comment_end = "*/",
+        .has_single_quote_strings = true,
+        .has_preproc = true,
+        .extra_word_chars = "",
+        .extra_number_chars = ".",
+        .keywords = syntax_c_keywords,
+        .count_keywords = SYNTAX_COUNT_OF(syntax_c_keywords),
+        .types = syntax_c_types,
+        .count_types = SYNTAX_COUNT_OF(syntax_c_types),
+    },
+    [SYNTAX_LANG_SHELL] = {
+        .line_comment = "#",
+        .has_single_quote_strings = true,
+        .has_multi_line_strings = true,
+        .has_variables = true,
+        .is_comment_at_word_start_only = true,
+        .extra_word_chars = "-",
+        .extra_number_chars = ".",
+        .keywords = syntax_shell_keywords,
+        .count_keywords = SYNTAX_COUNT_OF(syntax_shell_keywords),
+    },
+    [SYNTAX_LANG_JSON] = {
+        .has_keys = true,
+        .extra_word_chars = "",
+        .extra_number_chars = ".+-",
+        .keywords = syntax_json_keywords,
+        .count_keywords = SYNTAX_COUNT_OF(syntax_json_keywords),
+    },
+    [SYNTAX_LANG_LOG] = {
+        .extra_word_chars = "",
+        .extra_number_chars = ".:-",
+        .keywords = syntax_log_keywords,
+        .count_keywords = SYNTAX_COUNT_OF(syntax_log_keywords),
+    },
+};
+
+
+// bytes that continue a token
+#define SYNTAX_CHAR_WORD   (1 << 0)
+#define SYNTAX_CHAR_NUMBER (1 << 1)
+
+
+typedef struct {
+    uint8_t classes[256]; // SYNTAX_CLASS of a byte that starts a token
+    uint8_t flags[256]; // SYNTAX_CHAR_*
+    uint32_t word_lengths[256]; // bit len is set if a keyword or type of len bytes starts with the byte
+} Syntax_lexer_table;
+
+
+static inline void syntax_lexer_add_word_lengths(Syntax_lexer_table* table, const char* const* words, size_t count_words) {
+    for (size_t idx = 0; idx < count_words; idx++) {
+        size_t len = strlen(words[idx]);
+        assert(len < 32);
+        table->word_lengths[(unsigned char)words[idx][0]] |= (uint32_t)1 << len;
+    }
+}
+
+
+// table of a language (it is built the first time that the language is lexed)
+static inline const Syntax_lexer_table* syntax_lexer_table(SYNTAX_LANG lang) {
+    static Syntax_lexer_table tables[SYNTAX_LANG_COUNT];
+    static bool is_built[SYNTAX_LANG_COUNT];
+    Syntax_lexer_table* table = &tables[lang];
+    if (is_built[lang]) {
+        return table;
+    }
+
+    const Syntax_lang_def* def = &syntax_lang_defs[lang];
+    for (int byte = 0; byte < 256; byte++) {
+        if ((byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || byte == '_') {
+            table->classes[byte] = SYNTAX_CLASS_WORD;
+            table->flags[byte] = SYNTAX_CHAR_WORD | SYNTAX_CHAR_NUMBER;
+        } else if (byte >= '0' && byte <= '9') {
+            table->classes[byte] = SYNTAX_CLASS_DIGIT;
+            table->flags[byte] = SYNTAX_CHAR_WORD | SYNTAX_CHAR_NUMBER;
+        }
+    }
+    for (const char* curr_char = def->extra_word_chars; *curr_char; curr_char++) {
+        table->flags[(unsigned char)*curr_char] |= SYNTAX_CHAR_WORD;
+    }
+    for (const char* curr_char = def->extra_number_chars; *curr_char; curr_char++) {
+        table->flags[(unsigned char)*curr_char] |= SYNTAX_CHAR_NUMBER;
+    }
+
+    table->classes['"'] = SYNTAX_CLASS_DOUBLE_QUOTE;
+    if (def->has_single_quote_strings) {
+        table->classes['\''] = SYNTAX_CLASS_SINGLE_QUOTE;
+    }
+    if (def->line_comment) {
+        table->classes[(unsigned char)def->line_comment[0]] = SYNTAX_CLASS_COMMENT;
+    }
+    if (def->block_comment_start) {
+        table->classes[(unsigned char)def->block_comment_start[0]] = SYNTAX_CLASS_COMMENT;
+    }
+    if (def->has_preproc) {
+        table->classes['#'] = SYNTAX_CLASS_PREPROC;
+    }
+    if (def->has_variables) {
+        table->classes['$'] = SYNTAX_CLASS_VARIABLE;
+    }
+
+    syntax_lexer_add_word_lengths(table, def->keywords, def->count_keywords);
+    syntax_lexer_add_word_lengths(table, def->types, def->count_types);
+    is_built[lang] = true;
+    return table;
+}
+
+
+// returns true if items[0, len) is in words (which are sorted)
+static inline bool syntax_lexer_is_in_words(const char* const* words, size_t count_words, const char* items, size_t len) {
+    size_t low = 0;
+    size_t high = count_words;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strncmp(words[mid], items, len);
+        if (cmp == 0 && words[mid][len] != '\0') {
+            // items is a prefix of this word
+            cmp = 1;
+        }
+        if (cmp == 0) {
+            return true;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+
+static inline bool syntax_lexer_starts_with(const char* items, size_t idx, size_t end, const char* prefix) {
+    size_t len = strlen(prefix);
+    return end - idx >= len && 0 == memcmp(items + idx, prefix, len);
+}
+
+
+static inline void syntax_lexer_emit(Vector_Syntax_span* spans, size_t start, size_t end, SYNTAX_KIND kind) {
+    if (spans && start < end) {
+        Syntax_span span = {.start = start, .end = end, .kind = kind};
+        vector_append_Syntax_span(spans, &span);
+    }
+}
+
+
+// end of the block comment that continues at items[idx] (*is_closed is false if it does not end before end)
+static inline size_t syntax_lexer_skip_block_comment(bool* is_closed, const Syntax_lang_def* def, const char* items, size_t idx, size_t end) {
+    while (line_scan_find_byte_forward(&idx, items, idx, end, def->block_comment_end[0])) {
+        if (syntax_lexer_starts_with(items, idx, end, def->block_comment_end)) {
+            *is_closed = true;
+            return idx + strlen(def->block_comment_end);
+        }
+        idx++;
+    }
+    *is_closed = false;
+    return end;
+}
+
+
+// end of the string that continues at items[idx] (*is_closed is false if it does not end before end)
+static inline size_t syntax_lexer_skip_string(bool* is_closed, const char* items, size_t idx, size_t end, char quote) {
+    for (; idx < end; idx++) {
+        if (items[idx] == '\\') {
+            idx++;
+        } else if (items[idx] == quote) {
+            *is_closed = true;
+            return idx + 1;
+        }
+    }
+    *is_closed = false;
+    return end;
+}
+
+
+// lex one line, items[start, end) (without its \n), that starts in state
+// the highlighted parts of the line are appended to spans (if spans is not NULL)
+// returns the state that the next line starts in
+static inline uint8_t syntax_lex_line(Vector_Syntax_span* spans, SYNTAX_LANG lang, const char* items, size_t start, size_t end, uint8_t state) {
+    const Syntax_lang_def* def = &syntax_lang_defs[lang];
+    const Syntax_lexer_table* table = syntax_lexer_table(lang);
+    size_t idx = start;
+    bool is_closed;
+
+    // rest of what the line before ended in
+    switch (state) {
+    case SYNTAX_LEX_NORMAL:
+        break;
+    case SYNTAX_LEX_BLOCK_COMMENT:
+        idx = syntax_lexer_skip_block_comment(&is_closed, def, items, idx, end);
+        syntax_lexer_emit(spans, start, idx, SYNTAX_COMMENT);
+        if (!is_closed) {
+            return SYNTAX_LEX_BLOCK_COMMENT;
+        }
+        break;
+    case SYNTAX_LEX_STRING_DOUBLE: // fallthrough
+    case SYNTAX_LEX_STRING_SINGLE:
+        idx = syntax_lexer_skip_string(&is_closed, items, idx, end, state == SYNTAX_LEX_STRING_DOUBLE ? '"' : '\'');
+        syntax_lexer_emit(spans, start, idx, SYNTAX_STRING);
+        if (!is_closed) {
+            return state;
+        }
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+
+    while (idx < end) {
+        size_t token_start = idx;
+        char curr_char = items[idx];
+        switch (table->classes[(unsigned char)curr_char]) {
+        case SYNTAX_CLASS_OTHER:
+            idx++;
+            while (idx < end && table->classes[(unsigned char)items[idx]] == SYNTAX_CLASS_OTHER) {
+                idx++;
+            }
+            break;
+        case SYNTAX_CLASS_WORD: {
+            idx++;
+            while (idx < end && (table->flags[(unsigned char)items[idx]] & SYNTAX_CHAR_WORD)) {
+                idx++;
+            }
+            // (most words are not keywords or types; they are found without a search by their first byte and length)
+            size_t len = idx - token_start;
+            if (len >= 32 || !(table->word_lengths[(unsigned char)curr_char] & ((uint32_t)1 << len))) {
+                break;
+            }
+            if (syntax_lexer_is_in_words(def->keywords, def->count_keywords, items + token_start, len)) {
+                syntax_lexer_emit(spans, token_start, idx, SYNTAX_KEYWORD);
+            } else if (syntax_lexer_is_in_words(def->types, def->count_types, items + token_start, len)) {
+                syntax_lexer_emit(spans, token_start, idx, SYNTAX_TYPE);
+            }
+        } break;
+        case SYNTAX_CLASS_DIGIT:
+            idx++;
+            while (idx < end && (table->flags[(unsigned char)items[idx]] & SYNTAX_CHAR_NUMBER)) {
+                idx++;
+            }
+            syntax_lexer_emit(spans, token_start, idx, SYNTAX_NUMBER);
+            break;
+        case SYNTAX_CLASS_DOUBLE_QUOTE: // fallthrough
+        case SYNTAX_CLASS_SINGLE_QUOTE: {
+            idx = syntax_lexer_skip_string(&is_closed, items, idx + 1, end, curr_char);
+            SYNTAX_KIND kind = SYNTAX_STRING;
+            if (def->has_keys) {
+                size_t idx_after = idx;
+                while (idx_after < end && (items[idx_after] == ' ' || items[idx_after] == '\t')) {
+                    idx_after++;
+                }
+                if (idx_after < end && items[idx_after] == ':') {
+                    kind = SYNTAX_TYPE;
+                }
+            }
+            syntax_lexer_emit(spans, token_start, idx, kind);
+            if (!is_closed && def->has_multi_line_strings) {
+                return curr_char == '"' ? SYNTAX_LEX_STRING_DOUBLE : SYNTAX_LEX_STRING_SINGLE;
+            }
+        } break;
+        case SYNTAX_CLASS_COMMENT:
+            if (def->line_comment && syntax_lexer_starts_with(items, idx, end, def->line_comment) &&
+                !(def->is_comment_at_word_start_only && idx > start && items[idx - 1] != ' ' && items[idx - 1] != '\t')) {
+                syntax_lexer_emit(spans, token_start, end, SYNTAX_COMMENT);
+                return SYNTAX_LEX_NORMAL;
+            }
+            if (def->block_comment_start && syntax_lexer_starts_with(items, idx, end, def->block_comment_start)) {
+                idx = syntax_lexer_skip_block_comment(&is_closed, def, items, idx + strlen(def->block_comment_start), end);
+                syntax_lexer_emit(spans, token_start, idx, SYNTAX_COMMENT);
+                if (!is_closed) {
+                    return SYNTAX_LEX_BLOCK_COMMENT;
+                }
+                break;
+            }
+            idx++;
+            break;
+        case SYNTAX_CLASS_PREPROC: {
+            // only at the start of the line (after indentation)
+            size_t idx_before = idx;
+            while (idx_before > start && (items[idx_before - 1] == ' ' || items[idx_before - 1] == '\t')) {
+                idx_before--;
+            }
+            idx++;
+            if (idx_before == start) {
+                while (idx < end && (items[idx] == ' ' || (table->flags[(unsigned char)items[idx]] & SYNTAX_CHAR_WORD))) {
+                    idx++;
+                }
+                syntax_lexer_emit(spans, token_start, idx, SYNTAX_PREPROC);
+            }
+        } break;
+        case SYNTAX_CLASS_VARIABLE:
+            idx++;
+            if (idx < end && items[idx] == '{') {
+                size_t end_brace;
+                idx = line_scan_find_byte_forward(&end_brace, items, idx, end, '}') ? end_brace + 1 : end;
+            } else {
+                while (idx < end && (table->flags[(unsigned char)items[idx]] & SYNTAX_CHAR_WORD)) {
+                    idx++;
+                }
+            }
+            if (idx > token_start + 1) {
+                syntax_lexer_emit(spans, token_start, idx, SYNTAX_VARIABLE);
+            }
+            break;
+        default:
+            assert(false && "unreachable");
+            abort();
+        }
+    }
+    return SYNTAX_LEX_NORMAL;
+}
+
+
+define_vector(uint8_t)
+
+
+// after an edit, at most this many lines are lexed again (the states of the lines after them are dropped, and are
+// found again when those lines are displayed)
+#define SYNTAX_LEXER_MAX_RELEX_LINES 512
+
+
+typedef struct {
+    // state at the start of every line, for lines [0, line_states.count) (line 0 always starts in SYNTAX_LEX_NORMAL)
+    Vector_uint8_t line_states;
+    size_t start_last_line; // start of line line_states.count - 1
+} Syntax_lexer;
+
+
+static inline void Syntax_lexer_init(Syntax_lexer* lexer) {
+    memset(lexer, 0, sizeof(*lexer));
+    uint8_t state = SYNTAX_LEX_NORMAL;
+    vector_append_uint8_t(&lexer->line_states, &state);
+}
+
+
+static inline void Syntax_lexer_free(Syntax_lexer* lexer) {
+    free(lexer->line_states.items);
+    memset(lexer, 0, sizeof(*lexer));
+}
+
+
+// find the states of the lines up to line (line is counted from 0)
+// returns false if the text has fewer lines
+static inline bool Syntax_lexer_extend(Syntax_lexer* lexer, SYNTAX_LANG lang, const String* string, size_t line) {
+    while (lexer->line_states.count <= line) {
+        size_t end_line;
+        if (!line_scan_find_newline_forward(&end_line, string->items, lexer->start_last_line, string->count)) {
+            return false;
+        }
+        uint8_t state = syntax_lex_line(NULL, lang, string->items, lexer->start_last_line, end_line, *vector_back_uint8_t(&lexer->line_states));
+        vector_append_uint8_t(&lexer->line_states, &state);
+        lexer->start_last_line = end_line + 1;
+    }
+    return true;
+}
+
+
+// to be called after count_removed bytes (rows_removed lines) at start were replaced by count_inserted bytes
+// (rows_inserted lines), where start is on line (which starts at start_line)
+static inline void Syntax_lexer_note_edit(
+    Syntax_lexer* lexer,
+    SYNTAX_LANG lang,
+    const String* string,
+    size_t line,
+    size_t start_line,
+    size_t count_removed,
+    size_t rows_removed,
+    size_t count_inserted,
+    size_t rows_inserted
+) {
+    Vector_uint8_t* states = &lexer->line_states;
+    size_t last_line = states->count - 1;
+    if (line >= last_line) {
+        // states of the lines up to the edited one did not change
+        return;
+    }
+
+    if (line + rows_removed >= last_line) {
+        // last line with a state was removed
+        states->count = line + 1;
+        lexer->start_last_line = start_line;
+    } else {
+        // lines after the edited one are moved (the new lines are given a state below)
+        vector_remove_range_uint8_t(states, line + 1, rows_removed);
+        vector_enlarge_if_nessessary_uint8_t(states, states->count + rows_inserted);
+        memmove(states->items + line + 1 + rows_inserted, states->items + line + 1, states->count - line - 1);
+        states->count += rows_inserted;
+        lexer->start_last_line = lexer->start_last_line - count_removed + count_inserted;
+    }
+
+    // lex the lines from the edited one on until a line starts in the same state as it did before the edit
+    size_t curr_line = line;
+    size_t start_curr_line = start_line;
+    size_t count_relexed = 0;
+    while (curr_line + 1 < states->count) {
+        size_t end_line;
+        if (!line_scan_find_newline_forward(&end_line, string->items, start_curr_line, string->count)) {
+            // the text ends on this line (the states of the lines after it are out of date)
+            states->count = curr_line + 1;
+            lexer->start_last_line = start_curr_line;
+            return;
+        }
+        uint8_t state = syntax_lex_line(NULL, lang, string->items, start_curr_line, end_line, states->items[curr_line]);
+        curr_line++;
+        start_curr_line = end_line + 1;
+        if (curr_line > line + rows_inserted && states->items[curr_line] == state) {
+            return;
+        }
+        states->items[curr_line] = state;
+
+        count_relexed++;
+        if (count_relexed >= SYNTAX_LEXER_MAX_RELEX_LINES) {
+            states->count = curr_line + 1;
+            lexer->start_last_line = start_curr_line;
+            return;
+        }
+    }
+}
+
+
+// append the highlighted parts of the lines from line (which starts at start_line) until end to spans
+// (the states of the lines that are lexed are kept, if they were not known yet)
+static inline void Syntax_lexer_get_spans(
+    Vector_Syntax_span* spans,
+    Syntax_lexer* lexer,
+    SYNTAX_LANG lang,
+    const String* string,
+    size_t line,
+    size_t start_line,
+    size_t end
+) {
+    if (!Syntax_lexer_extend(lexer, lang, string, line)) {
+        return;
+    }
+
+    uint8_t state = lexer->line_states.items[line];
+    size_t start_curr_line = start_line;
+    while (1) {
+        size_t end_line;
+        bool has_newline = line_scan_find_newline_forward(&end_line, string->items, start_curr_line, string->count);
+        if (!has_newline) {
+            end_line = string->count;
+        }
+        state = syntax_lex_line(spans, lang, string->items, start_curr_line, end_line, state);
+        if (!has_newline || end_line + 1 >= end) {
+            return;
+        }
+
+        line++;
+        start_curr_line = end_line + 1;
+        if (line == lexer->line_states.count) {
+            vector_append_uint8_t(&lexer->line_states, &state);
+            lexer->start_last_line = start_curr_line;
+        }
+    }
+}
+
+
+#endif // SYNTAX_LEXER_H
@@ -5,10 +5,18 @@
 #include "str_view.h"
 #include "util.h"
 #include "new_string.h"
+#include "line_scan.h"
+#include "columns.h"
+#include "fold.h"
 
 
 typedef enum {DIR_UP, DIR_DOWN, DIR_RIGHT, DIR_LEFT} DIRECTION;
-typedef enum {STATE_INSERT = 0, STATE_COMMAND, STATE_SEARCH, STATE_QUIT_CONFIRM} ED_STATE;
+typedef enum {JUMP_START_OF_FILE, JUMP_END_OF_FILE, JUMP_START_OF_LINE, JUMP_END_OF_LINE, JUMP_PAGE_UP, JUMP_PAGE_DOWN} JUMP;
+
+
+// pass as max_visual_width to disable wrapping (every visual line is then an actual line)
+#define TEXT_BOX_NO_WRAP SIZE_MAX
+typedef enum {STATE_INSERT = 0, STATE_COMMAND, STATE_SEARCH, STATE_QUIT_CONFIRM, STATE_GO_TO_LINE, STATE_REGISTER} ED_STATE;
 typedef enum {VIS_STATE_NONE = 0, VIS_STATE_ON} VISUAL_STATE;
 
 
@@ -32,6 +40,7 @@ typedef struct {
 
     size_t visual_y; // visual line that the cursor is currently at 
                      // (0 means that the cursor is on the first line of visual text)
+                     // (after a jump, counted from TEXT_BOX_VISUAL_Y_ANCHOR instead; see Scroll_data)
 } Pos_data;
 
 
@@ -40,9 +49,16 @@ typedef struct {
     size_t x; // amount right that the text is scrolled to the right (not in terms of screen)
     size_t y; // count visual lines that the text is scrolled down (not in terms of screen)
     size_t user_max_col; // column that cursor should be if possible
+    bool is_y_relative; // y and visual_y of the cursor are counted from TEXT_BOX_VISUAL_Y_ANCHOR at the
+                        // destination of a jump, not from the start of the text (only their difference is used)
 } Scroll_data;
 
 
+// counting the visual lines before the destination of a jump would walk the whole text,
+// so visual_y/scroll.y restart here instead (leaving room to move up from the destination)
+#define TEXT_BOX_VISUAL_Y_ANCHOR (SIZE_MAX / 2)
+
+
 typedef struct {
     Pos_data pos;
     Scroll_data scroll;
@@ -58,6 +74,65 @@ typedef struct {
 } Text_box;
 
 
+// column maps: the columns of the characters of an actual line, so that the column of a position on a line with tabs
+// (where the width of a tab depends on every character before it), or on a very long line, is found without walking
+// the line from its start
+// a map has a checkpoint at the start of every visual line, and every COLUMN_MAP_STEP bytes within a visual line
+// the maps of the last few lines that were used are kept; an edit only drops the map of the edited line (see 
+// Column_map_update_after_edit); every map is only dropped when a text is replaced (see Column_map_invalidate_all)
+
+
+#define COLUMN_MAP_CACHE_SIZE 8
+#define COLUMN_MAP_STEP 512
+
+// lines of printable ascii that are shorter than this are not mapped (a byte search is faster than a map)
+#define COLUMN_MAP_MIN_BYTES 4096
+
+
+typedef struct {
+    size_t cursor; // at the start of a character
+    size_t start_line; // start of the visual line that cursor is on
+    size_t visual_x; // column of cursor on that visual line
+} Column_checkpoint;
+
+define_vector(Column_checkpoint)
+
+typedef struct {
+    // the map is only used for the text, wrap width, and tab width that it was built for
+    const String* string;
+    const char* items;
+    size_t count;
+    size_t count_edits;
+    size_t max_visual_width;
+    size_t tab_width;
+
+    size_t start; // start of the actual line
+    size_t end; // its \n (or the end of the text)
+    bool is_plain; // the line is printable ascii, so there are no checkpoints (columns are counted in bytes)
+    Vector_Column_checkpoint checkpoints; // sorted by cursor
+} Column_map;
+
+
+static Column_map column_map_cache[COLUMN_MAP_CACHE_SIZE];
+static size_t column_map_cache_next = 0; // entry that is replaced next
+static size_t column_map_count_edits = 0; // maps built before the last edit are out of date
+
+
+// to be called after a text is replaced as a whole (an edit calls Column_map_update_after_edit instead)
+static inline void Column_map_invalidate_all(void) {
+    column_map_count_edits++;
+}
+
+
+static inline void Column_map_free_all(void) {
+    for (size_t idx = 0; idx < COLUMN_MAP_CACHE_SIZE; idx++) {
+        free(column_map_cache[idx].checkpoints.items);
+        memset(&column_map_cache[idx], 0, sizeof(column_map_cache[idx]));
+    }
+    column_map_cache_next = 0;
+}
+
+
 static inline Cursor_info* Cursor_info_get(void) {
     Cursor_info* info = safe_malloc(sizeof(*info));
     memset(info, 0, sizeof(*info));
@@ -90,6 +165,8 @@ static inline void Text_box_free(Text_box* text_box) {
     }
 
     String_free_char_data(&text_box->string);
+    // (the memory of the text can be reused for another text)
+    Column_map_invalidate_all();
 }
 
 
@@ -131,6 +208,364 @@ typedef enum {
     CUR_ADV_ERROR
 } CUR_ADVANCE_STATUS;
 
+// returns true if every character of string[start, end) is one byte that is one column wide (so columns can be counted in bytes)
+// (the byte at end is checked too, because a combining character there would belong to the character before it)
+static inline bool is_one_column_per_byte(const String* string, size_t start, size_t end) {
+    size_t special;
+    return !columns_find_special(&special, string->items, start, MIN(end + 1, string->count), false);
+}
+
+
+// index one past the character at cursor (see columns.h for what a character is)
+static inline size_t get_end_of_char(const String* string, size_t cursor) {
+    size_t width;
+    return columns_next_cell(&width, string->items, cursor, string->count, 0, TEXT_BOX_NO_WRAP);
+}
+
+
+// start of the character that ends at cursor (cursor > 0)
+static inline size_t get_start_prev_char(const String* string, size_t cursor) {
+    return columns_prev_cell(string->items, 0, cursor);
+}
+
+
+// count of columns of the character at cursor, when it comes right after another character on a visual line
+// (a line ending, or the end of the text, takes one column, because the cursor can be placed there; 
+// a tab takes at least one column, because it never goes past the end of a visual line)
+static inline size_t get_width_of_char(const String* string, size_t cursor) {
+    size_t width = 1;
+    if (cursor < string->count && String_at(string, cursor) != '\n' && String_at(string, cursor) != '\t') {
+        columns_next_cell(&width, string->items, cursor, string->count, 0, TEXT_BOX_NO_WRAP);
+    }
+    return width;
+}
+
+
+// a character is the last one on its visual line if the character after it does not fit on the line too
+// (so a wide character that does not fit at the end of a line is wrapped as a whole)
+static inline bool is_last_char_of_visual_line(size_t visual_x, size_t width, size_t width_next, size_t max_visual_width) {
+    return visual_x + width >= max_visual_width || max_visual_width - visual_x - width < width_next;
+}
+
+
+// last byte of the visual line that init_cursor is on (init_cursor is at column visual_x of that line): its \n, or the 
+// last byte of its last character
+// returns string->count if the text ends before the visual line does
+// printable ascii is skipped with a byte search; only the other characters are walked one at a time
+static inline size_t get_boundary_visual_line(const String* string, size_t init_cursor, size_t visual_x, size_t max_visual_width) {
+    const char* items = string->items;
+    size_t count = string->count;
+    size_t idx = init_cursor;
+    size_t curr_visual_x = visual_x;
+
+    // if lines are not wrapped, the visual line ends at the \n (a character is never more than columns_max_per_byte() 
+    // columns per byte, so a \n within that many bytes is on this visual line no matter what the characters before it are)
+    // otherwise the loop below finds the \n together with the characters that are not one column
+    if (max_visual_width == TEXT_BOX_NO_WRAP) {
+        size_t end_newline_search = idx + MIN((max_visual_width - curr_visual_x) / columns_max_per_byte(), count - idx);
+        size_t boundary;
+        if (line_scan_find_newline_forward(&boundary, items, idx, end_newline_search)) {
+            return boundary;
+        }
+        if (end_newline_search >= count) {
+            return count;
+        }
+    }
+
+    while (idx < count) {
+        // if the text is printable ascii, the rest of the visual line is this many bytes
+        size_t count_columns_left = curr_visual_x < max_visual_width ? max_visual_width - curr_visual_x : 1;
+        size_t end_ascii = idx + MIN(count_columns_left, count - idx);
+
+        size_t special;
+        if (!columns_find_special(&special, items, idx, end_ascii, true)) {
+            if (end_ascii >= count) {
+                return count;
+            }
+            // visual line is full; the last character may still have combining characters after it
+            if ((unsigned char)items[end_ascii] >= 0x80) {
+                return get_end_of_char(string, end_ascii - 1) - 1;
+            }
+            return end_ascii - 1;
+        }
+        if (items[special] == '\n') {
+            return special;
+        }
+
+        // printable ascii before the special character fits (except the last one, which may have combining characters 
+        // after it)
+        if (special > idx + 1) {
+            curr_visual_x += special - 1 - idx;
+            idx = special - 1;
+        }
+        size_t width;
+        size_t end_char = columns_next_cell(&width, items, idx, count, curr_visual_x, max_visual_width);
+        if (is_last_char_of_visual_line(curr_visual_x, width, get_width_of_char(string, end_char), max_visual_width)) {
+            return end_char - 1;
+        }
+        curr_visual_x += width;
+        idx = end_char;
+    }
+    return count;
+}
+
+
+static inline bool Column_map_is_valid(const Column_map* map, const String* string, size_t max_visual_width) {
+    return map->string == string && map->items == string->items && map->items && map->count == string->count &&
+        map->count_edits == column_map_count_edits && map->max_visual_width == max_visual_width && map->tab_width == tab_width;
+}
+
+
+static inline void Column_map_build(Column_map* map, const String* string, size_t start_actual_line, size_t max_visual_width) {
+    const char* items = string->items;
+    map->string = string;
+    map->items = items;
+    map->count = string->count;
+    map->count_edits = column_map_count_edits;
+    map->max_visual_width = max_visual_width;
+    map->tab_width = tab_width;
+    map->start = start_actual_line;
+    if (!line_scan_find_newline_forward(&map->end, items, start_actual_line, string->count)) {
+        map->end = string->count;
+    }
+    map->checkpoints.count = 0;
+
+    size_t special;
+    map->is_plain = !columns_find_special(&special, items, map->start, map->end, false);
+    if (map->is_plain) {
+        return;
+    }
+
+    size_t start_line = map->start;
+    while (1) {
+        size_t boundary = get_boundary_visual_line(string, start_line, 0, max_visual_width);
+        size_t end_line = boundary < map->end ? boundary + 1 : map->end;
+
+        Column_checkpoint checkpoint = {.cursor = start_line, .start_line = start_line, .visual_x = 0};
+        vector_append_Column_checkpoint(&map->checkpoints, &checkpoint);
+        while (end_line - checkpoint.cursor > COLUMN_MAP_STEP) {
+            checkpoint.cursor = columns_walk_to(
+                &checkpoint.visual_x, items, checkpoint.cursor, checkpoint.cursor + COLUMN_MAP_STEP, end_line, max_visual_width
+            );
+            vector_append_Column_checkpoint(&map->checkpoints, &checkpoint);
+        }
+
+        if (boundary >= map->end) {
+            return;
+        }
+        start_line = boundary + 1;
+    }
+}
+
+
+// column map of the actual line that starts at start_actual_line (it is built if it is not in the cache)
+static inline const Column_map* Column_map_get(const String* string, size_t start_actual_line, size_t max_visual_width) {
+    for (size_t idx = 0; idx < COLUMN_MAP_CACHE_SIZE; idx++) {
+        const Column_map* map = &column_map_cache[idx];
+        if (Column_map_is_valid(map, string, max_visual_width) && map->start == start_actual_line) {
+            return map;
+        }
+    }
+
+    Column_map* map = &column_map_cache[column_map_cache_next];
+    column_map_cache_next = (column_map_cache_next + 1) % COLUMN_MAP_CACHE_SIZE;
+    Column_map_build(map, string, start_actual_line, max_visual_width);
+    return map;
+}
+
+
+// column map of the actual line that cursor is on (the start of the line is only searched for if it is not in the cache)
+static inline const Column_map* Column_map_get_at(const String* string, size_t cursor, size_t max_visual_width) {
+    for (size_t idx = 0; idx < COLUMN_MAP_CACHE_SIZE; idx++) {
+        const Column_map* map = &column_map_cache[idx];
+        if (Column_map_is_valid(map, string, max_visual_width) && map->start <= cursor && cursor <= map->end) {
+            return map;
+        }
+    }
+
+    size_t start_actual_line = 0;
+    size_t end_prev_line;
+    if (cursor > 0 && line_scan_find_newline_backward(&end_prev_line, string->items, 0, cursor)) {
+        start_actual_line = end_prev_line + 1;
+    }
+    return Column_map_get(string, start_actual_line, max_visual_width);
+}
+
+
+// \n of the actual line that cursor is on (or the end of the text)
+// only the first COLUMN_MAP_MIN_BYTES bytes are searched; the end of a longer line is kept in its column map, so it is
+// not searched for again every time it is needed (eg. for every frame, if lines are not wrapped)
+static inline size_t get_end_actual_line(const String* string, size_t cursor, size_t max_visual_width) {
+    size_t end_search = cursor + MIN(COLUMN_MAP_MIN_BYTES, string->count - cursor);
+    size_t end_line;
+    if (line_scan_find_newline_forward(&end_line, string->items, cursor, end_search)) {
+        return end_line;
+    }
+    if (end_search >= string->count) {
+        return string->count;
+    }
+    return Column_map_get_at(string, cursor, max_visual_width)->end;
+}
+
+
+// to be called after count_removed bytes at index of string were replaced by string[index, index + count_inserted)
+// maps of the lines after the edit are moved; the map of the edited line is kept if the line is still printable ascii,
+// so typing on a very long line does not map it again after every key
+static inline void Column_map_update_after_edit(const String* string, size_t index, size_t count_removed, size_t count_inserted) {
+    size_t prev_count = string->count + count_removed - count_inserted;
+    size_t special;
+    bool is_inserted_plain = !columns_find_special(&special, string->items, index, index + count_inserted, true);
+
+    for (size_t idx = 0; idx < COLUMN_MAP_CACHE_SIZE; idx++) {
+        Column_map* map = &column_map_cache[idx];
+        if (map->string != string || !map->items || map->count != prev_count || map->count_edits != column_map_count_edits) {
+            continue;
+        }
+
+        if (map->end < index) {
+            // line is before the edit
+        } else if (map->start > index + count_removed) {
+            // line is after the edit (its line ending was not removed)
+            map->start = map->start - count_removed + count_inserted;
+            map->end = map->end - count_removed + count_inserted;
+            for (size_t idx_checkpoint = 0; idx_checkpoint < map->checkpoints.count; idx_checkpoint++) {
+                Column_checkpoint* checkpoint = &map->checkpoints.items[idx_checkpoint];
+                checkpoint->cursor = checkpoint->cursor - count_removed + count_inserted;
+                checkpoint->start_line = checkpoint->start_line - count_removed + count_inserted;
+            }
+        } else if (map->is_plain && is_inserted_plain && index >= map->start && index + count_removed <= map->end) {
+            map->end = map->end - count_removed + count_inserted;
+        } else {
+            map->items = NULL;
+            continue;
+        }
+        // (the text may have been moved to a larger buffer)
+        map->items = string->items;
+        map->count = string->count;
+    }
+}
+
+
+// start of the visual line that cursor (at the start of a character of the line of map) is on
+// visual_x is set to the column of cursor on that visual line
+static inline size_t Column_map_find_cursor(size_t* visual_x, const Column_map* map, const String* string, size_t cursor) {
+    assert(map->start <= cursor && cursor <= map->end);
+    if (map->is_plain) {
+        size_t start_line = map->start + ((cursor - map->start) / map->max_visual_width) * map->max_visual_width;
+        *visual_x = cursor - start_line;
+        return start_line;
+    }
+
+    // last checkpoint at or before cursor (there is one at the start of every visual line)
+    size_t low = 0;
+    size_t high = map->checkpoints.count;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (map->checkpoints.items[mid].cursor <= cursor) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    const Column_checkpoint* checkpoint = &map->checkpoints.items[low];
+    *visual_x = checkpoint->visual_x + columns_count(string->items, checkpoint->cursor, cursor, checkpoint->visual_x, map->max_visual_width);
+    return checkpoint->start_line;
+}
+
+
+// first character of the visual line that starts at start_line that does not fit in max_col columns (or end_line, the
+// end of the visual line); count_columns is set to the count of columns before it
+static inline size_t Column_map_find_column(
+    size_t* count_columns,
+    const Column_map* map,
+    const String* string,
+    size_t start_line,
+    size_t end_line,
+    size_t max_col
+) {
+    assert(map->start <= start_line && end_line <= map->end);
+    if (map->is_plain) {
+        *count_columns = MIN(max_col, end_line - start_line);
+        return start_line + *count_columns;
+    }
+
+    // last checkpoint of the visual line that is not past column max_col
+    size_t low = 0;
+    size_t high = map->checkpoints.count;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        const Column_checkpoint* checkpoint = &map->checkpoints.items[mid];
+        if (checkpoint->start_line < start_line || (checkpoint->start_line == start_line && checkpoint->visual_x <= max_col)) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    const Column_checkpoint* checkpoint = &map->checkpoints.items[low];
+    assert(checkpoint->start_line == start_line);
+    size_t idx = columns_skip(
+        count_columns, string->items, checkpoint->cursor, end_line, checkpoint->visual_x, max_col - checkpoint->visual_x, map->max_visual_width
+    );
+    *count_columns += checkpoint->visual_x;
+    return idx;
+}
+
+
+// start of the visual line that contains cursor, where start_actual_line is the start of the actual line of cursor
+// visual_x is set to the column of cursor on that visual line
+// every wrapped visual line of printable ascii is exactly max_visual_width characters long; otherwise the column map is used
+static inline size_t get_start_visual_line_and_x(
+    size_t* visual_x,
+    const String* string,
+    size_t start_actual_line,
+    size_t cursor,
+    size_t max_visual_width
+) {
+    if (cursor - start_actual_line < COLUMN_MAP_MIN_BYTES && is_one_column_per_byte(string, start_actual_line, cursor)) {
+        size_t start_line = start_actual_line + ((cursor - start_actual_line) / max_visual_width) * max_visual_width;
+        *visual_x = cursor - start_line;
+        return start_line;
+    }
+    return Column_map_find_cursor(visual_x, Column_map_get(string, start_actual_line, max_visual_width), string, cursor);
+}
+
+
+// start of the visual line that contains cursor, where start_actual_line is the start of the actual line of cursor
+static inline size_t get_start_visual_line_in_actual_line(const String* string, size_t start_actual_line, size_t cursor, size_t max_visual_width) {
+    size_t visual_x;
+    return get_start_visual_line_and_x(&visual_x, string, start_actual_line, cursor, max_visual_width);
+}
+
+
+// start of the visual line that ends right before cursor (at column visual_x of its visual line)
+// found by walking visual_x columns back (printable ascii is one column per byte, so then no characters are walked);
+// the width of a tab depends on the columns before it, so the column map is used if there is one
+static inline size_t get_start_visual_line_from_visual_x(const String* string, size_t cursor, size_t visual_x, size_t max_visual_width) {
+    if (visual_x < COLUMN_MAP_MIN_BYTES && visual_x <= cursor && is_one_column_per_byte(string, cursor - visual_x, cursor - 1)) {
+        return cursor - visual_x;
+    }
+
+    size_t start_line = cursor;
+    size_t count_columns = 0;
+    while (count_columns < visual_x && start_line > 0 && visual_x < COLUMN_MAP_MIN_BYTES) {
+        size_t start_prev_char = get_start_prev_char(string, start_line);
+        if (String_at(string, start_prev_char) == '\t') {
+            break;
+        }
+        count_columns += get_width_of_char(string, start_prev_char);
+        start_line = start_prev_char;
+    }
+    if (count_columns == visual_x) {
+        return start_line;
+    }
+
+    size_t map_visual_x;
+    start_line = Column_map_find_cursor(&map_visual_x, Column_map_get_at(string, cursor, max_visual_width), string, cursor);
+    assert(map_visual_x == visual_x && "visual_x does not match cursor");
+    return start_line;
+}
+
+
 // this function will not modify curr_pos if it returns CUR_ADV_PAST_END_BUFFER
 static inline CUR_ADVANCE_STATUS Pos_data_advance_one(
     Pos_data* curr_pos,
@@ -144,34 +579,46 @@ static inline CUR_ADVANCE_STATUS Pos_data_advance_one(
         return CUR_ADV_PAST_END_BUFFER;
     }
 
-    if (String_at(string, curr_pos->cursor) == '\r') {
-        assert(false && "\\r line ending not implemented; only \\n and \\n\\r are implemented");
+    // printable ascii character followed by printable ascii, a line ending, or a tab (or by the end of the text) is one
+    // byte and one column, and the next character is one column (at least) too
+    size_t init_cursor = curr_pos->cursor;
+    const unsigned char* bytes = (const unsigned char*)string->items + init_cursor;
+    unsigned char curr_char = bytes[0];
+    if (
+        curr_char >= ' ' && curr_char < 0x7f &&
+        (init_cursor + 1 >= string->count || (bytes[1] < 0x7f && (bytes[1] >= ' ' || !columns_is_control(bytes[1]) || bytes[1] == '\t')))
+    ) {
+        bool end_visual_thing = is_visual && curr_pos->visual_x + 1 >= max_visual_width;
+        if (!end_visual_thing) {
+            curr_pos->visual_x++;
+            curr_pos->cursor++;
+            return CUR_ADV_NORMAL;
+        }
+    }
+
+    size_t width = 1;
+    size_t end_char = init_cursor + 1;
+    bool end_visual_thing = false;
+    if (curr_char != '\n') {
+        end_char = columns_next_cell(&width, string->items, init_cursor, string->count, curr_pos->visual_x, max_visual_width);
+        end_visual_thing = is_visual && is_last_char_of_visual_line(
+            curr_pos->visual_x, width, get_width_of_char(string, end_char), max_visual_width
+        );
     }
 
-    bool end_visual_thing = is_visual && curr_pos->visual_x + 1 >= max_visual_width;
-    if (String_at(string, curr_pos->cursor) == '\n' || end_visual_thing) {
-        // found end curr visual line (or one before if \n\r is used)
+    if (String_at(string, init_cursor) == '\n' || end_visual_thing) {
+        // found end curr visual line
 
 
         // get to start of the next visual line
-        curr_pos->cursor++;
+        curr_pos->cursor = end_char;
         if (curr_pos->cursor >= string->count) {
             // no more lines are remaining
 
-            // decrement cursor, so that the cursor state will be unchanged from when the function was called
-            curr_pos->cursor--;
+            // restore cursor, so that the cursor state will be unchanged from when the function was called
+            curr_pos->cursor = init_cursor;
             return CUR_ADV_PAST_END_BUFFER;
         }
-        if (String_at(string, curr_pos->cursor) == '\r') {
-            curr_pos->cursor++;
-            if (curr_pos->cursor >= string->count) {
-                // no more lines are remaining
-
-                // decrement cursor twice, so that the cursor state will be unchanged from when the function was called
-                curr_pos->cursor -= 2;
-                return CUR_ADV_PAST_END_BUFFER;
-            }
-        }
 
         if (is_visual) {
             curr_pos->visual_y++;
@@ -182,9 +629,8 @@ static inline CUR_ADVANCE_STATUS Pos_data_advance_one(
     }
 
 
-    curr_pos->visual_x++;
-    // TODO: consider tab characters here
-    curr_pos->cursor++;
+    curr_pos->visual_x += width;
+    curr_pos->cursor = end_char;
     return CUR_ADV_NORMAL;
 }
 
@@ -219,56 +665,43 @@ static inline CUR_DECRE_STATUS Pos_data_decrement_one(
 
     if (is_visual && curr_pos->visual_x < 1) {
         // we are at start of the current visual line
-        Pos_data pos_curr_actual_line = {0};
-        Pos_data_cpy(&pos_curr_actual_line, curr_pos);
         // todo: only do everything below if at start of actual line
 
-        // get beginning of actual line
-        bool done = false;
-        while (!done) {
-            CUR_DECRE_STATUS status = Pos_data_decrement_one(&pos_curr_actual_line, string, max_visual_width, false);
-            switch (status) {
-            case CUR_DEC_AT_START_CURR_LINE: // fallthrough
-            case CUR_DEC_AT_START_BUFFER: 
-                done = true;
-                break;
-            case CUR_DEC_NORMAL: 
-            case CUR_DEC_MOVED_TO_PREV_LINE: 
-                break;
-            case CUR_DEC_ALREADY_AT_START_BUFFER: 
-            case CUR_DEC_ERROR: 
-                log("fetal error");
-                abort();
-                break;
-            }
-        }
-        /*
-        curr_cur_info->visual_x = (curr_cur_info->cursor - start_curr_actual_line->cursor + 1) % max_visual_width;
-        if (curr_cur_info->visual_x == 0) {
-            curr_cur_info->visual_x = max_visual_width - 1;
+        // column of the previous character (the line ending right before the cursor belongs to the previous line)
+        // the start of its actual line is searched for at most COLUMN_MAP_MIN_BYTES bytes back; a longer line is found 
+        // by its column map, which is cached, so walking back along a long line does not search it again on every visual line
+        size_t start_prev_char = get_start_prev_char(string, curr_pos->cursor);
+        size_t start_search = start_prev_char > COLUMN_MAP_MIN_BYTES ? start_prev_char - COLUMN_MAP_MIN_BYTES : 0;
+        size_t end_prev_actual_line;
+        if (line_scan_find_newline_backward(&end_prev_actual_line, string->items, start_search, start_prev_char)) {
+            get_start_visual_line_and_x(&curr_pos->visual_x, string, end_prev_actual_line + 1, start_prev_char, max_visual_width);
+        } else if (start_search == 0) {
+            get_start_visual_line_and_x(&curr_pos->visual_x, string, 0, start_prev_char, max_visual_width);
         } else {
-            curr_cur_info->visual_x--;
+            Column_map_find_cursor(&curr_pos->visual_x, Column_map_get_at(string, start_prev_char, max_visual_width), string, start_prev_char);
         }
-        curr_cur_info->cursor--;
-        */
-        size_t len_curr_actual_line = curr_pos->cursor - pos_curr_actual_line.cursor;
-        curr_pos->visual_x = (len_curr_actual_line - 1) % max_visual_width;
-        debug(
-            "decrement thing: past while loop thing: cursor: %zu; start_actual_line: %zu; cal visual_x: %zu",
-            curr_pos->cursor, pos_curr_actual_line.cursor, curr_pos->visual_x
-        );
+        debug("decrement thing: cursor: %zu; cal visual_x: %zu", curr_pos->cursor, curr_pos->visual_x);
 
-        curr_pos->cursor--;
+        curr_pos->cursor = start_prev_char;
         curr_pos->visual_y--;
 
         return CUR_DEC_MOVED_TO_PREV_LINE;
     }
 
     // decrement
+    size_t start_prev_char = get_start_prev_char(string, curr_pos->cursor);
     if (is_visual) {
-        curr_pos->visual_x--;
+        unsigned char prev_char = String_at(string, start_prev_char);
+        if (prev_char == '\t') {
+            // width of a tab depends on the columns before it
+            Column_map_find_cursor(&curr_pos->visual_x, Column_map_get_at(string, start_prev_char, max_visual_width), string, start_prev_char);
+        } else if (prev_char >= ' ' && prev_char < 0x7f) {
+            curr_pos->visual_x--;
+        } else {
+            curr_pos->visual_x -= get_width_of_char(string, start_prev_char);
+        }
     }
-    curr_pos->cursor--;
+    curr_pos->cursor = start_prev_char;
 
     if (curr_pos->cursor < 1) {
         // we are at start of first line
@@ -284,7 +717,7 @@ static inline CUR_DECRE_STATUS Pos_data_decrement_one(
     }
 
     // check for line ending if actual line
-    if (String_at(string, curr_pos->cursor - 1) == '\n' || String_at(string, curr_pos->cursor - 1) == '\r') {
+    if (String_at(string, curr_pos->cursor - 1) == '\n') {
         if (is_visual) {
             debug("get_start_curr_generic_line_from_curr_cursor_x_pos: visual_x : %zu; curr_cursor: %zu; is_visual: %d", curr_pos->visual_x, curr_pos->cursor, is_visual);
             assert(!is_visual && "previous if statement should have caught this");
@@ -292,7 +725,7 @@ static inline CUR_DECRE_STATUS Pos_data_decrement_one(
         return CUR_DEC_AT_START_CURR_LINE;
     }
 
-    if (String_at(string, curr_pos->cursor) == '\n' || String_at(string, curr_pos->cursor) == '\r') {
+    if (String_at(string, curr_pos->cursor) == '\n') {
         return CUR_DEC_MOVED_TO_PREV_LINE;
     }
 
@@ -300,40 +733,101 @@ static inline CUR_DECRE_STATUS Pos_data_decrement_one(
 }
 
 
-static inline bool get_start_next_generic_line_from_curr_cursor_x_pos(
+// get start of the line after the line that ends at boundary (\n character or last character before wrapping)
+// returns false if there are no more lines
+static inline bool get_start_line_after_boundary(size_t* result, const String* string, size_t boundary) {
+    size_t start_next_line = boundary + 1;
+    if (start_next_line >= string->count) {
+        return false;
+    }
+    *result = start_next_line;
+    return true;
+}
+
+
+// same result as calling Pos_data_advance_one until it reaches the next visual line, 
+// but the line ending is found with a byte search
+static inline bool get_start_next_visual_line_scan(
     Pos_data* result,
     const String* string,
     const Pos_data* init_pos,
-    size_t max_visual_width,
-    bool is_visual
+    size_t max_visual_width
 ) {
-    // find next newline
-    Pos_data curr_pos = *init_pos;
-    while (1) {
-        CUR_ADVANCE_STATUS status = Pos_data_advance_one(&curr_pos, string, max_visual_width, is_visual);
-        switch (status) {
-        case CUR_ADV_NORMAL:
-            //debug("thing 129: cursor: %zu", curr_pos.cursor);
-            break;
-        case CUR_ADV_AT_START_NEXT_LINE: {
-            result->cursor = curr_pos.cursor;
-            result->visual_x = curr_pos.visual_x;
-            result->visual_y = curr_pos.visual_y;
-            //debug("thing 129: returning; result->cursor: %zu", result->cursor);
-            return true;
-        } break;
-        case CUR_ADV_PAST_END_BUFFER: // fallthrough
+    size_t init_cursor = init_pos->cursor;
+    size_t init_visual_y = init_pos->visual_y;
+
+    // if lines are not wrapped, the visual line is the whole actual line
+    size_t boundary;
+    if (max_visual_width == TEXT_BOX_NO_WRAP) {
+        boundary = get_end_actual_line(string, init_cursor, max_visual_width);
+    } else {
+        boundary = get_boundary_visual_line(string, init_cursor, init_pos->visual_x, max_visual_width);
+    }
+
+    size_t start_next_line;
+    if (boundary >= string->count || !get_start_line_after_boundary(&start_next_line, string, boundary)) {
+        memset(result, 0, sizeof(*result));
+        return false;
+    }
+    result->cursor = start_next_line;
+    result->visual_x = 0;
+    result->visual_y = init_visual_y + 1;
+    return true;
+}
+
+
+// same result as calling Pos_data_advance_one until it reaches the next actual line, 
+// but the line ending is found with a byte search
+static inline bool get_start_next_actual_line_scan(
+    Pos_data* result,
+    const String* string,
+    const Pos_data* init_pos
+) {
+    size_t init_cursor = init_pos->cursor;
+    size_t init_visual_x = init_pos->visual_x;
+    size_t init_visual_y = init_pos->visual_y;
+
+    // printable ascii before the line ending is one column per byte; the rest of the line is only walked if it is not
+    size_t boundary;
+    size_t start_next_line;
+    size_t count_columns;
+    if (init_cursor >= string->count || !columns_find_special(&boundary, string->items, init_cursor, string->count, true)) {
+        memset(result, 0, sizeof(*result));
+        return false;
+    }
+    if (String_at(string, boundary) == '\n') {
+        count_columns = boundary - init_cursor;
+    } else {
+        size_t start_special = boundary > init_cursor ? boundary - 1 : init_cursor;
+        if (!line_scan_find_newline_forward(&boundary, string->items, boundary, string->count)) {
             memset(result, 0, sizeof(*result));
-            //debug("thing 129: return false");
             return false;
-        case CUR_ADV_ERROR:
-            log("fetal internal error");
-            abort();
-            break;
         }
+        size_t visual_x_special = init_visual_x + (start_special - init_cursor);
+        count_columns = (start_special - init_cursor) + columns_count(string->items, start_special, boundary, visual_x_special, TEXT_BOX_NO_WRAP);
     }
+    if (!get_start_line_after_boundary(&start_next_line, string, boundary)) {
+        memset(result, 0, sizeof(*result));
+        return false;
+    }
+    result->cursor = start_next_line;
+    result->visual_x = init_visual_x + count_columns;
+    result->visual_y = init_visual_y;
+    return true;
+}
 
-    assert(false && "unreachable");
+
+static inline bool get_start_next_generic_line_from_curr_cursor_x_pos(
+    Pos_data* result,
+    const String* string,
+    const Pos_data* init_pos,
+    size_t max_visual_width,
+    bool is_visual
+) {
+    if (is_visual) {
+        return get_start_next_visual_line_scan(result, string, init_pos, max_visual_width);
+    }
+    return get_start_next_actual_line_scan(result, string, init_pos);
 }
 
 static inline bool get_start_curr_generic_line_from_curr_cursor_x_pos(
@@ -358,65 +852,34 @@ static inline bool get_start_curr_generic_line_from_curr_cursor_x_pos(
         return false;
     }
 
-    // we are at line ending of current line
-    if (String_at(string, curr_pos.cursor) == '\r') {
-        if (is_visual && curr_visual_x < 1) {
-            debug("curr thing return 2");
-            result->cursor = curr_pos.cursor;
-            result->visual_x = curr_pos.visual_x;
-            return true;
-        }
-        curr_pos.cursor--;
-        curr_pos.visual_x--;
+    if (is_visual) {
+        // the visual line starts visual_x columns back (printable ascii is one column per byte, so no characters are 
+        // walked, and no walk back to the start of the line is needed, so this is fast even if a very long line is not wrapped)
+        result->cursor = get_start_visual_line_from_visual_x(string, curr_pos.cursor, curr_pos.visual_x, max_visual_width);
+        result->visual_x = 0;
+        return true;
     }
+
+    // we are at line ending of current line
     if (String_at(string, curr_pos.cursor) == '\n') {
-        if (is_visual && curr_visual_x < 1) {
-            result->cursor = curr_pos.cursor;
-            result->visual_x = curr_pos.visual_x;
-            debug("get_start_curr_generic_line_from_curr_cursor_x_pos: newline edge case (returning); curr_cursor: %zu", curr_pos.cursor);
-            return true;
-        }
         debug("get_start_curr_generic_line_from_curr_cursor_x_pos: newline edge case (not returning); curr_cursor: %zu; visual_x: %zu", curr_pos.cursor, curr_pos.visual_x);
         curr_pos.cursor--;
         curr_pos.visual_x--;
     }
 
-    while (1) {
-        debug("curr thing 239: cursor: %zu", curr_pos.cursor);
-        if (curr_pos.cursor < 1) {
-            // we are at the very beginning of the line
-            debug("curr thing return 3");
-            result->cursor = 0;
-            result->visual_x = 0;
-            return true;
-        }
-        if (is_visual && curr_pos.visual_x < 1) {
-            debug("curr thing return 4: visual_x: %zu; cursor: %zu", curr_pos.visual_x, curr_pos.cursor);
-            result->cursor = curr_pos.cursor;
-            result->visual_x = curr_pos.visual_x;
-            return true;
-        }
-        CUR_DECRE_STATUS status = Pos_data_decrement_one(&curr_pos, string, max_visual_width, is_visual);
-        switch (status) {
-        case CUR_DEC_NORMAL:
-        case CUR_DEC_MOVED_TO_PREV_LINE:
-            break;
-        case CUR_DEC_AT_START_CURR_LINE: // fallthrough
-        case CUR_DEC_AT_START_BUFFER:
-            result->cursor = curr_pos.cursor;
-            result->visual_x = curr_pos.visual_x;
-            debug("curr thing return 5");
-            return true;
-            break;
-        case CUR_DEC_ERROR: // fallthrough
-        case CUR_DEC_ALREADY_AT_START_BUFFER:
-            log("fetal internal error");
-            abort();
-            break;
-        }
+    // same result as decrementing until the start of the line, but the line ending is found with a byte search
+    if (curr_pos.cursor < 1) {
+        result->cursor = 0;
+        result->visual_x = 0;
+        return true;
     }
-
-    assert(false && "unreachable");
+    size_t end_prev_line;
+    result->cursor = 0;
+    if (line_scan_find_newline_backward(&end_prev_line, string->items, 0, curr_pos.cursor - 1)) {
+        result->cursor = end_prev_line + 1;
+    }
+    result->visual_x = curr_pos.visual_x;
+    return true;
 }
 
 static inline bool get_start_curr_actual_line_from_curr_cursor(
@@ -502,6 +965,10 @@ static inline bool get_start_prev_generic_line_from_curr_cursor_x_pos(
     }
     curr_pos.cursor = start_curr_line.cursor;
     curr_pos.visual_x = start_curr_line.visual_x;
+    if (is_visual) {
+        // the lines of a closed fold right above are skipped (its header is the previous line)
+        curr_pos.cursor = folds_skip_backward(string, curr_pos.cursor);
+    }
 
     debug("prev thing before decrement (curr_cur_info should be at end of prev line): start_curr_line: %zu", curr_pos.cursor);
 
@@ -610,6 +1077,11 @@ static inline void cal_start_generic_line_internal(
                 //debug("no thing");
                 break;
             }
+            // (a closed fold is skipped, so its header is one visual line)
+            temp.cursor = folds_skip_forward(string, temp.cursor);
+            if (temp.cursor >= string->count) {
+                break;
+            }
             curr_cursor = temp;
         } else {
             assert(false && "not implemented");
@@ -651,7 +1123,7 @@ static inline size_t cal_start_visual_line(const String* string, size_t cursor,
 
 
 static inline size_t cal_visual_x_at_cursor(const String* string, size_t cursor, size_t max_visual_width) {
-    return cursor - cal_start_visual_line(string, cursor, max_visual_width);
+    return columns_count(string->items, cal_start_visual_line(string, cursor, max_visual_width), cursor, 0, max_visual_width);
 }
 
 
@@ -669,7 +1141,7 @@ static inline size_t cal_start_next_visual_line(const String* string, size_t cur
         assert(false && "cursor is already at topmost line");
     }
 
-    // put cursor at \n or \n\r characters at end of previous line
+    // put cursor at \n at end of previous line
     curr_cursor++;
 
     return cal_start_visual_line(string, curr_cursor, max_visual_width);
@@ -683,7 +1155,7 @@ static inline size_t cal_start_prev_visual_line(const String* string, size_t cur
         assert(false && "cursor is already at topmost line");
     }
 
-    // put cursor at \n or \n\r characters at end of previous line
+    // put cursor at \n at end of previous line
     curr_cursor--;
 
     return cal_start_visual_line(string, curr_cursor, max_visual_width);
@@ -706,6 +1178,7 @@ static inline void Text_box_cal_index_scroll_offset(
         if (!get_start_next_visual_line_from_curr_cursor_x(&curr_cursor, string, &curr_cursor, max_visual_width)) {
             assert(false && "invalid scroll_y value");
         }
+        curr_cursor.cursor = folds_skip_forward(string, curr_cursor.cursor);
     }
     if (scroll->y > 0) {
         assert(curr_cursor.cursor > 0);
@@ -740,16 +1213,16 @@ static inline size_t cal_cur_screen_y_at_cursor(const Text_box* text_box) {
 }
 
 
-static inline void Text_box_recalculate_visual_xy_and_scroll_offset(Text_box* text_box, size_t max_visual_width) {
-    text_box->cursor_info.pos.visual_x = cal_visual_x_at_cursor(&text_box->string, text_box->cursor_info.pos.cursor, max_visual_width);
-    text_box->cursor_info.pos.visual_y = cal_visual_y_at_cursor(&text_box->string, text_box->cursor_info.pos.cursor, max_visual_width);
-    debug("visual_y cal thing: %zu; cursor: %zu", text_box->cursor_info.pos.visual_y, text_box->cursor_info.pos.cursor);
 
-    text_box->cursor_info.scroll.y = text_box->cursor_info.pos.visual_y;
 
-    size_t new_scroll_offset;
-    Text_box_cal_index_scroll_offset(&new_scroll_offset, &text_box->cursor_info.scroll, &text_box->string, max_visual_width);
-    text_box->cursor_info.scroll.offset = new_scroll_offset;
+// horizontal scrolling (only if lines are not wrapped): scroll just enough that the cursor column is on the screen
+static inline void Scroll_data_scroll_x_to_cursor(Scroll_data* scroll, const Pos_data* pos, size_t screen_width) {
+    assert(screen_width > 0);
+    if (pos->visual_x < scroll->x) {
+        scroll->x = pos->visual_x;
+    } else if (pos->visual_x >= scroll->x + screen_width) {
+        scroll->x = pos->visual_x - screen_width + 1;
+    }
 }
 
 
@@ -782,7 +1255,7 @@ static inline void Scroll_data_scroll_screen_down_one(Scroll_data* scroll, const
         )) {
             abort();
         };
-        scroll->offset = new_scroll_offset.cursor;
+        scroll->offset = folds_skip_forward(string, new_scroll_offset.cursor);
     }
 }
 
@@ -792,20 +1265,12 @@ static inline void Scroll_data_scroll_screen_up_one(Scroll_data* scroll, const P
         // do not scroll screen
         //debug("DIR_UP_NO: max_visual_height: %zu", max_visual_height);
     } else {
-        // scroll screen
-        scroll->y--; // scroll screen one line
-        Pos_data pos_at_new_scroll_offset = {0};
-        if (!get_start_prev_visual_line_from_curr_cursor_x(
-            &pos_at_new_scroll_offset,
-            string,
-            pos->cursor,
-            0,
-            max_visual_width
-        )) {
-            assert(false);
-        };
-        debug("DIR_UP_YES: scroll_offset before: %zu; scroll_offset after: %zu;", scroll->offset, pos_at_new_scroll_offset.cursor);
-        scroll->offset = pos_at_new_scroll_offset.cursor;
+        // scroll screen one line, to the visual line of the cursor (which the cursor can be anywhere on, eg. at its
+        // last character after moving left)
+        scroll->y--;
+        size_t start_line_cursor = get_start_visual_line_from_visual_x(string, pos->cursor, pos->visual_x, max_visual_width);
+        debug("DIR_UP_YES: scroll_offset before: %zu; scroll_offset after: %zu;", scroll->offset, start_line_cursor);
+        scroll->offset = start_line_cursor;
     }
 }
 
@@ -830,6 +1295,7 @@ static inline void Cursor_info_move_cursor_right(Cursor_info* cursor_info, const
             cursor_info->scroll.user_max_col = 0;
             cursor_info->scroll.x = 0;
             cursor_info->scroll.y = 0;
+            cursor_info->scroll.is_y_relative = false;
         }
         return;
     case CUR_ADV_ERROR:
@@ -839,36 +1305,428 @@ static inline void Cursor_info_move_cursor_right(Cursor_info* cursor_info, const
 }
 
 
-static inline void Cursor_info_move_cursor_to_end_of_file(
-    Cursor_info* cursor_info,
-    const String* string,
-    size_t max_visual_width,
-    size_t max_visual_height
-) {
-    while (1) {
-        CUR_ADVANCE_STATUS status = Pos_data_advance_one(
-            &cursor_info->pos,
-            string,
-            max_visual_width,
-            true
-        );
+// last position that the cursor can be placed at in the text (where moving right stops)
+static inline size_t get_end_of_text(const String* string, size_t max_visual_width) {
+    size_t count = string->count;
+    if (count < 1) {
+        return 0;
+    }
+    if (String_at(string, count - 1) == '\n') {
+        return count - 1;
+    }
+
+    // cursor stays on the last character if it reaches the last column of a visual line
+    size_t start_actual_line = 0;
+    size_t end_prev_line;
+    if (line_scan_find_newline_backward(&end_prev_line, string->items, 0, count)) {
+        start_actual_line = end_prev_line + 1;
+    }
+    if (is_one_column_per_byte(string, start_actual_line, count)) {
+        return (count - start_actual_line) % max_visual_width == 0 ? count - 1 : count;
+    }
+    size_t start_last_char = get_start_prev_char(string, count);
+    size_t start_last_line = get_start_visual_line_in_actual_line(string, start_actual_line, start_last_char, max_visual_width);
+    if (columns_count(string->items, start_last_line, count, 0, max_visual_width) >= max_visual_width) {
+        return start_last_char;
+    }
+    return count;
+}
+
+
+// last position that the cursor can be placed at on the visual line starting at start_line:
+// the \n, the last character of a wrapped line, or the end of the text
+static inline size_t get_end_visual_line(const String* string, size_t start_line, size_t max_visual_width) {
+    Pos_data start_pos = {.cursor = start_line, .visual_x = 0, .visual_y = 0};
+    Pos_data start_next_line;
+    if (get_start_next_visual_line_scan(&start_next_line, string, &start_pos, max_visual_width)) {
+        size_t end = start_next_line.cursor - 1;
+        if (String_at(string, end) != '\n') {
+            end = get_start_prev_char(string, start_next_line.cursor);
+        }
+        return end;
+    }
+
+    // last visual line: the cursor does not move past a trailing line ending, or past the last column of a full line
+    size_t count = string->count;
+    if (count > 0 && String_at(string, count - 1) == '\n') {
+        return get_end_of_text(string, max_visual_width);
+    }
+    assert(count >= start_line);
+    if (!is_one_column_per_byte(string, start_line, count)) {
+        return get_end_of_text(string, max_visual_width);
+    }
+    if (count > start_line && count - start_line >= max_visual_width) {
+        return count - 1;
+    }
+    return count;
+}
+
+
+// start of the visual line that contains cursor (without knowing visual_x of the cursor)
+// the start of the actual line is found with a byte search; the visual line follows from there
+static inline size_t cal_start_visual_line_jump(const String* string, size_t cursor, size_t max_visual_width) {
+    size_t start_actual_line = 0;
+    size_t end_prev_line;
+    if (cursor > 0 && line_scan_find_newline_backward(&end_prev_line, string->items, 0, cursor)) {
+        start_actual_line = end_prev_line + 1;
+    }
+    return get_start_visual_line_in_actual_line(string, start_actual_line, cursor, max_visual_width);
+}
+
+
+// walk up to count_lines visual lines up from the visual line starting at start_line
+// returns count of visual lines walked (less than count_lines if the start of the text was reached)
+static inline size_t walk_visual_lines_up(
+    size_t* result,
+    const String* string,
+    size_t start_line,
+    size_t count_lines,
+    size_t max_visual_width
+) {
+    size_t start_actual_line = 0;
+    size_t end_prev_line;
+    if (start_line > 0 && line_scan_find_newline_backward(&end_prev_line, string->items, 0, start_line)) {
+        start_actual_line = end_prev_line + 1;
+    }
+
+    size_t curr_start = start_line;
+    size_t count_walked = 0;
+    for (; count_walked < count_lines && curr_start > 0; count_walked++) {
+        if (curr_start > start_actual_line) {
+            // previous visual line is part of the same actual line
+            curr_start = get_start_visual_line_in_actual_line(string, start_actual_line, curr_start - 1, max_visual_width);
+            continue;
+        }
+
+        // last visual line of the previous actual line (the one that holds its line ending), which is the header of
+        // the closed fold right above (if there is one)
+        size_t end_line = folds_skip_backward(string, curr_start) - 1;
+        start_actual_line = 0;
+        if (end_line > 0 && line_scan_find_newline_backward(&end_prev_line, string->items, 0, end_line)) {
+            start_actual_line = end_prev_line + 1;
+        }
+        curr_start = get_start_visual_line_in_actual_line(string, start_actual_line, end_line, max_visual_width);
+    }
+
+    *result = curr_start;
+    return count_walked;
+}
+
 
-        switch (status) {
-        case CUR_ADV_AT_START_NEXT_LINE:
-            Scroll_data_scroll_screen_down_one(&cursor_info->scroll, &cursor_info->pos, string, max_visual_width, max_visual_height);
-            // fallthrough
-        case CUR_ADV_NORMAL:
+// returns true if the visual line starting at start_line is on the screen (screen_y is then set to its row)
+static inline bool Scroll_data_find_visual_line_on_screen(
+    size_t* screen_y,
+    const Scroll_data* scroll,
+    const String* string,
+    size_t start_line,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    Pos_data curr_pos = {.cursor = scroll->offset, .visual_x = 0, .visual_y = 0};
+    for (size_t idx_row = 0; idx_row < max_visual_height; idx_row++) {
+        if (curr_pos.cursor == start_line) {
+            *screen_y = idx_row;
+            return true;
+        }
+        if (curr_pos.cursor > start_line || !get_start_next_visual_line_scan(&curr_pos, string, &curr_pos, max_visual_width)) {
+            return false;
+        }
+        curr_pos.cursor = folds_skip_forward(string, curr_pos.cursor);
+        if (curr_pos.cursor >= string->count) {
+            return false;
+        }
+        curr_pos.visual_x = 0;
+    }
+    return false;
+}
+
+
+// put the cursor at cursor_dest (which is on the visual line starting at start_line_dest) without walking there
+// if the destination is not on the first max_visual_height rows of the screen, 
+// the screen is scrolled so that the destination is screen_y_dest rows down
+static inline void Cursor_info_jump(
+    Cursor_info* cursor_info,
+    const String* string,
+    size_t cursor_dest,
+    size_t start_line_dest,
+    size_t screen_y_dest,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    assert(start_line_dest <= cursor_dest);
+    cursor_info->pos.cursor = cursor_dest;
+    cursor_info->pos.visual_x = columns_count(string->items, start_line_dest, cursor_dest, 0, max_visual_width);
+
+    size_t screen_y;
+    if (Scroll_data_find_visual_line_on_screen(&screen_y, &cursor_info->scroll, string, start_line_dest, max_visual_width, max_visual_height)) {
+        cursor_info->pos.visual_y = cursor_info->scroll.y + screen_y;
+        return;
+    }
+
+    size_t new_scroll_offset;
+    screen_y = walk_visual_lines_up(&new_scroll_offset, string, start_line_dest, screen_y_dest, max_visual_width);
+    cursor_info->scroll.offset = new_scroll_offset;
+    if (new_scroll_offset == 0) {
+        // visual lines before the destination are known
+        cursor_info->scroll.y = 0;
+        cursor_info->scroll.is_y_relative = false;
+    } else {
+        cursor_info->scroll.y = TEXT_BOX_VISUAL_Y_ANCHOR;
+        cursor_info->scroll.is_y_relative = true;
+    }
+    cursor_info->pos.visual_y = cursor_info->scroll.y + screen_y;
+}
+
+
+// start of the visual line that the cursor is on when it is at cursor
+// (the cursor at the end of a full last line stays on that line, past its last column)
+static inline size_t cal_start_visual_line_of_cursor(const String* string, size_t cursor, size_t max_visual_width) {
+    if (cursor > 0 && cursor == string->count && String_at(string, cursor - 1) != '\n') {
+        return cal_start_visual_line_jump(string, get_start_prev_char(string, cursor), max_visual_width);
+    }
+    return cal_start_visual_line_jump(string, cursor, max_visual_width);
+}
+
+
+// put the cursor at cursor (on the visual line starting at start_line_cursor)
+// a cursor above the screen goes to the top row; a cursor below row screen_y_below (or below the screen), to that row
+static inline void cursor_info_place_cursor_on_line(
+    Cursor_info* cursor_info,
+    const String* string,
+    size_t cursor,
+    size_t start_line_cursor,
+    size_t screen_y_below,
+    size_t max_visual_width
+) {
+    size_t screen_y_dest = screen_y_below;
+    if (start_line_cursor < cursor_info->scroll.offset) {
+        screen_y_dest = 0;
+    }
+    Cursor_info_jump(cursor_info, string, cursor, start_line_cursor, screen_y_dest, max_visual_width, screen_y_dest + 1);
+}
+
+
+// visual_x and visual_y of the cursor, after the scroll offset was moved to the start of a visual line
+// (only the visual lines between the scroll offset and the cursor are walked)
+static inline void cursor_info_place_cursor(Cursor_info* cursor_info, const String* string, size_t max_visual_width, size_t max_visual_height) {
+    size_t cursor = cursor_info->pos.cursor;
+    assert(cursor <= string->count);
+
+    size_t start_line_cursor = cal_start_visual_line_of_cursor(string, cursor, max_visual_width);
+    // (the row where moving right would leave it)
+    size_t screen_y_below = max_visual_height >= 2 ? max_visual_height - 2 : 0;
+    cursor_info_place_cursor_on_line(cursor_info, string, cursor, start_line_cursor, screen_y_below, max_visual_width);
+}
+
+
+// visual lines before the scroll offset are no longer known, so y and visual_y are counted from
+// TEXT_BOX_VISUAL_Y_ANCHOR (the row of the cursor on the screen is kept)
+static inline void Scroll_data_make_y_relative(Cursor_info* cursor_info) {
+    if (cursor_info->scroll.offset == 0) {
+        cursor_info->pos.visual_y -= cursor_info->scroll.y;
+        cursor_info->scroll.y = 0;
+        cursor_info->scroll.is_y_relative = false;
+        return;
+    }
+    cursor_info->pos.visual_y = TEXT_BOX_VISUAL_Y_ANCHOR + (cursor_info->pos.visual_y - cursor_info->scroll.y);
+    cursor_info->scroll.y = TEXT_BOX_VISUAL_Y_ANCHOR;
+    cursor_info->scroll.is_y_relative = true;
+}
+
+
+// after the wrap width or the text changed (resize, undo, redo): the first character on the screen stays on the
+// screen, and only the visual lines between it and the cursor are walked, so the cost does not depend on how far
+// into the text the screen is (visual_y is then counted from TEXT_BOX_VISUAL_Y_ANCHOR; see Scroll_data)
+static inline void Text_box_recalculate_visual_xy_and_scroll_offset(Text_box* text_box, size_t max_visual_width, size_t max_visual_height) {
+    Cursor_info* cursor_info = &text_box->cursor_info;
+    const String* string = &text_box->string;
+
+    size_t first_visible = MIN(cursor_info->scroll.offset, get_end_of_text(string, max_visual_width));
+    cursor_info->scroll.offset = cal_start_visual_line_jump(string, first_visible, max_visual_width);
+    if (cursor_info->scroll.offset == 0) {
+        cursor_info->scroll.y = 0;
+        cursor_info->scroll.is_y_relative = false;
+    } else {
+        cursor_info->scroll.y = TEXT_BOX_VISUAL_Y_ANCHOR;
+        cursor_info->scroll.is_y_relative = true;
+    }
+    cursor_info_place_cursor(cursor_info, string, max_visual_width, max_visual_height);
+    debug("Text_box_recalculate_visual_xy_and_scroll_offset: cursor: %zu; visual_x: %zu; offset: %zu", cursor_info->pos.cursor, cursor_info->pos.visual_x, cursor_info->scroll.offset);
+}
+
+
+// position idx after count_removed bytes at start were replaced by count_inserted bytes
+// (a position within the removed bytes goes to their start; text inserted at idx goes after it)
+static inline size_t text_box_adjust_after_edit(size_t idx, size_t start, size_t count_removed, size_t count_inserted) {
+    if (idx <= start) {
+        return idx;
+    }
+    if (idx < start + count_removed) {
+        return start;
+    }
+    return idx - count_removed + count_inserted;
+}
+
+
+// second part of Cursor_info_note_edit, once the cursor and the scroll offset were moved with the text
+// (string[start, end) is the text that the edit inserted; see also Document_note_batch)
+static inline void Cursor_info_note_moved(
+    Cursor_info* cursor_info,
+    const String* string,
+    size_t start,
+    size_t end,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    Scroll_data* scroll = &cursor_info->scroll;
+    size_t end_prev_line;
+    size_t start_line_offset = line_scan_find_newline_backward(&end_prev_line, string->items, 0, scroll->offset) ? end_prev_line + 1 : 0;
+    if (end < start_line_offset) {
+        // the edit is before the line of the scroll offset, so the screen shows the same rows as before
+        Scroll_data_make_y_relative(cursor_info);
+        return;
+    }
+
+    size_t first_visible = MIN(scroll->offset, get_end_of_text(string, max_visual_width));
+    scroll->offset = cal_start_visual_line_jump(string, first_visible, max_visual_width);
+    if (start < scroll->offset) {
+        Scroll_data_make_y_relative(cursor_info);
+    }
+    cursor_info_place_cursor(cursor_info, string, max_visual_width, max_visual_height);
+}
+
+
+// keep the cursor and scroll of a window that did not make the edit (eg. the other window of a split) up to date,
+// after count_removed bytes at start of string were replaced by string[start, start + count_inserted)
+// positions are moved with the text; the visual lines between the scroll offset and the cursor are only walked again
+// if the edit was within them (an edit after the cursor, or before the line of the scroll offset, is not walked at all)
+static inline void Cursor_info_note_edit(
+    Cursor_info* cursor_info,
+    const String* string,
+    size_t start,
+    size_t count_removed,
+    size_t count_inserted,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    Pos_data* pos = &cursor_info->pos;
+    Scroll_data* scroll = &cursor_info->scroll;
+    if (start >= pos->cursor && start >= scroll->offset) {
+        return;
+    }
+    pos->cursor = text_box_adjust_after_edit(pos->cursor, start, count_removed, count_inserted);
+    scroll->offset = text_box_adjust_after_edit(scroll->offset, start, count_removed, count_inserted);
+    Cursor_info_note_moved(cursor_info, string, start, start + count_inserted, max_visual_width, max_visual_height);
+}
+
+
+static inline void Cursor_info_move_cursor_to_start_of_file(Cursor_info* cursor_info) {
+    Pos_data_move_to_start_of_file(&cursor_info->pos);
+    cursor_info->scroll.offset = 0;
+    cursor_info->scroll.y = 0;
+    cursor_info->scroll.is_y_relative = false;
+    cursor_info->scroll.user_max_col = 0;
+}
+
+
+// the end of the text is shown on the row above the bottom row of the screen, where moving right would leave it
+// (unless it is already on the screen)
+static inline void Cursor_info_move_cursor_to_end_of_file(
+    Cursor_info* cursor_info,
+    const String* string,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    size_t end = get_end_of_text(string, max_visual_width);
+    size_t start_last_line = cal_start_visual_line_jump(string, end, max_visual_width);
+    size_t screen_y_dest = max_visual_height >= 2 ? max_visual_height - 2 : 0;
+    Cursor_info_jump(cursor_info, string, end, start_last_line, screen_y_dest, max_visual_width, screen_y_dest + 1);
+}
+
+
+static inline void Cursor_info_move_cursor_to_start_of_line(Cursor_info* cursor_info, const String* string, size_t max_visual_width) {
+    cursor_info->pos.cursor = get_start_visual_line_from_visual_x(string, cursor_info->pos.cursor, cursor_info->pos.visual_x, max_visual_width);
+    cursor_info->pos.visual_x = 0;
+    cursor_info->scroll.user_max_col = 0;
+}
+
+
+static inline void Cursor_info_move_cursor_to_end_of_line(Cursor_info* cursor_info, const String* string, size_t max_visual_width) {
+    size_t start_line = get_start_visual_line_from_visual_x(string, cursor_info->pos.cursor, cursor_info->pos.visual_x, max_visual_width);
+    size_t end = get_end_visual_line(string, start_line, max_visual_width);
+    cursor_info->pos.cursor = end;
+    cursor_info->pos.visual_x = columns_count(string->items, start_line, end, 0, max_visual_width);
+    cursor_info->scroll.user_max_col = cursor_info->pos.visual_x;
+}
+
+
+// line_num is counted from 0; if the text has fewer lines, the cursor goes to the start of the last line
+// the line is shown on the top row of the screen (unless it is already on the screen)
+static inline void Cursor_info_move_cursor_to_line(
+    Cursor_info* cursor_info,
+    const String* string,
+    size_t line_num,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    size_t start_line = 0;
+    for (size_t idx = 0; idx < line_num; idx++) {
+        size_t boundary;
+        size_t start_next_line;
+        if (
+            !line_scan_find_newline_forward(&boundary, string->items, start_line, string->count) ||
+            !get_start_line_after_boundary(&start_next_line, string, boundary)
+        ) {
             break;
-        case CUR_ADV_PAST_END_BUFFER:
-            // cursor is now at the end of the file effectively
-            return;
-        case CUR_ADV_ERROR:
-            log("fetal error: unreachable");
-            abort();
         }
+        start_line = start_next_line;
     }
+
+    Cursor_info_jump(cursor_info, string, start_line, start_line, 0, max_visual_width, max_visual_height);
+    cursor_info->scroll.user_max_col = 0;
 }
 
+
+// position on the visual line from start_line to start_next_line (string->count + 1 if it is the last line) that is 
+// closest to column max_col, without going past the end of the line; visual_x is set to the column of that position
+static inline size_t get_cursor_at_column(
+    size_t* visual_x,
+    const String* string,
+    size_t start_line,
+    size_t start_next_line,
+    size_t max_col,
+    size_t max_visual_width
+) {
+    // printable ascii is one column per byte, so only the bytes up to column max_col are searched
+    // (far along a line that is not wrapped, the column is found with the column map of the line)
+    size_t end_line = MIN(start_next_line, string->count);
+    size_t end_search = end_line - start_line > max_col ? start_line + max_col + 1 : end_line;
+    if (max_visual_width == TEXT_BOX_NO_WRAP && end_search - start_line >= COLUMN_MAP_MIN_BYTES) {
+        const Column_map* map = Column_map_get_at(string, start_line, max_visual_width);
+        return Column_map_find_column(visual_x, map, string, start_line, MIN(start_next_line - 1, string->count), max_col);
+    }
+    size_t special;
+    if (!columns_find_special(&special, string->items, start_line, end_search, false)) {
+        *visual_x = MIN(start_next_line - start_line - 1, max_col);
+        return start_line + *visual_x;
+    }
+
+    size_t cursor = start_line;
+    size_t curr_visual_x = 0;
+    while (cursor < string->count && String_at(string, cursor) != '\n') {
+        size_t width;
+        size_t end_char = columns_next_cell(&width, string->items, cursor, string->count, curr_visual_x, max_visual_width);
+        if (end_char >= start_next_line || curr_visual_x + width > max_col) {
+            break;
+        }
+        curr_visual_x += width;
+        cursor = end_char;
+    }
+    *visual_x = curr_visual_x;
+    return cursor;
+}
+
+
 static inline void Cursor_info_move_cursor_left(
     Cursor_info* cursor_info,
     const String* string,
@@ -880,7 +1738,6 @@ static inline void Cursor_info_move_cursor_left(
     switch (status) {
     case CUR_DEC_MOVED_TO_PREV_LINE:
         Scroll_data_scroll_screen_up_one(&cursor_info->scroll, &cursor_info->pos, string, max_visual_width);
-        assert(cursor_info->scroll.x == 0 && "not implemented");
         // fallthrough
     case CUR_DEC_NORMAL:
         // fallthrough
@@ -918,8 +1775,8 @@ static inline void Cursor_info_move_cursor_up(
         String_at(string, cursor_info->scroll.offset)
     );
 
-    if (cursor_info->pos.visual_y < 1) {
-        // cursor is already at topmost line of the buffer
+    if (0 == get_start_visual_line_from_visual_x(string, cursor_info->pos.cursor, cursor_info->pos.visual_x, max_visual_width)) {
+        // cursor is already at topmost line of the buffer (visual line starts at 0)
         //debug("topmost thing");
         return;
     }
@@ -948,14 +1805,16 @@ static inline void Cursor_info_move_cursor_up(
         abort();
     }
     debug("after start_prev_line thing");
-    size_t len_prev_line = start_curr_line.cursor - start_prev_line.cursor;
-    debug("dir_up: start_curr_line: %zu; start_prev_line: %zu; len_prev_line: %zu", start_curr_line.cursor, start_prev_line.cursor, len_prev_line);
-    assert(len_prev_line > 0);
+    debug("dir_up: start_curr_line: %zu; start_prev_line: %zu", start_curr_line.cursor, start_prev_line.cursor);
+    assert(start_curr_line.cursor > start_prev_line.cursor);
 
     //debug("dir_up: thing 5");
+    // (if the previous line is the header of a closed fold, it ends where the fold starts)
     cursor_info->pos.visual_y--;
-    cursor_info->pos.visual_x = MIN(len_prev_line - 1, cursor_info->scroll.user_max_col);
-    cursor_info->pos.cursor = start_prev_line.cursor + cursor_info->pos.visual_x;
+    cursor_info->pos.cursor = get_cursor_at_column(
+        &cursor_info->pos.visual_x, string, start_prev_line.cursor, folds_skip_backward(string, start_curr_line.cursor),
+        cursor_info->scroll.user_max_col, max_visual_width
+    );
     //cursor_info->scroll_offset = start_prev_line->cursor + cursor_info->visual_x;
 
     if (cursor_info->pos.visual_y < cursor_info->scroll.y) {
@@ -1005,6 +1864,11 @@ static inline void Cursor_info_move_cursor_down(Cursor_info* cursor_info, const
     )) {
         return;
     }
+    // the lines of a closed fold are skipped (if the rest of the text is folded, there is no next line)
+    start_next_line.cursor = folds_skip_forward(string, start_next_line.cursor);
+    if (start_next_line.cursor >= string->count) {
+        return;
+    }
 
     Pos_data start_curr_line;
     if (!get_start_curr_visual_line_from_curr_cursor_x(&start_curr_line, string, cursor_info->pos.cursor, cursor_info->pos.visual_x, max_visual_width)) {
@@ -1017,12 +1881,11 @@ static inline void Cursor_info_move_cursor_down(Cursor_info* cursor_info, const
 #   endif
     //print_chars_near_cursor(text_box, start_curr_line);
 
+    // (if lines are not wrapped, the end of the next line is kept in its column map, so a long line is not searched)
     size_t start_2next_line;
     {
         Pos_data temp;
-        if (get_start_next_visual_line_from_curr_cursor_x(
-            &temp, string, &start_next_line, max_visual_width
-        )) {
+        if (get_start_next_visual_line_from_curr_cursor_x(&temp, string, &start_next_line, max_visual_width)) {
             start_2next_line = temp.cursor;
         } else {
             start_2next_line = string->count + 1;
@@ -1030,7 +1893,6 @@ static inline void Cursor_info_move_cursor_down(Cursor_info* cursor_info, const
     }
 
     assert(start_2next_line > start_next_line.cursor);
-    size_t len_next_line = start_2next_line - start_next_line.cursor;
     //debug("DIR_DOWN before making changes: cursor: %zu; start_curr_line: %zu; start_next_line: %zu; len_next_line: %zu", text_box->cursor, start_curr_line, start_next_line, len_next_line);
 
     /*
@@ -1047,9 +1909,10 @@ static inline void Cursor_info_move_cursor_down(Cursor_info* cursor_info, const
     );
     */
     Scroll_data_scroll_screen_down_one(&cursor_info->scroll, &cursor_info->pos, string, max_visual_width, max_visual_height);
-    cursor_info->pos.visual_x = MIN(len_next_line - 1, cursor_info->scroll.user_max_col);
     cursor_info->pos.visual_y++;
-    cursor_info->pos.cursor = start_next_line.cursor + cursor_info->pos.visual_x;
+    cursor_info->pos.cursor = get_cursor_at_column(
+        &cursor_info->pos.visual_x, string, start_next_line.cursor, start_2next_line, cursor_info->scroll.user_max_col, max_visual_width
+    );
 
     /*
     debug(
@@ -1074,8 +1937,13 @@ static inline void Text_box_move_cursor(
     size_t max_visual_height,
     bool wrap
 ) {
+    Pos_data* pos = &text_box->cursor_info.pos;
     switch (direction) {
     case DIR_LEFT:
+        if (pos->visual_x == 0) {
+            // moving left from the line after a closed fold goes to the end of its header
+            pos->cursor = folds_skip_backward(&text_box->string, pos->cursor);
+        }
         Cursor_info_move_cursor_left(
             &text_box->cursor_info,
             &text_box->string,
@@ -1084,7 +1952,17 @@ static inline void Text_box_move_cursor(
             wrap
         );
         break;
-    case DIR_RIGHT:
+    case DIR_RIGHT: {
+        // moving right from the end of the header of a closed fold goes to the line after the fold
+        size_t start_next_line = pos->cursor + 1;
+        size_t after_fold = start_next_line;
+        if (pos->cursor < text_box->string.count && String_at(&text_box->string, pos->cursor) == '\n') {
+            after_fold = folds_skip_forward(&text_box->string, start_next_line);
+        }
+        if (after_fold != start_next_line && after_fold >= text_box->string.count) {
+            // (the rest of the text is folded)
+            break;
+        }
         Cursor_info_move_cursor_right(
             &text_box->cursor_info,
             &text_box->string,
@@ -1092,7 +1970,10 @@ static inline void Text_box_move_cursor(
             max_visual_height,
             wrap
         );
-        break;
+        if (after_fold != start_next_line && pos->cursor == start_next_line) {
+            pos->cursor = after_fold;
+        }
+        } break;
     case DIR_UP:
         Cursor_info_move_cursor_up(
             &text_box->cursor_info,
@@ -1113,15 +1994,245 @@ static inline void Text_box_move_cursor(
 }
 
 
+// position count_moves characters left (or right) of cursor, stopping at the start (or end) of the text
+// (a line ending next to a closed fold steps over the fold, as in Text_box_move_cursor)
+static inline size_t text_box_step_chars(const String* string, size_t cursor, DIRECTION direction, size_t count_moves, size_t max_visual_width) {
+    if (direction == DIR_LEFT) {
+        for (size_t idx = 0; idx < count_moves && cursor > 0; idx++) {
+            if (String_at(string, cursor - 1) == '\n') {
+                cursor = folds_skip_backward(string, cursor);
+            }
+            cursor = get_start_prev_char(string, cursor);
+        }
+        return cursor;
+    }
+
+    size_t end = get_end_of_text(string, max_visual_width);
+    for (size_t idx = 0; idx < count_moves && cursor < end; idx++) {
+        if (String_at(string, cursor) != '\n') {
+            cursor = get_end_of_char(string, cursor);
+            continue;
+        }
+        size_t after_fold = folds_skip_forward(string, cursor + 1);
+        if (after_fold != cursor + 1 && after_fold >= string->count) {
+            // (the rest of the text is folded)
+            break;
+        }
+        cursor = after_fold;
+    }
+    return cursor;
+}
+
+
+// start of the visual line count_lines visual lines down from the visual line starting at start_line (closed folds are
+// skipped, as in Cursor_info_move_cursor_down)
+// returns count of visual lines walked (less than count_lines if the last line was reached)
+static inline size_t walk_visual_lines_down(
+    size_t* result,
+    const String* string,
+    size_t start_line,
+    size_t count_lines,
+    size_t max_visual_width
+) {
+    size_t curr_start = start_line;
+    size_t count_walked = 0;
+    for (; count_walked < count_lines; count_walked++) {
+        Pos_data curr_pos = {.cursor = curr_start, .visual_x = 0, .visual_y = 0};
+        Pos_data start_next_line;
+        if (!get_start_next_visual_line_scan(&start_next_line, string, &curr_pos, max_visual_width)) {
+            break;
+        }
+        size_t after_fold = folds_skip_forward(string, start_next_line.cursor);
+        if (after_fold >= string->count) {
+            break;
+        }
+        curr_start = after_fold;
+    }
+    *result = curr_start;
+    return count_walked;
+}
+
+
+// move the cursor count_moves visual lines up or down, to the column it was last moved to (user_max_col)
+static inline void cursor_info_move_lines(
+    Cursor_info* cursor_info,
+    const String* string,
+    DIRECTION direction,
+    size_t count_moves,
+    size_t max_visual_width,
+    size_t max_visual_height
+) {
+    if (direction == DIR_UP && cursor_info->pos.cursor == string->count && count_moves > 0) {
+        // (moving up from the end of the text moves left)
+        Cursor_info_move_cursor_up(cursor_info, string, max_visual_width, max_visual_height);
+        count_moves--;
+    }
+
+    size_t start_curr_line = get_start_visual_line_from_visual_x(string, cursor_info->pos.cursor, cursor_info->pos.visual_x, max_visual_width);
+    size_t start_dest_line;
+    size_t count_walked = direction == DIR_UP ?
+        walk_visual_lines_up(&start_dest_line, string, start_curr_line, count_moves, max_visual_width) :
+        walk_visual_lines_down(&start_dest_line, string, start_curr_line, count_moves, max_visual_width);
+    if (count_walked < 1) {
+        return;
+    }
+
+    Pos_data dest_line = {.cursor = start_dest_line, .visual_x = 0, .visual_y = 0};
+    Pos_data temp;
+    size_t start_after_dest_line = string->count + 1;
+    if (get_start_next_visual_line_from_curr_cursor_x(&temp, string, &dest_line, max_visual_width)) {
+        start_after_dest_line = temp.cursor;
+    }
+    size_t visual_x;
+    size_t cursor = get_cursor_at_column(
+        &visual_x, string, start_dest_line, start_after_dest_line, cursor_info->scroll.user_max_col, max_visual_width
+    );
+
+    // (moving down leaves the cursor on the bottom row of the screen)
+    size_t screen_y_below = max_visual_height >= 1 ? max_visual_height - 1 : 0;
+    cursor_info_place_cursor_on_line(cursor_info, string, cursor, start_dest_line, screen_y_below, max_visual_width);
+}
+
+
+// several consecutive moves in the same direction (eg. held arrow key) are merged into one: the destination is found
+// first (stepping over characters, or over visual lines), and then the cursor is placed there, and the screen is
+// scrolled, once (like a jump)
+static inline void Text_box_move_cursor_repeat(
+    Text_box* text_box,
+    DIRECTION direction,
+    size_t count_moves,
+    size_t max_visual_width,
+    size_t max_visual_height,
+    bool wrap
+) {
+    if (count_moves < 2 || wrap) {
+        for (size_t idx = 0; idx < count_moves; idx++) {
+            Text_box_move_cursor(text_box, direction, max_visual_width, max_visual_height, wrap);
+        }
+        return;
+    }
+
+    Cursor_info* cursor_info = &text_box->cursor_info;
+    const String* string = &text_box->string;
+    switch (direction) {
+    case DIR_LEFT: // fallthrough
+    case DIR_RIGHT: {
+        size_t cursor = text_box_step_chars(string, cursor_info->pos.cursor, direction, count_moves, max_visual_width);
+        if (cursor == cursor_info->pos.cursor) {
+            return;
+        }
+        // moving right leaves the cursor on the row above the bottom row of the screen (or on the bottom row, if it
+        // already was there)
+        size_t screen_y = cursor_info->pos.visual_y - cursor_info->scroll.y;
+        size_t screen_y_below = MAX(max_visual_height >= 2 ? max_visual_height - 2 : 0, screen_y);
+        cursor_info_place_cursor_on_line(
+            cursor_info, string, cursor, cal_start_visual_line_of_cursor(string, cursor, max_visual_width), screen_y_below, max_visual_width
+        );
+        cursor_info->scroll.user_max_col = cursor_info->pos.visual_x;
+        } break;
+    case DIR_UP: // fallthrough
+    case DIR_DOWN:
+        cursor_info_move_lines(cursor_info, string, direction, count_moves, max_visual_width, max_visual_height);
+        break;
+    }
+}
+
+
+// move the cursor one page (max_visual_height - 1 visual lines) down, and scroll the screen by the same amount
+static inline void Cursor_info_move_page_down(Cursor_info* cursor_info, const String* string, size_t max_visual_width, size_t max_visual_height) {
+    size_t screen_y = cursor_info->pos.visual_y - cursor_info->scroll.y;
+    size_t count_lines = max_visual_height > 1 ? max_visual_height - 1 : 1;
+    for (size_t idx = 0; idx < count_lines; idx++) {
+        size_t prev_visual_y = cursor_info->pos.visual_y;
+        Cursor_info_move_cursor_down(cursor_info, string, max_visual_width, max_visual_height);
+        if (cursor_info->pos.visual_y == prev_visual_y) {
+            // cursor is on the last line
+            break;
+        }
+    }
+
+    // keep the cursor on the same row of the screen
+    while (cursor_info->pos.visual_y - cursor_info->scroll.y > screen_y) {
+        Pos_data pos_scroll_offset = {.cursor = cursor_info->scroll.offset, .visual_x = 0, .visual_y = 0};
+        Pos_data new_scroll_offset;
+        if (!get_start_next_visual_line_scan(&new_scroll_offset, string, &pos_scroll_offset, max_visual_width)) {
+            assert(false && "cursor is below the scroll offset");
+            abort();
+        }
+        cursor_info->scroll.offset = folds_skip_forward(string, new_scroll_offset.cursor);
+        cursor_info->scroll.y++;
+    }
+}
+
+
+// move the cursor one page (max_visual_height - 1 visual lines) up, and scroll the screen by the same amount
+static inline void Cursor_info_move_page_up(Cursor_info* cursor_info, const String* string, size_t max_visual_width, size_t max_visual_height) {
+    size_t screen_y = cursor_info->pos.visual_y - cursor_info->scroll.y;
+    size_t count_lines = max_visual_height > 1 ? max_visual_height - 1 : 1;
+    for (size_t idx = 0; idx < count_lines; idx++) {
+        size_t prev_cursor = cursor_info->pos.cursor;
+        Cursor_info_move_cursor_up(cursor_info, string, max_visual_width, max_visual_height);
+        if (cursor_info->pos.cursor == prev_cursor) {
+            // cursor is on the first line
+            break;
+        }
+    }
+
+    // keep the cursor on the same row of the screen
+    size_t curr_screen_y = cursor_info->pos.visual_y - cursor_info->scroll.y;
+    if (curr_screen_y >= screen_y) {
+        return;
+    }
+    size_t count_rows_up = screen_y - curr_screen_y;
+    size_t new_scroll_offset;
+    count_rows_up = walk_visual_lines_up(&new_scroll_offset, string, cursor_info->scroll.offset, count_rows_up, max_visual_width);
+    cursor_info->scroll.offset = new_scroll_offset;
+    cursor_info->scroll.y -= count_rows_up;
+}
+
+
+static inline void Text_box_jump(Text_box* text_box, JUMP jump, size_t max_visual_width, size_t max_visual_height) {
+    Cursor_info* cursor_info = &text_box->cursor_info;
+    switch (jump) {
+    case JUMP_START_OF_FILE:
+        Cursor_info_move_cursor_to_start_of_file(cursor_info);
+        break;
+    case JUMP_END_OF_FILE:
+        Cursor_info_move_cursor_to_end_of_file(cursor_info, &text_box->string, max_visual_width, max_visual_height);
+        cursor_info->scroll.user_max_col = cursor_info->pos.visual_x;
+        break;
+    case JUMP_START_OF_LINE:
+        Cursor_info_move_cursor_to_start_of_line(cursor_info, &text_box->string, max_visual_width);
+        break;
+    case JUMP_END_OF_LINE:
+        Cursor_info_move_cursor_to_end_of_line(cursor_info, &text_box->string, max_visual_width);
+        break;
+    case JUMP_PAGE_UP:
+        Cursor_info_move_page_up(cursor_info, &text_box->string, max_visual_width, max_visual_height);
+        break;
+    case JUMP_PAGE_DOWN:
+        Cursor_info_move_page_down(cursor_info, &text_box->string, max_visual_width, max_visual_height);
+        break;
+    default:
+        assert(false && "unreachable");
+        abort();
+    }
+}
+
+
 static inline bool Text_box_del_ch(Text_box* text_box, size_t index, size_t max_visual_width, size_t max_visual_height) {
     if (text_box->string.count < 1) {
         return false;
     }
 
-    assert(text_box->cursor_info.pos.cursor > 0);
+    // index is the start of the character before the cursor (which can be several bytes long)
+    size_t end_char = text_box->cursor_info.pos.cursor;
+    assert(end_char > index);
     Text_box_move_cursor(text_box, DIR_LEFT, max_visual_width, max_visual_height, false);
 
-    return String_del(&text_box->string, index);
+    bool is_deleted = String_del_substr(&text_box->string, index, end_char - index);
+    Column_map_update_after_edit(&text_box->string, index, end_char - index, 0);
+    return is_deleted;
 }
 
 
@@ -1131,22 +2242,16 @@ static inline bool Text_box_del_substr(Text_box* text_box, size_t index_start, s
     }
 
     assert(count_to_del > 0);
-    size_t idx_end = index_start + (count_to_del - 1);
-
-    for (size_t idx = 0; idx < count_to_del; idx++) {
-        if (!String_del(&text_box->string, idx_end)) {
-            return false;
-        }
-        idx_end--;
-    }
-
-    return true;
+    bool is_deleted = String_del_substr(&text_box->string, index_start, count_to_del);
+    Column_map_update_after_edit(&text_box->string, index_start, count_to_del, 0);
+    return is_deleted;
 }
 
 
 static inline void Text_box_insert_ch(Text_box* text_box, int new_ch, size_t index, size_t max_visual_width, size_t max_visual_height) {
     assert(index <= text_box->string.count && "out of bounds");
     String_insert(&text_box->string, new_ch, index);
+    Column_map_update_after_edit(&text_box->string, index, 0, 1);
     Text_box_move_cursor(text_box, DIR_RIGHT, max_visual_width, max_visual_height, false);
 }
 
@@ -1156,13 +2261,28 @@ static inline void Text_box_append(Text_box* text, int new_ch, size_t max_visual
 }
 
 
+// the whole substring is inserted with one memmove; then the cursor is moved past the inserted text
+// (one move per character, and a character can be several bytes long)
 static inline void Text_box_insert_substr(Text_box* text_box, const String* new_str, size_t index_start, size_t max_visual_width, size_t max_visual_height) {
-    for (size_t idx = new_str->count - 1; idx > 0; idx--) {
-        debug("YES YES thing");
-        Text_box_insert_ch(text_box, String_at(new_str, idx), index_start, max_visual_width, max_visual_height);
+    assert(index_start <= text_box->string.count && "out of bounds");
+    String_insert_cstr(&text_box->string, index_start, new_str->items, new_str->count);
+    Column_map_update_after_edit(&text_box->string, index_start, 0, new_str->count);
+    size_t end_inserted = index_start + new_str->count;
+    size_t len_combining;
+    if (utf8_is_zero_width_at(text_box->string.items, index_start, text_box->string.count, &len_combining)) {
+        // a combining character joins the character before it, so the cursor cannot be moved over it alone
+        text_box->cursor_info.pos.cursor = end_inserted;
+        Text_box_recalculate_visual_xy_and_scroll_offset(text_box, max_visual_width, max_visual_height);
+        return;
+    }
+    while (text_box->cursor_info.pos.cursor < end_inserted) {
+        size_t prev_cursor = text_box->cursor_info.pos.cursor;
+        Text_box_move_cursor(text_box, DIR_RIGHT, max_visual_width, max_visual_height, false);
+        if (prev_cursor == text_box->cursor_info.pos.cursor) {
+            // cursor is at the end of the text
+            break;
+        }
     }
-    debug("YES YES thing bottom");
-    Text_box_insert_ch(text_box, String_at(new_str, 0), index_start, max_visual_width, max_visual_height);
 }
 
 
@@ -1278,50 +2398,6 @@ static inline void Text_box_toggle_visual_mode(Text_box* text_box) {
 }
 
 
-typedef enum {
-    STATUS_LAST_LINE_ERROR,
-    STATUS_LAST_LINE_END_BUFFER,
-    STATUS_LAST_LINE_SUCCESS,
-} STATUS_GET_LAST_LINE;
-
-
-static inline STATUS_GET_LAST_LINE get_end_last_displayed_visual_line_from_cursor(
-    size_t* count_lines_actually_displayed,
-    size_t* end_last_displayed_line,
-    const Text_box* text_box,
-    size_t initial_scroll_offset,
-    size_t max_visual_height,
-    size_t max_visual_width
-) {
-    Pos_data curr_pos = {.cursor = initial_scroll_offset, .visual_x = 0, .visual_y = 0};
-    for (size_t idx = 0; idx < max_visual_height; idx++) {
-        Pos_data new_curr_cursor;
-        if (!get_start_next_visual_line_from_curr_cursor_x(
-            &new_curr_cursor,
-            &text_box->string,
-            &curr_pos,
-            max_visual_width
-        )) {
-            curr_pos.cursor = (text_box->string.count > 1) ? (text_box->string.count - 1) : 0;
-            *end_last_displayed_line = curr_pos.cursor;
-            *count_lines_actually_displayed = idx;
-            debug("last line end buffer thing");
-            return STATUS_LAST_LINE_END_BUFFER;
-        }
-
-        curr_pos.visual_x = 0;
-        curr_pos.cursor = new_curr_cursor.cursor;
-    }
-
-    // curr_cursor is now at the beginning of the next line
-    
-    *end_last_displayed_line = curr_pos.cursor - 1;
-    *count_lines_actually_displayed = max_visual_height;
-    debug("last line success normal thing");
-    return STATUS_LAST_LINE_SUCCESS;
-}
-
-
 static size_t Text_box_get_visual_sel_start(const Text_box* text_box) {
     if (text_box->visual_sel.cursor_started < text_box->cursor_info.pos.cursor) {
         return text_box->visual_sel.cursor_started;
@@ -0,0 +1,59 @@
+#ifndef TEXT_EDITOR_CORE_H
+#define TEXT_EDITOR_CORE_H
+
+
+// headless api of the editor core (libtext_editor_core.a; see make build_core)
+// the buffer, cursor, undo, search, and save logic of the editor, without any dependency on a terminal
+//
+// text is wrapped at the width set with Core_document_set_size, the same way as the editor displays it
+//
+// the core is single threaded: all documents share process wide state (the column map cache, the tab width, the
+// registries of folds and clipboard blobs, and the tables of the syntax lexer), so all documents have to be used
+// from the same thread (or calls into the core have to be serialized by the caller)
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+typedef struct Core_document Core_document;
+
+
+typedef enum {CORE_DIR_UP, CORE_DIR_DOWN, CORE_DIR_RIGHT, CORE_DIR_LEFT} CORE_DIRECTION;
+
+
+// returns NULL if memory could not be allocated
+// log_file_name may be NULL (log messages are then written to stderr)
+Core_document* Core_document_new(const char* log_file_name);
+void Core_document_free(Core_document* document);
+
+// returns false if file could not be read (errno is set)
+bool Core_document_open(Core_document* document, const char* file_name);
+// the file is written to a temporary file in the same directory, which then replaces the file
+// returns false if file could not be written
+bool Core_document_save(Core_document* document);
+bool Core_document_has_unsaved_changes(const Core_document* document);
+
+// size of the (imaginary) screen that the text is displayed on
+void Core_document_set_size(Core_document* document, size_t width, size_t height);
+
+// text is not null terminated, and has \n line endings (the line ending of the file is restored when it is saved)
+const char* Core_document_get_text(const Core_document* document, size_t* count);
+size_t Core_document_get_cursor(const Core_document* document);
+void Core_document_move_cursor(Core_document* document, CORE_DIRECTION direction, size_t count);
+
+// insert text at the cursor (as one undoable action), and move the cursor past it
+void Core_document_insert(Core_document* document, const char* text, size_t count);
+// returns false if cursor is at the start of the text
+bool Core_document_backspace(Core_document* document);
+
+// returns false if there is nothing to undo/redo
+bool Core_document_undo(Core_document* document);
+bool Core_document_redo(Core_document* document);
+
+// move the cursor to the next (or previous) occurrence of query, starting at the cursor
+// returns false if query was not found
+bool Core_document_search(Core_document* document, const char* query, size_t count_query, bool forwards);
+
+
+#endif // TEXT_EDITOR_CORE_H
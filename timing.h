@@ -0,0 +1,206 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+
+#include <stdint.h>
+#include <time.h>
+#include "util.h"
+
+
+// phases of handling one keystroke (from the blocking read of the terminal returning until the terminal is flushed)
+// input decode is the time spent reading and decoding the keys (and pastes) that were already pending
+typedef enum {
+    PHASE_INPUT_DECODE = 0,
+    PHASE_PROCESS,
+    PHASE_LAYOUT,
+    PHASE_DRAW,
+    PHASE_FLUSH,
+
+    PHASE_COUNT
+} PHASE;
+
+
+static const char* PHASE_NAMES[PHASE_COUNT] = {"input decode", "process", "layout", "draw", "flush"};
+
+
+// bucket n holds durations in [2^n, 2^(n + 1)) nanoseconds
+#define LATENCY_HIST_COUNT_BUCKETS 40
+
+
+typedef struct {
+    uint64_t buckets[LATENCY_HIST_COUNT_BUCKETS];
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} Latency_hist;
+
+
+typedef struct {
+    bool enabled;
+    uint64_t slow_key_threshold_ns; // keystrokes slower than this are logged (0 means never log)
+
+    bool key_in_flight; // true between the blocking read of the terminal returning and the terminal being flushed
+    int curr_key;
+    uint64_t key_start_ns;
+    uint64_t phase_start_ns;
+    uint64_t curr_phases_ns[PHASE_COUNT];
+
+    Latency_hist phases[PHASE_COUNT];
+    Latency_hist total;
+} Timing;
+
+
+static inline uint64_t get_time_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+
+static inline void Latency_hist_add(Latency_hist* hist, uint64_t duration_ns) {
+    size_t bucket = 0;
+    while (bucket + 1 < LATENCY_HIST_COUNT_BUCKETS && (duration_ns >> (bucket + 1)) > 0) {
+        bucket++;
+    }
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->total_ns += duration_ns;
+    if (duration_ns > hist->max_ns) {
+        hist->max_ns = duration_ns;
+    }
+}
+
+
+// returns the upper bound of the bucket that contains the requested percentile
+static inline uint64_t Latency_hist_percentile(const Latency_hist* hist, double percentile) {
+    if (hist->count < 1) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(percentile * (double)hist->count);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_HIST_COUNT_BUCKETS; bucket++) {
+        seen += hist->buckets[bucket];
+        if (seen > target) {
+            return MIN((uint64_t)1 << (bucket + 1), hist->max_ns);
+        }
+    }
+    return hist->max_ns;
+}
+
+
+static inline void Timing_init(Timing* timing) {
+    memset(timing, 0, sizeof(*timing));
+}
+
+
+// all of the functions below return immediately when timing is disabled
+
+// to be called right after the blocking read of the terminal returns
+static inline void Timing_key_start(Timing* timing) {
+    if (!timing->enabled) {
+        return;
+    }
+    timing->key_in_flight = true;
+    timing->curr_key = 0;
+    timing->key_start_ns = get_time_ns();
+    timing->phase_start_ns = timing->key_start_ns;
+    memset(timing->curr_phases_ns, 0, sizeof(timing->curr_phases_ns));
+}
+
+
+static inline void Timing_phase_end(Timing* timing, PHASE phase) {
+    if (!timing->enabled || !timing->key_in_flight) {
+        return;
+    }
+    uint64_t now = get_time_ns();
+    timing->curr_phases_ns[phase] += now - timing->phase_start_ns;
+    timing->phase_start_ns = now;
+}
+
+
+// to be called once the pending keys are read and decoded (key is the first of them)
+static inline void Timing_key_decoded(Timing* timing, int key) {
+    if (!timing->enabled || !timing->key_in_flight) {
+        return;
+    }
+    timing->curr_key = key;
+    Timing_phase_end(timing, PHASE_INPUT_DECODE);
+}
+
+
+static inline void Timing_key_end(Timing* timing) {
+    if (!timing->enabled || !timing->key_in_flight) {
+        return;
+    }
+    timing->key_in_flight = false;
+
+    uint64_t total_ns = get_time_ns() - timing->key_start_ns;
+    Latency_hist_add(&timing->total, total_ns);
+    for (size_t idx = 0; idx < PHASE_COUNT; idx++) {
+        Latency_hist_add(&timing->phases[idx], timing->curr_phases_ns[idx]);
+    }
+
+    if (timing->slow_key_threshold_ns > 0 && total_ns >= timing->slow_key_threshold_ns) {
+        log(
+            "slow keystroke: key %d: total %.3f ms; %s: %.3f ms; %s: %.3f ms; %s: %.3f ms; %s: %.3f ms; %s: %.3f ms",
+            timing->curr_key,
+            total_ns / 1e6,
+            PHASE_NAMES[PHASE_INPUT_DECODE], timing->curr_phases_ns[PHASE_INPUT_DECODE] / 1e6,
+            PHASE_NAMES[PHASE_PROCESS], timing->curr_phases_ns[PHASE_PROCESS] / 1e6,
+            PHASE_NAMES[PHASE_LAYOUT], timing->curr_phases_ns[PHASE_LAYOUT] / 1e6,
+            PHASE_NAMES[PHASE_DRAW], timing->curr_phases_ns[PHASE_DRAW] / 1e6,
+            PHASE_NAMES[PHASE_FLUSH], timing->curr_phases_ns[PHASE_FLUSH] / 1e6
+        );
+    }
+}
+
+
+static inline void Latency_hist_log(const Latency_hist* hist, const char* name) {
+    log(
+        "timing: %s: count: %llu; mean: %.3f us; p50: %.3f us; p90: %.3f us; p99: %.3f us; max: %.3f us",
+        name,
+        (unsigned long long)hist->count,
+        hist->count > 0 ? hist->total_ns / 1e3 / hist->count : 0.0,
+        Latency_hist_percentile(hist, 0.50) / 1e3,
+        Latency_hist_percentile(hist, 0.90) / 1e3,
+        Latency_hist_percentile(hist, 0.99) / 1e3,
+        hist->max_ns / 1e3
+    );
+    for (size_t bucket = 0; bucket < LATENCY_HIST_COUNT_BUCKETS; bucket++) {
+        if (hist->buckets[bucket] < 1) {
+            continue;
+        }
+        log(
+            "timing: %s:     < %.3f us: %llu",
+            name,
+            ((uint64_t)1 << (bucket + 1)) / 1e3,
+            (unsigned long long)hist->buckets[bucket]
+        );
+    }
+}
+
+
+// write histograms to the log file, and a one line summary into summary
+static inline void Timing_report(String* summary, const Timing* timing) {
+    Latency_hist_log(&timing->total, "keystroke total");
+    for (size_t idx = 0; idx < PHASE_COUNT; idx++) {
+        Latency_hist_log(&timing->phases[idx], PHASE_NAMES[idx]);
+    }
+
+    char buf[256];
+    int len = snprintf(
+        buf,
+        sizeof(buf),
+        "[timing]: keys: %llu; p50: %.1f us; p99: %.1f us; max: %.1f us (histograms written to %s)",
+        (unsigned long long)timing->total.count,
+        Latency_hist_percentile(&timing->total, 0.50) / 1e3,
+        Latency_hist_percentile(&timing->total, 0.99) / 1e3,
+        timing->total.max_ns / 1e3,
+        LOG_FILE_NAME
+    );
+    String_cpy_from_cstr(summary, buf, MIN((size_t)len, sizeof(buf) - 1));
+}
+
+
+#endif // TIMING_H
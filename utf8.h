@@ -0,0 +1,248 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "util.h"
+#include "line_scan.h"
+
+
+// utf-8 decoding, and the display width of characters
+//
+// the text is kept as bytes; a character is drawn in one or two columns of the screen, together with the combining
+// (zero width) characters that follow it (see columns.h for how the columns of the text are counted)
+// bytes that are not part of a valid utf-8 sequence are characters of their own (one column wide, drawn as U+FFFD)
+//
+// ascii (every byte < 0x80) is never decoded: it is skipped with a vectorized search
+
+
+#define UTF8_INVALID 0xffffffffu
+#define UTF8_MAX_LEN 4
+
+#define UTF8_REPLACEMENT "\xef\xbf\xbd"
+#define UTF8_REPLACEMENT_LEN 3
+
+
+// find the first byte >= 0x80 in items[start, end)
+// returns false if there is none
+static inline bool utf8_find_non_ascii(size_t* result, const char* items, size_t start, size_t end) {
+    size_t idx = start;
+
+#ifdef __SSE2__
+    for (; idx + 16 <= end; idx += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(items + idx));
+        unsigned mask = (unsigned)_mm_movemask_epi8(chunk);
+        if (mask) {
+            *result = idx + __builtin_ctz(mask);
+            return true;
+        }
+    }
+#else
+    for (; idx + 8 <= end; idx += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, items + idx, sizeof(chunk));
+        if (chunk & LINE_SCAN_SWAR_HIGHS) {
+            // exact position is found below
+            break;
+        }
+    }
+#endif // __SSE2__
+
+    for (; idx < end; idx++) {
+        if ((unsigned char)items[idx] >= 0x80) {
+            *result = idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// decode the character at items[idx] (idx < end)
+// returns its length in bytes; code_point is UTF8_INVALID (and the length is 1) if the bytes at idx are not valid utf-8
+// (overlong encodings, surrogates, and code points past U+10FFFF are not valid)
+static inline size_t utf8_decode(uint32_t* code_point, const char* items, size_t idx, size_t end) {
+    const unsigned char* bytes = (const unsigned char*)items + idx;
+    unsigned char lead = bytes[0];
+    if (lead < 0x80) {
+        *code_point = lead;
+        return 1;
+    }
+
+    size_t len;
+    uint32_t result;
+    uint32_t min_code_point;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        len = 2;
+        result = lead & 0x1f;
+        min_code_point = 0x80;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        len = 3;
+        result = lead & 0x0f;
+        min_code_point = 0x800;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        len = 4;
+        result = lead & 0x07;
+        min_code_point = 0x10000;
+    } else {
+        *code_point = UTF8_INVALID;
+        return 1;
+    }
+
+    if (len > end - idx) {
+        *code_point = UTF8_INVALID;
+        return 1;
+    }
+    for (size_t idx_byte = 1; idx_byte < len; idx_byte++) {
+        if ((bytes[idx_byte] & 0xc0) != 0x80) {
+            *code_point = UTF8_INVALID;
+            return 1;
+        }
+        result = (result << 6) | (bytes[idx_byte] & 0x3f);
+    }
+    if (result < min_code_point || result > 0x10ffff || (result >= 0xd800 && result <= 0xdfff)) {
+        *code_point = UTF8_INVALID;
+        return 1;
+    }
+
+    *code_point = result;
+    return len;
+}
+
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} Utf8_range;
+
+
+// combining marks, zero width spaces and joiners, and variation selectors (sorted)
+static const Utf8_range UTF8_ZERO_WIDTH[] = {
+    {0x0300, 0x036f}, {0x0483, 0x0489}, {0x0591, 0x05bd}, {0x05bf, 0x05bf}, {0x05c1, 0x05c2}, {0x05c4, 0x05c5},
+    {0x05c7, 0x05c7}, {0x0610, 0x061a}, {0x064b, 0x065f}, {0x0670, 0x0670}, {0x06d6, 0x06dc}, {0x06df, 0x06e4},
+    {0x06e7, 0x06e8}, {0x06ea, 0x06ed}, {0x0711, 0x0711}, {0x0730, 0x074a}, {0x07a6, 0x07b0}, {0x07eb, 0x07f3},
+    {0x0816, 0x082d}, {0x0859, 0x085b}, {0x08d3, 0x08ff}, {0x0900, 0x0902}, {0x093a, 0x093a}, {0x093c, 0x093c},
+    {0x0941, 0x0948}, {0x094d, 0x094d}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0981, 0x0981}, {0x09bc, 0x09bc},
+    {0x09c1, 0x09c4}, {0x09cd, 0x09cd}, {0x09e2, 0x09e3}, {0x0a01, 0x0a02}, {0x0a3c, 0x0a3c}, {0x0a41, 0x0a51},
+    {0x0a70, 0x0a71}, {0x0a75, 0x0a75}, {0x0a81, 0x0a82}, {0x0abc, 0x0abc}, {0x0ac1, 0x0ac8}, {0x0acd, 0x0acd},
+    {0x0ae2, 0x0ae3}, {0x0b01, 0x0b01}, {0x0b3c, 0x0b3c}, {0x0b3f, 0x0b3f}, {0x0b41, 0x0b44}, {0x0b4d, 0x0b4d},
+    {0x0b82, 0x0b82}, {0x0bc0, 0x0bc0}, {0x0bcd, 0x0bcd}, {0x0c3e, 0x0c40}, {0x0c46, 0x0c56}, {0x0cbc, 0x0cbc},
+    {0x0ccc, 0x0ccd}, {0x0d41, 0x0d44}, {0x0d4d, 0x0d4d}, {0x0dca, 0x0dca}, {0x0dd2, 0x0dd6}, {0x0e31, 0x0e31},
+    {0x0e34, 0x0e3a}, {0x0e47, 0x0e4e}, {0x0eb1, 0x0eb1}, {0x0eb4, 0x0ebc}, {0x0ec8, 0x0ecd}, {0x0f18, 0x0f19},
+    {0x0f35, 0x0f35}, {0x0f37, 0x0f37}, {0x0f39, 0x0f39}, {0x0f71, 0x0f7e}, {0x0f80, 0x0f84}, {0x0f86, 0x0f87},
+    {0x0f8d, 0x0fbc}, {0x102d, 0x1030}, {0x1032, 0x1037}, {0x1039, 0x103a}, {0x1058, 0x1059}, {0x1160, 0x11ff},
+    {0x135d, 0x135f}, {0x1712, 0x1714}, {0x1732, 0x1734}, {0x1752, 0x1753}, {0x1772, 0x1773}, {0x17b4, 0x17b5},
+    {0x17b7, 0x17bd}, {0x17c6, 0x17c6}, {0x17c9, 0x17d3}, {0x17dd, 0x17dd}, {0x180b, 0x180f}, {0x1885, 0x1886},
+    {0x18a9, 0x18a9}, {0x1920, 0x1922}, {0x1927, 0x1928}, {0x1932, 0x1932}, {0x1939, 0x193b}, {0x1a17, 0x1a18},
+    {0x1ab0, 0x1aff}, {0x1b00, 0x1b03}, {0x1b34, 0x1b34}, {0x1b36, 0x1b3a}, {0x1b6b, 0x1b73}, {0x1dc0, 0x1dff},
+    {0x200b, 0x200f}, {0x202a, 0x202e}, {0x2060, 0x2064}, {0x20d0, 0x20ff}, {0x2cef, 0x2cf1}, {0x2de0, 0x2dff},
+    {0x302a, 0x302d}, {0x3099, 0x309a}, {0xa66f, 0xa672}, {0xa674, 0xa67d}, {0xa69e, 0xa69f}, {0xa6f0, 0xa6f1},
+    {0xa8e0, 0xa8f1}, {0xfb1e, 0xfb1e}, {0xfe00, 0xfe0f}, {0xfe20, 0xfe2f}, {0xfeff, 0xfeff}, {0x1d167, 0x1d169},
+    {0x1d17b, 0x1d182}, {0x1d185, 0x1d18b}, {0x1d1aa, 0x1d1ad}, {0x1f3fb, 0x1f3ff}, {0xe0001, 0xe0001},
+    {0xe0020, 0xe007f}, {0xe0100, 0xe01ef},
+};
+
+
+// east asian wide and fullwidth characters, and emoji that are drawn two columns wide (sorted)
+static const Utf8_range UTF8_WIDE[] = {
+    {0x1100, 0x115f}, {0x231a, 0x231b}, {0x2329, 0x232a}, {0x23e9, 0x23ec}, {0x23f0, 0x23f0}, {0x23f3, 0x23f3},
+    {0x25fd, 0x25fe}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267f, 0x267f}, {0x2693, 0x2693}, {0x26a1, 0x26a1},
+    {0x26aa, 0x26ab}, {0x26bd, 0x26be}, {0x26c4, 0x26c5}, {0x26ce, 0x26ce}, {0x26d4, 0x26d4}, {0x26ea, 0x26ea},
+    {0x26f2, 0x26f3}, {0x26f5, 0x26f5}, {0x26fa, 0x26fa}, {0x26fd, 0x26fd}, {0x2705, 0x2705}, {0x270a, 0x270b},
+    {0x2728, 0x2728}, {0x274c, 0x274c}, {0x274e, 0x274e}, {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797},
+    {0x27b0, 0x27b0}, {0x27bf, 0x27bf}, {0x2b1b, 0x2b1c}, {0x2b50, 0x2b50}, {0x2b55, 0x2b55}, {0x2e80, 0x303e},
+    {0x3041, 0x3096}, {0x309b, 0x33ff}, {0x3400, 0x4dbf}, {0x4e00, 0x9fff}, {0xa000, 0xa4cf}, {0xa960, 0xa97f},
+    {0xac00, 0xd7a3}, {0xf900, 0xfaff}, {0xfe10, 0xfe19}, {0xfe30, 0xfe6f}, {0xff00, 0xff60}, {0xffe0, 0xffe6},
+    {0x16fe0, 0x16fe4}, {0x17000, 0x18cff}, {0x1b000, 0x1b2ff}, {0x1f004, 0x1f004}, {0x1f0cf, 0x1f0cf},
+    {0x1f18e, 0x1f18e}, {0x1f191, 0x1f19a}, {0x1f200, 0x1f251}, {0x1f300, 0x1f320}, {0x1f32d, 0x1f335},
+    {0x1f337, 0x1f37c}, {0x1f37e, 0x1f393}, {0x1f3a0, 0x1f3ca}, {0x1f3cf, 0x1f3d3}, {0x1f3e0, 0x1f3f0},
+    {0x1f3f4, 0x1f3f4}, {0x1f3f8, 0x1f3fa}, {0x1f400, 0x1f43e}, {0x1f440, 0x1f440}, {0x1f442, 0x1f4fc},
+    {0x1f4ff, 0x1f53d}, {0x1f54b, 0x1f54e}, {0x1f550, 0x1f567}, {0x1f57a, 0x1f57a}, {0x1f595, 0x1f596},
+    {0x1f5a4, 0x1f5a4}, {0x1f5fb, 0x1f64f}, {0x1f680, 0x1f6c5}, {0x1f6cc, 0x1f6cc}, {0x1f6d0, 0x1f6d2},
+    {0x1f6d5, 0x1f6d7}, {0x1f6eb, 0x1f6ec}, {0x1f6f4, 0x1f6fc}, {0x1f7e0, 0x1f7eb}, {0x1f90c, 0x1f93a},
+    {0x1f93c, 0x1f945}, {0x1f947, 0x1f9ff}, {0x1fa70, 0x1faff}, {0x20000, 0x2fffd}, {0x30000, 0x3fffd},
+};
+
+
+static inline bool utf8_is_in_ranges(uint32_t code_point, const Utf8_range* ranges, size_t count_ranges) {
+    size_t low = 0;
+    size_t high = count_ranges;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (code_point < ranges[mid].first) {
+            high = mid;
+        } else if (code_point > ranges[mid].last) {
+            low = mid + 1;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// count of columns that the code point takes on the screen: 0 for combining characters, 2 for wide characters
+// (the tables are fixed, so the layout does not depend on the locale or the libc of the machine)
+static inline size_t utf8_code_point_width(uint32_t code_point) {
+    if (code_point < 0x300) {
+        return 1;
+    }
+    if (utf8_is_in_ranges(code_point, UTF8_ZERO_WIDTH, sizeof(UTF8_ZERO_WIDTH)/sizeof(UTF8_ZERO_WIDTH[0]))) {
+        return 0;
+    }
+    if (utf8_is_in_ranges(code_point, UTF8_WIDE, sizeof(UTF8_WIDE)/sizeof(UTF8_WIDE[0]))) {
+        return 2;
+    }
+    return 1;
+}
+
+
+static inline bool utf8_is_zero_width_at(const char* items, size_t idx, size_t end, size_t* len) {
+    uint32_t code_point;
+    *len = utf8_decode(&code_point, items, idx, end);
+    return code_point != UTF8_INVALID && utf8_code_point_width(code_point) == 0;
+}
+
+
+// start of the character (not cell) that ends at items[idx] (start < idx)
+static inline size_t utf8_prev_char(const char* items, size_t start, size_t idx) {
+    size_t lead = idx - 1;
+    size_t min_lead = idx - MIN(idx - start, (size_t)UTF8_MAX_LEN);
+    while (lead > min_lead && ((unsigned char)items[lead] & 0xc0) == 0x80) {
+        lead--;
+    }
+
+    uint32_t code_point;
+    size_t len = utf8_decode(&code_point, items, lead, idx);
+    if (code_point != UTF8_INVALID && lead + len == idx) {
+        return lead;
+    }
+    // byte before idx is not the end of a valid character, so it is a cell of its own
+    return idx - 1;
+}
+
+
+// returns true if items[0, count) is valid utf-8; otherwise first_invalid is set to the index of the first invalid byte
+// ascii is skipped 16 bytes at a time, so only the non ascii characters are decoded one at a time
+static inline bool utf8_validate(size_t* first_invalid, const char* items, size_t count) {
+    size_t idx = 0;
+    while (idx < count) {
+        size_t non_ascii;
+        if (!utf8_find_non_ascii(&non_ascii, items, idx, count)) {
+            return true;
+        }
+        uint32_t code_point;
+        size_t len = utf8_decode(&code_point, items, non_ascii, count);
+        if (code_point == UTF8_INVALID) {
+            *first_invalid = non_ascii;
+            return false;
+        }
+        idx = non_ascii + len;
+    }
+    return true;
+}
+
+
+#endif // UTF8_H
@@ -11,7 +11,7 @@
                     \
     static inline void vector_shift_left_##type(Vector_##type* vector, size_t start_src, size_t count_elements) { \
         assert(start_src >= count_elements); \
-        memmove(vector->items + start_src - count_elements, vector->items + start_src, count_elements); \
+        memmove(vector->items + start_src - count_elements, vector->items + start_src, count_elements * sizeof(type)); \
     } \
     static inline void vector_shift_right_##type(Vector_##type* vector, size_t index_to_insert_item, size_t size_gap_to_create) { \
         size_t count_elements_need_to_shift = vector->count - index_to_insert_item; \
@@ -19,7 +19,7 @@
         debug("vector_shift_right_char: items: %p; index_to_insert_item: %zu; count_elements_need_to_shift: %zu; vector->count: %zu", \
             (void*)vector->items, index_to_insert_item, count_elements_need_to_shift, vector->count \
         ); \
-        memmove(vector->items + index_to_insert_item + size_gap_to_create, vector->items + index_to_insert_item, count_elements_need_to_shift); \
+        memmove(vector->items + index_to_insert_item + size_gap_to_create, vector->items + index_to_insert_item, count_elements_need_to_shift * sizeof(type)); \
     } \
     static inline void vector_init_##type(Vector_##type* vector) { \
         memset(vector, 0, sizeof(*vector)); \
@@ -43,7 +43,7 @@
     static inline void vector_insert_##type(Vector_##type* vector, const type* item, size_t index) { \
         vector_enlarge_if_nessessary_##type(vector, vector->count + 1); \
         assert(vector->capacity >= vector->count + 1); \
-        memmove(vector->items + index + 1, vector->items + index, vector->count - index); \
+        memmove(vector->items + index + 1, vector->items + index, (vector->count - index) * sizeof(type)); \
         vector->items[index] = *item; \
         vector->count++; \
     } \
@@ -55,14 +55,26 @@
         vector_shift_right_##type(dest, index_dest, src->count); \
         \
         /* copy elements */ \
-        memmove(dest->items + index_dest, src->items, src->count); \
+        memmove(dest->items + index_dest, src->items, src->count * sizeof(type)); \
 \
         dest->count += src->count; \
     } \
+    static inline void vector_insert_items_##type(Vector_##type* dest, const type* items, size_t count_items, size_t index_dest) { \
+        assert(index_dest <= dest->count); \
+        vector_enlarge_if_nessessary_##type(dest, dest->count + count_items); \
+        \
+        /* make space for items to be inserted, then copy them in one go */ \
+        memmove(dest->items + index_dest + count_items, dest->items + index_dest, (dest->count - index_dest) * sizeof(type)); \
+        memmove(dest->items + index_dest, items, count_items * sizeof(type)); \
+\
+        dest->count += count_items; \
+    } \
+    /* dest must be initialized (its items are reused); only count_src elements are allocated */ \
     static inline void vector_get_from_subvector_##type(Vector_##type* dest, const Vector_##type* src, size_t index_src, size_t count_src) { \
-        memset(dest, 0, sizeof(*dest)); \
-        vector_enlarge_if_nessessary_##type(dest, src->count); \
-        assert(dest->capacity >= src->count); \
+        assert(index_src + count_src <= src->count); \
+        dest->count = 0; \
+        vector_enlarge_if_nessessary_##type(dest, count_src); \
+        assert(dest->capacity >= count_src); \
         \
         \
         /* copy elements */ \
@@ -89,6 +101,11 @@
         memmove(vector->items + index, vector->items + index + 1, sizeof(type) * (vector->count - index - 1)); \
         vector->count--; \
     } \
+    static inline void vector_remove_range_##type(Vector_##type* vector, size_t index, size_t count_items) { \
+        assert(index + count_items <= vector->count); \
+        memmove(vector->items + index, vector->items + index + count_items, sizeof(type) * (vector->count - index - count_items)); \
+        vector->count -= count_items; \
+    } \
     static inline void vector_pop_##type(type* popped_item, Vector_##type* vector) { \
         vector_remove_##type(popped_item, vector, vector->count - 1); \
     } \
@@ -0,0 +1,230 @@
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+
+#include "util.h"
+#include "vector.h"
+#include "text_box.h"
+
+
+// one visual line as it appears on the screen
+// the part of the row that is on the screen is found once per frame when the viewport is built (characters can be 
+// several bytes long, and several columns wide, so bytes and columns only match if the row is printable ascii)
+typedef struct {
+    size_t start; // absolute position of the first character of the row
+    size_t count; // count bytes in the row (including the line ending, if any)
+    size_t visual_y; // visual line of the row (in terms of the whole text, not the screen)
+
+    size_t draw_start; // absolute position of the first character that is drawn
+    size_t draw_end; // absolute position one past the last character that is drawn
+    size_t draw_x; // screen column of draw_start (not 0 if a wide character or a tab is cut by the horizontal scroll)
+    size_t draw_visual_x; // column of draw_start on the row (less than the horizontal scroll if the row ends left of the screen)
+    bool is_plain; // every drawn character is printable ascii (so it can be drawn as is)
+    bool is_folded; // the row is the header of a closed fold (the hidden lines after it are not part of the row)
+} Visual_row;
+
+
+define_vector(Visual_row)
+
+
+// rows currently displayed in a window
+// this is built once per frame, and then used for drawing, highlighting, and cursor placement
+typedef struct {
+    Vector_Visual_row rows;
+    size_t end; // absolute position one past the last displayed character
+    size_t x; // first displayed column of every row (horizontal scroll; 0 if lines are wrapped)
+    size_t max_visual_width; // wrap width that the rows were built with
+} Viewport;
+
+
+static inline void Viewport_init(Viewport* viewport) {
+    memset(viewport, 0, sizeof(*viewport));
+}
+
+
+static inline void Viewport_free(Viewport* viewport) {
+    free(viewport->rows.items);
+    memset(viewport, 0, sizeof(*viewport));
+}
+
+
+static inline const Visual_row* Viewport_row_at(const Viewport* viewport, size_t screen_y) {
+    assert(screen_y < viewport->rows.count && "out of bounds");
+    return &viewport->rows.items[screen_y];
+}
+
+
+// count of characters in the row that should actually be printed (line ending is not printed)
+static inline size_t Visual_row_count_printable(const Visual_row* row, const String* string) {
+    size_t count = row->count;
+    if (count > 0 && String_at(string, row->start + count - 1) == '\n') {
+        count--;
+    }
+    return count;
+}
+
+
+// find the characters of the row that are between column x and column x + screen_width
+// (only the bytes up to there are looked at, because rows can be very long if lines are not wrapped; 
+// far to the right, column x is found with the column map of the line)
+static inline void Visual_row_set_drawn_part(Visual_row* row, const String* string, size_t x, size_t screen_width, size_t max_visual_width) {
+    size_t end_printable = row->start + Visual_row_count_printable(row, string);
+    size_t special;
+    if (x < COLUMN_MAP_MIN_BYTES && !columns_find_special(&special, string->items, row->start, MIN(end_printable, row->start + x + screen_width + 1), false)) {
+        row->is_plain = true;
+        row->draw_x = 0;
+        row->draw_start = MIN(row->start + x, end_printable);
+        row->draw_visual_x = row->draw_start - row->start;
+        row->draw_end = MIN(row->draw_start + screen_width, end_printable);
+        return;
+    }
+
+    size_t count_columns;
+    if (x < COLUMN_MAP_MIN_BYTES) {
+        row->draw_start = columns_skip(&count_columns, string->items, row->start, end_printable, 0, x, max_visual_width);
+    } else {
+        const Column_map* map = Column_map_get_at(string, row->start, max_visual_width);
+        row->draw_start = Column_map_find_column(&count_columns, map, string, row->start, end_printable, x);
+    }
+    row->draw_x = 0;
+    if (count_columns < x && row->draw_start < end_printable) {
+        // wide character or tab that starts left of the screen is not drawn
+        size_t width;
+        row->draw_start = columns_next_cell(&width, string->items, row->draw_start, end_printable, count_columns, max_visual_width);
+        count_columns += width;
+        row->draw_x = count_columns - x;
+    }
+    row->draw_visual_x = count_columns;
+    row->draw_end = columns_skip(
+        &count_columns, string->items, row->draw_start, end_printable, row->draw_visual_x, screen_width - MIN(row->draw_x, screen_width), max_visual_width
+    );
+    row->is_plain = !columns_find_special(&special, string->items, row->draw_start, row->draw_end, false);
+}
+
+
+// walk the visible text once, starting at the scroll offset
+// if lines are not wrapped, max_visual_width is TEXT_BOX_NO_WRAP, and every row is a whole actual line
+// (only the part of it starting at column scroll->x is drawn)
+static inline void Viewport_build(
+    Viewport* viewport,
+    const String* string,
+    const Scroll_data* scroll,
+    size_t max_visual_height,
+    size_t max_visual_width,
+    size_t screen_width
+) {
+    viewport->rows.count = 0;
+    viewport->x = scroll->x;
+    viewport->max_visual_width = max_visual_width;
+
+    Pos_data curr_pos = {.cursor = scroll->offset, .visual_x = 0, .visual_y = scroll->y};
+    for (size_t idx = 0; idx < max_visual_height; idx++) {
+        Pos_data start_next_line;
+        bool has_next_line = get_start_next_visual_line_from_curr_cursor_x(
+            &start_next_line,
+            string,
+            &curr_pos,
+            max_visual_width
+        );
+
+        size_t end_curr_row = has_next_line ? start_next_line.cursor : string->count;
+        Visual_row new_row = {.start = curr_pos.cursor, .count = end_curr_row - curr_pos.cursor, .visual_y = curr_pos.visual_y};
+        if (has_next_line) {
+            // the lines of a closed fold are skipped (see fold.h)
+            start_next_line.cursor = folds_skip_forward(string, end_curr_row);
+            new_row.is_folded = start_next_line.cursor != end_curr_row;
+            has_next_line = start_next_line.cursor < string->count;
+        }
+        Visual_row_set_drawn_part(&new_row, string, scroll->x, screen_width, max_visual_width);
+        vector_append_Visual_row(&viewport->rows, &new_row);
+
+        if (!has_next_line) {
+            break;
+        }
+
+        curr_pos = start_next_line;
+        curr_pos.visual_x = 0;
+    }
+
+    viewport->end = scroll->offset;
+    if (viewport->rows.count > 0) {
+        const Visual_row* last_row = vector_back_Visual_row(&viewport->rows);
+        viewport->end = last_row->start + last_row->count;
+    }
+}
+
+
+// screen column of position idx of the row (idx is at the start of a character at or after draw_start)
+static inline size_t Visual_row_get_screen_x(const Visual_row* row, const Viewport* viewport, const String* string, size_t idx) {
+    assert(idx >= row->draw_start);
+    if (row->is_plain) {
+        return row->draw_x + (idx - row->draw_start);
+    }
+    return row->draw_x + columns_count(string->items, row->draw_start, idx, row->draw_visual_x, viewport->max_visual_width);
+}
+
+
+// screen columns of the row that show string[start, end), including the line ending, and (on the last row of the text)
+// the column after the last character, where the cursor is drawn at the end of the text
+// returns the count of columns (not limited to the width of the screen), and sets screen_x to the first of them
+static inline size_t Visual_row_get_screen_span(
+    size_t* screen_x,
+    const Visual_row* row,
+    const Viewport* viewport,
+    const String* string,
+    size_t start,
+    size_t end
+) {
+    size_t end_printable = row->start + Visual_row_count_printable(row, string);
+    size_t end_row = row->start + row->count;
+    size_t seg_start = MAX(start, row->draw_start);
+    size_t seg_end = MIN(end, row->draw_end);
+    size_t count_columns = 0;
+    *screen_x = 0;
+    if (seg_start < seg_end) {
+        *screen_x = Visual_row_get_screen_x(row, viewport, string, seg_start);
+        count_columns = Visual_row_get_screen_x(row, viewport, string, seg_end) - *screen_x;
+    }
+
+    // the line ending (and the end of the text) is one column each, if the row is drawn up to it
+    bool is_drawn_to_end = row->draw_end == end_printable && !(row->draw_start == end_printable && row->draw_visual_x < viewport->x);
+    if (!is_drawn_to_end) {
+        return count_columns;
+    }
+    if (end_printable < end_row && start <= end_printable && end > end_printable) {
+        if (count_columns < 1) {
+            *screen_x = Visual_row_get_screen_x(row, viewport, string, end_printable);
+        }
+        count_columns++;
+    }
+    bool is_last_row = viewport->rows.count > 0 && row == &viewport->rows.items[viewport->rows.count - 1];
+    if (is_last_row && end_row == string->count && start <= end_row && end > end_row) {
+        if (count_columns < 1) {
+            *screen_x = Visual_row_get_screen_x(row, viewport, string, end_row);
+        }
+        count_columns++;
+    }
+    return count_columns;
+}
+
+
+// returns false if cursor is not within the viewport (or is left of the horizontally scrolled screen)
+static inline bool Viewport_get_screen_yx(size_t* screen_y, size_t* screen_x, const Viewport* viewport, const String* string, size_t cursor) {
+    for (size_t idx = 0; idx < viewport->rows.count; idx++) {
+        const Visual_row* row = Viewport_row_at(viewport, idx);
+        bool is_last_row = idx + 1 >= viewport->rows.count;
+        if (cursor >= row->start && (cursor < row->start + row->count || (is_last_row && cursor == row->start + row->count))) {
+            // (the line ending of a row that ends left of the screen is at draw_start too)
+            if (cursor < row->draw_start || (cursor == row->draw_start && row->draw_visual_x < viewport->x)) {
+                return false;
+            }
+            *screen_x = Visual_row_get_screen_x(row, viewport, string, cursor);
+            *screen_y = idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+#endif // VIEWPORT_H
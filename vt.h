@@ -0,0 +1,368 @@
+#ifndef VT_H
+#define VT_H
+
+
+// lightweight terminal backend that writes vt escape sequences directly (alternative to ncurses; see --vt)
+//
+// every frame is drawn into the back grid; Vt_screen_flush compares it with the front grid (what the terminal
+// currently shows), and writes only the cells that changed, with one write call
+
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include "util.h"
+#include "new_string.h"
+#include "columns.h"
+
+
+typedef uint8_t VT_ATTR;
+#define VT_ATTR_NONE      0
+#define VT_ATTR_HIGHLIGHT (1 << 0) // same colors as SEARCH_RESULT_PAIR (black text on green background)
+#define VT_ATTR_REVERSE   (1 << 1)
+#define VT_ATTR_UNDERLINE (1 << 2)
+// text color (one of the 8 ansi colors) is stored in the high bits (0 is the default color)
+#define VT_ATTR_FG_SHIFT  4
+#define VT_ATTR_FG_MASK   (0xf << VT_ATTR_FG_SHIFT)
+#define VT_ATTR_MAX_FG    8
+#define VT_ATTR_FG(color) ((VT_ATTR)(((color) + 1) << VT_ATTR_FG_SHIFT))
+
+
+// a character together with its combining characters (longer combining sequences are cut off)
+#define VT_CELL_MAX_BYTES 14
+
+
+typedef struct {
+    char bytes[VT_CELL_MAX_BYTES]; // utf-8 of what is drawn in the cell
+    uint8_t count; // count of bytes; 0 if the cell is the right half of a wide character
+    VT_ATTR attr;
+} Vt_cell;
+
+
+typedef struct {
+    int height;
+    int width;
+    Vt_cell* front; // what the terminal currently shows
+    Vt_cell* back; // frame that is being drawn
+    bool front_valid; // false if the terminal contents are unknown (eg. after a resize)
+
+    int cursor_y;
+    int cursor_x;
+
+    bool has_color;
+    bool is_raw;
+    struct termios orig_termios;
+
+    String out; // escape sequences and text of the frame (written with one write call)
+} Vt_screen;
+
+
+static volatile sig_atomic_t vt_did_resize = 0;
+
+
+static void vt_on_resize(int signal_num) {
+    (void) signal_num;
+    vt_did_resize = 1;
+}
+
+
+static inline void Vt_screen_init(Vt_screen* vt) {
+    memset(vt, 0, sizeof(*vt));
+    String_init(&vt->out);
+}
+
+
+static inline void Vt_screen_free(Vt_screen* vt) {
+    free(vt->front);
+    free(vt->back);
+    String_free_char_data(&vt->out);
+    memset(vt, 0, sizeof(*vt));
+}
+
+
+static inline void Vt_screen_write_all(const char* data, size_t count) {
+    size_t total_written = 0;
+    while (total_written < count) {
+        ssize_t amount_written = write(STDOUT_FILENO, data + total_written, count - total_written);
+        if (amount_written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log("error: could not write to terminal: errno: %d: %s", errno, strerror(errno));
+            return;
+        }
+        total_written += amount_written;
+    }
+}
+
+
+static inline void Vt_screen_append_cstr(Vt_screen* vt, const char* cstr) {
+    String_append_cstr(&vt->out, cstr, strlen(cstr));
+}
+
+
+// size of the terminal
+static inline void Vt_screen_resize(Vt_screen* vt) {
+    struct winsize size;
+    if (0 != ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) || size.ws_row < 1 || size.ws_col < 1) {
+        log("warning: could not get terminal size; using 24x80");
+        size.ws_row = 24;
+        size.ws_col = 80;
+    }
+
+    vt->height = size.ws_row;
+    vt->width = size.ws_col;
+    size_t count_cells = (size_t)vt->height * (size_t)vt->width;
+    vt->front = safe_realloc(vt->front, count_cells * sizeof(*vt->front));
+    vt->back = safe_realloc(vt->back, count_cells * sizeof(*vt->back));
+    vt->front_valid = false;
+}
+
+
+// switch terminal to raw mode and to the alternate screen
+// returns false if stdin is not a terminal
+static inline bool Vt_screen_enter(Vt_screen* vt) {
+    if (0 != tcgetattr(STDIN_FILENO, &vt->orig_termios)) {
+        log("error: could not get terminal attributes: errno: %d: %s", errno, strerror(errno));
+        return false;
+    }
+
+    struct termios raw = vt->orig_termios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_oflag &= ~(OPOST);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (0 != tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw)) {
+        log("error: could not set terminal attributes: errno: %d: %s", errno, strerror(errno));
+        return false;
+    }
+    vt->is_raw = true;
+
+    struct sigaction resize_action;
+    memset(&resize_action, 0, sizeof(resize_action));
+    resize_action.sa_handler = vt_on_resize;
+    sigemptyset(&resize_action.sa_mask);
+    sigaction(SIGWINCH, &resize_action, NULL);
+
+    // alternate screen; clear screen
+    const char* enter_seq = "\033[?1049h\033[H\033[2J";
+    Vt_screen_write_all(enter_seq, strlen(enter_seq));
+    Vt_screen_resize(vt);
+    return true;
+}
+
+
+static inline void Vt_screen_leave(Vt_screen* vt) {
+    if (!vt->is_raw) {
+        return;
+    }
+    // reset attributes; show cursor; leave alternate screen
+    const char* leave_seq = "\033[0m\033[?25h\033[?1049l";
+    Vt_screen_write_all(leave_seq, strlen(leave_seq));
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &vt->orig_termios);
+    vt->is_raw = false;
+}
+
+
+static inline Vt_cell* Vt_screen_back_at(Vt_screen* vt, int y, int x) {
+    assert(y >= 0 && y < vt->height && x >= 0 && x < vt->width && "out of bounds");
+    return &vt->back[(size_t)y * vt->width + x];
+}
+
+
+static inline void Vt_screen_clear(Vt_screen* vt) {
+    size_t count_cells = (size_t)vt->height * (size_t)vt->width;
+    for (size_t idx = 0; idx < count_cells; idx++) {
+        vt->back[idx].bytes[0] = ' ';
+        vt->back[idx].count = 1;
+        vt->back[idx].attr = VT_ATTR_NONE;
+    }
+}
+
+
+static inline void Vt_cell_set(Vt_cell* cell, const char* bytes, size_t count) {
+    assert(count <= VT_CELL_MAX_BYTES);
+    memcpy(cell->bytes, bytes, count);
+    cell->count = count;
+    cell->attr = VT_ATTR_NONE;
+}
+
+
+// right half of a wide character whose left half was overwritten is cleared
+static inline void Vt_screen_clear_right_half(const Vt_screen* vt, Vt_cell* row, int x) {
+    if (x < vt->width && row[x].count == 0) {
+        Vt_cell_set(&row[x], " ", 1);
+    }
+}
+
+
+// str is utf-8; characters past the right edge of the screen are dropped
+static inline void Vt_screen_put_str(Vt_screen* vt, int y, int x, const char* str, size_t count) {
+    if (y < 0 || y >= vt->height || x >= vt->width) {
+        return;
+    }
+    Vt_cell* row = Vt_screen_back_at(vt, y, 0);
+    if (x > 0 && row[x].count == 0) {
+        // left half of a wide character that is overwritten
+        Vt_cell_set(&row[x - 1], " ", 1);
+    }
+
+    size_t idx = 0;
+    int curr_x = x;
+    while (idx < count && curr_x < vt->width) {
+        unsigned char curr_char = str[idx];
+        if (curr_char < 0x80 && (idx + 1 >= count || (unsigned char)str[idx + 1] < 0x80)) {
+            // control characters would move the terminal cursor
+            char new_char = (curr_char < ' ' || curr_char == 0x7f) ? ' ' : (char)curr_char;
+            Vt_cell_set(&row[curr_x], &new_char, 1);
+            Vt_screen_clear_right_half(vt, row, curr_x + 1);
+            idx++;
+            curr_x++;
+            continue;
+        }
+
+        size_t width;
+        size_t end_cell = columns_next_cell(&width, str, idx, count, curr_x, SIZE_MAX);
+        uint32_t code_point;
+        size_t len_first = utf8_decode(&code_point, str, idx, count);
+        if (code_point == UTF8_INVALID) {
+            Vt_cell_set(&row[curr_x], UTF8_REPLACEMENT, UTF8_REPLACEMENT_LEN);
+        } else if (width > 1 && curr_x + 1 >= vt->width) {
+            // wide character does not fit in the last column
+            Vt_cell_set(&row[curr_x], " ", 1);
+        } else {
+            Vt_cell_set(&row[curr_x], str + idx, end_cell - idx <= VT_CELL_MAX_BYTES ? end_cell - idx : len_first);
+        }
+        if (width > 1 && curr_x + 1 < vt->width) {
+            row[curr_x + 1].count = 0;
+            row[curr_x + 1].attr = VT_ATTR_NONE;
+            Vt_screen_clear_right_half(vt, row, curr_x + 2);
+        } else {
+            Vt_screen_clear_right_half(vt, row, curr_x + 1);
+        }
+        idx = end_cell;
+        curr_x += width;
+    }
+}
+
+
+static inline void Vt_screen_set_attr(Vt_screen* vt, int y, int x, size_t count, VT_ATTR attr) {
+    if (y < 0 || y >= vt->height || x >= vt->width) {
+        return;
+    }
+    size_t count_fits = MIN(count, (size_t)(vt->width - x));
+    Vt_cell* cells = Vt_screen_back_at(vt, y, x);
+    for (size_t idx = 0; idx < count_fits; idx++) {
+        // (a text color replaces the one that was set before)
+        VT_ATTR prev_attr = attr & VT_ATTR_FG_MASK ? cells[idx].attr & ~VT_ATTR_FG_MASK : cells[idx].attr;
+        cells[idx].attr = prev_attr | attr;
+    }
+}
+
+
+static inline void Vt_screen_set_cursor(Vt_screen* vt, int y, int x) {
+    vt->cursor_y = y;
+    vt->cursor_x = x;
+}
+
+
+static inline void Vt_screen_append_attr(Vt_screen* vt, VT_ATTR attr) {
+    Vt_screen_append_cstr(vt, "\033[0");
+    if ((attr & VT_ATTR_HIGHLIGHT) && vt->has_color) {
+        Vt_screen_append_cstr(vt, ";30;42");
+    } else if ((attr & VT_ATTR_FG_MASK) && vt->has_color) {
+        char buf[8];
+        int len = snprintf(buf, sizeof(buf), ";%d", 30 + ((attr & VT_ATTR_FG_MASK) >> VT_ATTR_FG_SHIFT) - 1);
+        String_append_cstr(&vt->out, buf, len);
+    }
+    if (attr & VT_ATTR_UNDERLINE) {
+        Vt_screen_append_cstr(vt, ";4");
+    }
+    if (attr & VT_ATTR_REVERSE) {
+        Vt_screen_append_cstr(vt, ";7");
+    }
+    Vt_screen_append_cstr(vt, "m");
+}
+
+
+static inline void Vt_screen_append_move(Vt_screen* vt, int y, int x) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\033[%d;%dH", y + 1, x + 1);
+    String_append_cstr(&vt->out, buf, len);
+}
+
+
+// rewriting a few unchanged cells is shorter than moving the cursor past them
+#define VT_MAX_UNCHANGED_REWRITE 6
+
+
+static inline bool Vt_cell_equal(const Vt_cell* lhs, const Vt_cell* rhs) {
+    return lhs->count == rhs->count && lhs->attr == rhs->attr && 0 == memcmp(lhs->bytes, rhs->bytes, lhs->count);
+}
+
+
+// send the changes since the previous frame to the terminal
+static inline void Vt_screen_flush(Vt_screen* vt) {
+    vt->out.count = 0;
+    Vt_screen_append_cstr(vt, "\033[?25l"); // hide cursor while drawing
+    if (!vt->front_valid) {
+        Vt_screen_append_cstr(vt, "\033[0m\033[2J");
+    }
+
+    VT_ATTR curr_attr = VT_ATTR_NONE;
+    Vt_screen_append_attr(vt, curr_attr);
+
+    for (int y = 0; y < vt->height; y++) {
+        const Vt_cell* back_row = &vt->back[(size_t)y * vt->width];
+        const Vt_cell* front_row = &vt->front[(size_t)y * vt->width];
+        int term_x = -1; // column of the terminal cursor if it is on this row (-1 if unknown)
+
+        int x = 0;
+        while (x < vt->width) {
+            if (vt->front_valid && Vt_cell_equal(&back_row[x], &front_row[x])) {
+                x++;
+                continue;
+            }
+            if (back_row[x].count == 0 && x > 0) {
+                // right half of a wide character is written together with its left half
+                x--;
+            }
+
+            // write unchanged cells in between if that is shorter than moving the cursor
+            if (term_x < 0 || x < term_x || x - term_x > VT_MAX_UNCHANGED_REWRITE) {
+                Vt_screen_append_move(vt, y, x);
+                term_x = x;
+            }
+            while (term_x <= x) {
+                const Vt_cell* cell = &back_row[term_x];
+                if (cell->attr != curr_attr) {
+                    curr_attr = cell->attr;
+                    Vt_screen_append_attr(vt, curr_attr);
+                }
+                String_append_cstr(&vt->out, cell->bytes, cell->count);
+                // terminal moves past both halves of a wide character
+                term_x += (term_x + 1 < vt->width && back_row[term_x + 1].count == 0) ? 2 : 1;
+            }
+            x = term_x;
+        }
+    }
+
+    if (curr_attr != VT_ATTR_NONE) {
+        Vt_screen_append_attr(vt, VT_ATTR_NONE);
+    }
+    Vt_screen_append_move(vt, vt->cursor_y, vt->cursor_x);
+    Vt_screen_append_cstr(vt, "\033[?25h");
+    Vt_screen_write_all(vt->out.items, vt->out.count);
+
+    // back grid is now on the screen
+    Vt_cell* temp = vt->front;
+    vt->front = vt->back;
+    vt->back = temp;
+    vt->front_valid = true;
+}
+
+
+#endif // VT_H